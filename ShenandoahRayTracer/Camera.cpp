@@ -20,7 +20,7 @@ Camera::Camera()
 	// These are set to 1 instead of zero since zero can cause division errors.
 	resolution_x = 1;
 	resolution_y = 1;
-	aspect_ratio = resolution_x / resolution_y;
+	aspect_ratio = (float)resolution_x / resolution_y;
 
 	vertical_fov = 90;
 	SetHeightAndWidth();
@@ -43,7 +43,7 @@ Camera::Camera(Vector3 _origin, Vector3 _up, Vector3 _right, int _resx, int _res
 	focal_length = _focal;
 	resolution_x = _resx;
 	resolution_y = _resy;
-	aspect_ratio = resolution_x / resolution_y;
+	aspect_ratio = (float)resolution_x / resolution_y;
 
 	vertical_fov = _vertical_fov;
 	SetHeightAndWidth();
@@ -127,7 +127,7 @@ void Camera::SetUp(Vector3 vec)
 void Camera::SetResolutionX(int new_x)
 {
 	resolution_x = new_x;
-	aspect_ratio = resolution_x / resolution_y;
+	aspect_ratio = (float)resolution_x / resolution_y;
 
 	SetHeightAndWidth();
 
@@ -137,7 +137,7 @@ void Camera::SetResolutionX(int new_x)
 void Camera::SetResolutionY(int new_y)
 {
 	resolution_y = new_y;
-	aspect_ratio = resolution_x / resolution_y;
+	aspect_ratio = (float)resolution_x / resolution_y;
 
 	SetHeightAndWidth();
 
@@ -176,32 +176,51 @@ Vector3 Camera::GetPixelRayDirection(int i, int j)
 
 // Same as previous method, but in-place.
 void Camera::GetPixelRayDirection(int i, int j, float* output_location)
+{
+	GetRayDirection(i + 0.5f, j + 0.5f, output_location);
+}
+
+// Compares every value that goes into the rays, bit for bit.
+bool Camera::Equals(Camera other)
+{
+	// The vector array holds the origin and every direction, exactly as they
+	// are used to generate rays.
+	return memcmp(vectors, other.vectors, sizeof(vectors)) == 0 &&
+		resolution_x == other.resolution_x && resolution_y == other.resolution_y &&
+		vertical_fov == other.vertical_fov && focal_length == other.focal_length;
+}
+
+void Camera::GetRayDirection(float x, float y, float* output_location)
 {
 	float u = -(left_distance + (right_distance - left_distance) *
-		(i + 0.5) / resolution_x);
+		(double)x / resolution_x);
 	float v = -(bottom_distance + (top_distance - bottom_distance) *
-		(j + 0.5) / resolution_y);
+		(double)y / resolution_y);
 	
 	// In this situation we multiply the vectors that are in the array by their
 	// respective values.  This saves allocation time, since we only have to
 	// use the temp_vectors variable that is pre-allocated in the constructor.
-	Vector3::MultiplyF(forward_address, focal_length, output_location);
-	Vector3::MultiplyF(right_address, u, &temp_vectors[0]);
+	Vector3::MultiplyF(&vectors[FORWARD_OFFSET], focal_length, output_location);
+	Vector3::MultiplyF(&vectors[RIGHT_OFFSET], u, &temp_vectors[0]);
 	Vector3::Add(output_location, &temp_vectors[0], output_location);
-	Vector3::MultiplyF(up_address, v, &temp_vectors[0]);
+	Vector3::MultiplyF(&vectors[UP_OFFSET], v, &temp_vectors[0]);
 	Vector3::Add(output_location, &temp_vectors[0], output_location);
 	Vector3::Normalize(output_location);
 }
 
+float Camera::GetPixelSpreadAngle()
+{
+	return atan((top_distance - bottom_distance) / resolution_y / focal_length);
+}
 
 // Puts the values in the origin, up, right, and forward vectors into the array.
 // Should be called any time a camera vector is changed.
 void Camera::RefreshVectorArray()
 {
-	origin.Copy(origin_address);
-	up.Copy(up_address);
-	right.Copy(right_address);
-	forward.Copy(forward_address);
+	origin.Copy(&vectors[ORIGIN_OFFSET]);
+	up.Copy(&vectors[UP_OFFSET]);
+	right.Copy(&vectors[RIGHT_OFFSET]);
+	forward.Copy(&vectors[FORWARD_OFFSET]);
 }
 
 // Should be called every time the FOV, resolution, or focal length change.
@@ -2,6 +2,7 @@
 
 #define _USE_MATH_DEFINES
 
+#include <cstring>
 #include <math.h>
 #include "Vector.h"
 
@@ -33,6 +34,19 @@ public:
 	Vector3 GetPixelRayDirection(int i, int j);
 	void GetPixelRayDirection(int i, int j, float* output_location);
 
+	// Same as the in-place GetPixelRayDirection, but for any point on the
+	// image plane rather than the centre of a pixel.  x and y are measured in
+	// pixels, so the centre of pixel (i, j) is (i + 0.5, j + 0.5).
+	void GetRayDirection(float x, float y, float* output_location);
+
+	// The angle in radians between the rays through neighbouring pixels at
+	// the centre of the image, which is how quickly the footprint of a
+	// camera ray grows with distance.
+	float GetPixelSpreadAngle();
+
+	// Whether another camera generates exactly the same rays as this one.
+	bool Equals(Camera other);
+
 private:
 	Vector3 origin;  // O
 	Vector3 up;      // vv
@@ -43,10 +57,13 @@ private:
 					   // copy them during runtime.
 	float temp_vectors[3];
 
-	float* origin_address = &vectors[0];
-	float* up_address = &vectors[3];
-	float* right_address = &vectors[6];
-	float* forward_address = &vectors[9];
+	// Offsets of each vector within the array.  These are offsets rather than
+	// pointers so that copying a camera doesn't leave the copy pointing at the
+	// original's array, which lets each render thread use its own copy.
+	static const int ORIGIN_OFFSET = 0;
+	static const int UP_OFFSET = 3;
+	static const int RIGHT_OFFSET = 6;
+	static const int FORWARD_OFFSET = 9;
 
 
 	float focal_length; // d
@@ -0,0 +1,262 @@
+#include "Denoiser.h"
+
+// How many standard deviations of noise two colours can differ by and still
+// be blurred together.
+#define COLOR_SIGMA 4.0f
+// The power the cosine between two normals is raised to.  Higher values stop
+// the blur at shallower creases.  Hits only have the geometric normals of
+// their triangles, so this has to be low enough to blend neighbouring facets
+// of a curved mesh.
+#define NORMAL_POWER 16.0f
+// How far off the local slope of the depth two pixels can be, relative to
+// their distance apart.
+#define DEPTH_SIGMA 1.0f
+// How far apart two albedos can be, summed over the channels.
+#define ALBEDO_SIGMA 0.1f
+// How far apart the coverage of two pixels can be.  Pixels on silhouettes
+// are partly background, so they shouldn't bleed into the object's inside.
+#define COVERAGE_SIGMA 0.1f
+
+Denoiser::Denoiser()
+{
+
+}
+
+void Denoiser::SetIterations(int _iterations)
+{
+	if (_iterations <= 0 || _iterations > 10)
+		throw std::invalid_argument("The denoiser iterations must be from 1 to 10.");
+
+	iterations = _iterations;
+}
+
+int Denoiser::GetIterations()
+{
+	return iterations;
+}
+
+void Denoiser::Denoise(FrameBuffer* frame, int max_threads, int* output_location)
+{
+	if (!frame->HasAOVs())
+		throw std::invalid_argument("The denoiser needs a frame buffer with AOVs.");
+
+	Buffers buffers;
+	int width = frame->GetWidth();
+	int height = frame->GetHeight();
+	int num_pixels = width * height;
+	buffers.width = width;
+	buffers.height = height;
+
+	buffers.albedos.resize(num_pixels * 3);
+	buffers.normals.resize(num_pixels * 3);
+	buffers.depths.resize(num_pixels);
+	buffers.coverages.resize(num_pixels);
+	buffers.depth_gradients.resize(num_pixels);
+	for (int i = 0; i < 2; i++)
+	{
+		buffers.colors[i].resize(num_pixels * 3);
+		buffers.variances[i].resize(num_pixels);
+	}
+
+	for (int p = 0; p < num_pixels; p++)
+	{
+		frame->GetColor(p, &buffers.colors[0][p * 3]);
+		frame->GetAlbedo(p, &buffers.albedos[p * 3]);
+		frame->GetNormal(p, &buffers.normals[p * 3]);
+		buffers.depths[p] = frame->GetDepth(p);
+		buffers.coverages[p] = frame->GetCoverage(p);
+	}
+
+	// The slope of the depth is what two neighbours would differ by on a flat
+	// surface, so surfaces seen at a grazing angle aren't split up.
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int left = y * width + std::max(x - 1, 0);
+			int right = y * width + std::min(x + 1, width - 1);
+			int up = std::max(y - 1, 0) * width + x;
+			int down = std::min(y + 1, height - 1) * width + x;
+
+			float dx = fabs(buffers.depths[right] - buffers.depths[left]) /
+				std::max(std::min(x + 1, width - 1) - std::max(x - 1, 0), 1);
+			float dy = fabs(buffers.depths[down] - buffers.depths[up]) /
+				std::max(std::min(y + 1, height - 1) - std::max(y - 1, 0), 1);
+			buffers.depth_gradients[y * width + x] = fmax(dx, dy);
+		}
+	}
+
+	EstimateVariance(frame, &buffers);
+
+	int num_threads = std::max(std::min(max_threads, height), 1);
+	int source = 0;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < num_threads; t++)
+		{
+			int first_row = height * t / num_threads;
+			int end_row = height * (t + 1) / num_threads;
+			threads.push_back(std::thread(&Denoiser::FilterRows, &buffers, source,
+										  1 << i, first_row, end_row));
+		}
+
+		for (int t = 0; t < num_threads; t++)
+			threads[t].join();
+
+		source = 1 - source;
+	}
+
+	for (int p = 0; p < num_pixels * 3; p++)
+		output_location[p] = (int)round(buffers.colors[source][p]);
+}
+
+void Denoiser::FilterRows(Buffers* buffers, int source, int step,
+						  int first_row, int end_row)
+{
+	const float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+	const float blur[3] = { 1.0f / 4, 1.0f / 2, 1.0f / 4 };
+
+	int width = buffers->width;
+	int height = buffers->height;
+	float* colors = buffers->colors[source].data();
+	float* variances = buffers->variances[source].data();
+	float* output_colors = buffers->colors[1 - source].data();
+	float* output_variances = buffers->variances[1 - source].data();
+
+	for (int y = first_row; y < end_row; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int p = y * width + x;
+			float* normal = &buffers->normals[p * 3];
+			float* albedo = &buffers->albedos[p * 3];
+			float depth = buffers->depths[p];
+			float coverage = buffers->coverages[p];
+			float gradient = buffers->depth_gradients[p];
+			float luminance = FrameBuffer::GetLuminance(&colors[p * 3]);
+			bool missed = normal[0] == 0 && normal[1] == 0 && normal[2] == 0;
+
+			// The variance of a single pixel is itself noisy, so it is blurred
+			// a little before it sets how strict the colour weight is.
+			float variance = 0;
+			float variance_weight = 0;
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int qx = x + dx, qy = y + dy;
+					if (qx < 0 || qx >= width || qy < 0 || qy >= height)
+						continue;
+
+					float w = blur[dx + 1] * blur[dy + 1];
+					variance += variances[qy * width + qx] * w;
+					variance_weight += w;
+				}
+			}
+			float color_scale = COLOR_SIGMA * sqrt(variance / variance_weight) + 1e-4f;
+
+			float color_sum[3] = { 0, 0, 0 };
+			float variance_sum = 0;
+			float weight_sum = 0;
+
+			for (int dy = -2; dy <= 2; dy++)
+			{
+				int qy = y + dy * step;
+				if (qy < 0 || qy >= height)
+					continue;
+
+				for (int dx = -2; dx <= 2; dx++)
+				{
+					int qx = x + dx * step;
+					if (qx < 0 || qx >= width)
+						continue;
+
+					int q = qy * width + qx;
+					float* q_normal = &buffers->normals[q * 3];
+					float* q_albedo = &buffers->albedos[q * 3];
+					bool q_missed = q_normal[0] == 0 && q_normal[1] == 0 && q_normal[2] == 0;
+
+					// Pixels that missed every object only blend with each
+					// other.
+					float normal_weight = 1;
+					if (missed != q_missed)
+						continue;
+					if (!missed)
+					{
+						float cosine = normal[0] * q_normal[0] + normal[1] * q_normal[1] +
+							normal[2] * q_normal[2];
+						if (cosine <= 0)
+							continue;
+						normal_weight = pow(cosine, NORMAL_POWER);
+					}
+
+					float distance = step * sqrt((float)(dx * dx + dy * dy));
+					float depth_term = fabs(depth - buffers->depths[q]) /
+						(DEPTH_SIGMA * gradient * distance + 1e-4f);
+					float albedo_term = (fabs(albedo[0] - q_albedo[0]) +
+										 fabs(albedo[1] - q_albedo[1]) +
+										 fabs(albedo[2] - q_albedo[2])) / ALBEDO_SIGMA;
+					float coverage_term = fabs(coverage - buffers->coverages[q]) /
+						COVERAGE_SIGMA;
+					float color_term = fabs(luminance -
+											FrameBuffer::GetLuminance(&colors[q * 3])) /
+						color_scale;
+
+					float w = kernel[dx + 2] * kernel[dy + 2] * normal_weight *
+						exp(-(depth_term + albedo_term + coverage_term + color_term));
+
+					color_sum[0] += colors[q * 3] * w;
+					color_sum[1] += colors[q * 3 + 1] * w;
+					color_sum[2] += colors[q * 3 + 2] * w;
+					variance_sum += variances[q] * w * w;
+					weight_sum += w;
+				}
+			}
+
+			// The centre pixel always has a weight, so the sum is never 0.
+			for (int c = 0; c < 3; c++)
+				output_colors[p * 3 + c] = color_sum[c] / weight_sum;
+			output_variances[p] = variance_sum / (weight_sum * weight_sum);
+		}
+	}
+}
+
+void Denoiser::EstimateVariance(FrameBuffer* frame, Buffers* buffers)
+{
+	int width = buffers->width;
+	int height = buffers->height;
+	float* colors = buffers->colors[0].data();
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int p = y * width + x;
+			int count = frame->GetSampleCount(p);
+
+			if (count >= 2)
+			{
+				buffers->variances[0][p] = frame->GetVariance(p) / count;
+				continue;
+			}
+
+			float sum = 0, sum_squares = 0;
+			int n = 0;
+			for (int qy = std::max(y - 1, 0); qy <= std::min(y + 1, height - 1); qy++)
+			{
+				for (int qx = std::max(x - 1, 0); qx <= std::min(x + 1, width - 1); qx++)
+				{
+					float luminance = FrameBuffer::GetLuminance(&colors[(qy * width + qx) * 3]);
+					sum += luminance;
+					sum_squares += luminance * luminance;
+					n++;
+				}
+			}
+
+			float mean = sum / n;
+			buffers->variances[0][p] = fmax(sum_squares / n - mean * mean, 0.0f);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "FrameBuffer.h"
+
+/** Removes the noise of a low sample count render, guided by the features of
+each pixel's first hit.
+
+The filter is the edge-avoiding à-trous wavelet transform (Dammertz et al.,
+"Edge-Avoiding À-Trous Wavelet Transform for fast Global Illumination
+Filtering"), with the colour weights scaled by each pixel's variance as in
+SVGF (Schied et al.).  Each iteration blurs with a 5x5 B3 spline kernel
+whose taps are twice as far apart as the last, so a few iterations cover a
+wide area at 25 taps per pixel each.  Every tap is weighted by how similar
+its pixel is to the centre:
+
+- Normals, depths, and coverage have to match, so the blur stops at the
+  edges of objects and creases.
+- Albedos have to match, so texture and material boundaries stay sharp.
+- Colours have to be within a few standard deviations of the centre's
+  noise, so real detail in the lighting (such as shadow edges) is kept
+  once the noise around it has been smoothed out.
+
+The variance is filtered along with the colour, and shrinks with each
+iteration, so later iterations are more careful than the first.
+
+*/
+class Denoiser
+{
+public:
+	Denoiser();
+
+	// The number of filter iterations.  Each one doubles the width of the
+	// blur, so 5 iterations reach 64 pixels across.
+	void SetIterations(int _iterations);
+	int GetIterations();
+
+	/**
+	* @brief Denoises a frame and writes it in the same layout as
+	* FrameBuffer::Resolve.
+	*
+	* @param frame The frame, which must have AOVs enabled.
+	* @param max_threads The number of threads to filter with.  Each thread
+	* filters a band of rows.
+	* @param output_location An int array with minimum size width * height * 3.
+	*/
+	void Denoise(FrameBuffer* frame, int max_threads, int* output_location);
+
+private:
+	int iterations = 5;
+
+	// The inputs of the filter, gathered from the frame once, along with the
+	// colours and variances of the current and next iteration.
+	struct Buffers
+	{
+		int width;
+		int height;
+		std::vector<float> albedos;
+		std::vector<float> normals;
+		std::vector<float> depths;
+		std::vector<float> depth_gradients;
+		std::vector<float> coverages;
+		std::vector<float> colors[2];
+		std::vector<float> variances[2];
+	};
+
+	// Runs one iteration over the rows [first_row, end_row), reading from
+	// colors[source] and writing to the other buffer.
+	static void FilterRows(Buffers* buffers, int source, int step,
+						   int first_row, int end_row);
+
+	// Estimates the variance of every pixel's mean luminance.  Pixels with
+	// fewer than 2 samples have no estimate of their own, so the variance of
+	// their 3x3 neighbourhood is used instead.
+	static void EstimateVariance(FrameBuffer* frame, Buffers* buffers);
+};
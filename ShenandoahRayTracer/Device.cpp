@@ -1,10 +1,163 @@
 #include "Device.h"
 
-#define EPSILON 0.000001
+void Device::SetTraceRecorder(TraceRecorder* recorder)
+{
+	trace = recorder;
+}
+
+long long Device::GetTraceTimestamp()
+{
+	if (trace == nullptr)
+		return 0;
+	return trace->GetTimestamp();
+}
+
+void Device::SetRenderMode(RenderMode mode)
+{
+	render_mode = mode;
+}
+
+RenderMode Device::GetRenderMode()
+{
+	return render_mode;
+}
+
+void Device::SetIntegrator(Integrator* _integrator)
+{
+	integrator = _integrator;
+}
+
+Integrator* Device::GetIntegrator()
+{
+	if (integrator == nullptr)
+		return &uv_integrator;
+	return integrator;
+}
+
+void Device::SetExecutionMode(ExecutionMode mode)
+{
+	execution_mode = mode;
+}
+
+ExecutionMode Device::GetExecutionMode()
+{
+	return execution_mode;
+}
+
+void Device::SetMeshEncoding(MeshEncoding encoding)
+{
+	mesh_encoding = encoding;
+}
+
+MeshEncoding Device::GetMeshEncoding()
+{
+	return mesh_encoding;
+}
+
+void Device::SetGeometryCache(std::shared_ptr<GeometryCache> cache)
+{
+	geometry_cache = cache;
+}
+
+std::shared_ptr<GeometryCache> Device::GetGeometryCache()
+{
+	return geometry_cache;
+}
+
+void Device::SetSamplesPerPixel(int samples)
+{
+	if (samples <= 0)
+		throw std::invalid_argument("Samples per pixel must be positive.");
+
+	samples_per_pixel = samples;
+}
+
+int Device::GetSamplesPerPixel()
+{
+	return samples_per_pixel;
+}
+
+void Device::SetSamplerType(SamplerType type)
+{
+	sampler = Sampler(type, 0);
+}
+
+void Device::SetFilterType(FilterType type)
+{
+	filter = ReconstructionFilter(type);
+}
+
+void Device::SetAdaptiveSampling(float error_threshold, int min_samples)
+{
+	if (error_threshold < 0 || min_samples <= 0)
+		throw std::invalid_argument("Invalid adaptive sampling settings.");
+
+	adaptive_threshold = error_threshold;
+	adaptive_min_samples = min_samples;
+}
+
+void Device::SetTimeBudget(int milliseconds)
+{
+	if (milliseconds < 0)
+		throw std::invalid_argument("The time budget can't be negative.");
+
+	time_budget = milliseconds;
+}
+
+void Device::SetProgressivePassSamples(int samples)
+{
+	if (samples <= 0)
+		throw std::invalid_argument("Samples per pass must be positive.");
+
+	progressive_pass_samples = samples;
+}
+
+void Device::SetDenoising(int iterations)
+{
+	if (iterations < 0)
+		throw std::invalid_argument("The denoiser iterations can't be negative.");
+
+	denoise = iterations > 0;
+	if (denoise)
+		denoiser.SetIterations(iterations);
+}
+
+void Device::SetCheckpointing(std::string location, int interval_seconds)
+{
+	if (interval_seconds < 0)
+		throw std::invalid_argument("The checkpoint interval can't be negative.");
+
+	checkpoint_location = location;
+	checkpoint_interval = interval_seconds;
+}
+
+void Device::SetAOVsEnabled(bool enabled)
+{
+	aovs_enabled = enabled;
+}
+
+bool Device::NeedsAOVs()
+{
+	return (aovs_enabled || denoise) && render_mode == RenderMode::Shaded;
+}
+
+void Device::AddTraceSpan(std::string name, std::string category,
+						  long long start, int thread_id)
+{
+	if (trace != nullptr)
+		trace->AddSpan(name, category, start, thread_id);
+}
+
 
 CPUDevice::CPUDevice()
 {
-	
+	samples_taken = 0;
+	stop_requested = false;
+}
+
+CPUDevice::~CPUDevice()
+{
+	StopProgressiveRender();
 }
 
 // This just returns true because we assume that if the code is running, there
@@ -27,189 +180,760 @@ bool CPUDevice::IsDeviceFinished()
 
 void CPUDevice::RenderFrame(Camera c, int max_threads, int* output_location)
 {
-	// We don't trust the thread number provided because it could be wrong.
-	max_threads = fmin(max_threads, std::thread::hardware_concurrency());
+	RenderFrames({ c }, max_threads, { output_location });
+}
+
+void CPUDevice::RenderFrames(std::vector<Camera> cameras, int max_threads,
+							 std::vector<int*> output_locations)
+{
+	if (cameras.size() != output_locations.size())
+		throw std::invalid_argument("Every camera needs an output location.");
+
+	StopProgressiveRender();
+
+	max_threads = ClampThreadCount(max_threads);
 
 	is_finished = false;
+	samples_taken = 0;
+	deadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds(time_budget);
+
+	long long frame_start = GetTraceTimestamp();
+
+	std::vector<RenderView> views(cameras.size());
+	job_frames.assign(cameras.size(), FrameBuffer());
+	progressive_job = false;
+	for (int v = 0; v < cameras.size(); v++)
+	{
+		RenderView& view = views[v];
+		view.camera = cameras[v];
+		view.output_location = output_locations[v];
+
+		// We switch this over so that there's no vector copying at all, which
+		// accelerates the process.
+		view.camera.GetOrigin().Copy(view.origin);
+
+		job_frames[v] = FrameBuffer(cameras[v].GetResolutionX(),
+									cameras[v].GetResolutionY());
+		if (NeedsAOVs())
+			job_frames[v].EnableAOVs();
+		view.frame = &job_frames[v];
+
+		view.costs = nullptr;
+		if (render_mode == RenderMode::TraversalHeatmap)
+		{
+			view.costs = new int[cameras[v].GetResolutionX() * cameras[v].GetResolutionY()];
+			std::fill(view.costs, view.costs + cameras[v].GetResolutionX() *
+					  cameras[v].GetResolutionY(), 0);
+		}
+
+		view.region_x = 0;
+		view.region_y = 0;
+		view.region_width = cameras[v].GetResolutionX();
+		view.region_height = cameras[v].GetResolutionY();
+
+		view.first_sample = 0;
+		view.num_samples = samples_per_pixel;
+		view.set_samples = samples_per_pixel;
+		view.history = nullptr;
+	}
 
-	Vector3 camera_origin = c.GetOrigin();
-	// We switch this over so that there's no vector copying at all, which
-	// accelerates the process.
-	float camera_origin_array[3] = { camera_origin.x, camera_origin.y,
-									 camera_origin.z };
+	RenderViews(&views, max_threads);
 
-	float* camera_points_array = new float[3 * c.GetResolutionX() * c.GetResolutionY()];
-	for (int j = 0; j < c.GetResolutionY(); j++)
+	for (int v = 0; v < views.size(); v++)
 	{
-		for (int i = 0; i < c.GetResolutionX(); i++)
+		if (views[v].costs == nullptr)
+			ResolveFrame(views[v].frame, max_threads, views[v].output_location);
+		else
 		{
-			c.GetPixelRayDirection(i, j,
-								   &camera_points_array[(j * c.GetResolutionX() + i) * 3]);
+			// The heatmap can only be normalized once every tile is done, since
+			// it depends on the most expensive pixel in the whole frame.
+			WriteHeatmap(views[v].costs,
+						 views[v].camera.GetResolutionX() * views[v].camera.GetResolutionY(),
+						 views[v].output_location);
+			delete[] views[v].costs;
 		}
 	}
 
+	is_finished = true;
+
+	AddTraceSpan("RenderFrames", "frame", frame_start, 0);
+}
 
-	
-	int current_thread_position = 0;
-	int pixels_per_thread = c.GetResolutionX() * c.GetResolutionY() / max_threads;
+void CPUDevice::RenderViews(std::vector<RenderView>* views, int max_threads)
+{
+	int max_tiles_per_view = 0;
+	for (int v = 0; v < views->size(); v++)
+	{
+		int tiles_x = (views->at(v).region_width + TILE_SIZE - 1) / TILE_SIZE;
+		int tiles_y = (views->at(v).region_height + TILE_SIZE - 1) / TILE_SIZE;
+		max_tiles_per_view = fmax(max_tiles_per_view, tiles_x * tiles_y);
+	}
+
+	// Tiles are listed round-robin across the views, so the first tile of
+	// every view comes first, then the second of every view, and so on.
+	std::vector<Tile> tiles;
+	for (int t = 0; t < max_tiles_per_view; t++)
+	{
+		for (int v = 0; v < views->size(); v++)
+		{
+			RenderView& view = views->at(v);
+			int tiles_x = (view.region_width + TILE_SIZE - 1) / TILE_SIZE;
+			int tiles_y = (view.region_height + TILE_SIZE - 1) / TILE_SIZE;
+
+			if (t >= tiles_x * tiles_y)
+				continue;
+
+			Tile tile;
+			tile.view = v;
+			tile.x = view.region_x + (t % tiles_x) * TILE_SIZE;
+			tile.y = view.region_y + (t / tiles_x) * TILE_SIZE;
+			tile.width = fmin(TILE_SIZE, view.region_x + view.region_width - tile.x);
+			tile.height = fmin(TILE_SIZE, view.region_y + view.region_height - tile.y);
+			tiles.push_back(tile);
+		}
+	}
+
+	// Arenas are only ever added, so the blocks of the threads that took
+	// part in earlier frames are kept for the next one.
+	while (arenas.size() < max_threads)
+		arenas.emplace_back();
+
+	std::atomic<int> next_tile(0);
 	std::vector<std::thread> threads;
-	for (current_thread_position = 0; current_thread_position < max_threads; current_thread_position++)
+	for (int current_thread_position = 0; current_thread_position < max_threads; current_thread_position++)
 	{
-		threads.emplace_back(std::thread(&CPUDevice::RenderSection, this,
-			camera_origin_array,
-			&camera_points_array[current_thread_position * pixels_per_thread*3],
-			pixels_per_thread,
-			&output_location[current_thread_position * pixels_per_thread * 3]));
+		threads.emplace_back(std::thread(&CPUDevice::RenderWorker, this,
+			views, &tiles, &next_tile, current_thread_position + 1));
 	}
 
 	for (int i = 0; i < threads.size(); i++)
 	{
 		threads.at(i).join();
 	}
+}
+
+long long CPUDevice::RenderRegion(Camera c, int x, int y, int width, int height,
+								  int max_threads, FrameBuffer* frame, int* costs)
+{
+	if (frame->GetWidth() != c.GetResolutionX() || frame->GetHeight() != c.GetResolutionY())
+		throw std::invalid_argument("The frame buffer must be the size of the camera's image.");
+	if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+		x + width > c.GetResolutionX() || y + height > c.GetResolutionY())
+		throw std::invalid_argument("The region doesn't lie within the camera's image.");
+
+	StopProgressiveRender();
+
+	samples_taken = 0;
+	deadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds(time_budget);
+
+	long long region_start = GetTraceTimestamp();
+
+	std::vector<RenderView> views(1);
+	RenderView& view = views[0];
+	view.camera = c;
+	view.camera.GetOrigin().Copy(view.origin);
+	view.output_location = nullptr;
+	view.frame = frame;
+	view.costs = render_mode == RenderMode::TraversalHeatmap ? costs : nullptr;
+	view.region_x = x;
+	view.region_y = y;
+	view.region_width = width;
+	view.region_height = height;
+	view.first_sample = 0;
+	view.num_samples = samples_per_pixel;
+	view.set_samples = samples_per_pixel;
+	view.history = nullptr;
+
+	RenderViews(&views, ClampThreadCount(max_threads));
+
+	AddTraceSpan("RenderRegion", "frame", region_start, 0);
+
+	return samples_taken;
+}
+
+void CPUDevice::ResolveRemoteFrame(FrameBuffer frame, int* costs,
+								   long long samples, int max_threads,
+								   int* output_location)
+{
+	StopProgressiveRender();
+
+	job_frames.assign(1, std::move(frame));
+	progressive_job = false;
+	samples_taken = samples;
 
-	delete[] camera_points_array;
+	int num_pixels = job_frames[0].GetWidth() * job_frames[0].GetHeight();
+	if (render_mode == RenderMode::TraversalHeatmap)
+		WriteHeatmap(costs, num_pixels, output_location);
+	else
+		ResolveFrame(&job_frames[0], ClampThreadCount(max_threads), output_location);
+
+	is_finished = true;
+}
+
+void CPUDevice::StartProgressiveRender(Camera c, int max_threads)
+{
+	BeginProgressiveRender(c, max_threads, nullptr);
 }
 
-void CPUDevice::RenderSection(float* origin, float* positions, int num_positions, 
-	                          int* output_location)
+void CPUDevice::ResumeProgressiveRender(Camera c, int max_threads,
+										std::string checkpoint_location)
 {
-	std::cout << "Rendering Now..." << std::endl;
-	Hit best_hit;
-	Hit current_hit;
-	ObjectHandler* current_object;
-	for (int i = 0; i < num_positions * 3; i+=3)
+	RenderCheckpoint checkpoint = RenderCheckpoint::Read(checkpoint_location);
+
+	// The render being resumed is described the same way as the checkpoint,
+	// so the two can be compared setting by setting.
+	RenderCheckpoint current;
+	GetCheckpointSettings(c, &current);
+	current.frame = FrameBuffer(c.GetResolutionX(), c.GetResolutionY());
+	if (NeedsAOVs())
+		current.frame.EnableAOVs();
+	checkpoint.CheckCompatible(&current);
+
+	BeginProgressiveRender(c, max_threads, &checkpoint);
+}
+
+void CPUDevice::BeginProgressiveRender(Camera c, int max_threads,
+									   RenderCheckpoint* checkpoint)
+{
+	StopProgressiveRender();
+
+	int resolution_x = c.GetResolutionX();
+	int resolution_y = c.GetResolutionY();
+	int first_sample = 0;
+
+	progressive_frame = FrameBuffer(resolution_x, resolution_y);
+	if (NeedsAOVs())
+		progressive_frame.EnableAOVs();
+	progressive_job = true;
+	progressive_costs.assign(resolution_x * resolution_y, 0);
+	progressive_passes = 0;
+	progressive_threads = ClampThreadCount(max_threads);
+	progressive_resumed_milliseconds = 0;
+	samples_taken = 0;
+
+	if (checkpoint != nullptr)
 	{
-		for (int o = 0; o < objects->size(); o++)
+		progressive_frame = std::move(checkpoint->frame);
+		if (!checkpoint->costs.empty())
+			progressive_costs = std::move(checkpoint->costs);
+		progressive_passes = checkpoint->passes;
+		progressive_resumed_milliseconds = checkpoint->elapsed_milliseconds;
+		samples_taken = checkpoint->samples_taken;
+		first_sample = checkpoint->next_sample;
+	}
+
+	is_finished = false;
+	stop_requested = false;
+	progressive_start = std::chrono::steady_clock::now();
+	deadline = progressive_start + std::chrono::milliseconds(time_budget) -
+		std::chrono::milliseconds(progressive_resumed_milliseconds);
+
+	progressive_thread = std::thread(&CPUDevice::ProgressiveWorker, this, c,
+									 progressive_threads, first_sample);
+}
+
+int CPUDevice::GetProgressiveResult(int* output_location)
+{
+	std::lock_guard<std::mutex> lock(progressive_mutex);
+
+	if (progressive_passes == 0)
+		return 0;
+
+	if (render_mode == RenderMode::TraversalHeatmap)
+		WriteHeatmap(progressive_costs.data(), progressive_costs.size(),
+					 output_location);
+	else
+		ResolveFrame(&progressive_frame, progressive_threads, output_location);
+
+	return progressive_passes;
+}
+
+void CPUDevice::GetAOV(AOVType type, int view, float* output_location)
+{
+	if (progressive_job)
+	{
+		if (view != 0)
+			throw std::invalid_argument("Progressive renders only have view 0.");
+
+		std::lock_guard<std::mutex> lock(progressive_mutex);
+		progressive_frame.GetAOV(type, output_location);
+		return;
+	}
+
+	if (view < 0 || view >= job_frames.size())
+		throw std::invalid_argument("There is no view " + std::to_string(view) +
+									" in the last render.");
+
+	job_frames[view].GetAOV(type, output_location);
+}
+
+void CPUDevice::StopProgressiveRender()
+{
+	if (!progressive_thread.joinable())
+		return;
+
+	stop_requested = true;
+	progressive_thread.join();
+}
+
+void CPUDevice::ProgressiveWorker(Camera c, int max_threads, int first_sample)
+{
+	long long render_start = GetTraceTimestamp();
+
+	int num_pixels = c.GetResolutionX() * c.GetResolutionY();
+	FrameBuffer pass_frame(c.GetResolutionX(), c.GetResolutionY());
+	if (progressive_frame.HasAOVs())
+		pass_frame.EnableAOVs();
+	std::vector<int> pass_costs(num_pixels);
+
+	std::vector<RenderView> views(1);
+	RenderView& view = views[0];
+	view.camera = c;
+	view.camera.GetOrigin().Copy(view.origin);
+	view.output_location = nullptr;
+	view.frame = &pass_frame;
+	view.costs = nullptr;
+	if (render_mode == RenderMode::TraversalHeatmap)
+		view.costs = pass_costs.data();
+	view.region_x = 0;
+	view.region_y = 0;
+	view.region_width = c.GetResolutionX();
+	view.region_height = c.GetResolutionY();
+
+	// Only this thread writes to progressive_frame, so it can be read here
+	// without the lock while the workers use it to skip converged pixels.
+	view.history = &progressive_frame;
+
+	auto last_checkpoint = std::chrono::steady_clock::now();
+	bool checkpoint_saved = true;
+
+	for (; first_sample < samples_per_pixel; first_sample += progressive_pass_samples)
+	{
+		if (stop_requested)
+			break;
+		if (time_budget > 0 && std::chrono::steady_clock::now() >= deadline)
+			break;
+
+		long long pass_start = GetTraceTimestamp();
+
+		pass_frame.Clear();
+		std::fill(pass_costs.begin(), pass_costs.end(), 0);
+		view.first_sample = first_sample;
+		view.num_samples = fmin(progressive_pass_samples,
+								samples_per_pixel - first_sample);
+		view.set_samples = progressive_pass_samples;
+
+		RenderViews(&views, max_threads);
+
+		{
+			std::lock_guard<std::mutex> lock(progressive_mutex);
+
+			progressive_frame.Add(&pass_frame);
+			for (int p = 0; p < num_pixels; p++)
+				progressive_costs[p] += pass_costs[p];
+			progressive_passes++;
+		}
+		checkpoint_saved = false;
+
+		AddTraceSpan("Pass", "frame", pass_start, 0);
+
+		if (!checkpoint_location.empty() &&
+			std::chrono::steady_clock::now() - last_checkpoint >=
+			std::chrono::seconds(checkpoint_interval))
 		{
-			current_object = objects->at(o);
-			int* triangles = new int[current_object->GetNumTriangles() * 3];
-			float* vertices = new float[current_object->GetNumVertices() * 4];
+			SaveCheckpoint(c, first_sample + view.num_samples);
+			last_checkpoint = std::chrono::steady_clock::now();
+			checkpoint_saved = true;
+		}
+	}
+
+	// Whatever was rendered since the last checkpoint is saved before the
+	// render ends, including when it was stopped early.
+	if (!checkpoint_location.empty() && !checkpoint_saved)
+		SaveCheckpoint(c, first_sample);
+
+	is_finished = true;
+
+	AddTraceSpan("ProgressiveRender", "frame", render_start, 0);
+}
+
+void CPUDevice::GetCheckpointSettings(Camera c, RenderCheckpoint* output)
+{
+	output->camera = c;
+	output->samples_per_pixel = samples_per_pixel;
+	output->pass_samples = progressive_pass_samples;
+	output->render_mode = render_mode;
+	output->sampler_type = sampler.GetType();
+	output->sampler_seed = sampler.GetSeed();
+	output->filter_type = filter.GetType();
+	output->adaptive_threshold = adaptive_threshold;
+	output->adaptive_min_samples = adaptive_min_samples;
+	GetIntegrator()->GetCheckpointSettings(output);
+	output->mesh_encoding = scene.GetMeshEncoding();
+
+	if (!has_scene_hash)
+	{
+		scene_hash = scene.GetHash();
+		has_scene_hash = true;
+	}
+	output->scene_hash = scene_hash;
+}
+
+void CPUDevice::SaveCheckpoint(Camera c, int next_sample)
+{
+	long long checkpoint_start = GetTraceTimestamp();
+
+	RenderCheckpoint checkpoint;
+	GetCheckpointSettings(c, &checkpoint);
+	checkpoint.next_sample = next_sample;
+	checkpoint.samples_taken = samples_taken;
+	checkpoint.elapsed_milliseconds = progressive_resumed_milliseconds +
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - progressive_start).count();
+
+	// The frame is lent to the checkpoint rather than copied, since it can be
+	// large.  Holding the lock keeps readers from seeing it while it's gone.
+	std::lock_guard<std::mutex> lock(progressive_mutex);
+
+	checkpoint.passes = progressive_passes;
+	std::swap(checkpoint.frame, progressive_frame);
+	if (render_mode == RenderMode::TraversalHeatmap)
+		std::swap(checkpoint.costs, progressive_costs);
+
+	try
+	{
+		checkpoint.Write(checkpoint_location);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+
+	std::swap(checkpoint.frame, progressive_frame);
+	if (render_mode == RenderMode::TraversalHeatmap)
+		std::swap(checkpoint.costs, progressive_costs);
+
+	AddTraceSpan("Checkpoint", "frame", checkpoint_start, 0);
+}
+
+int CPUDevice::ClampThreadCount(int max_threads)
+{
+	// We don't trust the thread number provided because it could be wrong.
+	// hardware_concurrency can return 0 if it can't tell, so we always keep at
+	// least one thread.
+	if (std::thread::hardware_concurrency() > 0)
+		max_threads = fmin(max_threads, std::thread::hardware_concurrency());
+	return fmax(max_threads, 1);
+}
+
+void CPUDevice::RenderWorker(std::vector<RenderView>* views,
+							 std::vector<Tile>* tiles, std::atomic<int>* next_tile,
+							 int thread_id)
+{
+	if (trace != nullptr)
+		trace->SetThreadName(thread_id, "Worker " + std::to_string(thread_id));
+
+	// Scratch space is allocated once per thread rather than once per tile,
+	// from an arena only this thread uses.
+	FrameArena* arena = &arenas[thread_id - 1];
+	Hit* hits = arena->Allocate<Hit>(TILE_SIZE * TILE_SIZE * SAMPLE_BATCH);
+	float* directions = arena->Allocate<float>(TILE_SIZE * TILE_SIZE * SAMPLE_BATCH * 3);
+
+	// Every view gets its own copy of the camera, since generating ray
+	// directions in-place uses scratch space inside the camera.
+	std::vector<RenderView> local_views = *views;
+
+	long long samples = 0;
+	int t;
+	while ((t = next_tile->fetch_add(1)) < tiles->size())
+	{
+		Tile tile = tiles->at(t);
+		samples += RenderTile(&local_views[tile.view], tile, hits, directions,
+							  arena, thread_id);
+	}
+	samples_taken += samples;
+
+	arena->Reset();
+}
+
+long long CPUDevice::RenderTile(RenderView* view, Tile tile, Hit* hits,
+								float* directions, FrameArena* arena,
+								int thread_id)
+{
+	long long tile_start = GetTraceTimestamp();
+
+	int resolution_x = view->camera.GetResolutionX();
+	bool adaptive = adaptive_threshold > 0;
+	Integrator* shader = GetIntegrator();
+	long long tile_samples = 0;
+
+	// The pixels of the tile that still need samples, as their index in the
+	// frame.  Every pixel has taken the same number of samples as the others
+	// that are still active, so they all continue from the same index.
+	int active_pixels[TILE_SIZE * TILE_SIZE];
+	int num_active = 0;
+	for (int j = 0; j < tile.height; j++)
+	{
+		for (int i = 0; i < tile.width; i++)
+		{
+			int pixel = (tile.y + j) * resolution_x + tile.x + i;
+
+			// Pixels that converged in an earlier pass are done.
+			if (adaptive && view->history != nullptr &&
+				view->history->GetSampleCount(pixel) >= adaptive_min_samples &&
+				view->history->IsConverged(pixel, adaptive_threshold))
+				continue;
+
+			active_pixels[num_active++] = pixel;
+		}
+	}
+
+	int end_sample = view->first_sample + view->num_samples;
+	for (int first_sample = view->first_sample;
+		 first_sample < end_sample && num_active > 0;)
+	{
+		int batch = fmin(SAMPLE_BATCH, end_sample - first_sample);
 
-			current_object->CopyTriangles(&triangles[0]);
-			current_object->CopyAdjustedVertices(&vertices[0]);
+		// Convergence is first checked right after the minimum number of
+		// samples, rather than at the end of whichever batch passes it.
+		if (adaptive && first_sample < adaptive_min_samples)
+			batch = fmin(batch, adaptive_min_samples - first_sample);
+
+		long long generation_start = GetTraceTimestamp();
+		float samples[SAMPLE_BATCH * 2];
+		for (int p = 0; p < num_active; p++)
+		{
+			int i = active_pixels[p] % resolution_x;
+			int j = active_pixels[p] / resolution_x;
+			sampler.GetPixelSamples(i, j, first_sample, batch, view->set_samples,
+									samples);
 
-			for (int f = 0; f < current_object->GetNumTriangles() * 3; f += 3)
+			for (int s = 0; s < batch; s++)
 			{
-				GetRayHit(origin, &positions[i], &vertices[0],
-					      &triangles[f], &current_hit);
-				
-				if (current_hit.IsGreater(best_hit))
-				{
-					best_hit = current_hit;
-					best_hit.object = current_object;
-					best_hit.triangle_index = f;
-				}
+				float offset[2];
+				filter.SampleOffset(&samples[s * 2], offset);
+				view->camera.GetRayDirection(i + 0.5f + offset[0],
+											 j + 0.5f + offset[1],
+											 &directions[(p * batch + s) * 3]);
 			}
-			
-			delete[] triangles;
-			delete[] vertices;
 		}
+		AddTraceSpan("Ray Generation", "render", generation_start, thread_id);
 
-		if (best_hit.hit)
+		long long intersection_start = GetTraceTimestamp();
+		for (int r = 0; r < num_active * batch; r++)
+			hits[r] = Hit();
+		for (int p = 0; p < num_active; p++)
 		{
-			// Loading UVs and Triangle UVs
-			int* triangle_uvs = new int[best_hit.object->GetNumTriangles() * 3];
-			float* uvs = new float[best_hit.object->GetNumUVs() * 2];
-
-			best_hit.object->CopyTriangles(triangle_uvs);
-			best_hit.object->CopyUVs(uvs);
-
-			// We find the best triangle by taking the index of the best triangle,
-			// and copying the triangle UVs into here.
-			int best_triangle_uvs[3];
-			memcpy(best_triangle_uvs, &triangle_uvs[best_hit.triangle_index],
-				   sizeof(int) * 3);
-
-			float a_uvs[2], b_uvs[2], c_uvs[2];
-			memcpy(a_uvs, &uvs[best_triangle_uvs[0] * 2], sizeof(float) * 2);
-			memcpy(b_uvs, &uvs[best_triangle_uvs[1] * 2], sizeof(float) * 2);
-			memcpy(c_uvs, &uvs[best_triangle_uvs[2] * 2], sizeof(float) * 2);
-
-			// Now we create the u and v vectors within the texture plane, by
-			// subtracting the UV coordinates of A-B and A-C
-			float ab[2], ac[2];
-			Vector2::Subtract(b_uvs, a_uvs, ab);
-			Vector2::Subtract(c_uvs, a_uvs, ac);
-
-			// Now that we have these vectors, we can compute the final vector
-			// for the texture coordinate
-			Vector2::MultiplyF(ab, best_hit.u, ab);
-			Vector2::MultiplyF(ac, best_hit.v, ac);
-
-			// Same as writing A + ab(u) + ac(v)
-			
-			Vector2::Add(&uvs[best_triangle_uvs[0]], ab, ab);
-			Vector2::Add(ab, ac, ab);
-			
-			output_location[i] = abs((int)(ab[0] * 63) % 63);
-			output_location[i + 1] = abs((int)(ab[1] * 63) % 63);
-			output_location[i + 2] = 0;
-
-			delete[] triangle_uvs;
-			delete[] uvs;
+			scene.IntersectPacket(view->origin, &directions[p * batch * 3], batch,
+								  &hits[p * batch]);
+		}
+		AddTraceSpan("Intersection", "render", intersection_start, thread_id);
+
+		long long shading_start = GetTraceTimestamp();
+		int num_samples = num_active * batch;
+		if (view->costs != nullptr)
+		{
+			// The colour is filled in by WriteHeatmap once the frame is done.
+			for (int r = 0; r < num_samples; r++)
+				view->costs[active_pixels[r / batch]] += hits[r].nodes_visited +
+					hits[r].triangles_tested;
 		}
 		else
 		{
-			output_location[i] = 0;
-			output_location[i + 1] = 0;
-			output_location[i + 2] = 0;
+			// Each sample gets its own random numbers, so the image doesn't
+			// depend on which thread rendered which tile, or on the execution
+			// mode.
+			FrameArena::Marker batch_start = arena->GetMarker();
+
+			RandomSequence* randoms = arena->AllocateUninitialized<RandomSequence>(num_samples);
+			for (int r = 0; r < num_samples; r++)
+				new (&randoms[r]) RandomSequence(Sampler::Hash(active_pixels[r / batch],
+															   first_sample + r % batch, 0));
+
+			float* colors = arena->Allocate<float>(num_samples * 3);
+			if (execution_mode == ExecutionMode::Wavefront)
+				shader->ShadeBatch(&scene, view->origin, directions, hits,
+								   randoms, num_samples, colors, arena);
+			else
+			{
+				for (int r = 0; r < num_samples; r++)
+				{
+					shader->Shade(&scene, view->origin, &directions[r * 3], &hits[r],
+								  &randoms[r], &colors[r * 3]);
+				}
+			}
+
+			for (int r = 0; r < num_samples; r++)
+				view->frame->AddSample(active_pixels[r / batch], &colors[r * 3]);
+
+			if (view->frame->HasAOVs())
+			{
+				for (int r = 0; r < num_samples; r++)
+				{
+					AOVSample aov;
+					GetAOVSample(view, &directions[r * 3], &hits[r], &aov);
+					view->frame->AddAOVSample(active_pixels[r / batch], &aov);
+				}
+			}
+
+			arena->Rewind(batch_start);
 		}
+		AddTraceSpan("Shading", "render", shading_start, thread_id);
 
-		best_hit.hit = false;
-	}
+		tile_samples += num_active * batch;
+		first_sample += batch;
 
-}
+		if (time_budget > 0 && std::chrono::steady_clock::now() >= deadline)
+			break;
 
-void CPUDevice::GetRayHit(float* origin, float* direction, float* vertices,
-						  int* triangle, Hit* output)
-{
-	output->hit = false;
-	float edge1[3], edge2[3], tvec[3], pvec[3], qvec[3];
-	float det, inv_det;
+		// Converged pixels are dropped from the list, and the rest are
+		// compacted so the next batch only traces the noisy ones.  The
+		// heatmap has no colours to measure, so it always takes every sample.
+		if (adaptive && view->costs == nullptr && view->history == nullptr &&
+			first_sample >= adaptive_min_samples)
+		{
+			int remaining = 0;
+			for (int p = 0; p < num_active; p++)
+			{
+				if (!view->frame->IsConverged(active_pixels[p], adaptive_threshold))
+					active_pixels[remaining++] = active_pixels[p];
+			}
+			num_active = remaining;
+		}
+	}
 
-	Vector3::Subtract(&vertices[triangle[1] * 4], &vertices[triangle[0] * 4], edge1);
-	Vector3::Subtract(&vertices[triangle[2] * 4], &vertices[triangle[0] * 4], edge2);
+	AddTraceSpan("Tile", "render", tile_start, thread_id);
 
-	Vector3::Cross(direction, edge2, pvec);
+	return tile_samples;
+}
 
-	det = Vector3::Dot(edge1, pvec);
-	
-	if (det > -EPSILON && det < EPSILON)
+void CPUDevice::GetAOVSample(RenderView* view, float* direction, Hit* hit,
+							 AOVSample* output)
+{
+	output->hit = hit->hit;
+	if (!hit->hit)
 		return;
 
-	inv_det = 1.0f / det;
+	output->depth = hit->t * sqrt(Vector3::Dot(direction, direction));
+	output->object_id = hit->object_index;
+	output->triangle_id = hit->triangle_index / 3;
+	scene.GetHitNormal(hit, direction, output->normal);
 
-	Vector3::Subtract(origin, &vertices[triangle[0] * 4], tvec);
+	float uv[3] = { 0, 0, 0 };
+	scene.GetHitUV(hit, uv);
+	uv[2] = output->depth * view->camera.GetPixelSpreadAngle() *
+		scene.GetHitUVDensity(hit);
+	output->uv[0] = uv[0];
+	output->uv[1] = uv[1];
 
-	output->u = Vector3::Dot(tvec, pvec) * inv_det;
+	std::visit([&](const auto& material)
+	{
+		material.GetAlbedo(uv, output->albedo);
+	}, scene.GetMaterial(hit->object_index));
+}
 
-	if (output->u < 0.0 || output->u > 1.0)
+void CPUDevice::ResolveFrame(FrameBuffer* frame, int max_threads,
+							 int* output_location)
+{
+	if (!denoise || !frame->HasAOVs())
+	{
+		frame->Resolve(output_location);
 		return;
+	}
+
+	long long denoise_start = GetTraceTimestamp();
+	denoiser.Denoise(frame, max_threads, output_location);
+	AddTraceSpan("Denoise", "frame", denoise_start, 0);
+}
 
-	Vector3::Cross(tvec, edge1, qvec);
+void CPUDevice::WriteHeatmap(int* costs, int num_pixels, int* output_location)
+{
+	int max_cost = 1;
+	for (int i = 0; i < num_pixels; i++)
+		max_cost = fmax(max_cost, costs[i]);
 
-	output->v = Vector3::Dot(direction, qvec) * inv_det;
+	// The colour ramp goes blue -> cyan -> green -> yellow -> red, so cheap
+	// pixels are cold and the most expensive ones are hot.  Values are in the
+	// range 0-255.
+	const float ramp[5][3] = { { 0, 0, 255 }, { 0, 255, 255 }, { 0, 255, 0 },
+							   { 255, 255, 0 }, { 255, 0, 0 } };
 
-	if (output->v < 0.0 || (double)output->u + (double)output->v > 1.0)
-		return;
+	for (int i = 0; i < num_pixels; i++)
+	{
+		float t = (float)costs[i] / max_cost * 4;
+		int segment = fmin((int)t, 3);
+		float f = t - segment;
 
-	output->t = Vector3::Dot(edge2, qvec) * inv_det;
-	output->hit = true;
+		for (int c = 0; c < 3; c++)
+		{
+			output_location[i * 3 + c] = (int)(ramp[segment][c] * (1 - f) +
+											   ramp[segment + 1][c] * f);
+		}
+	}
 }
 
 void CPUDevice::UploadData(std::vector<ObjectHandler*>* _objects)
 {
+	long long upload_start = GetTraceTimestamp();
+
 	objects = _objects;
+
+	long long build_start = GetTraceTimestamp();
+	scene = PreparedScene(objects, mesh_encoding, geometry_cache);
+	has_scene_hash = false;
+	AddTraceSpan("Acceleration Build", "upload", build_start, 0);
+
+	is_ready = true;
+
+	AddTraceSpan("Upload", "upload", upload_start, 0);
+}
+
+void CPUDevice::PublishScene(std::string location)
+{
+	if (!is_ready)
+		throw std::invalid_argument("The scene has to be uploaded before it is published.");
+
+	long long publish_start = GetTraceTimestamp();
+	published_scene = scene.Publish(location);
+	AddTraceSpan("Publish", "upload", publish_start, 0);
+}
+
+void CPUDevice::AttachScene(std::string location,
+							std::shared_ptr<TextureCache> texture_cache)
+{
+	long long attach_start = GetTraceTimestamp();
+
+	objects = nullptr;
+	scene = PreparedScene::Attach(location, texture_cache);
+	has_scene_hash = false;
+	is_ready = true;
+
+	AddTraceSpan("Attach", "upload", attach_start, 0);
 }
 
+void CPUDevice::SwapPreparedScene(PreparedScene* other)
+{
+	std::swap(scene, *other);
+	has_scene_hash = false;
+	is_ready = true;
+}
+
+size_t CPUDevice::GetGeometryBytes()
+{
+	return scene.GetGeometryBytes();
+}
+
+ArenaStatistics CPUDevice::GetArenaStatistics()
+{
+	ArenaStatistics total;
+	for (int i = 0; i < arenas.size(); i++)
+		FrameArena::AddStatistics(arenas[i].GetStatistics(), &total);
+	return total;
+}
 
-bool Hit::IsGreater(Hit h)
+long long CPUDevice::GetSamplesTaken()
 {
-	if (hit && !h.hit)
-		return true;
-	else if (!hit && h.hit)
-		return false;
-	if (t < h.t)
-		return true;
-	return false;
+	return samples_taken;
 }
\ No newline at end of file
@@ -2,13 +2,47 @@
 
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <iostream>
+#include <chrono>
+#include <mutex>
 #include "ObjectHandler.h"
 #include "Camera.h"
+#include "Denoiser.h"
+#include "FrameArena.h"
+#include "FrameBuffer.h"
+#include "Hit.h"
+#include "Integrator.h"
+#include "PreparedScene.h"
+#include "ReconstructionFilter.h"
+#include "RenderCheckpoint.h"
+#include "Sampler.h"
+#include "Trace.h"
 
 class Device;
 class CPUDevice;
 
-struct Hit;
+// What a device writes into the output buffer for each pixel.
+enum class RenderMode
+{
+	// The colour computed by the device's integrator for each sample.
+	Shaded,
+	// A false-colour image of how expensive each pixel was to trace, made from
+	// the number of nodes visited and triangles tested.  Used to find meshes
+	// that make one region of the frame far more expensive than the rest.
+	TraversalHeatmap
+};
+
+// How a device runs the integrator over the samples of a batch.
+enum class ExecutionMode
+{
+	// Each sample is shaded on its own from start to finish.
+	DepthFirst,
+	// Every sample of a batch is shaded together, one bounce at a time, so
+	// the integrator can trace each bounce as one large sorted queue.  Faster
+	// for incoherent secondary rays, but needs more memory per thread.
+	Wavefront
+};
 
 // A class that encapsulates a specific implementation of the ray tracing
 // algorithm, either for different devices (CPU, GPU, Optix) or for specific
@@ -30,58 +64,449 @@ public:
 	// using one thread.  
 	virtual void RenderFrame(Camera c, int max_threads, int* output_location) = 0;
 
+	// Renders the same uploaded scene from several cameras as one job.  Each
+	// camera writes into the output location with the same index.  This is
+	// faster than calling RenderFrame for each camera, since the threads are
+	// only started once and are never idle waiting on a single view to finish.
+	virtual void RenderFrames(std::vector<Camera> cameras, int max_threads,
+							  std::vector<int*> output_locations) = 0;
+
+	// Starts rendering a frame progressively in the background and returns
+	// immediately.  The frame is rendered as a series of passes over the whole
+	// image, each adding a few samples to every pixel, until the samples per
+	// pixel or the time budget is reached.  IsDeviceFinished becomes true
+	// once it's done.  The objects must not be uploaded again until the
+	// render is stopped.
+	virtual void StartProgressiveRender(Camera c, int max_threads) = 0;
+
+	// Writes the frame as of the last completed pass into the output
+	// location, which can be called at any time during a progressive render.
+	// Returns the number of passes completed, so 0 means nothing was written.
+	virtual int GetProgressiveResult(int* output_location) = 0;
+
+	// Stops a progressive render after its current pass, and waits for it.
+	// The result of the completed passes is still available afterwards.
+	virtual void StopProgressiveRender() = 0;
+
+	/**
+	* @brief Carries on a progressive render from a checkpoint saved by an
+	* earlier one, such as in another process that was stopped.  The render
+	* then continues as if it had never stopped, and gives exactly the same
+	* image.  Throws an std::invalid_argument if the checkpoint can't be read,
+	* or was saved with different settings or a different camera.
+	*
+	* @param c The camera, which must be the one the render was started with.
+	* @param max_threads The maximum number of render threads.
+	* @param checkpoint_location Where the checkpoint was saved.
+	*/
+	virtual void ResumeProgressiveRender(Camera c, int max_threads,
+										 std::string checkpoint_location) = 0;
+
+	/**
+	* @brief Reads an AOV of the last render, which must have been made with
+	* AOVs enabled.  For a progressive render, this is the AOV as of the last
+	* completed pass.  Throws an std::invalid_argument if the AOV isn't
+	* available.
+	*
+	* @param type The AOV.
+	* @param view The index of the camera within the last RenderFrames call,
+	* which is 0 for RenderFrame and progressive renders.
+	* @param output_location A float array with minimum size width * height
+	* * FrameBuffer::GetAOVChannels(type).
+	*/
+	virtual void GetAOV(AOVType type, int view, float* output_location) = 0;
+
 	// Handles the data depending on the device in question.  For CPUs, there
 	// might be no need; for GPUs it will have to be uplaoded.  Entirely depends
-	// on specific implementation.
+	// on specific implementation.  Must be called again after objects change
+	// for the changes to show up in the render.
 	virtual void UploadData(std::vector<ObjectHandler*>* objects) = 0;
 
+	/**
+	* @brief Publishes the uploaded scene, so that other processes on this
+	* machine can attach to it instead of loading and uploading the objects
+	* themselves.  Throws an std::invalid_argument if it can't be published.
+	*
+	* @param location Where the scene is published, as "shm:name" for a
+	* shared memory segment or a file path.
+	*/
+	virtual void PublishScene(std::string location) = 0;
+
+	/**
+	* @brief Uploads a scene that another process published, in place of
+	* UploadData.  The geometry is shared with every other process attached
+	* to it rather than copied.  Throws an std::invalid_argument if it can't
+	* be attached.
+	*
+	* @param location Where the scene was published.
+	* @param texture_cache The cache for the scene's textures, if it has any.
+	*/
+	virtual void AttachScene(std::string location,
+							 std::shared_ptr<TextureCache> texture_cache) = 0;
+
+	// Sets the recorder that the device reports the timeline of its render
+	// phases to.  Passing nullptr (the default) disables tracing.
+	void SetTraceRecorder(TraceRecorder* recorder);
+
+	void SetRenderMode(RenderMode mode);
+	RenderMode GetRenderMode();
+
+	// Sets what computes the colour of each sample in the shaded render mode.
+	// The device doesn't take ownership, and the integrator must outlive any
+	// render using it.  Passing nullptr (the default) goes back to the
+	// device's own UVIntegrator.
+	void SetIntegrator(Integrator* _integrator);
+	Integrator* GetIntegrator();
+
+	void SetExecutionMode(ExecutionMode mode);
+	ExecutionMode GetExecutionMode();
+
+	// How the geometry of uploaded objects is stored.  Only takes effect the
+	// next time objects are uploaded.
+	void SetMeshEncoding(MeshEncoding encoding);
+	MeshEncoding GetMeshEncoding();
+
+	// Where the geometry of uploaded objects is streamed from, or nullptr to
+	// keep it all in memory.  Only takes effect the next time objects are
+	// uploaded.
+	void SetGeometryCache(std::shared_ptr<GeometryCache> cache);
+	std::shared_ptr<GeometryCache> GetGeometryCache();
+
+	// The number of rays traced through each pixel.  The samples are averaged
+	// to anti-alias the image.
+	void SetSamplesPerPixel(int samples);
+	int GetSamplesPerPixel();
+
+	// Where the samples are placed within each pixel, and how they are
+	// weighted when they are combined.
+	void SetSamplerType(SamplerType type);
+	void SetFilterType(FilterType type);
+
+	/**
+	* @brief Enables adaptive sampling, where pixels stop taking samples once
+	* they have converged, so that the samples per pixel setting becomes a
+	* maximum.  Flat regions then finish in a fraction of the samples, and the
+	* time saved goes to the noisy pixels (such as mesh edges).
+	*
+	* @param error_threshold The largest acceptable standard error of a
+	* pixel's luminance, relative to the luminance.  0 disables adaptive
+	* sampling.
+	* @param min_samples The number of samples every pixel takes before it
+	* can be considered converged, so that pixels that happen to get a few
+	* similar samples aren't stopped early.
+	*/
+	void SetAdaptiveSampling(float error_threshold, int min_samples);
+
+	/**
+	* @brief Limits how long a frame can spend taking samples.  Once the time
+	* is up, tiles stop taking more samples, but every pixel always gets at
+	* least one batch so that the image is complete.  Tiles that are started
+	* late get fewer samples than those started early.
+	*
+	* @param milliseconds The budget for each call to RenderFrames.  0 (the
+	* default) means no limit.
+	*/
+	void SetTimeBudget(int milliseconds);
+
+	// The number of samples each pixel gets per pass of a progressive render.
+	// Fewer samples per pass give the first preview sooner, and more reduce
+	// the overhead of starting each pass.
+	void SetProgressivePassSamples(int samples);
+
+	/**
+	* @brief Enables denoising of shaded frames.  The device then also records
+	* the albedo, normal, and depth of each sample's first hit, which guide
+	* the denoiser, so far fewer samples per pixel are needed for a clean
+	* image.  Progressive renders denoise each result as it is read.
+	*
+	* @param iterations The number of iterations of the denoiser, each of
+	* which doubles the width of its blur.  0 (the default) disables it.
+	*/
+	void SetDenoising(int iterations);
+
+	/**
+	* @brief Makes progressive renders save a checkpoint as they go, so that
+	* they can be resumed with ResumeProgressiveRender if the process is
+	* stopped.  A checkpoint is saved at the end of a pass once the interval
+	* has passed since the last one, and always when the render finishes or
+	* is stopped.
+	*
+	* @param location Where the checkpoint is saved, or empty (the default)
+	* to disable checkpoints.
+	* @param interval_seconds The least time between checkpoints.  0 saves
+	* one after every pass.
+	*/
+	void SetCheckpointing(std::string location, int interval_seconds);
+
+	// Enables recording AOVs (depth, normals, IDs and so on) while shaded
+	// frames render, so they can be read with GetAOV afterwards.  They are
+	// always recorded while denoising, since they guide the denoiser.
+	void SetAOVsEnabled(bool enabled);
+
+	// Whether the frame buffers of the next render need AOVs.
+	bool NeedsAOVs();
+
 protected:
 	bool is_ready = false;
-	bool is_finished = false;
+	// Atomic since it is polled from other threads during progressive renders.
+	std::atomic<bool> is_finished = false;
+
+	TraceRecorder* trace = nullptr;
+	RenderMode render_mode = RenderMode::Shaded;
+
+	Integrator* integrator = nullptr;
+	UVIntegrator uv_integrator;
+	ExecutionMode execution_mode = ExecutionMode::DepthFirst;
+	MeshEncoding mesh_encoding = MeshEncoding::Exact;
+	std::shared_ptr<GeometryCache> geometry_cache;
+
+	int samples_per_pixel = 1;
+	Sampler sampler;
+	ReconstructionFilter filter;
+
+	float adaptive_threshold = 0;
+	int adaptive_min_samples = 8;
+	int time_budget = 0;
+	int progressive_pass_samples = 1;
+	bool denoise = false;
+	Denoiser denoiser;
+	bool aovs_enabled = false;
+
+	std::string checkpoint_location = "";
+	int checkpoint_interval = 0;
+
+	// Helpers so that implementations don't have to check whether a recorder
+	// has been set every time they record a span.
+	long long GetTraceTimestamp();
+	void AddTraceSpan(std::string name, std::string category, long long start,
+					  int thread_id);
 };
 
 class CPUDevice : public Device
 {
 public:
+	// The width and height of the square tiles that frames are divided into.
+	// Tiles are handed out to threads as they become free, so smaller tiles
+	// balance the load better at the cost of more scheduling.
+	static const int TILE_SIZE = 16;
+
+	// The most samples per pixel traced in one pass over a tile.  Pixels with
+	// more samples than this take several passes, which bounds the scratch
+	// space each thread needs.
+	static const int SAMPLE_BATCH = 16;
+
 	CPUDevice();
+	~CPUDevice();
 
 	bool IsDeviceCompatible();
 	bool IsDeviceReady();
 	bool IsDeviceFinished();
 
 	void RenderFrame(Camera c, int max_threads, int* output_location);
+	// Stops any progressive render first.
+	void RenderFrames(std::vector<Camera> cameras, int max_threads,
+					  std::vector<int*> output_locations);
+
+	void StartProgressiveRender(Camera c, int max_threads);
+	int GetProgressiveResult(int* output_location);
+	void StopProgressiveRender();
+	void ResumeProgressiveRender(Camera c, int max_threads,
+								 std::string checkpoint_location);
+
+	void GetAOV(AOVType type, int view, float* output_location);
 
 	void UploadData(std::vector<ObjectHandler*>* _objects);
+	void PublishScene(std::string location);
+	void AttachScene(std::string location,
+					 std::shared_ptr<TextureCache> texture_cache);
+
+	/**
+	* @brief Renders one rectangle of a camera's image, adding its samples to
+	* a frame buffer the size of the whole image.  The samples are the same
+	* as the ones RenderFrame takes for those pixels, so rectangles rendered
+	* separately (even by different processes) can be put together into the
+	* same image.  Used by the workers of a distributed render.
+	*
+	* @param c The camera.
+	* @param x The left edge of the rectangle, in pixels.
+	* @param y The top edge of the rectangle, in pixels.
+	* @param width The width of the rectangle.
+	* @param height The height of the rectangle.
+	* @param max_threads The most threads to render the rectangle's tiles on.
+	* @param frame The frame buffer the samples are added to.  Its pixels in
+	* the rectangle should have no samples yet.
+	* @param costs The traversal cost of each pixel of the image, which is
+	* added to in the heatmap render mode and can be nullptr otherwise.
+	*
+	* @return The number of samples taken.
+	*/
+	long long RenderRegion(Camera c, int x, int y, int width, int height,
+						   int max_threads, FrameBuffer* frame, int* costs);
+
+	/**
+	* @brief Makes a frame that was rendered elsewhere, such as by the workers
+	* of a distributed render, the result of the last job, and writes it into
+	* the output the same way RenderFrame would, denoising it if enabled.
+	* Its AOVs can then be read with GetAOV as view 0.
+	*
+	* @param frame The rendered frame.
+	* @param costs The traversal cost of each pixel, only used in the heatmap
+	* render mode.
+	* @param samples The number of samples taken to render the frame.
+	* @param max_threads The most threads to denoise on.
+	* @param output_location An int array with minimum size width * height * 3.
+	*/
+	void ResolveRemoteFrame(FrameBuffer frame, int* costs, long long samples,
+							int max_threads, int* output_location);
+
+	// Swaps the scene being rendered with one that was prepared elsewhere,
+	// such as on another thread while the previous frame was rendering.  The
+	// scene that was being rendered is handed back through other, so that
+	// its storage can be refit for a later frame.
+	void SwapPreparedScene(PreparedScene* other);
+
+	// The total number of samples taken by the last job, across all of its
+	// views.  With adaptive sampling or a time budget this is usually fewer
+	// than the samples per pixel times the number of pixels.
+	long long GetSamplesTaken();
+
+	// The memory taken by the uploaded geometry, in bytes.
+	size_t GetGeometryBytes();
+
+	// The allocations made from the render threads' frame arenas since the
+	// device was created, summed over the threads.
+	ArenaStatistics GetArenaStatistics();
 
 private:
-	// This CPU Device doesn't copy the data since there's no advantage to it.
-	// Instead, we just hold the vector of objects so that we don't duplicate
-	// memory.  This is one of the reasons that render handlers are not allowed
-	// to update objects until the frame has finished rendering.
+	// A single camera being rendered as part of a job.
+	struct RenderView
+	{
+		Camera camera;
+		float origin[3];
+		int* output_location;
+		FrameBuffer* frame;
+		int* costs; // nullptr unless the heatmap is being rendered.
+
+		// The rectangle of the image to render, which is all of it unless
+		// only a region was asked for.
+		int region_x, region_y;
+		int region_width, region_height;
+
+		// The range of sample indices to take for each pixel.
+		int first_sample;
+		int num_samples;
+		// The size of a whole set of samples, which the stratified sampler
+		// divides each pixel between.  The same for every pass of a
+		// progressive render, including a last pass that is cut short.
+		int set_samples;
+
+		// The samples taken by earlier passes of a progressive render, used to
+		// skip pixels that have already converged.  nullptr otherwise.
+		FrameBuffer* history;
+	};
+
+	// A square section of one view.  Tiles at the edges of the frame can be
+	// smaller than TILE_SIZE.
+	struct Tile
+	{
+		int view;
+		int x, y;
+		int width, height;
+	};
+
+	// The objects are transformed into world space once when they are
+	// uploaded, and every view and thread of a job shares that copy.  This is
+	// one of the reasons that render handlers are not allowed to update
+	// objects until the frame has finished rendering.
 	std::vector<ObjectHandler*>* objects;
+	PreparedScene scene;
+	// The last scene this device published, which is kept open since a
+	// Windows shared memory segment only lasts while it is open.
+	SharedMemory published_scene;
+	// The hash of the prepared scene that checkpoints save, which is only
+	// worked out once one needs it, since it reads all of the geometry.
+	unsigned long long scene_hash = 0;
+	bool has_scene_hash = false;
 
-	// This renders a horizontal section.  It could technically be squares like
-	// many engines, but as far as I can tell this offers no benefit other than
-	// seeing the image being built, and since the engine doesn't currently
-	// display this seems fine.
-	void RenderSection(float* origin, float* positions, int num_positions, int* output_location);
-
-	// This implements the Moller-Trumbore algorithm, generally the fastest
-	// one that is easy to implement.  Origin and direction are both Vector3
-	// array equivalents, while vertices is the vertices that are being tested
-	// against.  triangle is the location of the triangle (this function only
-	// tests one triangle).  t, u, and v are all output variables used for 
-	// detecting the nearest hit.
-	void GetRayHit(float* origin, float* direction, float* vertices,
-					int* triangle, Hit* output);
-};
+	std::chrono::steady_clock::time_point deadline;
+	std::atomic<long long> samples_taken;
 
-struct Hit
-{
-	bool hit = false;
-	float t, u, v;
-	int triangle_index; // The index of the triangle that was hit.
-	ObjectHandler* object = nullptr; // The object that was hit.
+	// The frames of the last RenderFrames call, which are kept until the
+	// next one so that their AOVs can be read.
+	std::vector<FrameBuffer> job_frames;
+	// True if the last render was progressive, in which case the AOVs come
+	// from progressive_frame instead.
+	bool progressive_job = false;
+
+	// The state of the progressive render.  Each pass renders into its own
+	// buffers, which are added to these under the mutex once the pass is
+	// done, so readers never see a partially rendered pass.
+	std::thread progressive_thread;
+	std::mutex progressive_mutex;
+	std::atomic<bool> stop_requested;
+	FrameBuffer progressive_frame;
+	std::vector<int> progressive_costs;
+	int progressive_passes = 0;
+	int progressive_threads = 1;
+	// The time spent on the render by earlier processes, if it was resumed
+	// from a checkpoint, and when this process started on it.
+	long long progressive_resumed_milliseconds = 0;
+	std::chrono::steady_clock::time_point progressive_start;
+
+	// The scratch memory of each render thread, indexed by thread id - 1.
+	// They are kept between frames so their blocks are reused, and each is
+	// reset once its thread finishes the frame.
+	std::vector<FrameArena> arenas;
+
+	// Splits the views into tiles and renders them on up to max_threads
+	// threads, returning once every tile is done.
+	void RenderViews(std::vector<RenderView>* views, int max_threads);
+
+	// Sets up a progressive render, either from scratch or carrying on from
+	// a checkpoint, and starts progressive_thread.
+	void BeginProgressiveRender(Camera c, int max_threads,
+								RenderCheckpoint* checkpoint);
+
+	// Runs on progressive_thread, rendering passes from first_sample on until
+	// it is done or asked to stop.
+	void ProgressiveWorker(Camera c, int max_threads, int first_sample);
 
-	bool IsGreater(Hit h);
-};
\ No newline at end of file
+	// Fills in the settings of a checkpoint of a progressive render.
+	void GetCheckpointSettings(Camera c, RenderCheckpoint* output);
+
+	// Saves a checkpoint of the progressive render, as of the last completed
+	// pass.  Failures are reported but don't stop the render.
+	void SaveCheckpoint(Camera c, int next_sample);
+
+	// Limits the requested number of threads to what the hardware has.
+	static int ClampThreadCount(int max_threads);
+
+	// Each thread takes the next tile off the shared list until there are none
+	// left.  Tiles from different views are interleaved so that the threads
+	// keep busy until the very end of the job.
+	void RenderWorker(std::vector<RenderView>* views, std::vector<Tile>* tiles,
+					  std::atomic<int>* next_tile, int thread_id);
+
+	// Intersection and shading are done as two passes over the tile so that
+	// they show up as separate spans when tracing.  hits and directions are
+	// scratch space owned by the worker, large enough for SAMPLE_BATCH
+	// samples of every pixel in a full tile.  The samples of each pixel are
+	// intersected together as one packet.  Anything else a batch needs comes
+	// from the worker's arena, and is released at the end of the batch.
+	// Returns the number of samples taken.
+	long long RenderTile(RenderView* view, Tile tile, Hit* hits,
+						 float* directions, FrameArena* arena, int thread_id);
+
+	// Finds the AOVs of a camera ray's first hit.  Textures are looked up
+	// with the footprint of the pixel, so the albedo is no sharper than the
+	// image.
+	void GetAOVSample(RenderView* view, float* direction, Hit* hit,
+					  AOVSample* output);
+
+	// Writes a finished frame into the output, denoising it if enabled.
+	void ResolveFrame(FrameBuffer* frame, int max_threads, int* output_location);
+
+	// Converts the traversal cost of every pixel into a false colour,
+	// normalized against the most expensive pixel in the frame.
+	void WriteHeatmap(int* costs, int num_pixels, int* output_location);
+};
@@ -0,0 +1,99 @@
+#include "FrameArena.h"
+
+FrameArena::FrameArena(size_t _block_size)
+{
+	block_size = _block_size == 0 ? DEFAULT_BLOCK_SIZE : _block_size;
+}
+
+void* FrameArena::AllocateBytes(size_t bytes, size_t alignment)
+{
+	statistics.allocations++;
+
+	while (true)
+	{
+		if (current_block < blocks.size())
+		{
+			Block& block = blocks[current_block];
+			uintptr_t address = (uintptr_t)(block.data.get() + offset);
+			size_t padding = (alignment - address % alignment) % alignment;
+
+			if (offset + padding + bytes <= block.size)
+			{
+				offset += padding + bytes;
+				bytes_in_use += padding + bytes;
+				statistics.bytes_allocated += padding + bytes;
+				statistics.peak_bytes = std::max(statistics.peak_bytes, bytes_in_use);
+				return (void*)(address + padding);
+			}
+
+			// The rest of this block is left unused until the next rewind.
+			bytes_in_use += block.size - offset;
+			current_block++;
+			offset = 0;
+			continue;
+		}
+
+		// Blocks come from new[], which aligns them for any fundamental
+		// type, but the extra space covers larger alignments too.
+		Block block;
+		block.size = std::max(block_size, bytes + alignment);
+		block.data = std::make_unique<char[]>(block.size);
+		blocks.push_back(std::move(block));
+
+		statistics.reserved_bytes += blocks.back().size;
+		statistics.blocks_allocated++;
+	}
+}
+
+FrameArena::Marker FrameArena::GetMarker() const
+{
+	Marker marker;
+	marker.block = current_block;
+	marker.offset = offset;
+	marker.bytes_in_use = bytes_in_use;
+	return marker;
+}
+
+void FrameArena::Rewind(Marker marker)
+{
+	current_block = marker.block;
+	offset = marker.offset;
+	bytes_in_use = marker.bytes_in_use;
+}
+
+void FrameArena::Reset()
+{
+	statistics.resets++;
+
+	// The blocks are merged into one the first time a frame spills over, so
+	// this only happens until the arena has grown to fit a whole frame.
+	if (blocks.size() > 1)
+	{
+		Block block;
+		block.size = statistics.reserved_bytes;
+		block.data = std::make_unique<char[]>(block.size);
+
+		blocks.clear();
+		blocks.push_back(std::move(block));
+		statistics.blocks_allocated++;
+	}
+
+	current_block = 0;
+	offset = 0;
+	bytes_in_use = 0;
+}
+
+ArenaStatistics FrameArena::GetStatistics() const
+{
+	return statistics;
+}
+
+void FrameArena::AddStatistics(const ArenaStatistics& other, ArenaStatistics* total)
+{
+	total->allocations += other.allocations;
+	total->bytes_allocated += other.bytes_allocated;
+	total->peak_bytes += other.peak_bytes;
+	total->reserved_bytes += other.reserved_bytes;
+	total->blocks_allocated += other.blocks_allocated;
+	total->resets += other.resets;
+}
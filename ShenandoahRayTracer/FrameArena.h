@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Counts of what an arena (or a set of them) has handed out.
+struct ArenaStatistics
+{
+	long long allocations = 0;
+	// Every byte handed out, including the padding used to align them.
+	long long bytes_allocated = 0;
+	// The most memory in use at once between two resets.
+	size_t peak_bytes = 0;
+	// The memory held by the arena's blocks, which is kept across resets.
+	size_t reserved_bytes = 0;
+	// The number of times a block had to be allocated from the system.
+	int blocks_allocated = 0;
+	long long resets = 0;
+};
+
+/** A bump allocator for memory that only lives for one frame.
+
+An allocation just moves a pointer forward through a large block, and
+nothing is ever freed on its own.  Instead, Rewind releases everything
+allocated after a marker, and Reset releases everything at once, both
+without touching the allocations themselves.  When a block runs out the
+arena moves on to the next one, allocating it if it doesn't exist yet, and
+every block is kept for the next frame.  If a frame needed more than one
+block, the next Reset replaces them with a single block that fits it all,
+so from then on each frame stays in one block and never calls the system
+allocator.
+
+An arena isn't thread safe.  Each render thread owns its own, so threads
+never contend for memory the way they do over the global heap.  Since
+nothing is destroyed, only types with trivial destructors can be allocated
+directly, though containers of any type can use an ArenaAllocator.
+
+*/
+class FrameArena
+{
+public:
+	// The size of the first block, and the smallest any block can be.
+	static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+	// A point in the arena that it can be rewound to.
+	struct Marker
+	{
+		int block;
+		size_t offset;
+		size_t bytes_in_use;
+	};
+
+	/**
+	* @brief Creates an empty arena.  No memory is allocated until the first
+	* allocation.
+	*
+	* @param _block_size The size of each block, which must be positive.
+	* Allocations larger than this get a block of their own size.
+	*/
+	FrameArena(size_t _block_size = DEFAULT_BLOCK_SIZE);
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	FrameArena(FrameArena&&) = default;
+	FrameArena& operator=(FrameArena&&) = default;
+
+	/**
+	* @brief Allocates uninitialized memory.
+	*
+	* @param bytes The size of the allocation.
+	* @param alignment The alignment of the allocation, which must be a power
+	* of 2.
+	*
+	* @return The memory, which stays valid until the arena is rewound past it
+	* or reset.
+	*/
+	void* AllocateBytes(size_t bytes, size_t alignment);
+
+	/**
+	* @brief Allocates an array and value-initializes every element, so
+	* numbers start at 0 and classes are default constructed.
+	*
+	* @param count The number of elements.
+	*/
+	template <typename T>
+	T* Allocate(int count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>,
+					  "Arenas never run destructors.");
+
+		T* output = AllocateUninitialized<T>(count);
+		for (int i = 0; i < count; i++)
+			new (&output[i]) T();
+		return output;
+	}
+
+	// Allocates space for an array without constructing anything in it, for
+	// types that are constructed in place by the caller.
+	template <typename T>
+	T* AllocateUninitialized(int count)
+	{
+		return (T*)AllocateBytes(sizeof(T) * std::max(count, 0), alignof(T));
+	}
+
+	Marker GetMarker() const;
+
+	// Releases everything allocated since the marker was taken.
+	void Rewind(Marker marker);
+
+	// Releases everything, keeping the blocks for the next frame.
+	void Reset();
+
+	ArenaStatistics GetStatistics() const;
+
+	// Adds the counts of another arena to a running total.  The peak and
+	// reserved memory are added too, so the total is an upper bound on what
+	// the arenas used together.
+	static void AddStatistics(const ArenaStatistics& other, ArenaStatistics* total);
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t block_size;
+
+	// The next free byte is at blocks[current_block].data[offset].
+	int current_block = 0;
+	size_t offset = 0;
+
+	// Everything since the last reset, including the unused ends of the
+	// blocks that have been moved past.
+	size_t bytes_in_use = 0;
+
+	ArenaStatistics statistics;
+};
+
+/** Lets standard containers take their memory from a FrameArena.
+
+Memory given back by a container isn't reused until the arena is rewound or
+reset, so containers should reserve what they need up front rather than
+growing a bit at a time.  The allocator moves with the container it belongs
+to, so a container can be assigned one made from a specific arena.
+
+*/
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	// Allocators without an arena can't allocate, but let containers be
+	// declared before they are given one.
+	ArenaAllocator() {}
+	ArenaAllocator(FrameArena* _arena) : arena(_arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.GetArena()) {}
+
+	T* allocate(size_t count)
+	{
+		return (T*)arena->AllocateBytes(sizeof(T) * count, alignof(T));
+	}
+
+	void deallocate(T* pointer, size_t count) {}
+
+	FrameArena* GetArena() const
+	{
+		return arena;
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const
+	{
+		return arena == other.GetArena();
+	}
+
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const
+	{
+		return arena != other.GetArena();
+	}
+
+private:
+	FrameArena* arena = nullptr;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
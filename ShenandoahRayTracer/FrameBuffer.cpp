@@ -0,0 +1,434 @@
+#include "FrameBuffer.h"
+
+FrameBuffer::FrameBuffer()
+{
+
+}
+
+FrameBuffer::FrameBuffer(int _width, int _height)
+{
+	width = _width;
+	height = _height;
+
+	color_sums.resize(width * height * 3);
+	sample_counts.resize(width * height);
+	luminance_means.resize(width * height);
+	luminance_m2.resize(width * height);
+	Clear();
+}
+
+int FrameBuffer::GetWidth()
+{
+	return width;
+}
+
+int FrameBuffer::GetHeight()
+{
+	return height;
+}
+
+void FrameBuffer::Clear()
+{
+	std::fill(color_sums.begin(), color_sums.end(), 0.0f);
+	std::fill(sample_counts.begin(), sample_counts.end(), 0);
+	std::fill(luminance_means.begin(), luminance_means.end(), 0.0f);
+	std::fill(luminance_m2.begin(), luminance_m2.end(), 0.0f);
+	std::fill(aov_sums.begin(), aov_sums.end(), 0.0f);
+	std::fill(hit_counts.begin(), hit_counts.end(), 0);
+	std::fill(ids.begin(), ids.end(), -1);
+}
+
+void FrameBuffer::Clear(int x, int y, int region_width, int region_height)
+{
+	CheckRegion(x, y, region_width, region_height);
+
+	for (int j = y; j < y + region_height; j++)
+	{
+		int first = j * width + x;
+		int last = first + region_width;
+
+		std::fill(color_sums.begin() + first * 3, color_sums.begin() + last * 3, 0.0f);
+		std::fill(sample_counts.begin() + first, sample_counts.begin() + last, 0);
+		std::fill(luminance_means.begin() + first, luminance_means.begin() + last, 0.0f);
+		std::fill(luminance_m2.begin() + first, luminance_m2.begin() + last, 0.0f);
+
+		if (HasAOVs())
+		{
+			std::fill(aov_sums.begin() + first * AOV_SIZE,
+					  aov_sums.begin() + last * AOV_SIZE, 0.0f);
+			std::fill(hit_counts.begin() + first, hit_counts.begin() + last, 0);
+			std::fill(ids.begin() + first * 2, ids.begin() + last * 2, -1);
+		}
+	}
+}
+
+void FrameBuffer::WriteRegion(int x, int y, int region_width, int region_height,
+							  std::vector<char>* output)
+{
+	CheckRegion(x, y, region_width, region_height);
+
+	size_t position = output->size();
+	output->resize(position + GetRegionBytes(region_width, region_height));
+	char* data = output->data();
+
+	CopyRegion(&color_sums, 3, x, y, region_width, region_height, data, &position, true);
+	CopyRegion(&sample_counts, 1, x, y, region_width, region_height, data, &position, true);
+	CopyRegion(&luminance_means, 1, x, y, region_width, region_height, data, &position, true);
+	CopyRegion(&luminance_m2, 1, x, y, region_width, region_height, data, &position, true);
+	if (HasAOVs())
+	{
+		CopyRegion(&aov_sums, AOV_SIZE, x, y, region_width, region_height, data, &position, true);
+		CopyRegion(&hit_counts, 1, x, y, region_width, region_height, data, &position, true);
+		CopyRegion(&ids, 2, x, y, region_width, region_height, data, &position, true);
+	}
+}
+
+size_t FrameBuffer::ReadRegion(int x, int y, int region_width, int region_height,
+							   const char* data, size_t size)
+{
+	CheckRegion(x, y, region_width, region_height);
+
+	if (size < GetRegionBytes(region_width, region_height))
+		throw std::invalid_argument("Not enough data for a " + std::to_string(region_width) +
+									"x" + std::to_string(region_height) +
+									" region of a frame buffer.");
+
+	// CopyRegion only reads from the data when write is false.
+	char* source = const_cast<char*>(data);
+	size_t position = 0;
+
+	CopyRegion(&color_sums, 3, x, y, region_width, region_height, source, &position, false);
+	CopyRegion(&sample_counts, 1, x, y, region_width, region_height, source, &position, false);
+	CopyRegion(&luminance_means, 1, x, y, region_width, region_height, source, &position, false);
+	CopyRegion(&luminance_m2, 1, x, y, region_width, region_height, source, &position, false);
+	if (HasAOVs())
+	{
+		CopyRegion(&aov_sums, AOV_SIZE, x, y, region_width, region_height, source, &position, false);
+		CopyRegion(&hit_counts, 1, x, y, region_width, region_height, source, &position, false);
+		CopyRegion(&ids, 2, x, y, region_width, region_height, source, &position, false);
+	}
+
+	return position;
+}
+
+size_t FrameBuffer::GetRegionBytes(int region_width, int region_height)
+{
+	size_t pixel_bytes = sizeof(float) * 5 + sizeof(int);
+	if (HasAOVs())
+		pixel_bytes += sizeof(float) * AOV_SIZE + sizeof(int) * 3;
+
+	return pixel_bytes * region_width * region_height;
+}
+
+void FrameBuffer::CheckRegion(int x, int y, int region_width, int region_height)
+{
+	if (x < 0 || y < 0 || region_width < 0 || region_height < 0 ||
+		x + region_width > width || y + region_height > height)
+		throw std::invalid_argument("The region at " + std::to_string(x) + ", " +
+									std::to_string(y) + " doesn't lie within the frame buffer.");
+}
+
+template <typename T>
+void FrameBuffer::CopyRegion(std::vector<T>* values, int values_per_pixel, int x,
+							 int y, int region_width, int region_height, char* data,
+							 size_t* position, bool write)
+{
+	// Each row of the rectangle is contiguous in the array, so it is copied
+	// with one memcpy.
+	size_t row_bytes = sizeof(T) * values_per_pixel * region_width;
+	for (int j = y; j < y + region_height; j++)
+	{
+		T* row = values->data() + (size_t)(j * width + x) * values_per_pixel;
+		if (write)
+			memcpy(data + *position, row, row_bytes);
+		else
+			memcpy(row, data + *position, row_bytes);
+		*position += row_bytes;
+	}
+}
+
+void FrameBuffer::AddSample(int pixel, float* color)
+{
+	color_sums[pixel * 3] += color[0];
+	color_sums[pixel * 3 + 1] += color[1];
+	color_sums[pixel * 3 + 2] += color[2];
+	sample_counts[pixel]++;
+
+	float luminance = GetLuminance(color);
+	float delta = luminance - luminance_means[pixel];
+	luminance_means[pixel] += delta / sample_counts[pixel];
+	luminance_m2[pixel] += delta * (luminance - luminance_means[pixel]);
+}
+
+void FrameBuffer::Add(FrameBuffer* other)
+{
+	if (other->width != width || other->height != height)
+		throw std::invalid_argument("Frame buffers must be the same size.");
+
+	for (int p = 0; p < width * height; p++)
+	{
+		int other_count = other->sample_counts[p];
+		if (other_count == 0)
+			continue;
+
+		color_sums[p * 3] += other->color_sums[p * 3];
+		color_sums[p * 3 + 1] += other->color_sums[p * 3 + 1];
+		color_sums[p * 3 + 2] += other->color_sums[p * 3 + 2];
+
+		// This buffer's samples came first, so its IDs are kept if it has
+		// any.
+		if (!aov_sums.empty() && !other->aov_sums.empty())
+		{
+			for (int f = 0; f < AOV_SIZE; f++)
+				aov_sums[p * AOV_SIZE + f] += other->aov_sums[p * AOV_SIZE + f];
+			if (hit_counts[p] == 0)
+			{
+				ids[p * 2] = other->ids[p * 2];
+				ids[p * 2 + 1] = other->ids[p * 2 + 1];
+			}
+			hit_counts[p] += other->hit_counts[p];
+		}
+
+		// Chan et al.'s method for combining the variances of two sets.
+		int count = sample_counts[p] + other_count;
+		float delta = other->luminance_means[p] - luminance_means[p];
+		luminance_means[p] += delta * other_count / count;
+		luminance_m2[p] += other->luminance_m2[p] +
+			delta * delta * sample_counts[p] * other_count / count;
+		sample_counts[p] = count;
+	}
+}
+
+int FrameBuffer::GetSampleCount(int pixel)
+{
+	return sample_counts[pixel];
+}
+
+void FrameBuffer::EnableAOVs()
+{
+	aov_sums.resize(width * height * AOV_SIZE);
+	hit_counts.resize(width * height);
+	ids.resize(width * height * 2);
+	Clear();
+}
+
+bool FrameBuffer::HasAOVs()
+{
+	return !aov_sums.empty();
+}
+
+void FrameBuffer::AddAOVSample(int pixel, AOVSample* sample)
+{
+	if (!sample->hit)
+		return;
+
+	float* sums = &aov_sums[pixel * AOV_SIZE];
+	sums[0] += sample->depth;
+	for (int c = 0; c < 3; c++)
+	{
+		sums[1 + c] += sample->normal[c];
+		sums[4 + c] += sample->albedo[c];
+	}
+	sums[7] += sample->uv[0];
+	sums[8] += sample->uv[1];
+
+	if (hit_counts[pixel] == 0)
+	{
+		ids[pixel * 2] = sample->object_id;
+		ids[pixel * 2 + 1] = sample->triangle_id;
+	}
+	hit_counts[pixel]++;
+}
+
+float FrameBuffer::GetDepth(int pixel)
+{
+	if (hit_counts[pixel] == 0)
+		return 0;
+
+	return aov_sums[pixel * AOV_SIZE] / hit_counts[pixel];
+}
+
+void FrameBuffer::GetNormal(int pixel, float* output_location)
+{
+	float* sums = &aov_sums[pixel * AOV_SIZE + 1];
+	float length = sqrt(sums[0] * sums[0] + sums[1] * sums[1] + sums[2] * sums[2]);
+	float scale = length > 0 ? 1.0f / length : 0.0f;
+
+	for (int c = 0; c < 3; c++)
+		output_location[c] = sums[c] * scale;
+}
+
+void FrameBuffer::GetAlbedo(int pixel, float* output_location)
+{
+	float scale = hit_counts[pixel] > 0 ? 1.0f / hit_counts[pixel] : 0.0f;
+
+	for (int c = 0; c < 3; c++)
+		output_location[c] = aov_sums[pixel * AOV_SIZE + 4 + c] * scale;
+}
+
+void FrameBuffer::GetUV(int pixel, float* output_location)
+{
+	float scale = hit_counts[pixel] > 0 ? 1.0f / hit_counts[pixel] : 0.0f;
+
+	output_location[0] = aov_sums[pixel * AOV_SIZE + 7] * scale;
+	output_location[1] = aov_sums[pixel * AOV_SIZE + 8] * scale;
+}
+
+int FrameBuffer::GetObjectID(int pixel)
+{
+	return ids[pixel * 2];
+}
+
+int FrameBuffer::GetTriangleID(int pixel)
+{
+	return ids[pixel * 2 + 1];
+}
+
+float FrameBuffer::GetCoverage(int pixel)
+{
+	if (sample_counts[pixel] == 0)
+		return 0;
+
+	return (float)hit_counts[pixel] / sample_counts[pixel];
+}
+
+void FrameBuffer::GetAOV(AOVType type, float* output_location)
+{
+	if (aov_sums.empty())
+		throw std::invalid_argument("AOVs are not enabled for this frame buffer.");
+
+	int channels = GetAOVChannels(type);
+
+	for (int p = 0; p < width * height; p++)
+	{
+		float* output = &output_location[p * channels];
+
+		switch (type)
+		{
+		case AOVType::Depth:
+			output[0] = GetDepth(p);
+			break;
+		case AOVType::Normal:
+			GetNormal(p, output);
+			break;
+		case AOVType::Albedo:
+			GetAlbedo(p, output);
+			break;
+		case AOVType::UV:
+			GetUV(p, output);
+			break;
+		case AOVType::ObjectID:
+			output[0] = GetObjectID(p);
+			break;
+		case AOVType::TriangleID:
+			output[0] = GetTriangleID(p);
+			break;
+		case AOVType::Coverage:
+			output[0] = GetCoverage(p);
+			break;
+		}
+	}
+}
+
+int FrameBuffer::GetAOVChannels(AOVType type)
+{
+	switch (type)
+	{
+	case AOVType::Normal:
+	case AOVType::Albedo:
+		return 3;
+	case AOVType::UV:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+AOVType FrameBuffer::ParseAOVType(std::string name)
+{
+	if (name == "depth")
+		return AOVType::Depth;
+	if (name == "normal")
+		return AOVType::Normal;
+	if (name == "albedo")
+		return AOVType::Albedo;
+	if (name == "uv")
+		return AOVType::UV;
+	if (name == "objectid")
+		return AOVType::ObjectID;
+	if (name == "triangleid")
+		return AOVType::TriangleID;
+	if (name == "coverage")
+		return AOVType::Coverage;
+
+	throw std::invalid_argument("Unknown AOV: " + name);
+}
+
+std::string FrameBuffer::GetAOVName(AOVType type)
+{
+	switch (type)
+	{
+	case AOVType::Depth:
+		return "depth";
+	case AOVType::Normal:
+		return "normal";
+	case AOVType::Albedo:
+		return "albedo";
+	case AOVType::UV:
+		return "uv";
+	case AOVType::ObjectID:
+		return "objectid";
+	case AOVType::TriangleID:
+		return "triangleid";
+	default:
+		return "coverage";
+	}
+}
+
+void FrameBuffer::GetColor(int pixel, float* output_location)
+{
+	float scale = sample_counts[pixel] > 0 ? 1.0f / sample_counts[pixel] : 0.0f;
+
+	output_location[0] = color_sums[pixel * 3] * scale;
+	output_location[1] = color_sums[pixel * 3 + 1] * scale;
+	output_location[2] = color_sums[pixel * 3 + 2] * scale;
+}
+
+void FrameBuffer::Resolve(int* output_location)
+{
+	float color[3];
+	for (int p = 0; p < width * height; p++)
+	{
+		GetColor(p, color);
+		output_location[p * 3] = (int)round(color[0]);
+		output_location[p * 3 + 1] = (int)round(color[1]);
+		output_location[p * 3 + 2] = (int)round(color[2]);
+	}
+}
+
+float FrameBuffer::GetVariance(int pixel)
+{
+	if (sample_counts[pixel] < 2)
+		return INFINITY;
+
+	return luminance_m2[pixel] / (sample_counts[pixel] - 1);
+}
+
+float FrameBuffer::GetStandardError(int pixel)
+{
+	if (sample_counts[pixel] < 2)
+		return INFINITY;
+
+	return sqrt(GetVariance(pixel) / sample_counts[pixel]);
+}
+
+bool FrameBuffer::IsConverged(int pixel, float error_threshold)
+{
+	return GetStandardError(pixel) <=
+		error_threshold * fmax(luminance_means[pixel], 1.0f);
+}
+
+float FrameBuffer::GetLuminance(float* color)
+{
+	return 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+}
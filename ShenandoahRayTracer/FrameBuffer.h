@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The arbitrary output variables (AOVs) a frame buffer can record alongside
+// the colour of each pixel.
+enum class AOVType
+{
+	// The distance along the camera ray to the hit.  1 channel.
+	Depth,
+	// The geometric normal of the hit, facing the camera.  3 channels.
+	Normal,
+	// The overall colour of the material that was hit.  3 channels.
+	Albedo,
+	// The texture coordinates of the hit.  2 channels.
+	UV,
+	// The index of the object that was hit within the scene, or -1.  1 channel.
+	ObjectID,
+	// The index of the triangle that was hit within its object, or -1.
+	// 1 channel.
+	TriangleID,
+	// The fraction of the pixel's samples that hit something.  1 channel.
+	Coverage
+};
+
+// What the camera ray of one sample hit, which is what the AOVs are made
+// from.
+struct AOVSample
+{
+	bool hit = false;
+	float depth = 0;
+	float normal[3] = { 0, 0, 0 };
+	float albedo[3] = { 0, 0, 0 };
+	float uv[2] = { 0, 0 };
+	int object_id = -1;
+	int triangle_id = -1;
+};
+
+/** Accumulates the samples of a frame before they are turned into pixels.
+
+Colours are stored as the running sum of every sample's colour in floating
+point, along with the number of samples each pixel has received, so the
+samples of a pixel can arrive in any number of batches.  The variance of
+each pixel's luminance is tracked as samples arrive (using Welford's
+algorithm), which tells adaptive sampling how noisy the pixel still is.  Each pixel is only
+ever written by the thread rendering its tile, so no locking is needed.
+
+Frame buffers can also record AOVs, which describe the first surface each
+sample hits, in the same pass as the colour.  Continuous AOVs (depth,
+normal, albedo, UV) are averaged over the samples that hit something, so
+they are anti-aliased like the colour without edges being pulled towards
+the background.  IDs can't be averaged, so they come from the first sample
+of the pixel that hit something.  Besides being written out for compositing,
+the AOVs are much less noisy than the colour, and guide the denoiser towards
+the edges it should keep.
+
+*/
+class FrameBuffer
+{
+public:
+	FrameBuffer();
+	FrameBuffer(int _width, int _height);
+
+	int GetWidth();
+	int GetHeight();
+
+	// Resets every pixel to black with no samples.
+	void Clear();
+
+	// Resets the pixels of a rectangle, which must lie within the frame.
+	void Clear(int x, int y, int region_width, int region_height);
+
+	/**
+	* @brief Appends everything recorded for a rectangle of pixels (the colour
+	* sums, sample counts, variance estimates, and AOVs if enabled) to a
+	* buffer, so that it can be sent to another process or saved to disk.
+	* Reading it back with ReadRegion gives exactly the same pixels.  Values
+	* are written in the byte order of the machine.
+	*
+	* @param x The left edge of the rectangle.
+	* @param y The top edge of the rectangle.
+	* @param region_width The width of the rectangle.
+	* @param region_height The height of the rectangle.
+	* @param output The buffer the pixels are appended to, which grows by
+	* GetRegionBytes(region_width, region_height).
+	*/
+	void WriteRegion(int x, int y, int region_width, int region_height,
+					 std::vector<char>* output);
+
+	/**
+	* @brief Replaces the pixels of a rectangle with ones written by
+	* WriteRegion from a frame buffer with the same AOV setting.  Throws an
+	* std::invalid_argument if the rectangle doesn't lie within the frame or
+	* there isn't enough data.
+	*
+	* @param data The data written by WriteRegion.
+	* @param size The size of the data in bytes.
+	*
+	* @return The number of bytes read.
+	*/
+	size_t ReadRegion(int x, int y, int region_width, int region_height,
+					  const char* data, size_t size);
+
+	// The number of bytes WriteRegion writes for a rectangle of this size.
+	size_t GetRegionBytes(int region_width, int region_height);
+
+	/**
+	* @brief Adds a sample to a pixel.
+	*
+	* @param pixel The index of the pixel, y * width + x.
+	* @param color A float array of size 3.
+	*/
+	void AddSample(int pixel, float* color);
+
+	/**
+	* @brief Adds every sample of another frame buffer of the same size, as if
+	* they had been added to this one directly.  The variances are combined
+	* exactly, so convergence can be judged across batches that were
+	* accumulated separately, such as the passes of a progressive render.
+	*
+	* @param other The frame buffer to add.
+	*/
+	void Add(FrameBuffer* other);
+
+	int GetSampleCount(int pixel);
+
+	// Starts recording AOVs alongside the colours.  Clears every pixel.
+	void EnableAOVs();
+	bool HasAOVs();
+
+	/**
+	* @brief Adds what a sample hit to the AOVs of a pixel.  Must be called
+	* once for every call to AddSample, since the coverage is measured
+	* against the sample count.
+	*
+	* @param pixel The index of the pixel, y * width + x.
+	* @param sample What the sample's camera ray hit.
+	*/
+	void AddAOVSample(int pixel, AOVSample* sample);
+
+	// The AOVs of a single pixel.  Pixels where no sample hit anything have
+	// zero depth, normal, albedo, and UV, and IDs of -1.  The normal is
+	// normalized.
+	float GetDepth(int pixel);
+	void GetNormal(int pixel, float* output_location);
+	void GetAlbedo(int pixel, float* output_location);
+	void GetUV(int pixel, float* output_location);
+	int GetObjectID(int pixel);
+	int GetTriangleID(int pixel);
+	float GetCoverage(int pixel);
+
+	/**
+	* @brief Writes one AOV for every pixel, row by row from the top.
+	*
+	* @param type The AOV.
+	* @param output_location A float array with minimum size width * height
+	* * GetAOVChannels(type).
+	*/
+	void GetAOV(AOVType type, float* output_location);
+
+	// The number of floats each pixel of an AOV takes.
+	static int GetAOVChannels(AOVType type);
+
+	/**
+	* @brief Parses an AOV name: "depth", "normal", "albedo", "uv",
+	* "objectid", "triangleid", or "coverage".
+	*
+	* @param name The name of the AOV.
+	*
+	* @return The AOV type.
+	*/
+	static AOVType ParseAOVType(std::string name);
+	static std::string GetAOVName(AOVType type);
+
+	/**
+	* @brief Gets the average colour of the samples of a pixel.  Pixels
+	* without samples are black.
+	*
+	* @param pixel The index of the pixel, y * width + x.
+	* @param output_location A float array with minimum size 3.
+	*/
+	void GetColor(int pixel, float* output_location);
+
+	/**
+	* @brief Writes the average colour of every pixel, rounded to the nearest
+	* integer, in the same layout as the output of a device.
+	*
+	* @param output_location An int array with minimum size width * height * 3.
+	*/
+	void Resolve(int* output_location);
+
+	/**
+	* @brief Gets the sample variance of the luminance of a pixel's samples.
+	* Pixels with fewer than 2 samples have no estimate and return INFINITY.
+	*
+	* @param pixel The index of the pixel, y * width + x.
+	*/
+	float GetVariance(int pixel);
+
+	/**
+	* @brief Gets the standard error of a pixel's mean luminance, which is how
+	* far the pixel is likely to be from the converged value.
+	*
+	* @param pixel The index of the pixel, y * width + x.
+	*/
+	float GetStandardError(int pixel);
+
+	/**
+	* @brief Checks whether a pixel has converged, meaning its standard error
+	* is at most error_threshold times its mean luminance.  The mean is
+	* floored at 1 so that black pixels can converge too.
+	*
+	* @param pixel The index of the pixel, y * width + x.
+	* @param error_threshold The largest acceptable relative error.
+	*/
+	bool IsConverged(int pixel, float error_threshold);
+
+	// The luminance of a colour, using the Rec. 709 weights.
+	static float GetLuminance(float* color);
+
+private:
+	int width = 0;
+	int height = 0;
+
+	std::vector<float> color_sums; // 3 floats per pixel.
+	std::vector<int> sample_counts;
+	std::vector<float> luminance_means;
+	std::vector<float> luminance_m2; // Sum of squared differences from the mean.
+
+	// Sums of depth (1 float), normal (3), albedo (3), and UV (2) per pixel
+	// over the samples that hit, along with the number of those samples and
+	// the object and triangle IDs.  All empty unless AOVs are enabled.
+	std::vector<float> aov_sums;
+	std::vector<int> hit_counts;
+	std::vector<int> ids;
+	static const int AOV_SIZE = 9;
+
+	void CheckRegion(int x, int y, int region_width, int region_height);
+
+	// Copies the values of one array for every pixel of a rectangle, either
+	// into a buffer or out of one, moving position past them.
+	template <typename T>
+	void CopyRegion(std::vector<T>* values, int values_per_pixel, int x, int y,
+					int region_width, int region_height, char* data,
+					size_t* position, bool write);
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/** An array of mesh data that either owns its elements, like an std::vector,
+or is a read-only view of elements kept somewhere else, such as a scene in
+shared memory that other processes map as well.
+
+It has the parts of std::vector's interface that PreparedScene uses, so it
+can mostly stand in for one, with append in place of insert.  Reading is exactly as cheap as it is from a vector,
+since the elements are always reached through the same pointer whichever
+way they are stored.  Anything that changes a view first copies it into
+storage of its own, so views are never written through.
+
+*/
+template <typename T>
+class GeometryArray
+{
+public:
+	GeometryArray() {}
+
+	GeometryArray(std::vector<T>&& values)
+	{
+		storage = std::move(values);
+		Update();
+	}
+
+	GeometryArray(const GeometryArray& other)
+	{
+		*this = other;
+	}
+
+	GeometryArray(GeometryArray&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	GeometryArray& operator=(const GeometryArray& other)
+	{
+		storage = other.storage;
+		viewing = false;
+		if (other.viewing)
+			View(other.elements, other.count);
+		else
+			Update();
+		return *this;
+	}
+
+	GeometryArray& operator=(GeometryArray&& other) noexcept
+	{
+		storage = std::move(other.storage);
+		viewing = other.viewing;
+		elements = viewing ? other.elements : storage.data();
+		count = other.count;
+
+		other.storage.clear();
+		other.viewing = false;
+		other.Update();
+		return *this;
+	}
+
+	// Makes the array a view of elements it doesn't own, which must outlive
+	// it, dropping any elements it had.
+	void View(const T* _elements, size_t _count)
+	{
+		std::vector<T>().swap(storage);
+		viewing = true;
+		elements = const_cast<T*>(_elements);
+		count = _count;
+	}
+
+	bool IsView() const { return viewing; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T* data() { return elements; }
+	const T* data() const { return elements; }
+
+	T& operator[](size_t i) { return elements[i]; }
+	const T& operator[](size_t i) const { return elements[i]; }
+
+	T* begin() { return elements; }
+	T* end() { return elements + count; }
+	const T* begin() const { return elements; }
+	const T* end() const { return elements + count; }
+
+	void clear()
+	{
+		Own();
+		storage.clear();
+		Update();
+	}
+
+	void resize(size_t size)
+	{
+		Own();
+		storage.resize(size);
+		Update();
+	}
+
+	template <typename Iterator>
+	void assign(Iterator first, Iterator last)
+	{
+		std::vector<T> values(first, last);
+		storage.swap(values);
+		viewing = false;
+		Update();
+	}
+
+	void push_back(const T& value)
+	{
+		Own();
+		storage.push_back(value);
+		Update();
+	}
+
+	// Adds elements to the end.  Unlike std::vector, there is no insert,
+	// since nothing that uses the array inserts anywhere else.
+	void append(const T* first, const T* last)
+	{
+		Own();
+		storage.insert(storage.end(), first, last);
+		Update();
+	}
+
+private:
+	std::vector<T> storage;
+	bool viewing = false;
+	T* elements = nullptr;
+	size_t count = 0;
+
+	// Copies a view into storage of the array's own.
+	void Own()
+	{
+		if (!viewing)
+			return;
+		storage.assign(elements, elements + count);
+		viewing = false;
+	}
+
+	// Points the array back at its storage after the storage changes.
+	void Update()
+	{
+		elements = storage.data();
+		count = storage.size();
+	}
+};
@@ -0,0 +1,156 @@
+#include "GeometryCache.h"
+
+GeometryCache::GeometryCache(std::string _file_location, size_t _max_bytes)
+	: clusters("geometry", _max_bytes)
+{
+	file_location = _file_location;
+#ifdef _WIN32
+	// Overlapped, since Windows serializes every read and write of a handle
+	// opened without it.
+	file = CreateFileA(file_location.c_str(), GENERIC_READ | GENERIC_WRITE,
+					   FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+					   FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_OVERLAPPED, nullptr);
+	bool opened = file != INVALID_HANDLE_VALUE;
+#else
+	file = open(file_location.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	bool opened = file >= 0;
+#endif
+	if (!opened)
+		throw std::invalid_argument("Could not create the geometry cache file " +
+									file_location + ".");
+
+	file_bytes = 0;
+	next_key = 0;
+}
+
+GeometryCache::~GeometryCache()
+{
+#ifdef _WIN32
+	CloseHandle(file);
+#else
+	close(file);
+#endif
+	std::remove(file_location.c_str());
+}
+
+long long GeometryCache::Write(const char* data, size_t bytes)
+{
+	// Each write reserves its own range at the end of the file first, so
+	// writes from several threads never overlap.
+	long long offset = file_bytes.fetch_add(bytes);
+	if (!Transfer(offset, const_cast<char*>(data), bytes, true))
+		throw std::invalid_argument("Could not write to the geometry cache file.");
+	return offset;
+}
+
+void GeometryCache::Rewrite(long long offset, const char* data, size_t bytes)
+{
+	if (offset < 0 || offset + (long long)bytes > file_bytes)
+		throw std::invalid_argument("Can only rewrite data already in the geometry cache file.");
+	if (!Transfer(offset, const_cast<char*>(data), bytes, true))
+		throw std::invalid_argument("Could not write to the geometry cache file.");
+}
+
+void GeometryCache::Read(long long offset, char* output_location, size_t bytes)
+{
+	if (!Transfer(offset, output_location, bytes, false))
+		throw std::invalid_argument("Could not read from the geometry cache file.");
+}
+
+unsigned long long GeometryCache::CreateKey()
+{
+	return next_key++;
+}
+
+std::shared_ptr<PreparedObject> GeometryCache::Find(unsigned long long key)
+{
+	return clusters.Find(key);
+}
+
+std::shared_ptr<PreparedObject> GeometryCache::Insert(unsigned long long key,
+													  std::shared_ptr<PreparedObject> cluster,
+													  size_t bytes)
+{
+	return clusters.Insert(key, cluster, bytes);
+}
+
+void GeometryCache::Clear()
+{
+	clusters.Clear();
+}
+
+size_t GeometryCache::GetMaxBytes()
+{
+	return clusters.GetMaxBytes();
+}
+
+size_t GeometryCache::GetBytesUsed()
+{
+	return clusters.GetBytesUsed();
+}
+
+long long GeometryCache::GetFileBytes()
+{
+	return file_bytes;
+}
+
+long long GeometryCache::GetHits()
+{
+	return clusters.GetHits();
+}
+
+long long GeometryCache::GetMisses()
+{
+	return clusters.GetMisses();
+}
+
+long long GeometryCache::GetEvictions()
+{
+	return clusters.GetEvictions();
+}
+
+bool GeometryCache::Transfer(long long offset, char* buffer, size_t bytes, bool write)
+{
+#ifdef _WIN32
+	// One event serves every chunk, since each is finished before the next
+	// starts, and starting an operation resets it.
+	HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	if (event == nullptr)
+		return false;
+#endif
+
+	bool succeeded = true;
+	while (bytes > 0 && succeeded)
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+		overlapped.hEvent = event;
+
+		DWORD chunk = (DWORD)std::min(bytes, (size_t)1 << 30);
+		DWORD done = 0;
+		BOOL started = write ? WriteFile(file, buffer, chunk, nullptr, &overlapped) :
+			ReadFile(file, buffer, chunk, nullptr, &overlapped);
+		succeeded = (started || GetLastError() == ERROR_IO_PENDING) &&
+			GetOverlappedResult(file, &overlapped, &done, TRUE) && done > 0;
+#else
+		ssize_t done = write ? pwrite(file, buffer, bytes, offset) :
+			pread(file, buffer, bytes, offset);
+		if (done < 0 && errno == EINTR)
+			continue;
+		succeeded = done > 0;
+#endif
+		if (succeeded)
+		{
+			buffer += done;
+			offset += done;
+			bytes -= done;
+		}
+	}
+
+#ifdef _WIN32
+	CloseHandle(event);
+#endif
+	return succeeded;
+}
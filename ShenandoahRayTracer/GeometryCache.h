@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "ShardedLruCache.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct PreparedObject;
+
+/** Keeps the geometry of streamed objects on disk, and a bounded amount of
+it in memory.
+
+Streamed objects are split into clusters of triangles, which are written to
+a scratch file once when the scene is prepared.  Rays that reach a cluster
+load it through the cache, and once the loaded clusters take more than the
+budget, the least recently used ones are dropped, so scenes with far more
+geometry than memory can still be rendered.  Like the TextureCache, it keeps
+them in a ShardedLruCache, so a cluster evicted while a thread is still
+tracing against it stays alive until the thread is done.  Loaded clusters are never changed,
+so any number of threads can trace against one at once.
+
+Reads and writes give their offset in the file with each call, rather than
+seeking a shared position, so threads loading clusters at the same time
+don't wait on each other, only on the disk.  Keeping rays coherent (as the
+wavefront execution mode does) keeps the clusters they need in the cache.
+
+*/
+class GeometryCache
+{
+public:
+	/**
+	* @brief Creates an empty cache and its backing file, replacing any file
+	* already at the location.  The file is deleted with the cache.
+	*
+	* @param _file_location Where the clusters are written.
+	* @param _max_bytes The most memory the loaded clusters can take, which
+	* must be positive.
+	*/
+	GeometryCache(std::string _file_location, size_t _max_bytes);
+	~GeometryCache();
+
+	GeometryCache(const GeometryCache&) = delete;
+	GeometryCache& operator=(const GeometryCache&) = delete;
+
+	/**
+	* @brief Appends data to the end of the backing file.
+	*
+	* @param data The data to write.
+	* @param bytes The size of the data.
+	*
+	* @return The offset of the data within the file.
+	*/
+	long long Write(const char* data, size_t bytes);
+
+	// Writes over data already in the file, which must not be read by
+	// anything else until this returns.
+	void Rewrite(long long offset, const char* data, size_t bytes);
+
+	// Reads data written by Write back from the file.
+	void Read(long long offset, char* output_location, size_t bytes);
+
+	// Gives out a key that hasn't been used before, for a new cluster.
+	unsigned long long CreateKey();
+
+	/**
+	* @brief Looks up a loaded cluster, marking it as recently used.
+	*
+	* @param key The key of the cluster.
+	*
+	* @return The cluster, or nullptr if it isn't in memory.
+	*/
+	std::shared_ptr<PreparedObject> Find(unsigned long long key);
+
+	/**
+	* @brief Adds a cluster that was just loaded, evicting the least recently
+	* used clusters of its shard if the shard is over budget.  As with the
+	* TextureCache, two threads can load the same cluster at once, and the
+	* second to insert it gets the first one's copy back.
+	*
+	* @param key The key of the cluster.
+	* @param cluster The loaded cluster.
+	* @param bytes The memory the cluster takes.
+	*
+	* @return The cluster now in the cache under the key.
+	*/
+	std::shared_ptr<PreparedObject> Insert(unsigned long long key,
+										   std::shared_ptr<PreparedObject> cluster,
+										   size_t bytes);
+
+	// Drops every loaded cluster.  The file is left as it is.
+	void Clear();
+
+	size_t GetMaxBytes();
+	size_t GetBytesUsed();
+	long long GetFileBytes();
+
+	// Statistics since the cache was created, for tuning its size.
+	long long GetHits();
+	long long GetMisses();
+	long long GetEvictions();
+
+private:
+	ShardedLruCache<PreparedObject> clusters;
+
+	std::string file_location;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+#else
+	int file = -1;
+#endif
+	std::atomic<long long> file_bytes;
+
+	std::atomic<unsigned long long> next_key;
+
+	// Reads the file into buffer, or writes buffer to it, at an offset,
+	// returning false if it fails.
+	bool Transfer(long long offset, char* buffer, size_t bytes, bool write);
+};
@@ -0,0 +1,75 @@
+#include "HalfFloat.h"
+
+unsigned short HalfFloat::FromFloat(float f)
+{
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int significand = bits & 0x7fffff;
+
+	// Infinity and NaN, keeping NaNs as NaNs.
+	if (((bits >> 23) & 0xff) == 0xff)
+		return sign | 0x7c00 | (significand != 0 ? 0x200 : 0);
+
+	if (exponent >= 31)
+		return sign | 0x7c00;
+
+	// Numbers too small for a normal half become subnormal, which shifts the
+	// implicit leading bit into the significand.
+	int shift = 13;
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return sign;
+
+		significand |= 0x800000;
+		shift = 14 - exponent;
+		exponent = 0;
+	}
+
+	unsigned int half = significand >> shift;
+	unsigned int remainder = significand & ((1u << shift) - 1);
+	unsigned int halfway = 1u << (shift - 1);
+
+	// A carry out of the significand rounds up into the exponent, which is
+	// still the right result, all the way up to infinity.
+	half |= exponent << 10;
+	if (remainder > halfway || (remainder == halfway && (half & 1)))
+		half++;
+
+	return sign | half;
+}
+
+float HalfFloat::ToFloat(unsigned short h)
+{
+	unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+	unsigned int exponent = (h >> 10) & 0x1f;
+	unsigned int significand = h & 0x3ff;
+	unsigned int bits;
+
+	if (exponent == 0x1f)
+		bits = sign | 0x7f800000 | (significand << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent - 15 + 127) << 23) | (significand << 13);
+	else if (significand == 0)
+		bits = sign;
+	else
+	{
+		// Subnormal halves are normal floats, so the significand is shifted
+		// up until its leading bit becomes the implicit one.
+		int shift = 0;
+		while ((significand & 0x400) == 0)
+		{
+			significand <<= 1;
+			shift++;
+		}
+		bits = sign | ((unsigned int)(127 - 15 + 1 - shift) << 23) |
+			((significand & 0x3ff) << 13);
+	}
+
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstring>
+
+/** Conversions between 32 bit floats and IEEE 754 half precision floats,
+which are stored as the raw 16 bits.
+
+Halves have an 11 bit significand, so they hold numbers between 0.5 and 1 to
+within about 0.0002, and anything up to 65504.  Rounding is to the nearest
+half, with ties to even, and numbers too large for a half become infinite.
+
+*/
+class HalfFloat
+{
+public:
+	static unsigned short FromFloat(float f);
+	static float ToFloat(unsigned short h);
+};
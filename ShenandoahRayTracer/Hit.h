@@ -0,0 +1,24 @@
+#pragma once
+
+class ObjectHandler;
+
+// The result of casting a ray against the triangles in the scene.  See
+// Documentation/Hit.md.
+struct Hit
+{
+	bool hit = false;
+	float t, u, v;
+	int triangle_index; // The index of the triangle that was hit.
+	int object_index = -1; // The index of the object within the scene.
+	// The object that was hit, which is nullptr in a scene attached from
+	// shared memory.
+	ObjectHandler* object = nullptr;
+
+	// How much work it took to find the hit.  Nodes are the bounding volumes
+	// the ray was tested against, triangles are the individual ray-triangle
+	// tests.
+	int nodes_visited = 0;
+	int triangles_tested = 0;
+
+	bool IsGreater(Hit h);
+};
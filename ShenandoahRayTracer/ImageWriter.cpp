@@ -0,0 +1,96 @@
+#include "ImageWriter.h"
+
+void ImageWriter::Write(std::string file_location, std::string format,
+						int* pixels, int width, int height)
+{
+	if (format == "txt")
+		WriteText(file_location, pixels, width, height);
+	else if (format == "ppm")
+		WritePPM(file_location, pixels, width, height);
+	else
+		throw std::invalid_argument("Unknown output format: " + format);
+}
+
+void ImageWriter::WriteText(std::string file_location, int* pixels, int width,
+							int height)
+{
+	std::ofstream file;
+	file.open(file_location, std::ofstream::trunc);
+
+	if (!file)
+		throw std::invalid_argument("Could not open output file: " +
+									file_location);
+
+	// Using "\n" instead of std::endl avoids flushing on every pixel, which
+	// otherwise dominates the time spent writing large images.
+	for (int i = 0; i < width * height * 3; i += 3)
+	{
+		file << "(" << pixels[i] << "," << pixels[i + 1] << "," << pixels[i + 2]
+			 << ")\n";
+	}
+}
+
+void ImageWriter::WritePPM(std::string file_location, int* pixels, int width,
+						   int height)
+{
+	std::ofstream file;
+	file.open(file_location, std::ofstream::trunc | std::ofstream::binary);
+
+	if (!file)
+		throw std::invalid_argument("Could not open output file: " +
+									file_location);
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	unsigned char* bytes = new unsigned char[width * height * 3];
+	for (int i = 0; i < width * height * 3; i++)
+	{
+		int value = pixels[i];
+		if (value < 0)
+			value = 0;
+		else if (value > 255)
+			value = 255;
+
+		bytes[i] = (unsigned char)value;
+	}
+
+	file.write((char*)bytes, width * height * 3);
+
+	delete[] bytes;
+}
+
+void ImageWriter::WritePFM(std::string file_location, float* values, int width,
+						   int height, int channels)
+{
+	if (channels < 1 || channels > 3)
+		throw std::invalid_argument("PFM files have 1 to 3 channels.");
+
+	std::ofstream file;
+	file.open(file_location, std::ofstream::trunc | std::ofstream::binary);
+
+	if (!file)
+		throw std::invalid_argument("Could not open output file: " +
+									file_location);
+
+	// A negative scale marks the floats as little-endian, which is assumed to
+	// be the byte order of the machine.
+	int file_channels = channels == 1 ? 1 : 3;
+	file << (file_channels == 1 ? "Pf" : "PF") << "\n" << width << " "
+		 << height << "\n-1.0\n";
+
+	// PFM rows go from the bottom of the image to the top.
+	std::vector<float> row(width * file_channels);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			for (int c = 0; c < file_channels; c++)
+			{
+				row[x * file_channels + c] = c < channels ?
+					values[(y * width + x) * channels + c] : 0.0f;
+			}
+		}
+
+		file.write((char*)row.data(), row.size() * sizeof(float));
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Writes the integer RGB buffers produced by devices to disk.  Buffers are
+// row-major with three ints per pixel, starting at the top-left.
+class ImageWriter
+{
+public:
+	/**
+	* @brief Writes the buffer in the given format.
+	*
+	* @param file_location The location of the file to be written.
+	* @param format Either "txt" or "ppm".
+	* @param pixels The RGB buffer.
+	* @param width The width of the image in pixels.
+	* @param height The height of the image in pixels.
+	*/
+	static void Write(std::string file_location, std::string format,
+					  int* pixels, int width, int height);
+
+	/**
+	* @brief Writes one "(r,g,b)" tuple per line.  Values are written as-is.
+	*/
+	static void WriteText(std::string file_location, int* pixels, int width,
+						  int height);
+
+	/**
+	* @brief Writes a binary PPM (P6) image.  Values are clamped to 0-255.
+	*/
+	static void WritePPM(std::string file_location, int* pixels, int width,
+						 int height);
+
+	/**
+	* @brief Writes a float buffer, such as an AOV, as a little-endian
+	* Portable Float Map.  Buffers with 1 channel are written as greyscale,
+	* and those with 2 or 3 as colour, with any missing channels set to 0.
+	*
+	* @param file_location The location of the file to be written.
+	* @param values The buffer, row by row from the top.
+	* @param width The width of the image in pixels.
+	* @param height The height of the image in pixels.
+	* @param channels The number of floats per pixel, from 1 to 3.
+	*/
+	static void WritePFM(std::string file_location, float* values, int width,
+						 int height, int channels);
+};
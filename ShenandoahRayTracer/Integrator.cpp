@@ -0,0 +1,48 @@
+#include "Integrator.h"
+#include "RenderCheckpoint.h"
+
+RandomSequence::RandomSequence(unsigned int seed)
+{
+	state = seed;
+}
+
+float RandomSequence::Next()
+{
+	state = state * 747796405u + 2891336453u;
+	unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return Sampler::ToUnitFloat((word >> 22u) ^ word);
+}
+
+void Integrator::ShadeBatch(PreparedScene* scene, float* origin,
+							float* directions, Hit* hits,
+							RandomSequence* randoms, int count,
+							float* output_locations, FrameArena* arena)
+{
+	for (int i = 0; i < count; i++)
+	{
+		Shade(scene, origin, &directions[i * 3], &hits[i], &randoms[i],
+			  &output_locations[i * 3]);
+	}
+}
+
+void UVIntegrator::Shade(PreparedScene* scene, float* origin, float* direction,
+						 Hit* hit, RandomSequence* random, float* output_location)
+{
+	output_location[0] = 0;
+	output_location[1] = 0;
+	output_location[2] = 0;
+
+	if (!hit->hit)
+		return;
+
+	float uv[2];
+	scene->GetHitUV(hit, uv);
+
+	output_location[0] = abs((int)(uv[0] * 63) % 63);
+	output_location[1] = abs((int)(uv[1] * 63) % 63);
+}
+
+void UVIntegrator::GetCheckpointSettings(RenderCheckpoint* output)
+{
+	output->integrator = IntegratorType::UV;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <math.h>
+#include "FrameArena.h"
+#include "Hit.h"
+#include "PreparedScene.h"
+#include "Sampler.h"
+
+// Declared in RenderCheckpoint.h, which includes this file.
+struct RenderCheckpoint;
+
+// Which integrator rendered an image, as saved in checkpoints.
+enum class IntegratorType
+{
+	UV,
+	PathTracer
+};
+
+/** A stream of random numbers for the decisions made along one path.
+
+Each sample gets its own stream, seeded from the pixel and sample index, so
+renders are repeatable no matter which thread traces the sample.  The
+generator is the PCG hash, which is cheap and has no visible correlation
+between nearby seeds.
+
+*/
+class RandomSequence
+{
+public:
+	RandomSequence(unsigned int seed);
+
+	// Returns the next number in [0, 1).
+	float Next();
+
+private:
+	unsigned int state;
+};
+
+/** Computes the colour of a sample, given the closest hit of its camera ray.
+
+The device traces the camera rays itself, in batches, so an integrator
+starts from an existing hit rather than a ray.  Any further rays it needs,
+such as bounces or shadow rays, are traced through the scene it is given.
+Shade is called from every render thread at once, so implementations must
+not change their own state while shading.
+
+*/
+class Integrator
+{
+public:
+	virtual ~Integrator() {}
+
+	/**
+	* @brief Computes the colour of a single sample.
+	*
+	* @param scene The scene being rendered.
+	* @param origin The origin of the camera ray.
+	* @param direction The direction of the camera ray.
+	* @param hit The closest hit of the camera ray, which might be a miss.
+	* @param random Random numbers for any decisions the integrator makes.
+	* @param output_location A float array with minimum size 3, in the range
+	* 0-255 for display.
+	*/
+	virtual void Shade(PreparedScene* scene, float* origin, float* direction,
+					   Hit* hit, RandomSequence* random,
+					   float* output_location) = 0;
+
+	/**
+	* @brief Computes the colours of many samples at once, for devices that
+	* run in wavefront mode.  Integrators that trace further rays can
+	* override this to trace them in large, coherent batches.  By default it
+	* just calls Shade for each sample.
+	*
+	* @param scene The scene being rendered.
+	* @param origin The origin shared by every camera ray.
+	* @param directions The directions of the camera rays, 3 floats each.
+	* @param hits The closest hits of the camera rays.
+	* @param randoms The random numbers of each sample.
+	* @param count The number of samples.
+	* @param output_locations A float array with minimum size 3 * count.
+	* @param arena Scratch memory owned by the calling thread, for anything
+	* the batch needs while it is being shaded.  The caller releases it once
+	* the batch is done.
+	*/
+	virtual void ShadeBatch(PreparedScene* scene, float* origin,
+							float* directions, Hit* hits,
+							RandomSequence* randoms, int count,
+							float* output_locations, FrameArena* arena);
+
+	/**
+	* @brief Fills in the integrator's part of the settings of a checkpoint:
+	* which integrator it is, and anything it was given that changes the
+	* image.
+	*
+	* @param output The checkpoint being filled in.
+	*/
+	virtual void GetCheckpointSettings(RenderCheckpoint* output) = 0;
+};
+
+// Colours each hit by the texture coordinates of the closest hit, which is
+// useful for checking geometry and UVs without any lighting.
+class UVIntegrator : public Integrator
+{
+public:
+	void Shade(PreparedScene* scene, float* origin, float* direction, Hit* hit,
+			   RandomSequence* random, float* output_location);
+	void GetCheckpointSettings(RenderCheckpoint* output);
+};
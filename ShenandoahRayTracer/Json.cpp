@@ -0,0 +1,311 @@
+#include "Json.h"
+
+// Documents nested deeper than this are rejected rather than risking the
+// stack.  glTF files never come close.
+#define MAX_DEPTH 256
+
+JsonValue JsonValue::Parse(const std::string& text)
+{
+	size_t position = 0;
+	JsonValue root = ParseValue(text, &position, 0);
+
+	SkipWhitespace(text, &position);
+	if (position != text.size())
+		Fail("Unexpected text after the end of the document", position);
+
+	return root;
+}
+
+bool JsonValue::Has(const std::string& key) const
+{
+	return type == Type::Object && object.count(key) != 0;
+}
+
+const JsonValue& JsonValue::Get(const std::string& key) const
+{
+	if (type != Type::Object)
+		throw std::invalid_argument("JSON value isn't an object, looking up " + key + ".");
+
+	auto found = object.find(key);
+	if (found == object.end())
+		throw std::invalid_argument("JSON object has no member " + key + ".");
+
+	return found->second;
+}
+
+const JsonValue& JsonValue::At(int index) const
+{
+	if (type != Type::Array)
+		throw std::invalid_argument("JSON value isn't an array.");
+	if (index < 0 || index >= array.size())
+		throw std::invalid_argument("JSON array index " + std::to_string(index) +
+									" is out of range.");
+
+	return array[index];
+}
+
+int JsonValue::GetSize() const
+{
+	if (type == Type::Array)
+		return array.size();
+	if (type == Type::Object)
+		return object.size();
+	return 0;
+}
+
+double JsonValue::GetNumber(const std::string& key, double default_value) const
+{
+	if (!Has(key))
+		return default_value;
+
+	const JsonValue& value = Get(key);
+	if (value.type != Type::Number)
+		throw std::invalid_argument("JSON member " + key + " isn't a number.");
+
+	return value.number;
+}
+
+int JsonValue::GetInt(const std::string& key, int default_value) const
+{
+	return (int)GetNumber(key, default_value);
+}
+
+std::string JsonValue::GetString(const std::string& key,
+								 std::string default_value) const
+{
+	if (!Has(key))
+		return default_value;
+
+	const JsonValue& value = Get(key);
+	if (value.type != Type::String)
+		throw std::invalid_argument("JSON member " + key + " isn't a string.");
+
+	return value.string;
+}
+
+JsonValue JsonValue::ParseValue(const std::string& text, size_t* position,
+								int depth)
+{
+	if (depth > MAX_DEPTH)
+		Fail("The document is nested too deeply", *position);
+
+	SkipWhitespace(text, position);
+	if (*position >= text.size())
+		Fail("Unexpected end of the document", *position);
+
+	JsonValue value;
+	char c = text[*position];
+
+	if (c == '{')
+	{
+		value.type = Type::Object;
+		(*position)++;
+
+		SkipWhitespace(text, position);
+		if (*position < text.size() && text[*position] == '}')
+		{
+			(*position)++;
+			return value;
+		}
+
+		while (true)
+		{
+			SkipWhitespace(text, position);
+			if (*position >= text.size() || text[*position] != '"')
+				Fail("Expected a member name", *position);
+			std::string key = ParseString(text, position);
+
+			SkipWhitespace(text, position);
+			if (*position >= text.size() || text[*position] != ':')
+				Fail("Expected ':'", *position);
+			(*position)++;
+
+			value.object[key] = ParseValue(text, position, depth + 1);
+
+			SkipWhitespace(text, position);
+			if (*position < text.size() && text[*position] == ',')
+			{
+				(*position)++;
+				continue;
+			}
+			if (*position < text.size() && text[*position] == '}')
+			{
+				(*position)++;
+				return value;
+			}
+			Fail("Expected ',' or '}'", *position);
+		}
+	}
+
+	if (c == '[')
+	{
+		value.type = Type::Array;
+		(*position)++;
+
+		SkipWhitespace(text, position);
+		if (*position < text.size() && text[*position] == ']')
+		{
+			(*position)++;
+			return value;
+		}
+
+		while (true)
+		{
+			value.array.push_back(ParseValue(text, position, depth + 1));
+
+			SkipWhitespace(text, position);
+			if (*position < text.size() && text[*position] == ',')
+			{
+				(*position)++;
+				continue;
+			}
+			if (*position < text.size() && text[*position] == ']')
+			{
+				(*position)++;
+				return value;
+			}
+			Fail("Expected ',' or ']'", *position);
+		}
+	}
+
+	if (c == '"')
+	{
+		value.type = Type::String;
+		value.string = ParseString(text, position);
+		return value;
+	}
+
+	if (text.compare(*position, 4, "true") == 0)
+	{
+		value.type = Type::Bool;
+		value.boolean = true;
+		*position += 4;
+		return value;
+	}
+	if (text.compare(*position, 5, "false") == 0)
+	{
+		value.type = Type::Bool;
+		*position += 5;
+		return value;
+	}
+	if (text.compare(*position, 4, "null") == 0)
+	{
+		*position += 4;
+		return value;
+	}
+
+	if (c == '-' || (c >= '0' && c <= '9'))
+	{
+		// strtod accepts more than JSON does (such as hex and infinity), but
+		// only ever reads as far as the number goes here, since it can only
+		// start with a digit or a minus sign.
+		const char* start = text.c_str() + *position;
+		char* end;
+		value.type = Type::Number;
+		value.number = strtod(start, &end);
+		if (end == start)
+			Fail("Invalid number", *position);
+		*position += end - start;
+		return value;
+	}
+
+	Fail("Unexpected character", *position);
+	return value;
+}
+
+std::string JsonValue::ParseString(const std::string& text, size_t* position)
+{
+	std::string output;
+	(*position)++;
+
+	while (true)
+	{
+		if (*position >= text.size())
+			Fail("Unterminated string", *position);
+
+		char c = text[(*position)++];
+		if (c == '"')
+			return output;
+		if (c != '\\')
+		{
+			output += c;
+			continue;
+		}
+
+		if (*position >= text.size())
+			Fail("Unterminated string", *position);
+
+		char escape = text[(*position)++];
+		switch (escape)
+		{
+		case '"': output += '"'; break;
+		case '\\': output += '\\'; break;
+		case '/': output += '/'; break;
+		case 'b': output += '\b'; break;
+		case 'f': output += '\f'; break;
+		case 'n': output += '\n'; break;
+		case 'r': output += '\r'; break;
+		case 't': output += '\t'; break;
+		case 'u':
+		{
+			if (*position + 4 > text.size())
+				Fail("Invalid unicode escape", *position);
+
+			unsigned int code = std::stoul(text.substr(*position, 4), nullptr, 16);
+			*position += 4;
+
+			// Characters outside the basic plane are written as a pair of
+			// surrogates, which have to be put back together.
+			if (code >= 0xD800 && code < 0xDC00 && *position + 6 <= text.size() &&
+				text[*position] == '\\' && text[*position + 1] == 'u')
+			{
+				unsigned int low = std::stoul(text.substr(*position + 2, 4), nullptr, 16);
+				if (low >= 0xDC00 && low < 0xE000)
+				{
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					*position += 6;
+				}
+			}
+
+			// Written back out as UTF-8.
+			if (code < 0x80)
+				output += (char)code;
+			else if (code < 0x800)
+			{
+				output += (char)(0xC0 | code >> 6);
+				output += (char)(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				output += (char)(0xE0 | code >> 12);
+				output += (char)(0x80 | (code >> 6 & 0x3F));
+				output += (char)(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				output += (char)(0xF0 | code >> 18);
+				output += (char)(0x80 | (code >> 12 & 0x3F));
+				output += (char)(0x80 | (code >> 6 & 0x3F));
+				output += (char)(0x80 | (code & 0x3F));
+			}
+			break;
+		}
+		default:
+			Fail("Invalid escape", *position - 1);
+		}
+	}
+}
+
+void JsonValue::SkipWhitespace(const std::string& text, size_t* position)
+{
+	while (*position < text.size() &&
+		   (text[*position] == ' ' || text[*position] == '\t' ||
+			text[*position] == '\n' || text[*position] == '\r'))
+		(*position)++;
+}
+
+void JsonValue::Fail(const std::string& message, size_t position)
+{
+	throw std::invalid_argument(message + " in JSON at character " +
+								std::to_string(position) + ".");
+}
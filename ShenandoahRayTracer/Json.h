@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** A parsed JSON document, just enough of one to read glTF files with.
+
+Every value is one of the six JSON types.  Objects keep their members in a
+map, so their order isn't kept, and numbers are doubles.  Lookups that don't
+match the type of the value, or ask for something that isn't there, throw an
+std::invalid_argument, so files that are missing required parts are
+rejected with a message instead of read as zeroes.
+
+*/
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+
+	/**
+	* @brief Parses a JSON document.  Throws an std::invalid_argument with the
+	* position of the first error if the text isn't valid JSON.
+	*
+	* @param text The document.
+	*
+	* @return The value at the root of the document.
+	*/
+	static JsonValue Parse(const std::string& text);
+
+	// Whether this is an object with a member of the given name.
+	bool Has(const std::string& key) const;
+
+	// Gets a member of an object.
+	const JsonValue& Get(const std::string& key) const;
+
+	// Gets an element of an array.
+	const JsonValue& At(int index) const;
+
+	// The number of elements of an array, or members of an object.
+	int GetSize() const;
+
+	// Gets a member that has to be a number, or the default if the member
+	// isn't there.
+	double GetNumber(const std::string& key, double default_value) const;
+	int GetInt(const std::string& key, int default_value) const;
+	std::string GetString(const std::string& key, std::string default_value) const;
+
+private:
+	// Parses the value starting at position, moving position past it.
+	static JsonValue ParseValue(const std::string& text, size_t* position,
+								int depth);
+	static std::string ParseString(const std::string& text, size_t* position);
+	static void SkipWhitespace(const std::string& text, size_t* position);
+	static void Fail(const std::string& message, size_t position);
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+// A light that emits equally in every direction from a single point.  Since
+// it has no area, rays can never hit it, so it only contributes light through
+// next event estimation.
+struct PointLight
+{
+	float position[3] = { 0, 0, 0 };
+
+	// The radiant intensity in each colour channel.  The irradiance at a
+	// distance d is intensity / d^2.
+	float intensity[3] = { 1, 1, 1 };
+};
@@ -0,0 +1,161 @@
+#include "LightTree.h"
+
+LightTree::LightTree()
+{
+
+}
+
+void LightTree::Build(std::vector<PointLight>* lights)
+{
+	nodes.clear();
+	if (lights->empty())
+		return;
+
+	std::vector<int> indices(lights->size());
+	for (int i = 0; i < indices.size(); i++)
+		indices[i] = i;
+
+	nodes.reserve(lights->size() * 2 - 1);
+	BuildNode(lights, &indices, 0, indices.size());
+}
+
+bool LightTree::IsEmpty() const
+{
+	return nodes.empty();
+}
+
+bool LightTree::Sample(float* position, float* normal, float u,
+					   int* light_index, float* pdf) const
+{
+	if (nodes.empty())
+		return false;
+
+	// The root's own importance only matters when it is a single light.
+	if (GetImportance(nodes[0], position, normal) <= 0)
+		return false;
+
+	int index = 0;
+	*pdf = 1;
+
+	while (nodes[index].light < 0)
+	{
+		const Node& node = nodes[index];
+		float left = GetImportance(nodes[node.children[0]], position, normal);
+		float right = GetImportance(nodes[node.children[1]], position, normal);
+
+		if (left + right <= 0)
+			return false;
+
+		// The random number is stretched back to [0, 1) after each choice,
+		// so a single number can make every choice down the tree.
+		float probability = left / (left + right);
+		if (u < probability)
+		{
+			index = node.children[0];
+			u /= probability;
+			*pdf *= probability;
+		}
+		else
+		{
+			index = node.children[1];
+			u = (u - probability) / (1 - probability);
+			*pdf *= 1 - probability;
+		}
+		u = fmin(u, 0.99999994f);
+	}
+
+	*light_index = nodes[index].light;
+	return true;
+}
+
+int LightTree::BuildNode(std::vector<PointLight>* lights,
+						 std::vector<int>* indices, int begin, int end)
+{
+	int index = nodes.size();
+	nodes.push_back(Node());
+
+	Node node;
+	node.power = 0;
+	node.children[0] = -1;
+	node.children[1] = -1;
+	node.light = -1;
+	for (int c = 0; c < 3; c++)
+	{
+		node.min[c] = INFINITY;
+		node.max[c] = -INFINITY;
+	}
+
+	for (int i = begin; i < end; i++)
+	{
+		PointLight& light = lights->at(indices->at(i));
+		for (int c = 0; c < 3; c++)
+		{
+			node.min[c] = fmin(node.min[c], light.position[c]);
+			node.max[c] = fmax(node.max[c], light.position[c]);
+			node.power += fmax(light.intensity[c], 0.0f);
+		}
+	}
+
+	if (end - begin == 1)
+	{
+		node.light = indices->at(begin);
+		nodes[index] = node;
+		return index;
+	}
+
+	int axis = 0;
+	for (int c = 1; c < 3; c++)
+	{
+		if (node.max[c] - node.min[c] > node.max[axis] - node.min[axis])
+			axis = c;
+	}
+
+	int middle = (begin + end) / 2;
+	std::nth_element(indices->begin() + begin, indices->begin() + middle,
+					 indices->begin() + end, [&](int a, int b)
+	{
+		return lights->at(a).position[axis] < lights->at(b).position[axis];
+	});
+
+	node.children[0] = BuildNode(lights, indices, begin, middle);
+	node.children[1] = BuildNode(lights, indices, middle, end);
+	nodes[index] = node;
+
+	return index;
+}
+
+float LightTree::GetImportance(const Node& node, float* position, float* normal)
+{
+	if (node.power <= 0)
+		return 0;
+
+	// The node is treated as its bounding sphere.
+	float center[3], to_center[3], half_extent[3];
+	for (int c = 0; c < 3; c++)
+	{
+		center[c] = (node.min[c] + node.max[c]) * 0.5f;
+		half_extent[c] = (node.max[c] - node.min[c]) * 0.5f;
+	}
+	Vector3::Subtract(center, position, to_center);
+
+	float distance_squared = Vector3::Dot(to_center, to_center);
+	float radius_squared = Vector3::Dot(half_extent, half_extent);
+
+	// Inside the sphere, lights can be in any direction and arbitrarily
+	// close, so only the power is known.
+	if (distance_squared <= radius_squared)
+		return node.power / fmax(radius_squared, 1e-8f);
+
+	// The smallest angle between the normal and any direction into the
+	// sphere is the angle to its centre, less the angle the sphere covers.
+	float distance = sqrt(distance_squared);
+	float cos_center = Vector3::Dot(normal, to_center) / distance;
+	float angle_center = acos(fmin(fmax(cos_center, -1.0f), 1.0f));
+	float angle_covered = asin(fmin(sqrt(radius_squared) / distance, 1.0f));
+	float angle = fmax(angle_center - angle_covered, 0.0f);
+
+	if (angle >= M_PI / 2)
+		return 0;
+
+	return node.power * cos(angle) / distance_squared;
+}
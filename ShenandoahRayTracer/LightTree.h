@@ -0,0 +1,78 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <math.h>
+#include <vector>
+#include "Light.h"
+#include "Vector.h"
+
+/** A bounding volume hierarchy over lights, used to pick the light to sample
+at a shading point in proportion to how much it is likely to contribute.
+
+Each node stores the bounds and total power of the lights below it.  A light
+is picked by walking down from the root, choosing between the two children
+at random in proportion to an estimate of their importance at the shading
+point: their power, divided by the squared distance to them, times a bound
+on the cosine between the surface normal and any direction into them.  Nodes
+entirely below the surface are never picked.  The probability of the whole
+walk is returned with the light, so the estimate stays unbiased.
+
+A walk only looks at two nodes per level, so picking a light costs about
+log2 of the number of lights, and the light picked is usually one of the
+few that matter at that point rather than one of the thousands that don't.
+
+*/
+class LightTree
+{
+public:
+	LightTree();
+
+	/**
+	* @brief Builds the tree over a set of lights, replacing any earlier tree.
+	* The lights are split at the median of their longest axis at each level.
+	*
+	* @param lights The lights, which the tree refers to by index.
+	*/
+	void Build(std::vector<PointLight>* lights);
+
+	bool IsEmpty() const;
+
+	/**
+	* @brief Picks a light to sample from a shading point.
+	*
+	* @param position The shading point.
+	* @param normal The normalized surface normal, facing the side that
+	* is being shaded.
+	* @param u A random number in [0, 1), which is reused at each level.
+	* @param light_index Set to the index of the picked light.
+	* @param pdf Set to the probability that the light was picked.
+	*
+	* @return False if no light can reach the shading point.
+	*/
+	bool Sample(float* position, float* normal, float u, int* light_index,
+				float* pdf) const;
+
+private:
+	struct Node
+	{
+		float min[3];
+		float max[3];
+		float power;
+
+		// Both children are -1 in leaves, which hold a single light.
+		int children[2];
+		int light;
+	};
+
+	std::vector<Node> nodes;
+
+	// Builds the node over the lights indices[begin, end), returning its
+	// index.
+	int BuildNode(std::vector<PointLight>* lights, std::vector<int>* indices,
+				  int begin, int end);
+
+	// An estimate of how much light a node sends to a shading point, which
+	// is 0 only if none of its lights can reach it.
+	static float GetImportance(const Node& node, float* position, float* normal);
+};
@@ -0,0 +1,179 @@
+#include "Material.h"
+
+ShadingFrame::ShadingFrame(float* _normal)
+{
+	float sign = copysign(1.0f, _normal[2]);
+	float a = -1.0f / (sign + _normal[2]);
+	float b = _normal[0] * _normal[1] * a;
+
+	tangent[0] = 1 + sign * _normal[0] * _normal[0] * a;
+	tangent[1] = sign * b;
+	tangent[2] = -sign * _normal[0];
+
+	bitangent[0] = b;
+	bitangent[1] = sign + _normal[1] * _normal[1] * a;
+	bitangent[2] = -_normal[1];
+
+	normal[0] = _normal[0];
+	normal[1] = _normal[1];
+	normal[2] = _normal[2];
+}
+
+void ShadingFrame::ToWorld(float x, float y, float z, float* output_location) const
+{
+	for (int c = 0; c < 3; c++)
+		output_location[c] = tangent[c] * x + bitangent[c] * y + normal[c] * z;
+}
+
+void ShadingFrame::SampleCosineHemisphere(float u1, float u2,
+										  float* output_location) const
+{
+	// Uniform on the unit disk, projected up onto the hemisphere.
+	float radius = sqrt(u1);
+	float angle = 2 * M_PI * u2;
+	ToWorld(radius * cos(angle), radius * sin(angle), sqrt(fmax(0.0f, 1 - u1)),
+			output_location);
+}
+
+void DiffuseMaterial::Evaluate(float* normal, float* outgoing, float* incoming,
+							   float* uv, float* output_location) const
+{
+	for (int c = 0; c < 3; c++)
+		output_location[c] = albedo[c] / M_PI;
+}
+
+bool DiffuseMaterial::Sample(float* normal, float* outgoing, float* uv,
+							 float u1, float u2, float* direction,
+							 float* weight) const
+{
+	// With cosine weighted sampling, the cosine and the pdf cancel out, so the
+	// weight is just the albedo.
+	ShadingFrame(normal).SampleCosineHemisphere(u1, u2, direction);
+	for (int c = 0; c < 3; c++)
+		weight[c] = albedo[c];
+	return true;
+}
+
+void DiffuseMaterial::GetEmission(float* output_location) const
+{
+	output_location[0] = 0;
+	output_location[1] = 0;
+	output_location[2] = 0;
+}
+
+void DiffuseMaterial::GetAlbedo(float* uv, float* output_location) const
+{
+	for (int c = 0; c < 3; c++)
+		output_location[c] = albedo[c];
+}
+
+void GlossyMaterial::Evaluate(float* normal, float* outgoing, float* incoming,
+							  float* uv, float* output_location) const
+{
+	float reflected[3];
+	Vector3::MultiplyF(normal, 2 * Vector3::Dot(normal, outgoing), reflected);
+	Vector3::Subtract(reflected, outgoing, reflected);
+
+	float cosine = fmax(0.0f, Vector3::Dot(reflected, incoming));
+	float lobe = (exponent + 2) / (2 * M_PI) * pow(cosine, exponent);
+	for (int c = 0; c < 3; c++)
+		output_location[c] = color[c] * lobe;
+}
+
+bool GlossyMaterial::Sample(float* normal, float* outgoing, float* uv,
+							float u1, float u2, float* direction,
+							float* weight) const
+{
+	float reflected[3];
+	Vector3::MultiplyF(normal, 2 * Vector3::Dot(normal, outgoing), reflected);
+	Vector3::Subtract(reflected, outgoing, reflected);
+
+	// Sampling proportional to the lobe gives a pdf of
+	// (exponent + 1) / (2 pi) * cos^exponent, which mostly cancels the BSDF.
+	float cos_lobe = pow(u1, 1.0f / (exponent + 1));
+	float sin_lobe = sqrt(fmax(0.0f, 1 - cos_lobe * cos_lobe));
+	float angle = 2 * M_PI * u2;
+	ShadingFrame(reflected).ToWorld(sin_lobe * cos(angle), sin_lobe * sin(angle),
+									cos_lobe, direction);
+
+	// Directions that end up below the surface are absorbed.
+	float cosine = Vector3::Dot(normal, direction);
+	if (cosine <= 0)
+		return false;
+
+	float scale = (exponent + 2) / (exponent + 1) * cosine;
+	for (int c = 0; c < 3; c++)
+		weight[c] = color[c] * scale;
+	return true;
+}
+
+void GlossyMaterial::GetEmission(float* output_location) const
+{
+	output_location[0] = 0;
+	output_location[1] = 0;
+	output_location[2] = 0;
+}
+
+void GlossyMaterial::GetAlbedo(float* uv, float* output_location) const
+{
+	for (int c = 0; c < 3; c++)
+		output_location[c] = color[c];
+}
+
+void EmissiveMaterial::Evaluate(float* normal, float* outgoing,
+								float* incoming, float* uv,
+								float* output_location) const
+{
+	output_location[0] = 0;
+	output_location[1] = 0;
+	output_location[2] = 0;
+}
+
+bool EmissiveMaterial::Sample(float* normal, float* outgoing, float* uv,
+							  float u1, float u2, float* direction,
+							  float* weight) const
+{
+	return false;
+}
+
+void EmissiveMaterial::GetEmission(float* output_location) const
+{
+	for (int c = 0; c < 3; c++)
+		output_location[c] = radiance[c];
+}
+
+void EmissiveMaterial::GetAlbedo(float* uv, float* output_location) const
+{
+	// Bright lights would be far outside the range of the other albedos.
+	for (int c = 0; c < 3; c++)
+		output_location[c] = fmin(radiance[c], 1.0f);
+}
+
+void TexturedMaterial::Evaluate(float* normal, float* outgoing,
+								float* incoming, float* uv,
+								float* output_location) const
+{
+	texture->Sample(uv[0], uv[1], uv[2], output_location);
+	Vector3::MultiplyF(output_location, 1 / M_PI, output_location);
+}
+
+bool TexturedMaterial::Sample(float* normal, float* outgoing, float* uv,
+							  float u1, float u2, float* direction,
+							  float* weight) const
+{
+	ShadingFrame(normal).SampleCosineHemisphere(u1, u2, direction);
+	texture->Sample(uv[0], uv[1], uv[2], weight);
+	return true;
+}
+
+void TexturedMaterial::GetEmission(float* output_location) const
+{
+	output_location[0] = 0;
+	output_location[1] = 0;
+	output_location[2] = 0;
+}
+
+void TexturedMaterial::GetAlbedo(float* uv, float* output_location) const
+{
+	texture->Sample(uv[0], uv[1], uv[2], output_location);
+}
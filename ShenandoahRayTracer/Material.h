@@ -0,0 +1,129 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <memory>
+#include <variant>
+#include "MipmappedTexture.h"
+#include "Vector.h"
+
+/** An orthonormal basis around a surface normal, used to turn directions
+sampled around the z axis into world space. */
+struct ShadingFrame
+{
+	float tangent[3];
+	float bitangent[3];
+	float normal[3];
+
+	/**
+	* @brief Builds a frame around a normal, using the method from Duff et
+	* al., "Building an Orthonormal Basis, Revisited".
+	*
+	* @param _normal The normalized normal.
+	*/
+	ShadingFrame(float* _normal);
+
+	// Converts a direction in the frame's local space into world space.
+	void ToWorld(float x, float y, float z, float* output_location) const;
+
+	// Generates a direction in the frame's hemisphere, with a probability
+	// proportional to its cosine with the normal.
+	void SampleCosineHemisphere(float u1, float u2, float* output_location) const;
+};
+
+/*
+Materials are plain structs that all provide the same members, so that shading
+code can be written once as a template and compiled separately for each
+material, without any virtual calls:
+
+	IS_EMISSIVE   Whether the material emits light rather than reflecting it.
+	NEEDS_UV      Whether the texture coordinates of the hit are needed, so
+	              they are only computed for materials that use them.
+	Evaluate      The BSDF for a pair of directions (without the cosine).
+	Sample        Picks a reflected direction and returns the weight
+	              BSDF * cosine / pdf of the pick.  Returns false if the path
+	              should end.
+	GetEmission   The radiance the surface emits.
+	GetAlbedo     The overall colour of the surface in the range 0-1, which
+	              the denoiser uses to tell surfaces apart.
+
+All directions point away from the surface, and are normalized.  uv holds
+the texture coordinates of the hit, followed by the width of the ray's
+footprint in texture coordinates, which picks the mip level of textures.
+*/
+
+// A surface that scatters light equally in every direction.
+struct DiffuseMaterial
+{
+	static const bool IS_EMISSIVE = false;
+	static const bool NEEDS_UV = false;
+
+	float albedo[3] = { 0.8f, 0.8f, 0.8f };
+
+	void Evaluate(float* normal, float* outgoing, float* incoming, float* uv,
+				  float* output_location) const;
+	bool Sample(float* normal, float* outgoing, float* uv, float u1, float u2,
+				float* direction, float* weight) const;
+	void GetEmission(float* output_location) const;
+	void GetAlbedo(float* uv, float* output_location) const;
+};
+
+// A shiny surface, using an energy conserving Phong lobe around the mirror
+// direction.  Higher exponents give sharper reflections.
+struct GlossyMaterial
+{
+	static const bool IS_EMISSIVE = false;
+	static const bool NEEDS_UV = false;
+
+	float color[3] = { 0.8f, 0.8f, 0.8f };
+	float exponent = 50;
+
+	void Evaluate(float* normal, float* outgoing, float* incoming, float* uv,
+				  float* output_location) const;
+	bool Sample(float* normal, float* outgoing, float* uv, float u1, float u2,
+				float* direction, float* weight) const;
+	void GetEmission(float* output_location) const;
+	void GetAlbedo(float* uv, float* output_location) const;
+};
+
+// A surface that gives off light and reflects none.  Paths only pick up its
+// light by hitting it, since next event estimation only samples point
+// lights.
+struct EmissiveMaterial
+{
+	static const bool IS_EMISSIVE = true;
+	static const bool NEEDS_UV = false;
+
+	float radiance[3] = { 1, 1, 1 };
+
+	void Evaluate(float* normal, float* outgoing, float* incoming, float* uv,
+				  float* output_location) const;
+	bool Sample(float* normal, float* outgoing, float* uv, float u1, float u2,
+				float* direction, float* weight) const;
+	void GetEmission(float* output_location) const;
+	void GetAlbedo(float* uv, float* output_location) const;
+};
+
+// A diffuse surface whose albedo comes from a texture.  Textures are shared
+// between every material that uses them, and their tiles are loaded into a
+// shared cache as they are looked up.
+struct TexturedMaterial
+{
+	static const bool IS_EMISSIVE = false;
+	static const bool NEEDS_UV = true;
+
+	std::shared_ptr<const MipmappedTexture> texture;
+
+	void Evaluate(float* normal, float* outgoing, float* incoming, float* uv,
+				  float* output_location) const;
+	bool Sample(float* normal, float* outgoing, float* uv, float u1, float u2,
+				float* direction, float* weight) const;
+	void GetEmission(float* output_location) const;
+	void GetAlbedo(float* uv, float* output_location) const;
+};
+
+// Any one of the materials.  Code that handles a material uses std::visit, or
+// groups hits by the variant's index, so that each material gets its own
+// compiled path.
+using Material = std::variant<DiffuseMaterial, GlossyMaterial, EmissiveMaterial,
+							  TexturedMaterial>;
@@ -220,6 +220,12 @@ Matrix Matrix::GetVectorRowMatrix(Vector3 vec)
 // since this is being done in between classes.
 Matrix& Matrix::operator=(const Matrix& mat)
 {
+	if (this == &mat)
+		return *this;
+
+	// Deleting the old values to avoid a memory leak.
+	delete[] values;
+
 	rows = mat.rows;
 	columns = mat.columns;
 
@@ -0,0 +1,845 @@
+#include "MeshImporter.h"
+
+// The magic numbers and chunk types of binary glTF files.
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+// glTF accessor component types.
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+// glTF primitive modes that are made of triangles.
+#define GLTF_TRIANGLES 4
+#define GLTF_TRIANGLE_STRIP 5
+#define GLTF_TRIANGLE_FAN 6
+
+// Node hierarchies deeper than this are assumed to be cycles.
+#define MAX_NODE_DEPTH 256
+
+// Reads a whole file into memory with a single read.
+static std::vector<char> ReadFile(std::string file_location)
+{
+	std::ifstream file(file_location, std::ios::binary | std::ios::ate);
+	if (!file)
+		throw std::invalid_argument("File not found for mesh loading: " + file_location);
+
+	std::vector<char> data((size_t)file.tellg());
+	file.seekg(0);
+	if (!data.empty() && !file.read(data.data(), data.size()))
+		throw std::invalid_argument("Could not read " + file_location + ".");
+
+	return data;
+}
+
+// Multiplies two 4x4 matrices in the row vector layout, so that the output
+// applies first first, then second.
+static void MultiplyMatrices(float* first, float* second, float* output)
+{
+	float result[16];
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			result[r * 4 + c] = 0;
+			for (int k = 0; k < 4; k++)
+				result[r * 4 + c] += first[r * 4 + k] * second[k * 4 + c];
+		}
+	}
+	memcpy(output, result, sizeof(result));
+}
+
+void MeshImporter::Load(std::string file_location, std::vector<ObjectHandler*>* output)
+{
+	std::string extension = GetExtension(file_location);
+
+	if (extension == "ply")
+		output->push_back(LoadPLY(file_location));
+	else if (extension == "gltf" || extension == "glb")
+		LoadGLTF(file_location, output);
+	else
+		output->push_back(new ObjectHandler(file_location));
+}
+
+ObjectHandler* MeshImporter::LoadPLY(std::string file_location)
+{
+	std::vector<char> data = ReadFile(file_location);
+
+	// The header is text, ending with an end_header line, and the body comes
+	// straight after it.  Only the header is copied out to be parsed.
+	const char end_header[] = "end_header";
+	auto header_end = std::search(data.begin(), data.end(), end_header,
+								  end_header + strlen(end_header));
+	if (data.size() < 3 || memcmp(data.data(), "ply", 3) != 0 || header_end == data.end())
+		throw std::invalid_argument(file_location + " isn't a PLY file.");
+
+	size_t body_start = std::find(header_end, data.end(), '\n') - data.begin();
+	body_start = std::min(body_start + 1, data.size());
+
+	std::istringstream header(std::string(data.begin(), header_end));
+	std::string line;
+	std::string format;
+	std::vector<PLYElement> elements;
+
+	while (std::getline(header, line))
+	{
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+
+		if (keyword == "format")
+			stream >> format;
+		else if (keyword == "element")
+		{
+			PLYElement element;
+			if (!(stream >> element.name >> element.count) || element.count < 0)
+				throw std::invalid_argument("Invalid PLY element: " + line);
+			elements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			if (elements.empty())
+				throw std::invalid_argument("PLY property before any element: " + line);
+
+			PLYProperty property;
+			std::string type;
+			stream >> type;
+			if (type == "list")
+			{
+				std::string count_type;
+				stream >> count_type >> type;
+				property.is_list = true;
+				property.count_type = ParsePLYType(count_type);
+			}
+			property.type = ParsePLYType(type);
+			stream >> property.name;
+			elements.back().properties.push_back(property);
+		}
+	}
+
+	PLYReader reader;
+	reader.data = data.data() + body_start;
+	reader.size = data.size() - body_start;
+	reader.ascii = format == "ascii";
+	reader.big_endian = format == "binary_big_endian";
+	if (!reader.ascii && !reader.big_endian && format != "binary_little_endian")
+		throw std::invalid_argument("Unknown PLY format: " + format);
+
+	std::vector<float> vertices;
+	std::vector<float> uvs;
+	std::vector<int> triangles;
+	bool has_uvs = false;
+	int num_vertices = 0;
+
+	for (int e = 0; e < elements.size(); e++)
+	{
+		PLYElement& element = elements[e];
+
+		// Where each property is stored, as an offset into the vertex or UV
+		// arrays, or -1 if it isn't used.
+		std::vector<int> position_parts(element.properties.size(), -1);
+		std::vector<int> uv_parts(element.properties.size(), -1);
+		int face_list = -1;
+
+		for (int p = 0; p < element.properties.size(); p++)
+		{
+			std::string name = element.properties[p].name;
+			if (element.name == "vertex" && !element.properties[p].is_list)
+			{
+				if (name == "x" || name == "y" || name == "z")
+					position_parts[p] = name[0] - 'x';
+				else if (name == "s" || name == "u" || name == "texture_u")
+					uv_parts[p] = 0;
+				else if (name == "t" || name == "v" || name == "texture_v")
+					uv_parts[p] = 1;
+			}
+			else if (element.name == "face" && element.properties[p].is_list &&
+					 (name == "vertex_indices" || name == "vertex_index"))
+				face_list = p;
+		}
+
+		if (element.name == "vertex")
+		{
+			num_vertices = element.count;
+			has_uvs = std::count(uv_parts.begin(), uv_parts.end(), 0) > 0 &&
+				std::count(uv_parts.begin(), uv_parts.end(), 1) > 0;
+
+			vertices.assign((size_t)element.count * 4, 0);
+			if (has_uvs)
+				uvs.assign((size_t)element.count * 2, 0);
+		}
+
+		std::vector<int> polygon;
+		for (int i = 0; i < element.count; i++)
+		{
+			if (element.name == "vertex")
+				vertices[i * 4 + 3] = 1;
+
+			for (int p = 0; p < element.properties.size(); p++)
+			{
+				PLYProperty& property = element.properties[p];
+
+				if (property.is_list)
+				{
+					int count = (int)reader.Read(property.count_type);
+					if (count < 0)
+						throw std::invalid_argument("Invalid PLY list in " + file_location + ".");
+
+					polygon.resize(count);
+					for (int k = 0; k < count; k++)
+						polygon[k] = (int)reader.Read(property.type);
+
+					if (p != face_list)
+						continue;
+
+					// Polygons are split into a fan of triangles around their
+					// first corner.
+					for (int k = 2; k < count; k++)
+					{
+						triangles.push_back(polygon[0]);
+						triangles.push_back(polygon[k - 1]);
+						triangles.push_back(polygon[k]);
+					}
+					continue;
+				}
+
+				double value = reader.Read(property.type);
+				if (position_parts[p] != -1)
+					vertices[i * 4 + position_parts[p]] = value;
+				else if (has_uvs && uv_parts[p] != -1)
+					uvs[i * 2 + uv_parts[p]] = value;
+			}
+		}
+	}
+
+	for (int i = 0; i < triangles.size(); i++)
+	{
+		if (triangles[i] < 0 || triangles[i] >= num_vertices)
+			throw std::invalid_argument("PLY face index out of range in " + file_location + ".");
+	}
+
+	// PLY UVs belong to the vertices, so every corner uses the UV of its
+	// vertex.
+	std::vector<int> triangle_uvs;
+	if (has_uvs)
+		triangle_uvs = triangles;
+	else
+		triangle_uvs.assign(triangles.size(), 0);
+
+	ObjectHandler* object = CreateObject(&vertices, &triangles, &triangle_uvs, &uvs);
+	object->name = file_location;
+	return object;
+}
+
+void MeshImporter::LoadGLTF(std::string file_location, std::vector<ObjectHandler*>* output)
+{
+	GLTFFile file = ReadGLTF(file_location);
+	const JsonValue& json = file.json;
+
+	// Each mesh is loaded the first time a node uses it, as one object per
+	// primitive, and every node after that makes instances of them.
+	int num_meshes = json.Has("meshes") ? json.Get("meshes").GetSize() : 0;
+	std::vector<std::vector<ObjectHandler*>> meshes(num_meshes);
+
+	std::vector<int> roots;
+	if (json.Has("scenes") && json.Get("scenes").GetSize() > 0)
+	{
+		const JsonValue& scene = json.Get("scenes").At(json.GetInt("scene", 0));
+		if (scene.Has("nodes"))
+		{
+			for (int i = 0; i < scene.Get("nodes").GetSize(); i++)
+				roots.push_back((int)scene.Get("nodes").At(i).number);
+		}
+	}
+	else if (json.Has("nodes"))
+	{
+		// Without a scene, every node that isn't a child of another is placed.
+		int num_nodes = json.Get("nodes").GetSize();
+		std::vector<bool> is_child(num_nodes, false);
+		for (int n = 0; n < num_nodes; n++)
+		{
+			const JsonValue& node = json.Get("nodes").At(n);
+			if (!node.Has("children"))
+				continue;
+			for (int c = 0; c < node.Get("children").GetSize(); c++)
+			{
+				int child = (int)node.Get("children").At(c).number;
+				if (child >= 0 && child < num_nodes)
+					is_child[child] = true;
+			}
+		}
+		for (int n = 0; n < num_nodes; n++)
+		{
+			if (!is_child[n])
+				roots.push_back(n);
+		}
+	}
+
+	float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	size_t first_output = output->size();
+	try
+	{
+		for (int i = 0; i < roots.size(); i++)
+			AddNode(&file, roots[i], identity, &meshes, output, 0);
+	}
+	catch (...)
+	{
+		for (size_t i = first_output; i < output->size(); i++)
+			delete output->at(i);
+		output->resize(first_output);
+		for (int m = 0; m < meshes.size(); m++)
+		{
+			for (int p = 0; p < meshes[m].size(); p++)
+				delete meshes[m][p];
+		}
+		throw;
+	}
+
+	// The loaded meshes were only templates for the instances.
+	for (int m = 0; m < meshes.size(); m++)
+	{
+		for (int p = 0; p < meshes[m].size(); p++)
+			delete meshes[m][p];
+	}
+}
+
+double MeshImporter::PLYReader::Read(PLYType type)
+{
+	if (ascii)
+	{
+		// Values are separated by whitespace, which can include line breaks.
+		while (position < size && isspace((unsigned char)data[position]))
+			position++;
+
+		const char* start = data + position;
+		char* end;
+		double value = strtod(start, &end);
+		if (end == start)
+			throw std::invalid_argument("Invalid or missing value in PLY file.");
+		position += end - start;
+		return value;
+	}
+
+	int bytes = GetPLYTypeSize(type);
+	if (position + bytes > size)
+		throw std::invalid_argument("PLY file ends early.");
+
+	unsigned char raw[8];
+	memcpy(raw, data + position, bytes);
+	position += bytes;
+
+	// Values are copied out in the byte order of the machine, which is little
+	// endian on every platform the renderer builds for.
+	if (big_endian)
+		std::reverse(raw, raw + bytes);
+
+	switch (type)
+	{
+	case PLYType::Int8: { signed char v; memcpy(&v, raw, 1); return v; }
+	case PLYType::UInt8: return raw[0];
+	case PLYType::Int16: { short v; memcpy(&v, raw, 2); return v; }
+	case PLYType::UInt16: { unsigned short v; memcpy(&v, raw, 2); return v; }
+	case PLYType::Int32: { int v; memcpy(&v, raw, 4); return v; }
+	case PLYType::UInt32: { unsigned int v; memcpy(&v, raw, 4); return v; }
+	case PLYType::Float32: { float v; memcpy(&v, raw, 4); return v; }
+	default: { double v; memcpy(&v, raw, 8); return v; }
+	}
+}
+
+MeshImporter::PLYType MeshImporter::ParsePLYType(std::string name)
+{
+	if (name == "char" || name == "int8")
+		return PLYType::Int8;
+	if (name == "uchar" || name == "uint8")
+		return PLYType::UInt8;
+	if (name == "short" || name == "int16")
+		return PLYType::Int16;
+	if (name == "ushort" || name == "uint16")
+		return PLYType::UInt16;
+	if (name == "int" || name == "int32")
+		return PLYType::Int32;
+	if (name == "uint" || name == "uint32")
+		return PLYType::UInt32;
+	if (name == "float" || name == "float32")
+		return PLYType::Float32;
+	if (name == "double" || name == "float64")
+		return PLYType::Float64;
+
+	throw std::invalid_argument("Unknown PLY property type: " + name);
+}
+
+int MeshImporter::GetPLYTypeSize(PLYType type)
+{
+	switch (type)
+	{
+	case PLYType::Int8:
+	case PLYType::UInt8:
+		return 1;
+	case PLYType::Int16:
+	case PLYType::UInt16:
+		return 2;
+	case PLYType::Float64:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+MeshImporter::GLTFFile MeshImporter::ReadGLTF(std::string file_location)
+{
+	std::vector<char> data = ReadFile(file_location);
+	GLTFFile file;
+
+	std::vector<char> binary_chunk;
+	bool has_binary_chunk = false;
+
+	unsigned int magic = 0;
+	if (data.size() >= 4)
+		memcpy(&magic, data.data(), 4);
+
+	if (magic == GLB_MAGIC)
+	{
+		// A 12 byte header, then chunks of a length, a type, and the data.
+		// The first chunk is the JSON, and the second, if there is one, is
+		// the binary buffer.
+		if (data.size() < 12)
+			throw std::invalid_argument(file_location + " is too short for a .glb file.");
+
+		size_t position = 12;
+		std::string json_text;
+		while (position + 8 <= data.size())
+		{
+			unsigned int length, type;
+			memcpy(&length, &data[position], 4);
+			memcpy(&type, &data[position + 4], 4);
+			position += 8;
+			if (length > data.size() - position)
+				throw std::invalid_argument(file_location + " has a chunk that runs past its end.");
+
+			if (type == GLB_CHUNK_JSON && json_text.empty())
+				json_text.assign(&data[position], length);
+			else if (type == GLB_CHUNK_BIN && !has_binary_chunk)
+			{
+				binary_chunk.assign(data.begin() + position, data.begin() + position + length);
+				has_binary_chunk = true;
+			}
+			position += length;
+		}
+
+		file.json = JsonValue::Parse(json_text);
+	}
+	else
+		file.json = JsonValue::Parse(std::string(data.data(), data.size()));
+
+	// Buffers are in the file itself, in data URIs, or in files next to it.
+	std::string directory = "";
+	size_t separator = file_location.find_last_of("/\\");
+	if (separator != std::string::npos)
+		directory = file_location.substr(0, separator + 1);
+
+	if (file.json.Has("buffers"))
+	{
+		const JsonValue& buffers = file.json.Get("buffers");
+		for (int b = 0; b < buffers.GetSize(); b++)
+		{
+			const JsonValue& buffer = buffers.At(b);
+			std::string uri = buffer.GetString("uri", "");
+			std::vector<char> contents;
+
+			if (uri.empty())
+			{
+				if (b != 0 || !has_binary_chunk)
+					throw std::invalid_argument("glTF buffer " + std::to_string(b) +
+												" has no data.");
+				contents = binary_chunk;
+			}
+			else if (uri.compare(0, 5, "data:") == 0)
+			{
+				size_t comma = uri.find(',');
+				if (comma == std::string::npos ||
+					uri.substr(0, comma).find(";base64") == std::string::npos)
+					throw std::invalid_argument("Only base64 data URIs are supported in glTF files.");
+				contents = DecodeBase64(uri.substr(comma + 1));
+			}
+			else
+				contents = ReadFile(directory + uri);
+
+			if (contents.size() < (size_t)buffer.GetNumber("byteLength", 0))
+				throw std::invalid_argument("glTF buffer " + std::to_string(b) +
+											" is shorter than its byteLength.");
+			file.buffers.push_back(std::move(contents));
+		}
+	}
+
+	return file;
+}
+
+template <typename T>
+void MeshImporter::ReadAccessor(GLTFFile* file, int accessor_index, int components,
+								std::vector<T>* output)
+{
+	const JsonValue& accessor = file->json.Get("accessors").At(accessor_index);
+
+	if (accessor.Has("sparse"))
+		throw std::invalid_argument("Sparse glTF accessors aren't supported.");
+
+	std::string type = accessor.GetString("type", "");
+	int type_components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 :
+		type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+	if (type_components != components)
+		throw std::invalid_argument("glTF accessor " + std::to_string(accessor_index) +
+									" has the wrong type: " + type);
+
+	int count = accessor.GetInt("count", 0);
+	int component_type = accessor.GetInt("componentType", GLTF_FLOAT);
+	bool normalized = accessor.Has("normalized") && accessor.Get("normalized").boolean;
+
+	int component_size;
+	switch (component_type)
+	{
+	case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: component_size = 1; break;
+	case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: component_size = 2; break;
+	case GLTF_UNSIGNED_INT: case GLTF_FLOAT: component_size = 4; break;
+	default:
+		throw std::invalid_argument("Unknown glTF component type: " +
+									std::to_string(component_type));
+	}
+
+	output->assign((size_t)count * components, 0);
+
+	// Accessors without a buffer view are all zeroes.
+	if (!accessor.Has("bufferView") || count == 0)
+		return;
+
+	const JsonValue& view = file->json.Get("bufferViews").At(accessor.GetInt("bufferView", 0));
+	int buffer_index = view.GetInt("buffer", 0);
+	if (buffer_index < 0 || buffer_index >= file->buffers.size())
+		throw std::invalid_argument("glTF buffer view uses a missing buffer.");
+
+	std::vector<char>& buffer = file->buffers[buffer_index];
+	size_t element_size = (size_t)component_size * components;
+	size_t stride = view.GetInt("byteStride", 0);
+	if (stride == 0)
+		stride = element_size;
+
+	size_t view_start = (size_t)view.GetNumber("byteOffset", 0);
+	size_t view_length = (size_t)view.GetNumber("byteLength", 0);
+	size_t start = view_start + (size_t)accessor.GetNumber("byteOffset", 0);
+
+	if (view_start + view_length > buffer.size() ||
+		start + stride * (count - 1) + element_size > view_start + view_length)
+		throw std::invalid_argument("glTF accessor " + std::to_string(accessor_index) +
+									" runs past the end of its buffer view.");
+
+	// Tightly packed floats are the common case, and are copied as a block.
+	if (std::is_same_v<T, float> && component_type == GLTF_FLOAT && stride == element_size)
+	{
+		memcpy(output->data(), &buffer[start], element_size * count);
+		return;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const char* element = &buffer[start + stride * i];
+		for (int c = 0; c < components; c++)
+		{
+			const char* raw = element + c * component_size;
+
+			// Doubles hold every component type exactly, so integers come
+			// through whole whichever type they are read as.
+			double value;
+
+			switch (component_type)
+			{
+			case GLTF_BYTE:
+			{
+				signed char v;
+				memcpy(&v, raw, 1);
+				value = normalized ? fmax(v / 127.0f, -1.0f) : v;
+				break;
+			}
+			case GLTF_UNSIGNED_BYTE:
+			{
+				unsigned char v;
+				memcpy(&v, raw, 1);
+				value = normalized ? v / 255.0f : v;
+				break;
+			}
+			case GLTF_SHORT:
+			{
+				short v;
+				memcpy(&v, raw, 2);
+				value = normalized ? fmax(v / 32767.0f, -1.0f) : v;
+				break;
+			}
+			case GLTF_UNSIGNED_SHORT:
+			{
+				unsigned short v;
+				memcpy(&v, raw, 2);
+				value = normalized ? v / 65535.0f : v;
+				break;
+			}
+			case GLTF_UNSIGNED_INT:
+			{
+				unsigned int v;
+				memcpy(&v, raw, 4);
+				value = v;
+				break;
+			}
+			default:
+			{
+				float v;
+				memcpy(&v, raw, 4);
+				value = v;
+			}
+			}
+
+			if (std::is_integral_v<T> && value > std::numeric_limits<T>::max())
+				throw std::invalid_argument("glTF accessor " + std::to_string(accessor_index) +
+											" has a value too large to read.");
+			output->at((size_t)i * components + c) = (T)value;
+		}
+	}
+}
+
+void MeshImporter::ReadIndices(GLTFFile* file, int accessor_index,
+							   std::vector<int>* output)
+{
+	const JsonValue& accessor = file->json.Get("accessors").At(accessor_index);
+	int component_type = accessor.GetInt("componentType", 0);
+	if (component_type != GLTF_UNSIGNED_BYTE && component_type != GLTF_UNSIGNED_SHORT &&
+		component_type != GLTF_UNSIGNED_INT)
+		throw std::invalid_argument("glTF indices must be unsigned integers.");
+
+	ReadAccessor(file, accessor_index, 1, output);
+}
+
+ObjectHandler* MeshImporter::LoadPrimitive(GLTFFile* file, const JsonValue& primitive)
+{
+	int mode = primitive.GetInt("mode", GLTF_TRIANGLES);
+	if (mode != GLTF_TRIANGLES && mode != GLTF_TRIANGLE_STRIP && mode != GLTF_TRIANGLE_FAN)
+		return nullptr;
+
+	const JsonValue& attributes = primitive.Get("attributes");
+	if (!attributes.Has("POSITION"))
+		return nullptr;
+
+	std::vector<float> positions;
+	ReadAccessor(file, (int)attributes.Get("POSITION").number, 3, &positions);
+	int num_vertices = positions.size() / 3;
+
+	std::vector<float> vertices((size_t)num_vertices * 4);
+	for (int i = 0; i < num_vertices; i++)
+	{
+		vertices[i * 4] = positions[i * 3];
+		vertices[i * 4 + 1] = positions[i * 3 + 1];
+		vertices[i * 4 + 2] = positions[i * 3 + 2];
+		vertices[i * 4 + 3] = 1;
+	}
+
+	std::vector<int> indices;
+	if (primitive.Has("indices"))
+		ReadIndices(file, (int)primitive.Get("indices").number, &indices);
+	else
+	{
+		indices.resize(num_vertices);
+		for (int i = 0; i < num_vertices; i++)
+			indices[i] = i;
+	}
+
+	std::vector<int> triangles;
+	if (mode == GLTF_TRIANGLES)
+		triangles.assign(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+	else
+	{
+		for (int i = 2; i < indices.size(); i++)
+		{
+			// Every other triangle of a strip is flipped to keep the winding.
+			int a = mode == GLTF_TRIANGLE_FAN ? indices[0] : indices[i - 2];
+			int b = indices[i - 1];
+			int c = indices[i];
+			if (mode == GLTF_TRIANGLE_STRIP && i % 2 == 1)
+				std::swap(a, b);
+
+			triangles.push_back(a);
+			triangles.push_back(b);
+			triangles.push_back(c);
+		}
+	}
+
+	for (int i = 0; i < triangles.size(); i++)
+	{
+		if (triangles[i] < 0 || triangles[i] >= num_vertices)
+			throw std::invalid_argument("glTF index out of range.");
+	}
+
+	// UVs belong to the vertices, as in .ply files.
+	std::vector<float> uvs;
+	std::vector<int> triangle_uvs;
+	if (attributes.Has("TEXCOORD_0"))
+	{
+		ReadAccessor(file, (int)attributes.Get("TEXCOORD_0").number, 2, &uvs);
+		if (uvs.size() != num_vertices * 2)
+			throw std::invalid_argument("glTF UVs don't match the positions.");
+
+		for (int i = 1; i < uvs.size(); i += 2)
+			uvs[i] = 1 - uvs[i];
+		triangle_uvs = triangles;
+	}
+	else
+		triangle_uvs.assign(triangles.size(), 0);
+
+	return CreateObject(&vertices, &triangles, &triangle_uvs, &uvs);
+}
+
+void MeshImporter::AddNode(GLTFFile* file, int node_index, float* parent_matrix,
+						   std::vector<std::vector<ObjectHandler*>>* meshes,
+						   std::vector<ObjectHandler*>* output, int depth)
+{
+	if (depth > MAX_NODE_DEPTH)
+		throw std::invalid_argument("glTF node hierarchy is too deep, or has a cycle.");
+
+	const JsonValue& node = file->json.Get("nodes").At(node_index);
+
+	// glTF matrices are column major for column vectors, which is the same
+	// memory layout as a row major matrix for row vectors.
+	float local[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	if (node.Has("matrix"))
+	{
+		for (int i = 0; i < 16; i++)
+			local[i] = node.Get("matrix").At(i).number;
+	}
+	else
+	{
+		float t[3] = { 0, 0, 0 };
+		float r[4] = { 0, 0, 0, 1 };
+		float s[3] = { 1, 1, 1 };
+		for (int i = 0; i < 3 && node.Has("translation"); i++)
+			t[i] = node.Get("translation").At(i).number;
+		for (int i = 0; i < 4 && node.Has("rotation"); i++)
+			r[i] = node.Get("rotation").At(i).number;
+		for (int i = 0; i < 3 && node.Has("scale"); i++)
+			s[i] = node.Get("scale").At(i).number;
+
+		// Scale, then the rotation quaternion (x, y, z, w), then translate.
+		float x = r[0], y = r[1], z = r[2], w = r[3];
+		float rotation[9] = {
+			1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+			2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+			2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+		};
+		for (int row = 0; row < 3; row++)
+		{
+			for (int c = 0; c < 3; c++)
+				local[row * 4 + c] = s[row] * rotation[row * 3 + c];
+			local[12 + row] = t[row];
+		}
+	}
+
+	float world[16];
+	MultiplyMatrices(local, parent_matrix, world);
+
+	if (node.Has("mesh"))
+	{
+		int mesh_index = (int)node.Get("mesh").number;
+		if (mesh_index < 0 || mesh_index >= meshes->size())
+			throw std::invalid_argument("glTF node uses a missing mesh.");
+
+		const JsonValue& mesh = file->json.Get("meshes").At(mesh_index);
+		std::vector<ObjectHandler*>& primitives = meshes->at(mesh_index);
+
+		if (primitives.empty())
+		{
+			const JsonValue& mesh_primitives = mesh.Get("primitives");
+			for (int p = 0; p < mesh_primitives.GetSize(); p++)
+			{
+				ObjectHandler* loaded = LoadPrimitive(file, mesh_primitives.At(p));
+				if (loaded)
+					primitives.push_back(loaded);
+			}
+		}
+
+		std::string name = node.GetString("name", mesh.GetString("name", ""));
+		for (int p = 0; p < primitives.size(); p++)
+		{
+			ObjectHandler* instance = new ObjectHandler(primitives[p]->Instance());
+			instance->transform.SetLocalMatrix(Matrix(world, 4, 4));
+			instance->name = name;
+			output->push_back(instance);
+		}
+	}
+
+	if (node.Has("children"))
+	{
+		for (int c = 0; c < node.Get("children").GetSize(); c++)
+		{
+			AddNode(file, (int)node.Get("children").At(c).number, world, meshes,
+					output, depth + 1);
+		}
+	}
+}
+
+ObjectHandler* MeshImporter::CreateObject(std::vector<float>* vertices,
+										  std::vector<int>* triangles,
+										  std::vector<int>* triangle_uvs,
+										  std::vector<float>* uvs)
+{
+	return new ObjectHandler(vertices->data(), vertices->size() / 4, uvs->data(),
+							 uvs->size() / 2, triangles->data(), triangles->size() / 3,
+							 triangle_uvs->data(), Transform(), "");
+}
+
+std::string MeshImporter::GetExtension(std::string file_location)
+{
+	// Only an extension after the last directory separator counts.
+	size_t separator = file_location.find_last_of("/\\");
+	size_t dot = file_location.find_last_of('.');
+	if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+		return "";
+
+	std::string extension = file_location.substr(dot + 1);
+	for (int i = 0; i < extension.size(); i++)
+		extension[i] = tolower((unsigned char)extension[i]);
+	return extension;
+}
+
+std::vector<char> MeshImporter::DecodeBase64(const std::string& text)
+{
+	std::vector<char> output;
+	unsigned int bits = 0;
+	int num_bits = 0;
+
+	for (int i = 0; i < text.size(); i++)
+	{
+		char c = text[i];
+		int value;
+		if (c >= 'A' && c <= 'Z')
+			value = c - 'A';
+		else if (c >= 'a' && c <= 'z')
+			value = c - 'a' + 26;
+		else if (c >= '0' && c <= '9')
+			value = c - '0' + 52;
+		else if (c == '+' || c == '-')
+			value = 62;
+		else if (c == '/' || c == '_')
+			value = 63;
+		else if (c == '=')
+			break;
+		else
+			continue;
+
+		bits = bits << 6 | value;
+		num_bits += 6;
+		if (num_bits >= 8)
+		{
+			num_bits -= 8;
+			output.push_back((char)(bits >> num_bits & 0xFF));
+		}
+	}
+
+	return output;
+}
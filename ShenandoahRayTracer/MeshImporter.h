@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <math.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Json.h"
+#include "ObjectHandler.h"
+
+/** Loads the objects in a mesh file, picking the format by its extension.
+
+Besides text .obj files, which are loaded by ObjectHandler itself, it reads:
+
+- PLY (.ply), in either binary byte order or as text.  The vertex element
+  gives the positions and, if it has s and t (or u and v) properties, the
+  UVs, and the face element gives polygons, which are split into triangles
+  as fans.  Other elements and properties are skipped.
+- glTF 2.0 (.gltf with its buffers in separate files or data URIs, or
+  binary .glb).  Every mesh primitive made of triangles (including strips
+  and fans) becomes an object, placed by the world matrix of each node that
+  uses its mesh, starting from the default scene.  A mesh used by several
+  nodes is only loaded once, and the nodes share its geometry as instances.
+  Materials, normals, skins, morph targets, and animations are ignored.
+
+Binary data is read into memory with one read and copied straight into the
+objects' arrays, so there is no text to parse.  UVs are flipped vertically
+from glTF's convention, where v points down the image, to the .obj one the
+renderer uses.  Nothing is done about the differences in axes: glTF and
+most .ply files are y up while the renderer is z up, so they need to be
+rotated like .obj files from the same tools.
+
+*/
+class MeshImporter
+{
+public:
+	/**
+	* @brief Loads every object in a file.  Throws an std::invalid_argument if
+	* the file can't be read or isn't valid.
+	*
+	* @param file_location The location of the file.  The extension picks the
+	* format, and anything but .ply, .gltf, or .glb is loaded as .obj.
+	* @param output The vector the loaded objects are appended to.  The
+	* caller takes ownership of them.  Objects from glTF files have the
+	* placement of their node as the local matrix of their transform, and the
+	* node's name, if it has one.
+	*/
+	static void Load(std::string file_location, std::vector<ObjectHandler*>* output);
+
+	// Loads a PLY file, which always holds one object.
+	static ObjectHandler* LoadPLY(std::string file_location);
+
+	// Loads the objects placed by the default scene of a glTF file.
+	static void LoadGLTF(std::string file_location, std::vector<ObjectHandler*>* output);
+
+	// Decodes base64 text, as in glTF data URIs, in either the standard or the
+	// URL safe alphabet.  Decoding stops at the first padding character, and
+	// anything else outside the alphabet is skipped.
+	static std::vector<char> DecodeBase64(const std::string& text);
+
+private:
+	// The value types of PLY properties.
+	enum class PLYType
+	{
+		Int8,
+		UInt8,
+		Int16,
+		UInt16,
+		Int32,
+		UInt32,
+		Float32,
+		Float64
+	};
+
+	struct PLYProperty
+	{
+		std::string name;
+		PLYType type;
+		// Lists have a count of this type before their values.
+		bool is_list = false;
+		PLYType count_type;
+	};
+
+	struct PLYElement
+	{
+		std::string name;
+		int count;
+		std::vector<PLYProperty> properties;
+	};
+
+	// Reads PLY values out of the body of the file, in whichever encoding the
+	// file uses, moving forward past each one.
+	struct PLYReader
+	{
+		const char* data;
+		size_t size;
+		size_t position = 0;
+		bool ascii;
+		bool big_endian;
+
+		double Read(PLYType type);
+	};
+
+	static PLYType ParsePLYType(std::string name);
+	static int GetPLYTypeSize(PLYType type);
+
+	// The binary data of a glTF file, with the JSON describing it.
+	struct GLTFFile
+	{
+		JsonValue json;
+		std::vector<std::vector<char>> buffers;
+	};
+
+	static GLTFFile ReadGLTF(std::string file_location);
+
+	/**
+	* @brief Reads an accessor of a glTF file, converting every component to
+	* the type of the output, a float or an int.  Normalized integers are
+	* mapped to [0, 1] or [-1, 1].
+	*
+	* @param file The glTF file.
+	* @param accessor_index The index of the accessor.
+	* @param components The number of components each element must have,
+	* such as 3 for VEC3.
+	* @param output Set to count * components values.
+	*/
+	template <typename T>
+	static void ReadAccessor(GLTFFile* file, int accessor_index, int components,
+							 std::vector<T>* output);
+
+	// Reads an accessor of scalar indices.
+	static void ReadIndices(GLTFFile* file, int accessor_index,
+							std::vector<int>* output);
+
+	// Loads a mesh primitive of a glTF file, or returns nullptr if it isn't
+	// made of triangles.
+	static ObjectHandler* LoadPrimitive(GLTFFile* file, const JsonValue& primitive);
+
+	// Adds an object for every primitive of a node and its children.  Matrices
+	// are 4x4, in the row vector layout of Matrix.
+	static void AddNode(GLTFFile* file, int node_index, float* parent_matrix,
+						std::vector<std::vector<ObjectHandler*>>* meshes,
+						std::vector<ObjectHandler*>* output, int depth);
+
+	// Creates the geometry of an object from arrays that are already laid out
+	// the way ObjectHandler keeps them.
+	static ObjectHandler* CreateObject(std::vector<float>* vertices,
+									   std::vector<int>* triangles,
+									   std::vector<int>* triangle_uvs,
+									   std::vector<float>* uvs);
+
+	static std::string GetExtension(std::string file_location);
+};
@@ -0,0 +1,272 @@
+#include "MipmappedTexture.h"
+
+std::atomic<unsigned int> MipmappedTexture::next_id = 0;
+
+MipmappedTexture::MipmappedTexture(std::string _file_location,
+								   std::shared_ptr<TextureCache> _cache)
+{
+	id = next_id++;
+	cache = _cache;
+	file_location = _file_location;
+
+	file.open(file_location, std::ifstream::binary);
+	if (!file)
+		throw std::invalid_argument("Texture file not found: " + file_location);
+
+	header = Texture::ReadPPMHeader(&file, file_location);
+
+	if (!header.binary)
+	{
+		file.close();
+		source = std::make_shared<const Texture>(file_location);
+		CreateLevels(source->GetWidth(), source->GetHeight());
+		return;
+	}
+
+	// Checking the size up front means tiles can't fail to load halfway
+	// through a render.
+	int bytes_per_value = header.max_value > 255 ? 2 : 1;
+	file.seekg(0, std::ifstream::end);
+	if ((long long)file.tellg() - header.data_offset <
+		(long long)header.width * header.height * 3 * bytes_per_value)
+		throw std::invalid_argument("PPM file is too short: " + file_location);
+
+	CreateLevels(header.width, header.height);
+}
+
+MipmappedTexture::MipmappedTexture(std::shared_ptr<const Texture> _source,
+								   std::shared_ptr<TextureCache> _cache)
+{
+	id = next_id++;
+	cache = _cache;
+	source = _source;
+
+	CreateLevels(source->GetWidth(), source->GetHeight());
+}
+
+int MipmappedTexture::GetWidth() const
+{
+	return levels[0].width;
+}
+
+int MipmappedTexture::GetHeight() const
+{
+	return levels[0].height;
+}
+
+int MipmappedTexture::GetNumLevels() const
+{
+	return levels.size();
+}
+
+std::string MipmappedTexture::GetFileLocation() const
+{
+	return file_location;
+}
+
+float MipmappedTexture::GetLevel(float footprint) const
+{
+	float texels = footprint * std::max(levels[0].width, levels[0].height);
+	if (!(texels > 1))
+		return 0;
+
+	return fmin(log2(texels), levels.size() - 1);
+}
+
+void MipmappedTexture::Sample(float u, float v, float footprint,
+							  float* output_location) const
+{
+	float level = GetLevel(footprint);
+	int finer = (int)level;
+	float blend = level - finer;
+
+	SampleLevel(u, v, finer, output_location);
+	if (blend <= 0)
+		return;
+
+	float coarser[3];
+	SampleLevel(u, v, finer + 1, coarser);
+	for (int c = 0; c < 3; c++)
+		output_location[c] += (coarser[c] - output_location[c]) * blend;
+}
+
+void MipmappedTexture::SampleLevel(float u, float v, int level,
+								   float* output_location) const
+{
+	int width = levels[level].width;
+	int height = levels[level].height;
+
+	// Texel centres are at half-integer positions, and rows count down from
+	// the top of the image, as in Texture::Sample.
+	float x = (u - floor(u)) * width - 0.5f;
+	float y = (1 - (v - floor(v))) * height - 0.5f;
+
+	int x0 = (int)floor(x);
+	int y0 = (int)floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	int xs[2] = { (x0 % width + width) % width, ((x0 + 1) % width + width) % width };
+	int ys[2] = { (y0 % height + height) % height, ((y0 + 1) % height + height) % height };
+	float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+
+	TileReference reference;
+	float texel[3];
+	output_location[0] = 0;
+	output_location[1] = 0;
+	output_location[2] = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		GetTexel(level, xs[i % 2], ys[i / 2], &reference, texel);
+		for (int c = 0; c < 3; c++)
+			output_location[c] += texel[c] * weights[i];
+	}
+}
+
+void MipmappedTexture::CreateLevels(int width, int height)
+{
+	while (true)
+	{
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+		level.tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+		levels.push_back(level);
+
+		if (width == 1 && height == 1)
+			break;
+
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+
+	// The tile positions each get 17 bits of the cache key.
+	if (levels[0].tiles_x >= 1 << 17 || levels[0].tiles_y >= 1 << 17)
+		throw std::invalid_argument("Texture is too large: " + file_location);
+}
+
+void MipmappedTexture::GetTexel(int level, int x, int y,
+								TileReference* reference,
+								float* output_location) const
+{
+	int tile_x = x / TILE_SIZE;
+	int tile_y = y / TILE_SIZE;
+
+	if (reference->level != level || reference->tile_x != tile_x ||
+		reference->tile_y != tile_y)
+	{
+		reference->level = level;
+		reference->tile_x = tile_x;
+		reference->tile_y = tile_y;
+		reference->tile = GetTile(level, tile_x, tile_y);
+	}
+
+	const TextureTile* tile = reference->tile.get();
+	const float* texel = &tile->texels[((y - tile_y * TILE_SIZE) * tile->width +
+										x - tile_x * TILE_SIZE) * 3];
+	for (int c = 0; c < 3; c++)
+		output_location[c] = texel[c];
+}
+
+std::shared_ptr<const TextureTile> MipmappedTexture::GetTile(int level,
+															 int tile_x,
+															 int tile_y) const
+{
+	unsigned long long key = (unsigned long long)(id & 0xFFFFFF) << 40 |
+		(unsigned long long)level << 34 | (unsigned long long)tile_y << 17 |
+		(unsigned long long)tile_x;
+
+	std::shared_ptr<const TextureTile> tile = cache->Find(key);
+	if (tile)
+		return tile;
+
+	// The tile is loaded without holding any lock, since building a coarse
+	// tile looks up the tiles of the level below it.
+	return cache->Insert(key, LoadTile(level, tile_x, tile_y));
+}
+
+std::shared_ptr<TextureTile> MipmappedTexture::LoadTile(int level, int tile_x,
+														int tile_y) const
+{
+	const Level& size = levels[level];
+	int x0 = tile_x * TILE_SIZE;
+	int y0 = tile_y * TILE_SIZE;
+
+	std::shared_ptr<TextureTile> tile = std::make_shared<TextureTile>();
+	tile->width = std::min(TILE_SIZE, size.width - x0);
+	tile->height = std::min(TILE_SIZE, size.height - y0);
+	tile->texels.resize(tile->width * tile->height * 3);
+
+	if (level == 0)
+	{
+		if (!source)
+		{
+			ReadTile(tile_x, tile_y, tile.get());
+			return tile;
+		}
+
+		for (int y = 0; y < tile->height; y++)
+		{
+			for (int x = 0; x < tile->width; x++)
+				source->GetTexel(x0 + x, y0 + y, &tile->texels[(y * tile->width + x) * 3]);
+		}
+		return tile;
+	}
+
+	// Each texel is the average of the 2x2 texels below it.  The last row or
+	// column of a level with an odd size is dropped, apart from levels that
+	// are only one texel across, which reuse it.
+	const Level& finer = levels[level - 1];
+	TileReference reference;
+	float texel[3];
+
+	for (int y = 0; y < tile->height; y++)
+	{
+		int fy[2] = { (y0 + y) * 2, std::min((y0 + y) * 2 + 1, finer.height - 1) };
+
+		for (int x = 0; x < tile->width; x++)
+		{
+			int fx[2] = { (x0 + x) * 2, std::min((x0 + x) * 2 + 1, finer.width - 1) };
+			float* output = &tile->texels[(y * tile->width + x) * 3];
+
+			for (int i = 0; i < 4; i++)
+			{
+				GetTexel(level - 1, fx[i % 2], fy[i / 2], &reference, texel);
+				for (int c = 0; c < 3; c++)
+					output[c] += texel[c] * 0.25f;
+			}
+		}
+	}
+
+	return tile;
+}
+
+void MipmappedTexture::ReadTile(int tile_x, int tile_y, TextureTile* tile) const
+{
+	int bytes_per_value = header.max_value > 255 ? 2 : 1;
+	int row_values = tile->width * 3;
+	std::vector<unsigned char> bytes(row_values * bytes_per_value);
+
+	// The file is shared by every thread, so only one can seek and read it at
+	// a time.  Rows of the tile are not next to each other in the file.
+	std::lock_guard<std::mutex> lock(file_mutex);
+
+	for (int y = 0; y < tile->height; y++)
+	{
+		long long texel = (long long)(tile_y * TILE_SIZE + y) * header.width +
+			tile_x * TILE_SIZE;
+		file.clear();
+		file.seekg(header.data_offset + texel * 3 * bytes_per_value);
+		file.read((char*)bytes.data(), bytes.size());
+
+		for (int i = 0; i < row_values; i++)
+		{
+			int value = bytes[i * bytes_per_value];
+			if (bytes_per_value == 2)
+				value = value << 8 | bytes[i * 2 + 1];
+			tile->texels[y * row_values + i] = (float)value / header.max_value;
+		}
+	}
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Texture.h"
+#include "TextureCache.h"
+
+/** A texture stored as a pyramid of tiled mip levels, loaded on demand.
+
+Each level is half the size of the one before it, down to a single texel,
+and is split into square tiles of TILE_SIZE texels.  Nothing is loaded up
+front: the first lookup of a tile reads it into the shared TextureCache, and
+tiles that haven't been used for a while are evicted from it again.  Level 0
+tiles are read straight from the file, and the tiles of every other level
+are averaged from the four tiles below them, so a level is never built
+unless something looks at it.
+
+Binary (P6) files are read a tile at a time, so only the cached tiles are
+ever in memory.  Plain text (P3) files can't be read from the middle, so
+they are decoded into an in-memory Texture once, and only the tiles built
+from it are bounded by the cache.
+
+Lookups pick a level from the size of the ray's footprint on the texture,
+and blend between the two closest levels (trilinear filtering).  Distant
+and grazing surfaces then read a few texels from a small level rather than
+skipping across the full size image, which both removes the aliasing and
+keeps the working set small enough for the cache.
+
+*/
+class MipmappedTexture
+{
+public:
+	// The width and height of the tiles, in texels.
+	static constexpr int TILE_SIZE = 32;
+
+	/**
+	* @brief Opens a P3 or P6 PPM texture.  Throws an std::invalid_argument if
+	* the file can't be read.
+	*
+	* @param file_location The location of the PPM file.
+	* @param _cache The cache the tiles are loaded into.
+	*/
+	MipmappedTexture(std::string file_location, std::shared_ptr<TextureCache> _cache);
+
+	/**
+	* @brief Creates a mipmapped texture from a texture already in memory.
+	*
+	* @param _source The full size texture.
+	* @param _cache The cache the tiles are loaded into.
+	*/
+	MipmappedTexture(std::shared_ptr<const Texture> _source,
+					 std::shared_ptr<TextureCache> _cache);
+
+	int GetWidth() const;
+	int GetHeight() const;
+	int GetNumLevels() const;
+
+	// The file the texture was opened from, or an empty string if it was
+	// created from a texture in memory.
+	std::string GetFileLocation() const;
+
+	/**
+	* @brief Finds the mip level that matches a footprint, where one texel
+	* covers the footprint.
+	*
+	* @param footprint The width of the footprint in texture coordinates.
+	*
+	* @return The level, with a fraction between two levels.  0 for
+	* footprints smaller than a full size texel.
+	*/
+	float GetLevel(float footprint) const;
+
+	/**
+	* @brief Looks up the colour at a texture coordinate, blended between the
+	* two mip levels closest to the footprint.
+	*
+	* @param u The horizontal texture coordinate.
+	* @param v The vertical texture coordinate.
+	* @param footprint The width of the area being looked up, in texture
+	* coordinates.  0 always uses the full size level.
+	* @param output_location A float array with minimum size 3.
+	*/
+	void Sample(float u, float v, float footprint, float* output_location) const;
+
+	/**
+	* @brief Looks up the colour at a texture coordinate within a single mip
+	* level, with bilinear filtering.
+	*
+	* @param u The horizontal texture coordinate.
+	* @param v The vertical texture coordinate.
+	* @param level The mip level, where 0 is full size.
+	* @param output_location A float array with minimum size 3.
+	*/
+	void SampleLevel(float u, float v, int level, float* output_location) const;
+
+private:
+	struct Level
+	{
+		int width;
+		int height;
+		int tiles_x;
+		int tiles_y;
+	};
+
+	// The tile a lookup used last, so that neighbouring texels in the same
+	// tile don't each go through the cache.
+	struct TileReference
+	{
+		int level = -1;
+		int tile_x = -1;
+		int tile_y = -1;
+		std::shared_ptr<const TextureTile> tile;
+	};
+
+	// Identifies the texture's tiles within the cache.
+	unsigned int id;
+	std::vector<Level> levels;
+	std::shared_ptr<TextureCache> cache;
+
+	// Level 0 comes either from the source texture, or from the file if there
+	// is no source.
+	std::shared_ptr<const Texture> source;
+	std::string file_location;
+	PPMHeader header;
+	mutable std::ifstream file;
+	mutable std::mutex file_mutex;
+
+	static std::atomic<unsigned int> next_id;
+
+	// Works out the size of every level from the full size.
+	void CreateLevels(int width, int height);
+
+	// Copies a texel, given its column and row within a level.
+	void GetTexel(int level, int x, int y, TileReference* reference,
+				  float* output_location) const;
+
+	// Finds a tile in the cache, loading it if it isn't there.
+	std::shared_ptr<const TextureTile> GetTile(int level, int tile_x,
+											   int tile_y) const;
+	std::shared_ptr<TextureTile> LoadTile(int level, int tile_x, int tile_y) const;
+	void ReadTile(int tile_x, int tile_y, TextureTile* tile) const;
+};
@@ -1,19 +1,113 @@
 #include "ObjectHandler.h"
 
+// The sine of the smallest angle between two edges of a triangle that Weld
+// keeps, which matches the EPSILON that PreparedScene::GetRayHit rejects
+// determinants below.  Corners on one line rarely give a cross product of
+// exactly zero once rounded to floats, so anything flatter counts as having
+// no area.
+#define COLLINEAR_TOLERANCE 0.000001
+
+// Hashes bytes with 64 bit FNV-1a, continuing from an earlier hash.
+static size_t HashBytes(const void* data, size_t bytes, size_t hash)
+{
+	const unsigned char* input = (const unsigned char*)data;
+	unsigned long long value = hash;
+	for (size_t i = 0; i < bytes; i++)
+	{
+		value ^= input[i];
+		value *= 0x100000001B3ull;
+	}
+	return (size_t)value;
+}
+
+// Interleaves the low 10 bits of a number with two zero bits between each,
+// ready to be combined with two other axes into a Morton code.
+static unsigned int SpreadBits(unsigned int value)
+{
+	value &= 0x3FF;
+	value = (value | value << 16) & 0x030000FF;
+	value = (value | value << 8) & 0x0300F00F;
+	value = (value | value << 4) & 0x030C30C3;
+	value = (value | value << 2) & 0x09249249;
+	return value;
+}
+
+/**
+* @brief Renumbers values made of several floats in the order they are first
+* used, with the ones that are never used left at the end.
+*
+* @param values The values, each one size floats long.
+* @param count The number of values.
+* @param size The number of floats in each value.
+* @param indices The indices that use the values, which are renumbered.
+* @param output Where the reordered values are written, with room for count
+* values.
+*/
+static void RenumberValues(const float* values, int count, int size,
+						   std::vector<int>* indices, float* output)
+{
+	std::vector<int> remap(count, -1);
+	int next = 0;
+
+	for (int i = 0; i < indices->size(); i++)
+	{
+		int& index = indices->at(i);
+		if (remap[index] == -1)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (remap[i] == -1)
+			remap[i] = next++;
+		std::copy(&values[i * size], &values[(i + 1) * size], &output[remap[i] * size]);
+	}
+}
+
+/**
+* @brief Merges values made of several floats that are exactly the same, as
+* vertices and UVs are.
+*
+* @param values The values, each one size floats long.
+* @param count The number of values.
+* @param size The number of floats in each value.
+* @param used Whether each value is used at all.  Values that aren't are
+* dropped.
+* @param output Where the values that are left are appended.
+*
+* @return The new index of each value, or -1 for those that were dropped.
+*/
+static std::vector<int> MergeValues(const float* values, int count, int size,
+									const std::vector<bool>& used,
+									std::vector<float>* output)
+{
+	// Values are compared by their bits, so 0 and -0 are kept apart just as
+	// they would be by anything that reads them.
+	std::unordered_map<std::string, int> indices;
+	std::vector<int> remap(count, -1);
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!used[i])
+			continue;
+
+		std::string key((const char*)&values[i * size], sizeof(float) * size);
+		auto found = indices.emplace(key, (int)(output->size() / size));
+		if (found.second)
+			output->insert(output->end(), &values[i * size], &values[(i + 1) * size]);
+		remap[i] = found.first->second;
+	}
+
+	return remap;
+}
+
 ObjectHandler::ObjectHandler()
 {
 	transform = Transform();
 	name = "Default Object Name";
 
-	vertices = new float[1];
-	num_vertices = 0;
-
-	triangles = new int[1];
-	triangle_uvs = new int[1];
-	num_triangles = 0;
-
-	uvs = new float[1];
-	num_uvs = 0;
+	geometry = GetEmptyGeometry();
  }
 
 ObjectHandler::ObjectHandler(float* _vertices, int _num_vertices, float* _uvs,
@@ -21,11 +115,14 @@ ObjectHandler::ObjectHandler(float* _vertices, int _num_vertices, float* _uvs,
 							 int* _triangle_uvs, Transform t, std::string _name)
 {
 	transform = t;
-	num_vertices = _num_vertices;
-	num_triangles = _num_triangles;
-	num_uvs = _num_uvs;
 
-	InitializeArrays(_vertices, _triangles, _triangle_uvs, _uvs);
+	std::shared_ptr<Geometry> loaded = std::make_shared<Geometry>();
+	loaded->num_vertices = _num_vertices;
+	loaded->num_triangles = _num_triangles;
+	loaded->num_uvs = _num_uvs;
+
+	InitializeArrays(_vertices, _triangles, _triangle_uvs, _uvs, loaded.get());
+	geometry = loaded;
 
 	name = _name;
 }
@@ -48,75 +145,304 @@ ObjectHandler::ObjectHandler(std::string file_location)
 
 	// Now we use helper methods to individually find vertices, uvs, triangles,
 	// and triangle_uvs.
+	std::shared_ptr<Geometry> loaded = std::make_shared<Geometry>();
 
-	InitializeVertices(&lines);
-	InitializeTriangles(&lines);
-	InitializeUVs(&lines);
+	InitializeVertices(&lines, loaded.get());
+	InitializeTriangles(&lines, loaded.get());
+	InitializeUVs(&lines, loaded.get());
+	geometry = loaded;
 
 	name = "Test";
 }
 
 ObjectHandler::ObjectHandler(const ObjectHandler& obj)
 {
-	transform = obj.transform;
-	num_vertices = obj.num_vertices;
-	num_uvs = obj.num_uvs;
-	num_triangles = obj.num_triangles;
-
-
-	InitializeArrays(obj.vertices, obj.triangles, obj.triangle_uvs, obj.uvs);
+	*this = obj;
+}
 
-	name = obj.name;
+ObjectHandler::ObjectHandler(ObjectHandler&& obj) noexcept
+{
+	*this = std::move(obj);
 }
 
 ObjectHandler::~ObjectHandler()
 {
-	delete[] vertices;
-	delete[] triangles;
-	delete[] triangle_uvs;
-	delete[] uvs;
+
 }
 
 
 ObjectHandler& ObjectHandler::operator=(const ObjectHandler& obj)
 {
-	// Deleting old vertices to avoid memory leak.
-	delete[] vertices;
-	delete[] triangles;
-	delete[] triangle_uvs;
-	delete[] uvs;
+	if (this == &obj)
+		return *this;
 
-	num_vertices = obj.num_vertices;
-	num_triangles = obj.num_triangles;
-	num_uvs = obj.num_uvs;
+	// The old geometry is released by the shared pointer, so there is nothing
+	// to delete here.
+	std::shared_ptr<Geometry> copy = std::make_shared<Geometry>();
+	copy->num_vertices = obj.geometry->num_vertices;
+	copy->num_triangles = obj.geometry->num_triangles;
+	copy->num_uvs = obj.geometry->num_uvs;
 
-	InitializeArrays(obj.vertices, obj.triangles, obj.triangle_uvs, obj.uvs);
+	InitializeArrays(obj.geometry->vertices, obj.geometry->triangles,
+					 obj.geometry->triangle_uvs, obj.geometry->uvs, copy.get());
+	geometry = copy;
 
+	transform = obj.transform;
 	name = obj.name;
+	material = obj.material;
+
+	return *this;
+}
+
+ObjectHandler& ObjectHandler::operator=(ObjectHandler&& obj) noexcept
+{
+	if (this == &obj)
+		return *this;
+
+	// The other handler is left empty rather than without geometry, so it can
+	// still be used safely.
+	geometry = std::move(obj.geometry);
+	obj.geometry = GetEmptyGeometry();
+
+	transform = obj.transform;
+	name = std::move(obj.name);
+	material = std::move(obj.material);
 
 	return *this;
 }
 
 ObjectHandler ObjectHandler::Duplicate()
 {
-	return ObjectHandler(vertices, num_vertices, uvs, num_uvs, 
-		                 triangles, num_triangles, triangle_uvs,
-		                 transform, name + "_Copy");
+	ObjectHandler copy = ObjectHandler(geometry->vertices, geometry->num_vertices,
+									   geometry->uvs, geometry->num_uvs,
+									   geometry->triangles, geometry->num_triangles,
+									   geometry->triangle_uvs, transform,
+									   name + "_Copy");
+	copy.material = material;
+	return copy;
+}
+
+ObjectHandler ObjectHandler::Instance() const
+{
+	ObjectHandler instance;
+	instance.geometry = geometry;
+	instance.transform = transform;
+	instance.name = name;
+	instance.material = material;
+	return instance;
+}
+
+bool ObjectHandler::SharesGeometry(const ObjectHandler& obj) const
+{
+	return geometry == obj.geometry;
+}
+
+WeldStatistics ObjectHandler::Weld()
+{
+	const Geometry& old = *geometry;
+	bool using_uvs = old.num_uvs > 0;
+
+	// A triangle is kept if it has three different vertices that aren't on
+	// one line, to within rounding.  The others have no area, so GetRayHit
+	// never hits them.
+	std::vector<bool> kept(old.num_triangles);
+	std::vector<bool> used_vertices(old.num_vertices, false);
+	std::vector<bool> used_uvs(old.num_uvs, false);
+	for (int t = 0; t < old.num_triangles; t++)
+	{
+		int* triangle = &old.triangles[t * 3];
+		float edge1[3], edge2[3], cross[3];
+		Vector3::Subtract(&old.vertices[triangle[1] * 4], &old.vertices[triangle[0] * 4], edge1);
+		Vector3::Subtract(&old.vertices[triangle[2] * 4], &old.vertices[triangle[0] * 4], edge2);
+		Vector3::Cross(edge1, edge2, cross);
+
+		// |edge1 x edge2| is |edge1| |edge2| times the sine of the angle
+		// between them, which is compared squared.
+		double cross_squared = Vector3::Dot(cross, cross);
+		double edges_squared = (double)Vector3::Dot(edge1, edge1) * Vector3::Dot(edge2, edge2);
+		kept[t] = cross_squared > COLLINEAR_TOLERANCE * COLLINEAR_TOLERANCE * edges_squared;
+		if (!kept[t])
+			continue;
+
+		for (int k = 0; k < 3; k++)
+		{
+			used_vertices[triangle[k]] = true;
+			if (using_uvs)
+				used_uvs[old.triangle_uvs[t * 3 + k]] = true;
+		}
+	}
+
+	std::vector<float> vertices;
+	std::vector<float> uvs;
+	std::vector<int> vertex_remap = MergeValues(old.vertices, old.num_vertices, 4,
+												used_vertices, &vertices);
+	std::vector<int> uv_remap = MergeValues(old.uvs, old.num_uvs, 2, used_uvs, &uvs);
+
+	std::vector<int> triangles;
+	std::vector<int> triangle_uvs;
+	for (int t = 0; t < old.num_triangles; t++)
+	{
+		if (!kept[t])
+			continue;
+
+		for (int k = 0; k < 3; k++)
+		{
+			triangles.push_back(vertex_remap[old.triangles[t * 3 + k]]);
+			triangle_uvs.push_back(using_uvs ? uv_remap[old.triangle_uvs[t * 3 + k]] : 0);
+		}
+
+		// Merging can leave a triangle with a repeated vertex, which has no
+		// area either.
+		int* triangle = &triangles[triangles.size() - 3];
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] ||
+			triangle[0] == triangle[2])
+		{
+			triangles.resize(triangles.size() - 3);
+			triangle_uvs.resize(triangle_uvs.size() - 3);
+		}
+	}
+
+	std::shared_ptr<Geometry> welded = std::make_shared<Geometry>();
+	welded->num_vertices = vertices.size() / 4;
+	welded->num_triangles = triangles.size() / 3;
+	welded->num_uvs = uvs.size() / 2;
+	InitializeArrays(vertices.data(), triangles.data(), triangle_uvs.data(),
+					 uvs.data(), welded.get());
+
+	WeldStatistics statistics;
+	statistics.vertices_removed = old.num_vertices - welded->num_vertices;
+	statistics.uvs_removed = old.num_uvs - welded->num_uvs;
+	statistics.triangles_removed = old.num_triangles - welded->num_triangles;
+
+	geometry = welded;
+	return statistics;
+}
+
+void ObjectHandler::Reorder()
+{
+	const Geometry& old = *geometry;
+
+	float bounds_min[3] = { INFINITY, INFINITY, INFINITY };
+	float bounds_max[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (int i = 0; i < old.num_vertices; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			bounds_min[c] = fmin(bounds_min[c], old.vertices[i * 4 + c]);
+			bounds_max[c] = fmax(bounds_max[c], old.vertices[i * 4 + c]);
+		}
+	}
+
+	// Each axis of a triangle's centre is quantized to 10 bits within the
+	// bounds, which is finer than any cluster or leaf needs.
+	std::vector<unsigned int> keys(old.num_triangles);
+	for (int t = 0; t < old.num_triangles; t++)
+	{
+		unsigned int key = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			float centre = 0;
+			for (int k = 0; k < 3; k++)
+				centre += old.vertices[old.triangles[t * 3 + k] * 4 + c] / 3;
+
+			float extent = bounds_max[c] - bounds_min[c];
+			float f = extent > 0 ? (centre - bounds_min[c]) / extent : 0;
+			key |= SpreadBits((unsigned int)fmin(fmax(f * 1024, 0.0f), 1023.0f)) << c;
+		}
+		keys[t] = key;
+	}
+
+	// The sort is stable so that triangles in the same cell keep their order.
+	std::vector<int> order(old.num_triangles);
+	for (int t = 0; t < old.num_triangles; t++)
+		order[t] = t;
+	std::stable_sort(order.begin(), order.end(),
+					 [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+	std::vector<int> triangles(old.num_triangles * 3);
+	std::vector<int> triangle_uvs(old.num_triangles * 3);
+	for (int t = 0; t < old.num_triangles; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			triangles[t * 3 + k] = old.triangles[order[t] * 3 + k];
+			triangle_uvs[t * 3 + k] = old.triangle_uvs[order[t] * 3 + k];
+		}
+	}
+
+	std::shared_ptr<Geometry> reordered = std::make_shared<Geometry>();
+	reordered->num_vertices = old.num_vertices;
+	reordered->num_triangles = old.num_triangles;
+	reordered->num_uvs = old.num_uvs;
+	reordered->vertices = new float[old.num_vertices * 4];
+	reordered->triangles = new int[old.num_triangles * 3];
+	reordered->triangle_uvs = new int[old.num_triangles * 3];
+	reordered->uvs = new float[old.num_uvs * 2];
+
+	RenumberValues(old.vertices, old.num_vertices, 4, &triangles,
+				   reordered->vertices);
+	if (old.num_uvs > 0)
+		RenumberValues(old.uvs, old.num_uvs, 2, &triangle_uvs, reordered->uvs);
+
+	std::copy(triangles.begin(), triangles.end(), reordered->triangles);
+	std::copy(triangle_uvs.begin(), triangle_uvs.end(), reordered->triangle_uvs);
+
+	geometry = reordered;
+}
+
+size_t ObjectHandler::GetGeometryHash() const
+{
+	size_t hash = 0xCBF29CE484222325ull;
+	hash = HashBytes(&geometry->num_vertices, sizeof(int), hash);
+	hash = HashBytes(&geometry->num_triangles, sizeof(int), hash);
+	hash = HashBytes(&geometry->num_uvs, sizeof(int), hash);
+	hash = HashBytes(geometry->vertices, sizeof(float) * geometry->num_vertices * 4, hash);
+	hash = HashBytes(geometry->triangles, sizeof(int) * geometry->num_triangles * 3, hash);
+	hash = HashBytes(geometry->uvs, sizeof(float) * geometry->num_uvs * 2, hash);
+
+	// Triangle UVs are never read without UVs, so they don't count then.
+	if (geometry->num_uvs > 0)
+		hash = HashBytes(geometry->triangle_uvs, sizeof(int) * geometry->num_triangles * 3, hash);
+
+	return hash;
+}
+
+bool ObjectHandler::HasSameGeometry(const ObjectHandler& obj) const
+{
+	const Geometry& a = *geometry;
+	const Geometry& b = *obj.geometry;
+
+	if (&a == &b)
+		return true;
+	if (a.num_vertices != b.num_vertices || a.num_triangles != b.num_triangles ||
+		a.num_uvs != b.num_uvs)
+		return false;
+
+	return memcmp(a.vertices, b.vertices, sizeof(float) * a.num_vertices * 4) == 0 &&
+		memcmp(a.triangles, b.triangles, sizeof(int) * a.num_triangles * 3) == 0 &&
+		memcmp(a.uvs, b.uvs, sizeof(float) * a.num_uvs * 2) == 0 &&
+		(a.num_uvs == 0 ||
+		 memcmp(a.triangle_uvs, b.triangle_uvs, sizeof(int) * a.num_triangles * 3) == 0);
+}
+
+void ObjectHandler::ShareGeometry(const ObjectHandler& obj)
+{
+	geometry = obj.geometry;
 }
 
 int ObjectHandler::GetNumVertices()
 {
-	return num_vertices;
+	return geometry->num_vertices;
 }
 
 int ObjectHandler::GetNumTriangles()
 {
-	return num_triangles;
+	return geometry->num_triangles;
 }
 
 int ObjectHandler::GetNumUVs()
 {
-	return num_uvs;
+	return geometry->num_uvs;
 }
 
 void ObjectHandler::CopyRawVertices(float* output_location)
@@ -126,7 +452,7 @@ void ObjectHandler::CopyRawVertices(float* output_location)
 	// with those values.  To make sure the original mesh is preserved in case
 	// necessary, we store the raw vertices.  This method returns the raw verts
 	// so that they can be used for other operations if necessary.
-	memcpy(output_location, &vertices[0], sizeof(float) * num_vertices * 4);
+	memcpy(output_location, geometry->vertices, sizeof(float) * geometry->num_vertices * 4);
 }
 
 void ObjectHandler::CopyAdjustedVertices(float* output_location)
@@ -139,9 +465,9 @@ void ObjectHandler::CopyAdjustedVertices(float* output_location)
 
 	transformation_matrix.Copy(&matrix[0]);
 
-	for (int i = 0; i < num_vertices * 4; i += 4)
+	for (int i = 0; i < geometry->num_vertices * 4; i += 4)
 	{
-		Matrix::Multiply(&vertices[i], 1, 4, &matrix[0], 4, 4, &output_location[i]);
+		Matrix::Multiply(&geometry->vertices[i], 1, 4, &matrix[0], 4, 4, &output_location[i]);
 	}
 }
 
@@ -149,34 +475,36 @@ void ObjectHandler::CopyTriangles(int* output_location)
 {
 	// Unlike the vertices, there is no adjusted triangles, since the points in
 	// the triangle represent indices within the vertice array.
-	memcpy(output_location, triangles, sizeof(int) * num_triangles * 3);
+	memcpy(output_location, geometry->triangles, sizeof(int) * geometry->num_triangles * 3);
 }
 
 void ObjectHandler::CopyTriangleUVs(int* output_location)
 {
-	memcpy(output_location, &triangle_uvs[0], sizeof(int) * num_triangles * 3);
+	memcpy(output_location, geometry->triangle_uvs, sizeof(int) * geometry->num_triangles * 3);
 }
 
 void ObjectHandler::CopyUVs(float* output_location)
 {
-	memcpy(output_location, &uvs[0], sizeof(float) * num_uvs * 2);
+	memcpy(output_location, geometry->uvs, sizeof(float) * geometry->num_uvs * 2);
 }
 
 void ObjectHandler::InitializeArrays(float* _vertices, int* _triangles, 
-	                                 int* _triangle_uvs, float* _uvs)
+	                                 int* _triangle_uvs, float* _uvs,
+	                                 Geometry* output)
 {
-	vertices = new float[num_vertices * 4];
-	triangles = new int[num_triangles * 3];
-	triangle_uvs = new int[num_triangles * 3];
-	uvs = new float[num_uvs * 2];
-
-	memcpy(vertices, _vertices, sizeof(float) * num_vertices * 4);
-	memcpy(triangles, _triangles, sizeof(int) * num_triangles * 3);
-	memcpy(triangle_uvs, _triangle_uvs, sizeof(int) * num_triangles * 3);
-	memcpy(uvs, _uvs, sizeof(float) * num_uvs * 2);
+	output->vertices = new float[output->num_vertices * 4];
+	output->triangles = new int[output->num_triangles * 3];
+	output->triangle_uvs = new int[output->num_triangles * 3];
+	output->uvs = new float[output->num_uvs * 2];
+
+	memcpy(output->vertices, _vertices, sizeof(float) * output->num_vertices * 4);
+	memcpy(output->triangles, _triangles, sizeof(int) * output->num_triangles * 3);
+	memcpy(output->triangle_uvs, _triangle_uvs, sizeof(int) * output->num_triangles * 3);
+	memcpy(output->uvs, _uvs, sizeof(float) * output->num_uvs * 2);
 }
 
-void ObjectHandler::InitializeVertices(std::vector<std::string>* lines)
+void ObjectHandler::InitializeVertices(std::vector<std::string>* lines,
+									  Geometry* output)
 {
 	// Unformatted regex:
 	// \s*v\s+(-?[0-9]+.[0-9]+)\s+(-?[0-9]+.[0-9]+)\s+(-?[0-9]+.[0-9]+)\s*(-?[0-9]+.[0-9]+)?\s*
@@ -201,13 +529,14 @@ void ObjectHandler::InitializeVertices(std::vector<std::string>* lines)
 	}
 
 	// Initializing array and copying data.
-	num_vertices = values.size() / 4;
-	vertices = new float[num_vertices * 4];
+	output->num_vertices = values.size() / 4;
+	output->vertices = new float[output->num_vertices * 4];
 
-	std::copy(values.begin(), values.end(), vertices);
+	std::copy(values.begin(), values.end(), output->vertices);
 }
 
-void ObjectHandler::InitializeTriangles(std::vector<std::string>* lines)
+void ObjectHandler::InitializeTriangles(std::vector<std::string>* lines,
+									  Geometry* output)
 {
 	// This will also match and load quads, but converts them to triangles so
 	// it fits in the pipeline.  Face normals will be ignored, as the code
@@ -248,22 +577,23 @@ void ObjectHandler::InitializeTriangles(std::vector<std::string>* lines)
 	}
 
 	// Initializing arrays and copying values over
-	num_triangles = triangle_values.size() / 3;
-	triangles = new int[num_triangles * 3];
-	triangle_uvs = new int[num_triangles * 3];
+	output->num_triangles = triangle_values.size() / 3;
+	output->triangles = new int[output->num_triangles * 3];
+	output->triangle_uvs = new int[output->num_triangles * 3];
 
-	std::copy(triangle_values.begin(), triangle_values.end(), triangles);
+	std::copy(triangle_values.begin(), triangle_values.end(), output->triangles);
 
 	if (using_uvs)
-		std::copy(uv_values.begin(), uv_values.end(), triangle_uvs);
+		std::copy(uv_values.begin(), uv_values.end(), output->triangle_uvs);
 	else
 	{
-		for (int i = 0; i < num_triangles; i++)
-			triangle_uvs[i] = 0;
+		for (int i = 0; i < output->num_triangles * 3; i++)
+			output->triangle_uvs[i] = 0;
 	}
 }
 
-void ObjectHandler::InitializeUVs(std::vector<std::string>* lines)
+void ObjectHandler::InitializeUVs(std::vector<std::string>* lines,
+									  Geometry* output)
 {
 	// Unformatted regex:
 	// \\s*vt\\s+([0-9]+.[0-9]+)\\s+([0-9]+.[0-9]+)
@@ -282,8 +612,36 @@ void ObjectHandler::InitializeUVs(std::vector<std::string>* lines)
 	}
 
 	// Initializing array and copying data.
-	num_uvs = values.size() / 2;
-	uvs = new float[num_uvs * 2];
+	output->num_uvs = values.size() / 2;
+	output->uvs = new float[output->num_uvs * 2];
 
-	std::copy(values.begin(), values.end(), uvs);
-}
\ No newline at end of file
+	std::copy(values.begin(), values.end(), output->uvs);
+}
+
+ObjectHandler::Geometry::Geometry()
+{
+
+}
+
+ObjectHandler::Geometry::~Geometry()
+{
+	delete[] vertices;
+	delete[] triangles;
+	delete[] triangle_uvs;
+	delete[] uvs;
+}
+
+std::shared_ptr<const ObjectHandler::Geometry> ObjectHandler::GetEmptyGeometry()
+{
+	static const std::shared_ptr<const Geometry> empty = []()
+	{
+		std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
+		geometry->vertices = new float[1];
+		geometry->triangles = new int[1];
+		geometry->triangle_uvs = new int[1];
+		geometry->uvs = new float[1];
+		return geometry;
+	}();
+
+	return empty;
+}
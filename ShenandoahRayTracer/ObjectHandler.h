@@ -1,13 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <regex>
+#include "Material.h"
 #include "Transform.h"
 
+// What ObjectHandler::Weld removed from an object's geometry.
+struct WeldStatistics
+{
+	int vertices_removed = 0;
+	int uvs_removed = 0;
+	int triangles_removed = 0;
+};
+
 // Object handlers deal with the geometry, transform, and visuals of individual
 // objects within the scene.
 //
@@ -18,6 +30,9 @@ public:
 	Transform transform;
 	std::string name;
 
+	// How the surface of the object looks.  Diffuse by default.
+	Material material;
+
 	/**
 	* @brief Default constructor for ObjectHandlers
 	*/
@@ -54,22 +69,31 @@ public:
 	*/
 	ObjectHandler(std::string file_location);
 
-	// TODO: Create a constructor that can load from a .obj file.
-
 	/**
 	* @brief Copy constructor for the ObjectHandler.  Copies all values over
-	* and reinitializes arrays.
+	* and reinitializes arrays, so the copy has its own geometry.  Use
+	* Instance to share the geometry instead.
 	* 
 	* @param _obj The address of the ObjectHandler to be copied.
 	*/
 	ObjectHandler(const ObjectHandler& obj);
 
 	/**
-	* @brief Destructor for the ObjectHandler.  Deletes all dynamic arrays.
+	* @brief Move constructor for the ObjectHandler.  Takes over the geometry
+	* of the other handler without copying it, leaving it empty.
+	* 
+	* @param obj The ObjectHandler to be moved from.
+	*/
+	ObjectHandler(ObjectHandler&& obj) noexcept;
+
+	/**
+	* @brief Destructor for the ObjectHandler.  The geometry is deleted once
+	* no other handler shares it.
 	*/
 	~ObjectHandler();
 
 	ObjectHandler& operator=(const ObjectHandler& obj);
+	ObjectHandler& operator=(ObjectHandler&& obj) noexcept;
 
 	/**
 	* @brief Duplicates the object by creating an entirely new ObjectHandler
@@ -79,6 +103,67 @@ public:
 	*/
 	ObjectHandler Duplicate();
 
+	/**
+	* @brief Creates a new ObjectHandler that shares this object's geometry,
+	* with a copy of its transform, name, and material.  The geometry is never
+	* changed after it is loaded, so any number of instances can be placed
+	* around a scene for the memory of one.
+	* 
+	* @return An ObjectHandler with the same geometry.
+	*/
+	ObjectHandler Instance() const;
+
+	/**
+	* @brief Checks whether two handlers share the same geometry, as with
+	* Instance.
+	* 
+	* @param obj The ObjectHandler to compare against.
+	*/
+	bool SharesGeometry(const ObjectHandler& obj) const;
+
+	// Replaces the geometry of this handler with another's, as if it had been
+	// made with Instance.
+	void ShareGeometry(const ObjectHandler& obj);
+
+	/**
+	* @brief Cleans up the geometry of the object.  Vertices and UVs that are
+	* exactly the same are merged into one, triangles that can never be hit
+	* (those with a repeated vertex or no area) are removed, and vertices and
+	* UVs that no triangle uses are dropped.  Nothing that renders is
+	* changed, though the triangles that are left are numbered differently.
+	* The object is given a new geometry block, so its instances keep the
+	* old one.
+	* 
+	* @return What was removed.
+	*/
+	WeldStatistics Weld();
+
+	/**
+	* @brief Reorders the geometry of the object so that triangles that are
+	* close together in space are close together in memory.  Triangles are
+	* sorted along a Morton curve through the object's bounds, by their
+	* centres, and vertices and UVs are renumbered in the order the sorted
+	* triangles first use them.  Nothing that renders is changed, though the
+	* triangles are numbered differently.  As with Weld, the object is given
+	* a new geometry block.
+	*/
+	void Reorder();
+
+	/**
+	* @brief Hashes the geometry of the object, so that objects with the same
+	* geometry can be found without comparing them all against each other.
+	* The transform, name, and material aren't included.
+	*/
+	size_t GetGeometryHash() const;
+
+	/**
+	* @brief Checks whether two handlers have exactly the same geometry,
+	* whether or not they share it.
+	* 
+	* @param obj The ObjectHandler to compare against.
+	*/
+	bool HasSameGeometry(const ObjectHandler& obj) const;
+
 	int GetNumVertices();
 	int GetNumTriangles();
 	int GetNumUVs();
@@ -102,24 +187,41 @@ public:
 	void CopyTriangleUVs(int* output_location);
 	void CopyUVs(float* output_location);
 
-	//TODO: Design a system for having textures and shaders within the object.
-
 private:
-	float* vertices;
-	int num_vertices;
+	// The geometry of the object, which stays the same for as long as it
+	// exists.  Handlers only ever read it, so copies made through Instance
+	// can share one block instead of each holding their own arrays.
+	struct Geometry
+	{
+		float* vertices = nullptr;
+		int num_vertices = 0;
+
+		// UVs are handled in an interesting way since the code is designed to
+		// work with wavefront files.  We create an array of n uv coordinates
+		// of size 2.  Then, there are two arrays of triangles, with the first
+		// representing the indices of the three vertices, and the second
+		// representing the indices of each uv.  This allows us to only
+		// concern ourselves with geometry when we want to, and to deal with
+		// the uvs separately.
+		int* triangles = nullptr;
+		int num_triangles = 0;
+		int* triangle_uvs = nullptr;
+
+		float* uvs = nullptr;
+		int num_uvs = 0;
+
+		Geometry();
+		~Geometry();
+
+		Geometry(const Geometry&) = delete;
+		Geometry& operator=(const Geometry&) = delete;
+	};
 
-	// UVs are handled in an interesting way since the code is designed to work
-	// with wavefront files.  We create an array of n uv coordinates of size 2.
-	// Then, there are two arrays of triangles, with the first representing the
-	// indices of the three vertices, and the second representing the indices
-	// of each uv.  This allows us to only concern ourselves with geometry when
-	// we want to, and to deal with the uvs separately.
-	int* triangles;
-	int num_triangles;
-	int* triangle_uvs;
+	std::shared_ptr<const Geometry> geometry;
 
-	float* uvs;
-	int num_uvs;
+	// The geometry of default and moved-from handlers, shared by all of them
+	// so that neither has to allocate.
+	static std::shared_ptr<const Geometry> GetEmptyGeometry();
 
 	/**
 	* @brief Initializes the arrays by copying over the information.
@@ -128,30 +230,35 @@ private:
 	* @param _triangles A pointer to the triangles array to be copied.
 	* @param _triangle_uvs A pointer to the triangle uv array to be copied.
 	* @param _uvs A poitner to the uv array to be copied.
+	* @param output The geometry to initialize, which has its counts set.
 	*/
-	void InitializeArrays(float* _vertices, int* _triangles,
-		                  int* _triangle_uvs, float* _uvs);
+	static void InitializeArrays(float* _vertices, int* _triangles,
+		                         int* _triangle_uvs, float* _uvs,
+		                         Geometry* output);
 
 	/**
 	* @brief Initializes the vertices in .obj loading given a vector of lines.
 	* 
 	* @param lines The lines in the .obj file.
+	* @param output The geometry to initialize.
 	*/
-	void InitializeVertices(std::vector<std::string>* lines);
+	static void InitializeVertices(std::vector<std::string>* lines, Geometry* output);
 
 	/**
 	* @brief Initializes the triangles and triangle UVs in a .obj file given
 	* a vector of lines.
 	* 
 	* @param lines The lines in the .obj file.
+	* @param output The geometry to initialize.
 	*/
-	void InitializeTriangles(std::vector<std::string>* lines);
+	static void InitializeTriangles(std::vector<std::string>* lines, Geometry* output);
 
 	/**
 	* @brief Initializes the UVs in .obj loading given a vector of lines.
 	* 
 	* @param lines The lines in the .obj file.
+	* @param output The geometry to initialize.
 	*/
-	void InitializeUVs(std::vector<std::string>* lines);
+	static void InitializeUVs(std::vector<std::string>* lines, Geometry* output);
 };
 
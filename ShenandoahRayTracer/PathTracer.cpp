@@ -0,0 +1,418 @@
+#include "PathTracer.h"
+#include "RenderCheckpoint.h"
+
+// How far new rays start from the surface they leave, so that they don't hit
+// it again due to rounding.
+#define RAY_OFFSET 0.0001f
+
+// How much wider the ray cone gets after each bounce, in radians.  Rough
+// bounces scatter rays in every direction, so the footprint of the next hit
+// is only roughly known, and a blurrier mip level is just as good.
+#define BOUNCE_SPREAD 0.2f
+
+PathTracer::PathTracer()
+{
+
+}
+
+template <typename M>
+bool PathTracer::ShadeHit(const M& material, PreparedScene* scene, int depth,
+						  PathState* path, RandomSequence* random,
+						  ShadowRay* shadow, bool* has_shadow)
+{
+	*has_shadow = false;
+
+	float position[3], normal[3];
+	Vector3::MultiplyF(path->direction, path->hit.t, position);
+	Vector3::Add(path->origin, position, position);
+
+	if constexpr (M::IS_EMISSIVE)
+	{
+		float emission[3];
+		material.GetEmission(emission);
+		for (int c = 0; c < 3; c++)
+			path->radiance[c] += path->throughput[c] * emission[c];
+		return false;
+	}
+
+	scene->GetHitNormal(&path->hit, path->direction, normal);
+
+	float outgoing[3];
+	Vector3::Normalize(path->direction, outgoing);
+	Vector3::MultiplyF(outgoing, -1, outgoing);
+
+	// Camera ray directions aren't normalized, so t isn't always a distance.
+	float distance = path->hit.t * sqrt(Vector3::Dot(path->direction, path->direction));
+	float cone_width = path->cone_width + path->cone_spread * distance;
+
+	float uv[3] = { 0, 0, 0 };
+	if constexpr (M::NEEDS_UV)
+	{
+		scene->GetHitUV(&path->hit, uv);
+
+		// The footprint stretches along the surface as the ray gets closer to
+		// grazing it.  The limit stops it covering the whole texture.
+		float cosine = fmax(Vector3::Dot(normal, outgoing), 0.1f);
+		uv[2] = cone_width * scene->GetHitUVDensity(&path->hit) / cosine;
+	}
+
+	*has_shadow = GenerateShadowRay(material, position, normal, outgoing, uv,
+									path->throughput, random, shadow);
+
+	if (depth + 1 == max_depth)
+		return false;
+
+	float u1 = random->Next();
+	float u2 = random->Next();
+	float weight[3];
+	if (!material.Sample(normal, outgoing, uv, u1, u2, path->direction, weight))
+		return false;
+
+	for (int c = 0; c < 3; c++)
+		path->throughput[c] *= weight[c];
+
+	path->cone_width = cone_width;
+	path->cone_spread += BOUNCE_SPREAD;
+
+	if (depth + 1 >= russian_roulette_depth)
+	{
+		float survival = fmin(fmax(path->throughput[0],
+								   fmax(path->throughput[1], path->throughput[2])),
+							  0.95f);
+		if (random->Next() >= survival)
+			return false;
+
+		Vector3::MultiplyF(path->throughput, 1.0f / survival, path->throughput);
+	}
+
+	Vector3::MultiplyF(normal, RAY_OFFSET, path->origin);
+	Vector3::Add(position, path->origin, path->origin);
+
+	return true;
+}
+
+template <typename M>
+void PathTracer::ShadeGroup(PreparedScene* scene, int depth,
+							ArenaVector<int>* group,
+							ArenaVector<PathState>* paths,
+							RandomSequence* randoms,
+							ArenaVector<ShadowRay>* shadows,
+							ArenaVector<int>* next_active)
+{
+	for (int i = 0; i < group->size(); i++)
+	{
+		int index = group->at(i);
+		PathState& path = paths->at(index);
+		const M& material = *std::get_if<M>(&scene->GetMaterial(path.hit.object_index));
+
+		ShadowRay shadow;
+		bool has_shadow;
+		if (ShadeHit(material, scene, depth, &path, &randoms[index], &shadow,
+					 &has_shadow))
+			next_active->push_back(index);
+
+		if (has_shadow)
+		{
+			shadow.path = index;
+			shadows->push_back(shadow);
+		}
+	}
+}
+
+template <typename M>
+bool PathTracer::GenerateShadowRay(const M& material, float* position,
+								   float* normal, float* outgoing, float* uv,
+								   float* throughput, RandomSequence* random,
+								   ShadowRay* output)
+{
+	// Dividing by the probability of the pick keeps the estimate unbiased.
+	int index;
+	float pdf;
+	if (!light_tree.Sample(position, normal, random->Next(), &index, &pdf))
+		return false;
+	PointLight& light = lights[index];
+
+	float to_light[3];
+	Vector3::Subtract(light.position, position, to_light);
+	float distance_squared = Vector3::Dot(to_light, to_light);
+	float distance = sqrt(distance_squared);
+	Vector3::MultiplyF(to_light, 1.0f / distance, to_light);
+
+	float cosine = Vector3::Dot(normal, to_light);
+	if (cosine <= 0)
+		return false;
+
+	Vector3::MultiplyF(normal, RAY_OFFSET, output->origin);
+	Vector3::Add(position, output->origin, output->origin);
+	for (int c = 0; c < 3; c++)
+		output->direction[c] = to_light[c];
+	output->max_t = distance;
+
+	float bsdf[3];
+	material.Evaluate(normal, outgoing, to_light, uv, bsdf);
+
+	float scale = cosine / distance_squared / pdf;
+	for (int c = 0; c < 3; c++)
+		output->contribution[c] = throughput[c] * bsdf[c] * light.intensity[c] * scale;
+
+	return true;
+}
+
+void PathTracer::StartPath(float* origin, float* direction, Hit* hit,
+						   PathState* path)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		path->origin[c] = origin[c];
+		path->direction[c] = direction[c];
+		path->throughput[c] = 1;
+		path->radiance[c] = 0;
+	}
+	path->hit = *hit;
+
+	path->cone_width = 0;
+	path->cone_spread = pixel_spread;
+}
+
+void PathTracer::Shade(PreparedScene* scene, float* origin, float* direction,
+					   Hit* hit, RandomSequence* random, float* output_location)
+{
+	PathState path;
+	StartPath(origin, direction, hit, &path);
+
+	for (int depth = 0; depth < max_depth; depth++)
+	{
+		if (!path.hit.hit)
+		{
+			for (int c = 0; c < 3; c++)
+				path.radiance[c] += path.throughput[c] * background[c];
+			break;
+		}
+
+		ShadowRay shadow;
+		bool has_shadow;
+		bool continues = std::visit([&](const auto& material)
+		{
+			return ShadeHit(material, scene, depth, &path, random, &shadow,
+							&has_shadow);
+		}, scene->GetMaterial(path.hit.object_index));
+
+		if (has_shadow &&
+			!scene->IsOccluded(shadow.origin, shadow.direction, shadow.max_t))
+			Vector3::Add(path.radiance, shadow.contribution, path.radiance);
+
+		if (!continues)
+			break;
+
+		path.hit = Hit();
+		scene->Intersect(path.origin, path.direction, &path.hit);
+	}
+
+	for (int c = 0; c < 3; c++)
+		output_location[c] = path.radiance[c] * 255;
+}
+
+void PathTracer::ShadeBatch(PreparedScene* scene, float* origin,
+							float* directions, Hit* hits,
+							RandomSequence* randoms, int count,
+							float* output_locations, FrameArena* arena)
+{
+	float bounds_min[3], bounds_max[3], inverse_extent[3];
+	scene->GetBounds(bounds_min, bounds_max);
+	for (int c = 0; c < 3; c++)
+		inverse_extent[c] = 1.0f / fmax(bounds_max[c] - bounds_min[c], 0.0001f);
+
+	// No queue ever holds more than one entry per path, so each one is given
+	// room for the whole batch and never has to grow.
+	ArenaAllocator<int> allocator(arena);
+	ArenaVector<PathState> paths(count, allocator);
+	ArenaVector<int> active(count, allocator);
+	for (int i = 0; i < count; i++)
+	{
+		StartPath(origin, &directions[i * 3], &hits[i], &paths[i]);
+		active[i] = i;
+	}
+
+	ArenaVector<int> next_active(allocator);
+	ArenaVector<int> groups[std::variant_size_v<Material>];
+	ArenaVector<ShadowRay> shadows(allocator);
+	ArenaVector<std::pair<unsigned int, int>> keys(allocator);
+	next_active.reserve(count);
+	shadows.reserve(count);
+	keys.reserve(count);
+	for (int m = 0; m < std::variant_size_v<Material>; m++)
+	{
+		groups[m] = ArenaVector<int>(allocator);
+		groups[m].reserve(count);
+	}
+
+	for (int depth = 0; depth < max_depth && !active.empty(); depth++)
+	{
+		// Intersection stage.  The camera rays were already traced by the
+		// device, so this starts from the first bounce.
+		if (depth > 0)
+		{
+			keys.resize(active.size());
+			for (int i = 0; i < active.size(); i++)
+			{
+				PathState& path = paths[active[i]];
+				keys[i] = { GetRayKey(path.origin, path.direction, bounds_min,
+									  inverse_extent), active[i] };
+			}
+			std::sort(keys.begin(), keys.end());
+
+			for (int i = 0; i < keys.size(); i++)
+			{
+				PathState& path = paths[keys[i].second];
+				path.hit = Hit();
+				scene->Intersect(path.origin, path.direction, &path.hit);
+			}
+		}
+
+		// Shading stage, which queues up the shadow rays and the bounces.
+		// Hits are grouped by the type of material they hit, and each group
+		// is shaded by the code compiled for that material.
+		next_active.clear();
+		shadows.clear();
+		for (int m = 0; m < std::variant_size_v<Material>; m++)
+			groups[m].clear();
+
+		for (int i = 0; i < active.size(); i++)
+		{
+			PathState& path = paths[active[i]];
+
+			if (!path.hit.hit)
+			{
+				for (int c = 0; c < 3; c++)
+					path.radiance[c] += path.throughput[c] * background[c];
+				continue;
+			}
+
+			groups[scene->GetMaterial(path.hit.object_index).index()].push_back(active[i]);
+		}
+
+		static_assert(std::variant_size_v<Material> == 4,
+					  "Every material needs a ShadeGroup call.");
+		ShadeGroup<DiffuseMaterial>(scene, depth, &groups[0], &paths, randoms,
+									&shadows, &next_active);
+		ShadeGroup<GlossyMaterial>(scene, depth, &groups[1], &paths, randoms,
+								   &shadows, &next_active);
+		ShadeGroup<EmissiveMaterial>(scene, depth, &groups[2], &paths, randoms,
+									 &shadows, &next_active);
+		ShadeGroup<TexturedMaterial>(scene, depth, &groups[3], &paths, randoms,
+									 &shadows, &next_active);
+
+		// Shadow stage.  Only whether something is in the way matters, so the
+		// order the contributions are added in doesn't change the result.
+		keys.resize(shadows.size());
+		for (int i = 0; i < shadows.size(); i++)
+		{
+			keys[i] = { GetRayKey(shadows[i].origin, shadows[i].direction,
+								  bounds_min, inverse_extent), i };
+		}
+		std::sort(keys.begin(), keys.end());
+
+		for (int i = 0; i < keys.size(); i++)
+		{
+			ShadowRay& shadow = shadows[keys[i].second];
+			if (!scene->IsOccluded(shadow.origin, shadow.direction, shadow.max_t))
+			{
+				float* radiance = paths[shadow.path].radiance;
+				Vector3::Add(radiance, shadow.contribution, radiance);
+			}
+		}
+
+		active.swap(next_active);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			output_locations[i * 3 + c] = paths[i].radiance[c] * 255;
+	}
+}
+
+void PathTracer::AddLight(PointLight light)
+{
+	lights.push_back(light);
+	light_tree.Build(&lights);
+}
+
+void PathTracer::SetLights(std::vector<PointLight> _lights)
+{
+	lights = _lights;
+	light_tree.Build(&lights);
+}
+
+int PathTracer::GetNumLights()
+{
+	return lights.size();
+}
+
+void PathTracer::SetBackground(float r, float g, float b)
+{
+	background[0] = r;
+	background[1] = g;
+	background[2] = b;
+}
+
+void PathTracer::SetMaxDepth(int depth)
+{
+	if (depth <= 0)
+		throw std::invalid_argument("The maximum depth must be positive.");
+
+	max_depth = depth;
+}
+
+int PathTracer::GetMaxDepth()
+{
+	return max_depth;
+}
+
+void PathTracer::SetRussianRouletteDepth(int depth)
+{
+	if (depth <= 0)
+		throw std::invalid_argument("The Russian roulette depth must be positive.");
+
+	russian_roulette_depth = depth;
+}
+
+void PathTracer::SetPixelSpread(float angle)
+{
+	if (angle < 0)
+		throw std::invalid_argument("The pixel spread can't be negative.");
+
+	pixel_spread = angle;
+}
+
+void PathTracer::GetCheckpointSettings(RenderCheckpoint* output)
+{
+	// The pixel spread comes from the camera, which is saved already.
+	output->integrator = IntegratorType::PathTracer;
+	output->max_depth = max_depth;
+	output->russian_roulette_depth = russian_roulette_depth;
+	memcpy(output->background, background, sizeof(background));
+	output->lights = lights;
+}
+
+unsigned int PathTracer::GetRayKey(float* origin, float* direction,
+								   float* bounds_min, float* inverse_extent)
+{
+	unsigned int octant = (direction[0] < 0) | (direction[1] < 0) << 1 |
+		(direction[2] < 0) << 2;
+
+	// Each axis of the origin is quantized to 9 bits, and the bits of the
+	// three axes are interleaved.
+	unsigned int morton = 0;
+	for (int c = 0; c < 3; c++)
+	{
+		float f = (origin[c] - bounds_min[c]) * inverse_extent[c];
+		unsigned int q = (unsigned int)fmin(fmax(f * 512, 0.0f), 511.0f);
+
+		for (int bit = 0; bit < 9; bit++)
+			morton |= ((q >> bit) & 1) << (bit * 3 + c);
+	}
+
+	return octant << 27 | morton;
+}
+
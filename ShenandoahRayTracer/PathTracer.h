@@ -0,0 +1,153 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+#include <vector>
+#include "Integrator.h"
+#include "Light.h"
+#include "LightTree.h"
+#include "Material.h"
+
+/** A unidirectional path tracer.
+
+Each path starts from the camera ray's hit and bounces off surfaces according
+to their materials, picking up light in three ways:
+- Next event estimation: at every bounce, a shadow ray is traced towards one
+  light, and its light is added if nothing is in the way.  The light is
+  picked through a LightTree, in proportion to how much it is likely to
+  contribute at that point, so scenes with many lights don't get noisier
+  with every light added.  Point lights can only be found this way.
+- Emission: hitting an emissive surface adds its light and ends the path.
+- Escaping: a path that leaves the scene picks up the background colour,
+  which acts as a uniform sky.
+
+Paths end at the maximum depth, or earlier through Russian roulette, which
+stops dim paths at random and boosts the survivors to keep the estimate
+unbiased.
+
+Paths can be traced one at a time (Shade) or as a wavefront (ShadeBatch).
+A wavefront keeps every path of a batch in a queue, and runs each bounce as
+separate stages over the whole queue: intersection, shading, and tracing
+the shadow rays.  Rays are sorted by direction and origin before each
+trace stage, so that consecutive rays visit the same objects and triangles
+while they are still in the cache.  Hits are grouped by material before
+shading, so each group runs the shading code compiled for its material with
+no per-hit dispatch.  Both give the same result, since each path uses its
+own random numbers in the same order.  The queues of a wavefront are taken
+from the calling thread's frame arena, sized for the whole batch up front,
+so shading a batch never touches the heap.
+
+*/
+class PathTracer : public Integrator
+{
+public:
+	PathTracer();
+
+	void Shade(PreparedScene* scene, float* origin, float* direction, Hit* hit,
+			   RandomSequence* random, float* output_location);
+	void ShadeBatch(PreparedScene* scene, float* origin, float* directions,
+					Hit* hits, RandomSequence* randoms, int count,
+					float* output_locations, FrameArena* arena);
+	void GetCheckpointSettings(RenderCheckpoint* output);
+
+	// Both rebuild the light tree, so scenes with many lights should be set
+	// all at once.
+	void AddLight(PointLight light);
+	void SetLights(std::vector<PointLight> _lights);
+	int GetNumLights();
+
+	// The radiance of rays that escape the scene, in the range 0-1.
+	void SetBackground(float r, float g, float b);
+
+	// The most surfaces a path can bounce off, counting the first hit.  1 gives
+	// direct lighting only.
+	void SetMaxDepth(int depth);
+	int GetMaxDepth();
+
+	// The bounce after which Russian roulette starts ending paths.
+	void SetRussianRouletteDepth(int depth);
+
+	// The angle between neighbouring camera rays, from
+	// Camera::GetPixelSpreadAngle.  Paths carry a cone that starts with this
+	// angle, and its width where it hits a surface picks the mip level of
+	// textures.  0 (the default) always uses the full size textures.
+	void SetPixelSpread(float angle);
+
+	/**
+	* @brief Creates the key rays are sorted by in a wavefront.  The top bits
+	* are the octant of the direction, and the rest are the Morton code of the
+	* origin within the scene bounds, so rays that start close together and
+	* head the same way end up next to each other.
+	*
+	* @param origin The origin of the ray.
+	* @param direction The direction of the ray.
+	* @param bounds_min The minimum corner of the scene.
+	* @param inverse_extent One divided by the size of the scene on each axis.
+	*/
+	static unsigned int GetRayKey(float* origin, float* direction,
+								  float* bounds_min, float* inverse_extent);
+
+private:
+	// A shadow ray towards a light, with the light it carries if it isn't
+	// blocked.
+	struct ShadowRay
+	{
+		float origin[3];
+		float direction[3];
+		float max_t;
+		float contribution[3];
+		int path; // The index of the path in a wavefront.
+	};
+
+	// Everything needed to continue a path.
+	struct PathState
+	{
+		float origin[3];
+		float direction[3];
+		float throughput[3];
+		float radiance[3];
+		Hit hit;
+
+		// The ray cone around the path: its width at the origin, and the
+		// angle it widens by per unit of distance.
+		float cone_width;
+		float cone_spread;
+	};
+
+	std::vector<PointLight> lights;
+	LightTree light_tree;
+	float background[3] = { 0, 0, 0 };
+	int max_depth = 5;
+	int russian_roulette_depth = 3;
+	float pixel_spread = 0;
+
+	// Shades the hit of a path with a specific material: adds its emission,
+	// creates a shadow ray if a light can reach it, and sets up the next
+	// bounce.  Returns false if the path ends here.  Compiled separately for
+	// each material.
+	template <typename M>
+	bool ShadeHit(const M& material, PreparedScene* scene, int depth,
+				  PathState* path, RandomSequence* random, ShadowRay* shadow,
+				  bool* has_shadow);
+
+	// Starts a path from a camera ray and its hit.
+	void StartPath(float* origin, float* direction, Hit* hit, PathState* path);
+
+	// Runs ShadeHit over a group of paths that all hit the given material
+	// type, queueing their shadow rays and the paths that continue.
+	template <typename M>
+	void ShadeGroup(PreparedScene* scene, int depth, ArenaVector<int>* group,
+					ArenaVector<PathState>* paths, RandomSequence* randoms,
+					ArenaVector<ShadowRay>* shadows,
+					ArenaVector<int>* next_active);
+
+	// Creates a shadow ray towards one light picked from the light tree,
+	// carrying that light weighted by the BSDF and path throughput.  Returns false if there
+	// is no light or the light is behind the surface.
+	template <typename M>
+	bool GenerateShadowRay(const M& material, float* position, float* normal,
+						   float* outgoing, float* uv, float* throughput,
+						   RandomSequence* random, ShadowRay* output);
+};
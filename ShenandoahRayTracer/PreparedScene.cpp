@@ -0,0 +1,1356 @@
+#include "PreparedScene.h"
+
+#define EPSILON 0.000001
+
+// The most a quantized vertex can move, as a fraction of the shortest edge of
+// the object.  Any more and small triangles could visibly change shape.
+#define VERTEX_TOLERANCE 0.01f
+// The most a half float UV can be off by.  This is half a texel of a 1024
+// texture, which covers UVs up to 2 in magnitude.
+#define UV_TOLERANCE (1.0f / 2048)
+
+// The triangle that LoadTriangle points at when it decodes into scratch space.
+static int DECODED_TRIANGLE[3] = { 0, 1, 2 };
+
+// Copy the arrays of a cluster to and from its data in the geometry cache.
+template <typename T>
+static void WriteArray(const GeometryArray<T>& input, std::vector<char>* output)
+{
+	size_t start = output->size();
+	output->resize(start + input.size() * sizeof(T));
+	if (!input.empty())
+		memcpy(&output->at(start), input.data(), input.size() * sizeof(T));
+}
+
+// Hashes bytes with 64 bit FNV-1a, continuing from an earlier hash.
+static unsigned long long HashBytes(const void* data, size_t bytes,
+									unsigned long long hash)
+{
+	const unsigned char* input = (const unsigned char*)data;
+	for (size_t i = 0; i < bytes; i++)
+	{
+		hash ^= input[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+template <typename T>
+static unsigned long long HashArray(const GeometryArray<T>& input,
+									unsigned long long hash)
+{
+	size_t length = input.size();
+	hash = HashBytes(&length, sizeof(length), hash);
+	return HashBytes(input.data(), length * sizeof(T), hash);
+}
+
+template <typename T>
+static const char* ReadArray(const char* input, size_t length,
+							 GeometryArray<T>* output)
+{
+	output->resize(length);
+	if (length > 0)
+		memcpy(output->data(), input, length * sizeof(T));
+	return input + length * sizeof(T);
+}
+
+PreparedScene::PreparedScene()
+{
+
+}
+
+PreparedScene::PreparedScene(std::vector<ObjectHandler*>* _objects,
+							 MeshEncoding _encoding,
+							 std::shared_ptr<GeometryCache> _geometry_cache)
+{
+	encoding = _encoding;
+	geometry_cache = _geometry_cache;
+	objects.resize(_objects->size());
+
+	for (int o = 0; o < _objects->size(); o++)
+		PrepareObject(_objects->at(o), &objects[o]);
+}
+
+void PreparedScene::Refit()
+{
+	if (shared_scene)
+		throw std::invalid_argument("A scene attached from shared memory can't be refit.");
+
+	for (int o = 0; o < objects.size(); o++)
+	{
+		PreparedObject& prepared = objects[o];
+		ObjectHandler* source = prepared.object;
+
+		if (source->GetNumVertices() != prepared.num_vertices ||
+			source->GetNumTriangles() != prepared.num_triangles ||
+			source->GetNumUVs() != prepared.num_uvs)
+		{
+			PrepareObject(source, &prepared);
+			continue;
+		}
+
+		// The clusters of a streamed object can't be changed in place, so
+		// they are written out again, but only if the object moved.  The old
+		// ones are never looked up again, and age out of the cache.
+		if (prepared.streamed)
+		{
+			float transform[16];
+			source->transform.GetCompositeMatrix().Copy(transform);
+			if (memcmp(transform, prepared.transform, sizeof(transform)) != 0)
+				PrepareObject(source, &prepared);
+			prepared.material = source->material;
+			continue;
+		}
+
+		// Only the vertices depend on the transform, the triangles and UVs
+		// are left as they are.  Compact vertices are quantized again from
+		// scratch, since the bounds they are relative to have moved.
+		prepared.vertices.resize(prepared.num_vertices * 4);
+		source->CopyAdjustedVertices(prepared.vertices.data());
+		source->transform.GetCompositeMatrix().Copy(prepared.transform);
+		UpdateBounds(&prepared);
+		if (encoding == MeshEncoding::Compact)
+			EncodeVertices(&prepared);
+		prepared.material = source->material;
+	}
+}
+
+SharedMemory PreparedScene::Publish(std::string location)
+{
+	SharedHeader header = {};
+	memcpy(header.magic, "SRSS", 4);
+	header.version = SHARED_VERSION;
+	header.encoding = (int)encoding;
+	header.num_objects = objects.size();
+
+	std::vector<SharedObject> records(objects.size());
+	std::vector<char> data(sizeof(SharedHeader) + sizeof(SharedObject) * objects.size());
+
+	// Pads the data out to where the next array can start.
+	auto align = [&data]()
+	{
+		data.resize((data.size() + SHARED_ALIGNMENT - 1) / SHARED_ALIGNMENT *
+					SHARED_ALIGNMENT);
+		return data.size();
+	};
+
+	for (int o = 0; o < objects.size(); o++)
+	{
+		PreparedObject& object = objects[o];
+		SharedObject& record = records[o];
+
+		if (object.streamed)
+			throw std::invalid_argument("Streamed objects can't be published, since "
+										"their geometry is in the geometry cache.");
+
+		record.geometry.num_vertices = object.num_vertices;
+		record.geometry.num_triangles = object.num_triangles;
+		record.geometry.num_uvs = object.num_uvs;
+		record.geometry.quantized_vertices = object.quantized_vertices;
+		record.geometry.short_indices = object.short_indices;
+		record.geometry.half_uvs = object.half_uvs;
+		for (int k = 0; k < 3; k++)
+		{
+			record.geometry.quantization_origin[k] = object.quantization_origin[k];
+			record.geometry.quantization_scale[k] = object.quantization_scale[k];
+			record.geometry.bounds_min[k] = object.bounds_min[k];
+			record.geometry.bounds_max[k] = object.bounds_max[k];
+		}
+
+		record.geometry.lengths[0] = object.vertices.size();
+		record.offsets[0] = align();
+		WriteArray(object.vertices, &data);
+		record.geometry.lengths[1] = object.triangles.size();
+		record.offsets[1] = align();
+		WriteArray(object.triangles, &data);
+		record.geometry.lengths[2] = object.triangle_uvs.size();
+		record.offsets[2] = align();
+		WriteArray(object.triangle_uvs, &data);
+		record.geometry.lengths[3] = object.uvs.size();
+		record.offsets[3] = align();
+		WriteArray(object.uvs, &data);
+		record.geometry.lengths[4] = object.packed_vertices.size();
+		record.offsets[4] = align();
+		WriteArray(object.packed_vertices, &data);
+		record.geometry.lengths[5] = object.packed_triangles.size();
+		record.offsets[5] = align();
+		WriteArray(object.packed_triangles, &data);
+		record.geometry.lengths[6] = object.packed_triangle_uvs.size();
+		record.offsets[6] = align();
+		WriteArray(object.packed_triangle_uvs, &data);
+		record.geometry.lengths[7] = object.packed_uvs.size();
+		record.offsets[7] = align();
+		WriteArray(object.packed_uvs, &data);
+
+		record.material_type = object.material.index();
+		if (const DiffuseMaterial* diffuse = std::get_if<DiffuseMaterial>(&object.material))
+			memcpy(record.material_values, diffuse->albedo, sizeof(float) * 3);
+		else if (const GlossyMaterial* glossy = std::get_if<GlossyMaterial>(&object.material))
+		{
+			memcpy(record.material_values, glossy->color, sizeof(float) * 3);
+			record.material_values[3] = glossy->exponent;
+		}
+		else if (const EmissiveMaterial* emissive = std::get_if<EmissiveMaterial>(&object.material))
+			memcpy(record.material_values, emissive->radiance, sizeof(float) * 3);
+		else if (const TexturedMaterial* textured = std::get_if<TexturedMaterial>(&object.material))
+		{
+			// Only the location is shared, since the texels are loaded into
+			// each process's own texture cache.
+			std::string texture_location = textured->texture->GetFileLocation();
+			if (texture_location.empty())
+				throw std::invalid_argument("Textures that weren't loaded from a file "
+											"can't be published.");
+
+			record.texture_location_offset = data.size();
+			record.texture_location_length = texture_location.size();
+			data.insert(data.end(), texture_location.begin(), texture_location.end());
+		}
+	}
+
+	memcpy(data.data(), &header, sizeof(SharedHeader));
+	if (!records.empty())
+	{
+		memcpy(data.data() + sizeof(SharedHeader), records.data(),
+			   sizeof(SharedObject) * records.size());
+	}
+
+	return SharedMemory::Create(location, data, sizeof(SharedHeader));
+}
+
+PreparedScene PreparedScene::Attach(std::string location,
+									std::shared_ptr<TextureCache> texture_cache)
+{
+	PreparedScene scene;
+	scene.shared_scene = std::make_shared<SharedMemory>(SharedMemory::Open(location));
+
+	const char* data = scene.shared_scene->GetData();
+	size_t size = scene.shared_scene->GetSize();
+
+	SharedHeader header;
+	if (size < sizeof(SharedHeader))
+		throw std::invalid_argument(location + " is too short to be a published scene.");
+	memcpy(&header, data, sizeof(SharedHeader));
+
+	// Pairs with the fence in SharedMemory::Create, so that once the header
+	// is whole, so is everything after it.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (memcmp(header.magic, "SRSS", 4) != 0)
+		throw std::invalid_argument(location + " isn't a published scene, or is still "
+									"being published.");
+	if (header.version != SHARED_VERSION)
+		throw std::invalid_argument("The scene " + location +
+									" was published by a different version.");
+	if (header.num_objects < 0 ||
+		(size - sizeof(SharedHeader)) / sizeof(SharedObject) < header.num_objects)
+		throw std::invalid_argument("The scene " + location + " is damaged.");
+
+	scene.encoding = (MeshEncoding)header.encoding;
+	scene.objects.resize(header.num_objects);
+
+	// Objects that share a texture share it here as well.
+	std::unordered_map<std::string, std::shared_ptr<const MipmappedTexture>> textures;
+
+	for (int o = 0; o < header.num_objects; o++)
+	{
+		SharedObject record;
+		memcpy(&record, data + sizeof(SharedHeader) + sizeof(SharedObject) * o,
+			   sizeof(SharedObject));
+		PreparedObject& object = scene.objects[o];
+
+		// Only the layout is checked, not the indices within the arrays, so a
+		// published scene has to be trusted like the geometry cache is.
+		bool valid = HasValidLengths(record.geometry);
+		size_t element_sizes[8] = { sizeof(float), sizeof(int), sizeof(int),
+									sizeof(float), sizeof(unsigned short),
+									sizeof(unsigned short), sizeof(unsigned short),
+									sizeof(unsigned short) };
+		for (int i = 0; i < 8; i++)
+		{
+			valid = valid && record.offsets[i] % SHARED_ALIGNMENT == 0 &&
+				record.offsets[i] <= size &&
+				record.geometry.lengths[i] <= (size - record.offsets[i]) / element_sizes[i];
+		}
+		if (!valid)
+			throw std::invalid_argument("The scene " + location + " is damaged.");
+
+		object.num_vertices = record.geometry.num_vertices;
+		object.num_triangles = record.geometry.num_triangles;
+		object.num_uvs = record.geometry.num_uvs;
+		object.quantized_vertices = record.geometry.quantized_vertices;
+		object.short_indices = record.geometry.short_indices;
+		object.half_uvs = record.geometry.half_uvs;
+		for (int k = 0; k < 3; k++)
+		{
+			object.quantization_origin[k] = record.geometry.quantization_origin[k];
+			object.quantization_scale[k] = record.geometry.quantization_scale[k];
+			object.bounds_min[k] = record.geometry.bounds_min[k];
+			object.bounds_max[k] = record.geometry.bounds_max[k];
+		}
+
+		object.vertices.View((const float*)(data + record.offsets[0]),
+							 record.geometry.lengths[0]);
+		object.triangles.View((const int*)(data + record.offsets[1]),
+							  record.geometry.lengths[1]);
+		object.triangle_uvs.View((const int*)(data + record.offsets[2]),
+								 record.geometry.lengths[2]);
+		object.uvs.View((const float*)(data + record.offsets[3]),
+						record.geometry.lengths[3]);
+		object.packed_vertices.View((const unsigned short*)(data + record.offsets[4]),
+									record.geometry.lengths[4]);
+		object.packed_triangles.View((const unsigned short*)(data + record.offsets[5]),
+									 record.geometry.lengths[5]);
+		object.packed_triangle_uvs.View((const unsigned short*)(data + record.offsets[6]),
+										record.geometry.lengths[6]);
+		object.packed_uvs.View((const unsigned short*)(data + record.offsets[7]),
+							   record.geometry.lengths[7]);
+
+		if (record.material_type == 0)
+		{
+			DiffuseMaterial diffuse;
+			memcpy(diffuse.albedo, record.material_values, sizeof(float) * 3);
+			object.material = diffuse;
+		}
+		else if (record.material_type == 1)
+		{
+			GlossyMaterial glossy;
+			memcpy(glossy.color, record.material_values, sizeof(float) * 3);
+			glossy.exponent = record.material_values[3];
+			object.material = glossy;
+		}
+		else if (record.material_type == 2)
+		{
+			EmissiveMaterial emissive;
+			memcpy(emissive.radiance, record.material_values, sizeof(float) * 3);
+			object.material = emissive;
+		}
+		else if (record.material_type == 3)
+		{
+			if (record.texture_location_offset > size ||
+				record.texture_location_length > size - record.texture_location_offset)
+				throw std::invalid_argument("The scene " + location + " is damaged.");
+
+			std::string texture_location(data + record.texture_location_offset,
+										 record.texture_location_length);
+			if (textures.count(texture_location) == 0)
+			{
+				if (!texture_cache)
+					throw std::invalid_argument("The scene " + location +
+												" has textures, but no texture cache.");
+				textures[texture_location] =
+					std::make_shared<const MipmappedTexture>(texture_location,
+															 texture_cache);
+			}
+
+			TexturedMaterial textured;
+			textured.texture = textures[texture_location];
+			object.material = textured;
+		}
+		else
+			throw std::invalid_argument("The scene " + location + " is damaged.");
+	}
+
+	return scene;
+}
+
+bool PreparedScene::IsAttached()
+{
+	return shared_scene != nullptr;
+}
+
+int PreparedScene::GetNumObjects()
+{
+	return objects.size();
+}
+
+PreparedObject* PreparedScene::GetObject(int index)
+{
+	return &objects[index];
+}
+
+const Material& PreparedScene::GetMaterial(int object_index)
+{
+	return objects[object_index].material;
+}
+
+MeshEncoding PreparedScene::GetMeshEncoding()
+{
+	return encoding;
+}
+
+size_t PreparedScene::GetGeometryBytes()
+{
+	size_t bytes = 0;
+	for (int o = 0; o < objects.size(); o++)
+	{
+		PreparedObject& object = objects[o];
+		bytes += object.vertices.size() * sizeof(float) +
+			object.triangles.size() * sizeof(int) +
+			object.triangle_uvs.size() * sizeof(int) +
+			object.uvs.size() * sizeof(float) +
+			(object.packed_vertices.size() + object.packed_triangles.size() +
+			 object.packed_triangle_uvs.size() + object.packed_uvs.size()) *
+			sizeof(unsigned short);
+	}
+	return bytes;
+}
+
+unsigned long long PreparedScene::GetHash()
+{
+	unsigned long long hash = HashBytes(&encoding, sizeof(encoding), 0xCBF29CE484222325ull);
+	for (int o = 0; o < objects.size(); o++)
+	{
+		PreparedObject& object = objects[o];
+		int counts[3] = { object.num_vertices, object.num_triangles, object.num_uvs };
+		hash = HashBytes(counts, sizeof(counts), hash);
+
+		// A streamed object's prepared geometry is only in the geometry
+		// cache, so it is hashed by what it was prepared from instead.
+		if (object.streamed)
+		{
+			size_t source_hash = object.object->GetGeometryHash();
+			hash = HashBytes(&source_hash, sizeof(source_hash), hash);
+			hash = HashBytes(object.transform, sizeof(object.transform), hash);
+		}
+		else
+		{
+			bool flags[3] = { object.quantized_vertices, object.short_indices,
+							  object.half_uvs };
+			hash = HashBytes(flags, sizeof(flags), hash);
+			hash = HashBytes(object.quantization_origin, sizeof(float) * 3, hash);
+			hash = HashBytes(object.quantization_scale, sizeof(float) * 3, hash);
+			hash = HashArray(object.vertices, hash);
+			hash = HashArray(object.triangles, hash);
+			hash = HashArray(object.triangle_uvs, hash);
+			hash = HashArray(object.uvs, hash);
+			hash = HashArray(object.packed_vertices, hash);
+			hash = HashArray(object.packed_triangles, hash);
+			hash = HashArray(object.packed_triangle_uvs, hash);
+			hash = HashArray(object.packed_uvs, hash);
+		}
+
+		size_t material_type = object.material.index();
+		hash = HashBytes(&material_type, sizeof(material_type), hash);
+		if (const DiffuseMaterial* diffuse = std::get_if<DiffuseMaterial>(&object.material))
+			hash = HashBytes(diffuse->albedo, sizeof(diffuse->albedo), hash);
+		else if (const GlossyMaterial* glossy = std::get_if<GlossyMaterial>(&object.material))
+		{
+			hash = HashBytes(glossy->color, sizeof(glossy->color), hash);
+			hash = HashBytes(&glossy->exponent, sizeof(glossy->exponent), hash);
+		}
+		else if (const EmissiveMaterial* emissive = std::get_if<EmissiveMaterial>(&object.material))
+			hash = HashBytes(emissive->radiance, sizeof(emissive->radiance), hash);
+		else if (const TexturedMaterial* textured = std::get_if<TexturedMaterial>(&object.material))
+		{
+			std::string texture_location = textured->texture->GetFileLocation();
+			hash = HashBytes(texture_location.data(), texture_location.size(), hash);
+		}
+	}
+	return hash;
+}
+
+void PreparedScene::GetBounds(float* bounds_min, float* bounds_max)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		bounds_min[c] = objects.empty() ? 0 : INFINITY;
+		bounds_max[c] = objects.empty() ? 0 : -INFINITY;
+	}
+
+	for (int o = 0; o < objects.size(); o++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			bounds_min[c] = fmin(bounds_min[c], objects[o].bounds_min[c]);
+			bounds_max[c] = fmax(bounds_max[c], objects[o].bounds_max[c]);
+		}
+	}
+}
+
+void PreparedScene::Intersect(float* origin, float* direction, Hit* output)
+{
+	float inverse_direction[3] = { 1.0f / direction[0], 1.0f / direction[1],
+								   1.0f / direction[2] };
+
+	for (int o = 0; o < objects.size(); o++)
+	{
+		PreparedObject& object = objects[o];
+
+		output->nodes_visited++;
+		if (!IntersectBounds(origin, inverse_direction, object.bounds_min,
+							 object.bounds_max, output->hit ? output->t : INFINITY))
+			continue;
+
+		if (!object.streamed)
+		{
+			output->triangles_tested += object.num_triangles;
+			IntersectMesh(object, 0, o, origin, direction, output);
+			continue;
+		}
+
+		// Clusters are only loaded once the ray reaches their own bounds.
+		for (int c = 0; c < object.clusters.size(); c++)
+		{
+			StreamedCluster& cluster = object.clusters[c];
+
+			output->nodes_visited++;
+			if (!IntersectBounds(origin, inverse_direction, cluster.bounds_min,
+								 cluster.bounds_max, output->hit ? output->t : INFINITY))
+				continue;
+
+			output->triangles_tested += cluster.num_triangles;
+			std::shared_ptr<PreparedObject> mesh = LoadCluster(object, c);
+			IntersectMesh(*mesh, cluster.first_triangle * 3, o, origin, direction,
+						  output);
+		}
+	}
+}
+
+void PreparedScene::IntersectPacket(float* origin, float* directions,
+									int num_rays, Hit* outputs)
+{
+	float inverse_directions[MAX_PACKET_SIZE * 3];
+	bool active[MAX_PACKET_SIZE];
+	bool cluster_active[MAX_PACKET_SIZE];
+
+	for (int first = 0; first < num_rays; first += MAX_PACKET_SIZE)
+	{
+		int count = fmin(MAX_PACKET_SIZE, num_rays - first);
+		float* packet_directions = &directions[first * 3];
+		Hit* packet_outputs = &outputs[first];
+
+		for (int r = 0; r < count * 3; r++)
+			inverse_directions[r] = 1.0f / packet_directions[r];
+
+		for (int o = 0; o < objects.size(); o++)
+		{
+			PreparedObject& object = objects[o];
+
+			// Each ray is culled on its own, so a ray that already has a closer
+			// hit skips the object even if the rest of the packet doesn't.
+			int num_active = 0;
+			for (int r = 0; r < count; r++)
+			{
+				Hit* output = &packet_outputs[r];
+
+				output->nodes_visited++;
+				active[r] = IntersectBounds(origin, &inverse_directions[r * 3],
+											object.bounds_min, object.bounds_max,
+											output->hit ? output->t : INFINITY);
+				if (active[r])
+				{
+					if (!object.streamed)
+						output->triangles_tested += object.num_triangles;
+					num_active++;
+				}
+			}
+
+			if (num_active == 0)
+				continue;
+
+			if (!object.streamed)
+			{
+				IntersectMeshPacket(object, 0, o, origin, packet_directions, count,
+									active, packet_outputs);
+				continue;
+			}
+
+			// A cluster is loaded once for every ray of the packet that reaches
+			// it, which is where keeping rays coherent pays off.
+			for (int c = 0; c < object.clusters.size(); c++)
+			{
+				StreamedCluster& cluster = object.clusters[c];
+
+				int num_cluster_active = 0;
+				for (int r = 0; r < count; r++)
+				{
+					cluster_active[r] = false;
+					if (!active[r])
+						continue;
+
+					Hit* output = &packet_outputs[r];
+
+					output->nodes_visited++;
+					cluster_active[r] = IntersectBounds(origin, &inverse_directions[r * 3],
+														cluster.bounds_min,
+														cluster.bounds_max,
+														output->hit ? output->t : INFINITY);
+					if (cluster_active[r])
+					{
+						output->triangles_tested += cluster.num_triangles;
+						num_cluster_active++;
+					}
+				}
+
+				if (num_cluster_active == 0)
+					continue;
+
+				std::shared_ptr<PreparedObject> mesh = LoadCluster(object, c);
+				IntersectMeshPacket(*mesh, cluster.first_triangle * 3, o, origin,
+									packet_directions, count, cluster_active,
+									packet_outputs);
+			}
+		}
+	}
+}
+
+bool PreparedScene::IsOccluded(float* origin, float* direction, float max_t)
+{
+	float inverse_direction[3] = { 1.0f / direction[0], 1.0f / direction[1],
+								   1.0f / direction[2] };
+
+	for (int o = 0; o < objects.size(); o++)
+	{
+		PreparedObject& object = objects[o];
+
+		if (!IntersectBounds(origin, inverse_direction, object.bounds_min,
+							 object.bounds_max, max_t))
+			continue;
+
+		if (!object.streamed)
+		{
+			if (IsMeshOccluded(object, origin, direction, max_t))
+				return true;
+			continue;
+		}
+
+		for (int c = 0; c < object.clusters.size(); c++)
+		{
+			StreamedCluster& cluster = object.clusters[c];
+
+			if (!IntersectBounds(origin, inverse_direction, cluster.bounds_min,
+								 cluster.bounds_max, max_t))
+				continue;
+
+			std::shared_ptr<PreparedObject> mesh = LoadCluster(object, c);
+			if (IsMeshOccluded(*mesh, origin, direction, max_t))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void PreparedScene::GetHitNormal(Hit* hit, float* direction,
+								 float* output_location)
+{
+	std::shared_ptr<PreparedObject> holder;
+	int f;
+	PreparedObject& mesh = GetHitMesh(hit, &holder, &f);
+
+	float scratch[12];
+	float* vertices;
+	int* triangle;
+	LoadTriangle(mesh, f, scratch, &vertices, &triangle);
+
+	float edge1[3], edge2[3];
+	Vector3::Subtract(&vertices[triangle[1] * 4], &vertices[triangle[0] * 4], edge1);
+	Vector3::Subtract(&vertices[triangle[2] * 4], &vertices[triangle[0] * 4], edge2);
+	Vector3::Cross(edge1, edge2, output_location);
+	Vector3::Normalize(output_location, output_location);
+
+	if (Vector3::Dot(output_location, direction) > 0)
+		Vector3::MultiplyF(output_location, -1, output_location);
+}
+
+void PreparedScene::GetHitUV(Hit* hit, float* output_location)
+{
+	if (objects[hit->object_index].num_uvs == 0)
+	{
+		output_location[0] = hit->u;
+		output_location[1] = hit->v;
+		return;
+	}
+
+	std::shared_ptr<PreparedObject> holder;
+	int f;
+	PreparedObject& mesh = GetHitMesh(hit, &holder, &f);
+
+	float corner_uvs[6];
+	LoadTriangleUVs(mesh, f, corner_uvs);
+	float* a_uvs = &corner_uvs[0];
+	float* b_uvs = &corner_uvs[2];
+	float* c_uvs = &corner_uvs[4];
+
+	// Now we create the u and v vectors within the texture plane, by
+	// subtracting the UV coordinates of A-B and A-C
+	float ab[2], ac[2];
+	Vector2::Subtract(b_uvs, a_uvs, ab);
+	Vector2::Subtract(c_uvs, a_uvs, ac);
+
+	// Now that we have these vectors, we can compute the final vector
+	// for the texture coordinate
+	Vector2::MultiplyF(ab, hit->u, ab);
+	Vector2::MultiplyF(ac, hit->v, ac);
+
+	// Same as writing A + ab(u) + ac(v)
+	Vector2::Add(a_uvs, ab, output_location);
+	Vector2::Add(output_location, ac, output_location);
+}
+
+float PreparedScene::GetHitUVDensity(Hit* hit)
+{
+	std::shared_ptr<PreparedObject> holder;
+	int f;
+	PreparedObject& mesh = GetHitMesh(hit, &holder, &f);
+
+	float scratch[12];
+	float* vertices;
+	int* triangle;
+	LoadTriangle(mesh, f, scratch, &vertices, &triangle);
+
+	float edge1[3], edge2[3], cross[3];
+	Vector3::Subtract(&vertices[triangle[1] * 4], &vertices[triangle[0] * 4], edge1);
+	Vector3::Subtract(&vertices[triangle[2] * 4], &vertices[triangle[0] * 4], edge2);
+	Vector3::Cross(edge1, edge2, cross);
+	float world_area = sqrt(Vector3::Dot(cross, cross));
+
+	// Without UVs the barycentric coordinates are used, which always span
+	// half of the unit square.  Both areas are left doubled.
+	float uv_area = 1;
+	if (mesh.num_uvs != 0)
+	{
+		float corner_uvs[6];
+		LoadTriangleUVs(mesh, f, corner_uvs);
+		float* a_uvs = &corner_uvs[0];
+		float* b_uvs = &corner_uvs[2];
+		float* c_uvs = &corner_uvs[4];
+
+		uv_area = fabs((b_uvs[0] - a_uvs[0]) * (c_uvs[1] - a_uvs[1]) -
+					   (c_uvs[0] - a_uvs[0]) * (b_uvs[1] - a_uvs[1]));
+	}
+
+	if (world_area <= 0)
+		return 0;
+
+	return sqrt(uv_area / world_area);
+}
+
+void PreparedScene::GetRayHit(float* origin, float* direction, float* vertices,
+							  int* triangle, Hit* output)
+{
+	output->hit = false;
+	float edge1[3], edge2[3], tvec[3], pvec[3], qvec[3];
+	float det, inv_det;
+
+	Vector3::Subtract(&vertices[triangle[1] * 4], &vertices[triangle[0] * 4], edge1);
+	Vector3::Subtract(&vertices[triangle[2] * 4], &vertices[triangle[0] * 4], edge2);
+
+	Vector3::Cross(direction, edge2, pvec);
+
+	det = Vector3::Dot(edge1, pvec);
+
+	if (det > -EPSILON && det < EPSILON)
+		return;
+
+	inv_det = 1.0f / det;
+
+	Vector3::Subtract(origin, &vertices[triangle[0] * 4], tvec);
+
+	output->u = Vector3::Dot(tvec, pvec) * inv_det;
+
+	if (output->u < 0.0 || output->u > 1.0)
+		return;
+
+	Vector3::Cross(tvec, edge1, qvec);
+
+	output->v = Vector3::Dot(direction, qvec) * inv_det;
+
+	if (output->v < 0.0 || (double)output->u + (double)output->v > 1.0)
+		return;
+
+	output->t = Vector3::Dot(edge2, qvec) * inv_det;
+
+	// Triangles behind the origin of the ray aren't hits.
+	if (output->t < EPSILON)
+		return;
+
+	output->hit = true;
+}
+
+void PreparedScene::PrepareObject(ObjectHandler* source, PreparedObject* prepared)
+{
+	prepared->object = source;
+	prepared->num_vertices = source->GetNumVertices();
+	prepared->num_triangles = source->GetNumTriangles();
+	prepared->num_uvs = source->GetNumUVs();
+
+	prepared->vertices.resize(prepared->num_vertices * 4);
+	prepared->triangles.resize(prepared->num_triangles * 3);
+	prepared->triangle_uvs.resize(prepared->num_triangles * 3);
+	prepared->uvs.resize(prepared->num_uvs * 2);
+
+	source->CopyAdjustedVertices(prepared->vertices.data());
+	source->transform.GetCompositeMatrix().Copy(prepared->transform);
+	source->CopyTriangles(prepared->triangles.data());
+	source->CopyTriangleUVs(prepared->triangle_uvs.data());
+	source->CopyUVs(prepared->uvs.data());
+	prepared->material = source->material;
+
+	UpdateBounds(prepared);
+
+	prepared->quantized_vertices = false;
+	prepared->short_indices = false;
+	prepared->half_uvs = false;
+	prepared->packed_vertices.clear();
+	prepared->packed_triangles.clear();
+	prepared->packed_triangle_uvs.clear();
+	prepared->packed_uvs.clear();
+
+	std::vector<StreamedCluster> old_clusters;
+	old_clusters.swap(prepared->clusters);
+	prepared->streamed = false;
+
+	// Streamed objects are encoded one cluster at a time instead, so that
+	// each cluster is quantized within its own bounds.
+	if (geometry_cache)
+	{
+		StreamObject(prepared, &old_clusters);
+		return;
+	}
+
+	// The vertices are encoded first, since finding their precision needs
+	// the triangles.
+	if (encoding == MeshEncoding::Compact)
+	{
+		EncodeVertices(prepared);
+		EncodeIndices(prepared);
+		EncodeUVs(prepared);
+	}
+}
+
+void PreparedScene::StreamObject(PreparedObject* prepared,
+								 std::vector<StreamedCluster>* old_clusters)
+{
+	// The object's bounds become those of its clusters, which can be a hair
+	// larger than the exact ones if the clusters are compact.
+	for (int k = 0; k < 3; k++)
+	{
+		prepared->bounds_min[k] = INFINITY;
+		prepared->bounds_max[k] = -INFINITY;
+	}
+
+	for (int first = 0; first < prepared->num_triangles; first += STREAM_CLUSTER_SIZE)
+	{
+		PreparedObject cluster;
+		cluster.object = prepared->object;
+		cluster.num_triangles = fmin(STREAM_CLUSTER_SIZE,
+									 prepared->num_triangles - first);
+
+		// Only the vertices and UVs the cluster uses are copied, numbered in
+		// the order its triangles first use them.
+		std::unordered_map<int, int> vertex_indices;
+		std::unordered_map<int, int> uv_indices;
+		for (int i = first * 3; i < (first + cluster.num_triangles) * 3; i++)
+		{
+			int vertex = prepared->triangles[i];
+			auto found = vertex_indices.emplace(vertex, (int)vertex_indices.size());
+			if (found.second)
+			{
+				cluster.vertices.append(&prepared->vertices[vertex * 4],
+										&prepared->vertices[vertex * 4 + 4]);
+			}
+			cluster.triangles.push_back(found.first->second);
+
+			if (prepared->num_uvs == 0)
+			{
+				cluster.triangle_uvs.push_back(0);
+				continue;
+			}
+
+			int uv = prepared->triangle_uvs[i];
+			found = uv_indices.emplace(uv, (int)uv_indices.size());
+			if (found.second)
+			{
+				cluster.uvs.append(&prepared->uvs[uv * 2], &prepared->uvs[uv * 2 + 2]);
+			}
+			cluster.triangle_uvs.push_back(found.first->second);
+		}
+		cluster.num_vertices = vertex_indices.size();
+		cluster.num_uvs = uv_indices.size();
+
+		UpdateBounds(&cluster);
+		cluster.quantized_vertices = false;
+		cluster.short_indices = false;
+		cluster.half_uvs = false;
+		if (encoding == MeshEncoding::Compact)
+		{
+			EncodeVertices(&cluster);
+			EncodeIndices(&cluster);
+			EncodeUVs(&cluster);
+		}
+
+		ClusterHeader header;
+		memset(&header, 0, sizeof(header));
+		header.num_vertices = cluster.num_vertices;
+		header.num_triangles = cluster.num_triangles;
+		header.num_uvs = cluster.num_uvs;
+		header.quantized_vertices = cluster.quantized_vertices;
+		header.short_indices = cluster.short_indices;
+		header.half_uvs = cluster.half_uvs;
+		for (int k = 0; k < 3; k++)
+		{
+			header.quantization_origin[k] = cluster.quantization_origin[k];
+			header.quantization_scale[k] = cluster.quantization_scale[k];
+			header.bounds_min[k] = cluster.bounds_min[k];
+			header.bounds_max[k] = cluster.bounds_max[k];
+		}
+		header.lengths[0] = cluster.vertices.size();
+		header.lengths[1] = cluster.triangles.size();
+		header.lengths[2] = cluster.triangle_uvs.size();
+		header.lengths[3] = cluster.uvs.size();
+		header.lengths[4] = cluster.packed_vertices.size();
+		header.lengths[5] = cluster.packed_triangles.size();
+		header.lengths[6] = cluster.packed_triangle_uvs.size();
+		header.lengths[7] = cluster.packed_uvs.size();
+
+		std::vector<char> data(sizeof(header));
+		memcpy(data.data(), &header, sizeof(header));
+		WriteArray(cluster.vertices, &data);
+		WriteArray(cluster.triangles, &data);
+		WriteArray(cluster.triangle_uvs, &data);
+		WriteArray(cluster.uvs, &data);
+		WriteArray(cluster.packed_vertices, &data);
+		WriteArray(cluster.packed_triangles, &data);
+		WriteArray(cluster.packed_triangle_uvs, &data);
+		WriteArray(cluster.packed_uvs, &data);
+
+		// A cluster gets a new key even when it goes back in its old space,
+		// so the old one can't be found in memory under it.
+		StreamedCluster streamed;
+		streamed.key = geometry_cache->CreateKey();
+		streamed.bytes = data.size();
+
+		int index = prepared->clusters.size();
+		if (index < old_clusters->size() &&
+			old_clusters->at(index).bytes == data.size() &&
+			old_clusters->at(index).file_space.use_count() == 1)
+		{
+			streamed.offset = old_clusters->at(index).offset;
+			streamed.file_space = old_clusters->at(index).file_space;
+			geometry_cache->Rewrite(streamed.offset, data.data(), data.size());
+		}
+		else
+		{
+			streamed.offset = geometry_cache->Write(data.data(), data.size());
+			streamed.file_space = std::make_shared<bool>(true);
+		}
+		streamed.first_triangle = first;
+		streamed.num_triangles = cluster.num_triangles;
+		for (int k = 0; k < 3; k++)
+		{
+			streamed.bounds_min[k] = cluster.bounds_min[k];
+			streamed.bounds_max[k] = cluster.bounds_max[k];
+			prepared->bounds_min[k] = fmin(prepared->bounds_min[k], cluster.bounds_min[k]);
+			prepared->bounds_max[k] = fmax(prepared->bounds_max[k], cluster.bounds_max[k]);
+		}
+		prepared->clusters.push_back(streamed);
+	}
+
+	prepared->vertices = GeometryArray<float>();
+	prepared->triangles = GeometryArray<int>();
+	prepared->triangle_uvs = GeometryArray<int>();
+	prepared->uvs = GeometryArray<float>();
+	prepared->streamed = true;
+}
+
+bool PreparedScene::HasValidLengths(const ClusterHeader& header)
+{
+	if (header.num_vertices < 0 || header.num_triangles < 0 || header.num_uvs < 0)
+		return false;
+
+	size_t vertices = header.num_vertices;
+	size_t indices = (size_t)header.num_triangles * 3;
+	size_t uvs = (size_t)header.num_uvs * 2;
+
+	// Triangle UVs are dropped from the compact encoding of objects without
+	// UVs, but kept in the exact one.
+	bool vertices_valid = header.quantized_vertices ?
+		header.lengths[0] == 0 && header.lengths[4] == vertices * 3 :
+		header.lengths[0] == vertices * 4 && header.lengths[4] == 0;
+	bool indices_valid = header.short_indices ?
+		header.lengths[1] == 0 && header.lengths[5] == indices &&
+		header.lengths[2] == 0 && header.lengths[6] == (uvs > 0 ? indices : 0) :
+		header.lengths[1] == indices && header.lengths[5] == 0 &&
+		header.lengths[2] == indices && header.lengths[6] == 0;
+	bool uvs_valid = header.half_uvs ?
+		header.lengths[3] == 0 && header.lengths[7] == uvs :
+		header.lengths[3] == uvs && header.lengths[7] == 0;
+
+	return vertices_valid && indices_valid && uvs_valid;
+}
+
+std::shared_ptr<PreparedObject> PreparedScene::LoadCluster(PreparedObject& object,
+														   int cluster_index)
+{
+	StreamedCluster& cluster = object.clusters[cluster_index];
+
+	std::shared_ptr<PreparedObject> loaded = geometry_cache->Find(cluster.key);
+	if (loaded)
+		return loaded;
+
+	std::vector<char> data(cluster.bytes);
+	geometry_cache->Read(cluster.offset, data.data(), data.size());
+
+	ClusterHeader header;
+	memcpy(&header, data.data(), sizeof(header));
+
+	loaded = std::make_shared<PreparedObject>();
+	loaded->object = object.object;
+	loaded->num_vertices = header.num_vertices;
+	loaded->num_triangles = header.num_triangles;
+	loaded->num_uvs = header.num_uvs;
+	loaded->quantized_vertices = header.quantized_vertices;
+	loaded->short_indices = header.short_indices;
+	loaded->half_uvs = header.half_uvs;
+	for (int k = 0; k < 3; k++)
+	{
+		loaded->quantization_origin[k] = header.quantization_origin[k];
+		loaded->quantization_scale[k] = header.quantization_scale[k];
+		loaded->bounds_min[k] = header.bounds_min[k];
+		loaded->bounds_max[k] = header.bounds_max[k];
+	}
+
+	const char* position = data.data() + sizeof(header);
+	position = ReadArray(position, header.lengths[0], &loaded->vertices);
+	position = ReadArray(position, header.lengths[1], &loaded->triangles);
+	position = ReadArray(position, header.lengths[2], &loaded->triangle_uvs);
+	position = ReadArray(position, header.lengths[3], &loaded->uvs);
+	position = ReadArray(position, header.lengths[4], &loaded->packed_vertices);
+	position = ReadArray(position, header.lengths[5], &loaded->packed_triangles);
+	position = ReadArray(position, header.lengths[6], &loaded->packed_triangle_uvs);
+	ReadArray(position, header.lengths[7], &loaded->packed_uvs);
+
+	return geometry_cache->Insert(cluster.key, loaded, cluster.bytes);
+}
+
+PreparedObject& PreparedScene::GetHitMesh(Hit* hit,
+										  std::shared_ptr<PreparedObject>* holder,
+										  int* f)
+{
+	PreparedObject& object = objects[hit->object_index];
+	if (!object.streamed)
+	{
+		*f = hit->triangle_index;
+		return object;
+	}
+
+	// Every cluster but the last has the same number of triangles.
+	int cluster_index = hit->triangle_index / 3 / STREAM_CLUSTER_SIZE;
+	*holder = LoadCluster(object, cluster_index);
+	*f = hit->triangle_index - object.clusters[cluster_index].first_triangle * 3;
+	return **holder;
+}
+
+void PreparedScene::IntersectMesh(PreparedObject& mesh, int triangle_offset,
+								  int object_index, float* origin,
+								  float* direction, Hit* output)
+{
+	Hit current_hit;
+	float scratch[12];
+	float* vertices;
+	int* triangle;
+
+	for (int f = 0; f < mesh.num_triangles * 3; f += 3)
+	{
+		LoadTriangle(mesh, f, scratch, &vertices, &triangle);
+		GetRayHit(origin, direction, vertices, triangle, &current_hit);
+
+		if (current_hit.hit && current_hit.IsGreater(*output))
+		{
+			output->hit = true;
+			output->t = current_hit.t;
+			output->u = current_hit.u;
+			output->v = current_hit.v;
+			output->object = mesh.object;
+			output->object_index = object_index;
+			output->triangle_index = triangle_offset + f;
+		}
+	}
+}
+
+void PreparedScene::IntersectMeshPacket(PreparedObject& mesh, int triangle_offset,
+										int object_index, float* origin,
+										float* directions, int count,
+										bool* active, Hit* outputs)
+{
+	Hit current_hit;
+	float scratch[12];
+	float* vertices;
+	int* triangle;
+
+	for (int f = 0; f < mesh.num_triangles * 3; f += 3)
+	{
+		// Compact triangles are decoded once for the whole packet.
+		LoadTriangle(mesh, f, scratch, &vertices, &triangle);
+
+		for (int r = 0; r < count; r++)
+		{
+			if (!active[r])
+				continue;
+
+			Hit* output = &outputs[r];
+			GetRayHit(origin, &directions[r * 3], vertices, triangle, &current_hit);
+
+			if (current_hit.hit && current_hit.IsGreater(*output))
+			{
+				output->hit = true;
+				output->t = current_hit.t;
+				output->u = current_hit.u;
+				output->v = current_hit.v;
+				output->object = mesh.object;
+				output->object_index = object_index;
+				output->triangle_index = triangle_offset + f;
+			}
+		}
+	}
+}
+
+bool PreparedScene::IsMeshOccluded(PreparedObject& mesh, float* origin,
+								   float* direction, float max_t)
+{
+	Hit current_hit;
+	float scratch[12];
+	float* vertices;
+	int* triangle;
+
+	for (int f = 0; f < mesh.num_triangles * 3; f += 3)
+	{
+		LoadTriangle(mesh, f, scratch, &vertices, &triangle);
+		GetRayHit(origin, direction, vertices, triangle, &current_hit);
+
+		if (current_hit.hit && current_hit.t < max_t)
+			return true;
+	}
+
+	return false;
+}
+
+void PreparedScene::UpdateBounds(PreparedObject* prepared)
+{
+	// An empty object gets an inverted box so that nothing ever hits it.
+	for (int k = 0; k < 3; k++)
+	{
+		prepared->bounds_min[k] = INFINITY;
+		prepared->bounds_max[k] = -INFINITY;
+	}
+
+	for (int i = 0; i < prepared->num_vertices * 4; i += 4)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			prepared->bounds_min[k] = fmin(prepared->bounds_min[k],
+										   prepared->vertices[i + k]);
+			prepared->bounds_max[k] = fmax(prepared->bounds_max[k],
+										   prepared->vertices[i + k]);
+		}
+	}
+}
+
+void PreparedScene::EncodeVertices(PreparedObject* prepared)
+{
+	prepared->quantized_vertices = false;
+	prepared->packed_vertices.clear();
+	if (prepared->num_vertices == 0)
+		return;
+
+	// The worst a vertex can move is half a step along each axis.
+	float step_squared = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		prepared->quantization_origin[k] = prepared->bounds_min[k];
+		prepared->quantization_scale[k] = (prepared->bounds_max[k] -
+										   prepared->bounds_min[k]) / 65535;
+		step_squared += prepared->quantization_scale[k] *
+			prepared->quantization_scale[k];
+	}
+	float max_error = 0.5f * sqrt(step_squared);
+
+	float shortest_squared = INFINITY;
+	for (int f = 0; f < prepared->num_triangles * 3; f += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			int a = GetVertexIndex(*prepared, f, k);
+			int b = GetVertexIndex(*prepared, f, (k + 1) % 3);
+			float edge[3];
+			Vector3::Subtract(&prepared->vertices[a * 4], &prepared->vertices[b * 4],
+							  edge);
+
+			float length_squared = Vector3::Dot(edge, edge);
+			if (length_squared > 0)
+				shortest_squared = fmin(shortest_squared, length_squared);
+		}
+	}
+
+	if (!std::isfinite(max_error) ||
+		max_error > VERTEX_TOLERANCE * sqrt(shortest_squared))
+		return;
+
+	prepared->packed_vertices.resize(prepared->num_vertices * 3);
+	for (int i = 0; i < prepared->num_vertices; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			float scale = prepared->quantization_scale[k];
+			float offset = prepared->vertices[i * 4 + k] - prepared->quantization_origin[k];
+			float q = scale > 0 ? round(offset / scale) : 0;
+			prepared->packed_vertices[i * 3 + k] = (unsigned short)fmin(fmax(q, 0.0f), 65535.0f);
+		}
+	}
+
+	prepared->quantized_vertices = true;
+	prepared->vertices = GeometryArray<float>();
+
+	// The bounds are taken from the decoded vertices, since rounding can put
+	// them a hair outside the exact ones.
+	for (int k = 0; k < 3; k++)
+	{
+		prepared->bounds_min[k] = INFINITY;
+		prepared->bounds_max[k] = -INFINITY;
+	}
+	for (int i = 0; i < prepared->num_vertices; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			float value = prepared->quantization_origin[k] +
+				prepared->packed_vertices[i * 3 + k] * prepared->quantization_scale[k];
+			prepared->bounds_min[k] = fmin(prepared->bounds_min[k], value);
+			prepared->bounds_max[k] = fmax(prepared->bounds_max[k], value);
+		}
+	}
+}
+
+void PreparedScene::EncodeIndices(PreparedObject* prepared)
+{
+	int num_indices = prepared->num_triangles * 3;
+
+	// Indices that don't fit would be wrapped around, so the whole object
+	// stays exact if any are out of range.
+	for (int i = 0; i < num_indices; i++)
+	{
+		if (prepared->triangles[i] < 0 || prepared->triangles[i] > 65535)
+			return;
+		if (prepared->num_uvs > 0 &&
+			(prepared->triangle_uvs[i] < 0 || prepared->triangle_uvs[i] > 65535))
+			return;
+	}
+
+	prepared->packed_triangles.assign(prepared->triangles.begin(),
+									  prepared->triangles.end());
+	prepared->triangles = GeometryArray<int>();
+
+	// Triangle UVs are never read without UVs, so they aren't kept at all.
+	if (prepared->num_uvs > 0)
+	{
+		prepared->packed_triangle_uvs.assign(prepared->triangle_uvs.begin(),
+											 prepared->triangle_uvs.end());
+	}
+	prepared->triangle_uvs = GeometryArray<int>();
+
+	prepared->short_indices = true;
+}
+
+void PreparedScene::EncodeUVs(PreparedObject* prepared)
+{
+	std::vector<unsigned short> packed(prepared->num_uvs * 2);
+	for (int i = 0; i < prepared->num_uvs * 2; i++)
+	{
+		float uv = prepared->uvs[i];
+		packed[i] = HalfFloat::FromFloat(uv);
+
+		if (!(fabs(HalfFloat::ToFloat(packed[i]) - uv) <= UV_TOLERANCE))
+			return;
+	}
+
+	prepared->packed_uvs = std::move(packed);
+	prepared->uvs = GeometryArray<float>();
+	prepared->half_uvs = true;
+}
+
+int PreparedScene::GetVertexIndex(PreparedObject& object, int f, int corner)
+{
+	if (object.short_indices)
+		return object.packed_triangles[f + corner];
+	return object.triangles[f + corner];
+}
+
+void PreparedScene::LoadTriangle(PreparedObject& object, int f, float* scratch,
+								 float** vertices, int** triangle)
+{
+	if (!object.quantized_vertices && !object.short_indices)
+	{
+		*vertices = object.vertices.data();
+		*triangle = &object.triangles[f];
+		return;
+	}
+
+	for (int k = 0; k < 3; k++)
+	{
+		int index = GetVertexIndex(object, f, k);
+
+		if (object.quantized_vertices)
+		{
+			unsigned short* packed = &object.packed_vertices[index * 3];
+			for (int c = 0; c < 3; c++)
+			{
+				scratch[k * 4 + c] = object.quantization_origin[c] +
+					packed[c] * object.quantization_scale[c];
+			}
+		}
+		else
+		{
+			for (int c = 0; c < 3; c++)
+				scratch[k * 4 + c] = object.vertices[index * 4 + c];
+		}
+		scratch[k * 4 + 3] = 1;
+	}
+
+	*vertices = scratch;
+	*triangle = DECODED_TRIANGLE;
+}
+
+void PreparedScene::LoadTriangleUVs(PreparedObject& object, int f, float* output)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		int index = object.short_indices ? object.packed_triangle_uvs[f + k] :
+			object.triangle_uvs[f + k];
+
+		for (int c = 0; c < 2; c++)
+		{
+			if (object.half_uvs)
+				output[k * 2 + c] = HalfFloat::ToFloat(object.packed_uvs[index * 2 + c]);
+			else
+				output[k * 2 + c] = object.uvs[index * 2 + c];
+		}
+	}
+}
+
+bool PreparedScene::IntersectBounds(float* origin, float* inverse_direction,
+									float* bounds_min, float* bounds_max,
+									float max_t)
+{
+	float t_near = 0;
+	float t_far = max_t;
+
+	for (int k = 0; k < 3; k++)
+	{
+		float t0 = (bounds_min[k] - origin[k]) * inverse_direction[k];
+		float t1 = (bounds_max[k] - origin[k]) * inverse_direction[k];
+
+		if (t0 > t1)
+		{
+			float temp = t0;
+			t0 = t1;
+			t1 = temp;
+		}
+
+		t_near = fmax(t_near, t0);
+		t_far = fmin(t_far, t1);
+
+		if (t_near > t_far)
+			return false;
+	}
+
+	return true;
+}
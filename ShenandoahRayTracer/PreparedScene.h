@@ -0,0 +1,445 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "GeometryArray.h"
+#include "GeometryCache.h"
+#include "HalfFloat.h"
+#include "Hit.h"
+#include "ObjectHandler.h"
+#include "SharedMemory.h"
+#include "TextureCache.h"
+#include "Vector.h"
+
+// How the geometry of a prepared scene is stored.
+enum class MeshEncoding
+{
+	// 4 floats per vertex, 32 bit indices, and float UVs, exactly as loaded.
+	Exact,
+	// Positions quantized to 16 bits per axis within each object's bounds,
+	// 16 bit indices, and half float UVs, which take a little over half the
+	// memory.  Each part of an object falls back to the exact encoding on its
+	// own when it wouldn't be precise enough.
+	Compact
+};
+
+// Where a cluster of a streamed object's triangles is kept.  A cluster holds
+// a range of the object's triangles, with its own copy of the vertices and
+// UVs they use, so that it can be loaded on its own.
+struct StreamedCluster
+{
+	unsigned long long key; // The cluster's key in the geometry cache.
+	long long offset; // Where it starts in the geometry cache's file.
+	size_t bytes;
+
+	int first_triangle;
+	int num_triangles;
+
+	float bounds_min[3];
+	float bounds_max[3];
+
+	// Shared by every copy of the scene that has the cluster, so that when
+	// the object is streamed again, its space in the file is only written
+	// over once nothing else could still be reading it.
+	std::shared_ptr<bool> file_space;
+};
+
+// The render-ready copy of a single object.  Vertices are already transformed
+// into world space, so they don't have to be recomputed for every ray.
+struct PreparedObject
+{
+	// nullptr in a scene attached from shared memory, which has no objects
+	// of its own.
+	ObjectHandler* object = nullptr;
+
+	// The exact encoding of each part of the mesh, which is left empty when
+	// that part is stored compactly instead.  The arrays of a scene attached
+	// from shared memory are views of it.
+	GeometryArray<float> vertices; // 4 floats per vertex, in world space.
+	GeometryArray<int> triangles;
+	GeometryArray<int> triangle_uvs;
+	GeometryArray<float> uvs;
+
+	// The compact encoding.  Vertices are 3 values each, which are decoded
+	// as quantization_origin + value * quantization_scale.  The w of each
+	// vertex is dropped, since only the positions are used for rendering.
+	bool quantized_vertices = false;
+	bool short_indices = false; // For both triangles and triangle_uvs.
+	bool half_uvs = false;
+	GeometryArray<unsigned short> packed_vertices;
+	GeometryArray<unsigned short> packed_triangles;
+	GeometryArray<unsigned short> packed_triangle_uvs;
+	GeometryArray<unsigned short> packed_uvs;
+	float quantization_origin[3];
+	float quantization_scale[3];
+
+	Material material;
+
+	int num_vertices = 0;
+	int num_triangles = 0;
+	int num_uvs = 0;
+
+	// World space bounding box, used to skip the object's triangles entirely
+	// when a ray doesn't come near it.
+	float bounds_min[3];
+	float bounds_max[3];
+
+	// The transform the vertices were placed with, so that Refit can tell
+	// whether a streamed object moved.
+	float transform[16];
+
+	// Streamed objects keep none of their geometry in the arrays above, only
+	// the clusters it was split into, which are loaded through the geometry
+	// cache when a ray reaches them.  The counts are still those of the whole
+	// object.
+	bool streamed = false;
+	std::vector<StreamedCluster> clusters;
+};
+
+/** A snapshot of the scene that is ready to be rendered.
+
+Preparing the scene transforms every object's vertices into world space once
+and builds the bounding boxes used to cull objects.  Since the snapshot owns
+its own copies, it can be shared by any number of cameras and threads, and
+the ObjectHandlers can be changed while a prepared scene is being rendered.
+Changes to the objects are only picked up by preparing a new scene.
+
+A prepared scene can also be published for other processes on the same
+machine, which attach to it and render from the published geometry where
+it lies, rather than preparing their own copies.
+
+*/
+class PreparedScene
+{
+public:
+	// The most rays IntersectPacket traces together.  Larger packets are
+	// split, so this only limits the scratch space kept on the stack.
+	static const int MAX_PACKET_SIZE = 64;
+
+	// The most triangles in each cluster of a streamed object.  Every cluster
+	// has its own bounding box, so smaller clusters are culled more tightly
+	// but take more lookups in the cache.
+	static const int STREAM_CLUSTER_SIZE = 1024;
+
+	PreparedScene();
+
+	/**
+	* @brief Prepares the given objects for rendering.
+	*
+	* @param objects The objects in the scene.  They are copied, so the vector
+	* and objects can change afterwards.
+	* @param _encoding How the copied geometry is stored.  Compact geometry
+	* is decoded as it is intersected, so it is a little slower to render.
+	* @param _geometry_cache If set, every object is streamed: its geometry
+	* is written out to the cache's file in clusters, and only the clusters
+	* rays reach are loaded back, up to the cache's budget.
+	*/
+	PreparedScene(std::vector<ObjectHandler*>* objects,
+				  MeshEncoding _encoding = MeshEncoding::Exact,
+				  std::shared_ptr<GeometryCache> _geometry_cache = nullptr);
+
+	/**
+	* @brief Updates the world space vertices, bounds, and materials from the
+	* current state of the objects, reusing the existing storage.  This is much
+	* cheaper than preparing a new scene when only transforms have changed, as
+	* in animations.  Objects whose geometry changed size are prepared again
+	* from scratch, as are streamed objects that moved, whose clusters are
+	* written out again.  Clusters the same size as before go back where they
+	* were in the geometry cache's file, once no other copy of the scene uses
+	* them, and the rest go on the end.
+	*/
+	void Refit();
+
+	/**
+	* @brief Publishes the scene so that other processes on this machine can
+	* render it without loading or preparing it themselves, by attaching to
+	* it.  The geometry is written out exactly as it is stored here, so an
+	* attached scene renders identically.  Throws an std::invalid_argument if
+	* it can't be written, or if any object is streamed, or has a texture
+	* that didn't come from a file.
+	*
+	* @param location Where the scene is published, as "shm:name" for a
+	* shared memory segment or a file path (see SharedMemory).
+	*
+	* @return The published scene, which must be kept open for a Windows
+	* segment to last.
+	*/
+	SharedMemory Publish(std::string location);
+
+	/**
+	* @brief Attaches to a scene that another process published.  Its
+	* geometry is mapped read-only and used where it is, so however many
+	* processes attach, the machine only keeps one copy.  Textures are opened
+	* again from their files.  Throws an std::invalid_argument if the scene
+	* can't be opened, or wasn't published by this version.
+	*
+	* @param location Where the scene was published.
+	* @param texture_cache The cache the scene's textures load their tiles
+	* into.  Only needed if any object is textured.
+	*/
+	static PreparedScene Attach(std::string location,
+								std::shared_ptr<TextureCache> texture_cache);
+
+	// Whether the scene is attached to one that was published, in which case
+	// it can't be refit, since it has none of the objects it was prepared
+	// from.
+	bool IsAttached();
+
+	int GetNumObjects();
+	PreparedObject* GetObject(int index);
+
+	// The material of the object with the given index, such as a hit's
+	// object_index.
+	const Material& GetMaterial(int object_index);
+
+	MeshEncoding GetMeshEncoding();
+
+	// The memory taken by the geometry of every object, in bytes.  Streamed
+	// geometry is left out, since it is in the geometry cache, but attached
+	// geometry is counted even though it is shared with other processes.
+	size_t GetGeometryBytes();
+
+	/**
+	* @brief Hashes the scene as it renders: the geometry of every object,
+	* where it was placed, and its material.  Textures are hashed by their
+	* file locations.  Every byte of geometry is read, so it takes a while
+	* for large scenes.
+	*/
+	unsigned long long GetHash();
+
+	// Gets the box around every object in the scene.  An empty scene has a
+	// box of zero size at the origin.
+	void GetBounds(float* bounds_min, float* bounds_max);
+
+	/**
+	* @brief Finds the closest hit along a ray.
+	*
+	* @param origin The Vector3 array equivalent origin of the ray.
+	* @param direction The Vector3 array equivalent direction of the ray.
+	* @param output The hit.  Its counters are added to rather than reset, so
+	* they can be accumulated over multiple rays.
+	*/
+	void Intersect(float* origin, float* direction, Hit* output);
+
+	/**
+	* @brief Finds the closest hits of several rays that share an origin, such
+	* as all of the samples of one pixel.  The results are the same as calling
+	* Intersect for each ray, but each triangle is loaded once and tested
+	* against every ray that reached its object, which keeps it in the cache.
+	*
+	* @param origin The Vector3 array equivalent origin shared by the rays.
+	* @param directions The directions of the rays, 3 floats each.
+	* @param num_rays The number of rays.
+	* @param outputs The hits, one per ray.  Counters are added to, as with
+	* Intersect.
+	*/
+	void IntersectPacket(float* origin, float* directions, int num_rays,
+						 Hit* outputs);
+
+	/**
+	* @brief Checks whether anything blocks a ray before a given distance,
+	* such as a shadow ray towards a light.  This is cheaper than Intersect,
+	* since it stops at the first hit rather than looking for the closest.
+	*
+	* @param origin The Vector3 array equivalent origin of the ray.
+	* @param direction The Vector3 array equivalent direction of the ray.
+	* @param max_t The distance along the ray beyond which hits don't count.
+	*
+	* @return Whether any triangle is hit before max_t.
+	*/
+	bool IsOccluded(float* origin, float* direction, float max_t);
+
+	/**
+	* @brief Gets the geometric normal of the triangle that was hit, flipped if
+	* needed so that it faces back towards the ray.
+	*
+	* @param hit The hit, which must have hit something.
+	* @param direction The direction of the ray that made the hit.
+	* @param output_location A float array with minimum size 3.
+	*/
+	void GetHitNormal(Hit* hit, float* direction, float* output_location);
+
+	/**
+	* @brief Interpolates the texture coordinates of a hit.  Objects without
+	* UVs use the barycentric coordinates of the hit instead.
+	*
+	* @param hit The hit, which must have hit something.
+	* @param output_location A float array with minimum size 2.
+	*/
+	void GetHitUV(Hit* hit, float* output_location);
+
+	/**
+	* @brief Finds how far the texture coordinates move per unit of distance
+	* across the hit triangle, from the ratio of its area in texture space to
+	* its area in world space.  Used to turn the width of a ray's footprint
+	* into a width in texture coordinates.
+	*
+	* @param hit The hit, which must have hit something.
+	*
+	* @return The texture coordinate distance per unit of world distance, or
+	* 0 for degenerate triangles.
+	*/
+	float GetHitUVDensity(Hit* hit);
+
+	// This implements the Moller-Trumbore algorithm, generally the fastest
+	// one that is easy to implement.  Origin and direction are both Vector3
+	// array equivalents, while vertices is the vertices that are being tested
+	// against.  triangle is the location of the triangle (this function only
+	// tests one triangle).  t, u, and v are all output variables used for
+	// detecting the nearest hit.
+	static void GetRayHit(float* origin, float* direction, float* vertices,
+						  int* triangle, Hit* output);
+
+	/**
+	* @brief Tests a ray against an axis aligned bounding box using the slab
+	* method.
+	*
+	* @param origin The origin of the ray.
+	* @param inverse_direction One divided by each component of the direction.
+	* @param bounds_min The minimum corner of the box.
+	* @param bounds_max The maximum corner of the box.
+	* @param max_t The distance beyond which a hit doesn't matter.
+	*
+	* @return Whether the ray enters the box before max_t.
+	*/
+	static bool IntersectBounds(float* origin, float* inverse_direction,
+								float* bounds_min, float* bounds_max,
+								float max_t);
+
+private:
+	std::vector<PreparedObject> objects;
+	MeshEncoding encoding = MeshEncoding::Exact;
+	std::shared_ptr<GeometryCache> geometry_cache;
+	// The published scene the objects' arrays are views of, if attached.
+	std::shared_ptr<SharedMemory> shared_scene;
+
+	// The fixed size start of a cluster in the geometry cache's file, which
+	// is followed by the arrays it has the lengths of, in the order they are
+	// declared in PreparedObject.
+	struct ClusterHeader
+	{
+		int num_vertices;
+		int num_triangles;
+		int num_uvs;
+		bool quantized_vertices;
+		bool short_indices;
+		bool half_uvs;
+		float quantization_origin[3];
+		float quantization_scale[3];
+		float bounds_min[3];
+		float bounds_max[3];
+		size_t lengths[8];
+	};
+
+	// Changed whenever the layout of a published scene changes.
+	static const int SHARED_VERSION = 1;
+
+	// Where the arrays of a published scene start are rounded up to this, so
+	// that they can be read in place.
+	static const int SHARED_ALIGNMENT = 16;
+
+	// The start of a published scene, which is followed by a SharedObject for
+	// each object, and then the texture locations and arrays they point to.
+	struct SharedHeader
+	{
+		char magic[4];
+		int version;
+		int encoding;
+		int num_objects;
+	};
+
+	// One object of a published scene.  Offsets are from the start of the
+	// scene.
+	struct SharedObject
+	{
+		ClusterHeader geometry;
+		size_t offsets[8];
+
+		// The index of the material's type within Material, and its values:
+		// the colour, and then the exponent of a glossy material.
+		int material_type;
+		float material_values[4];
+		size_t texture_location_offset;
+		size_t texture_location_length;
+	};
+
+	void PrepareObject(ObjectHandler* source, PreparedObject* prepared);
+	static void UpdateBounds(PreparedObject* prepared);
+
+	// Splits an object that has just been prepared into clusters, which are
+	// encoded and written to the geometry cache, and then empties its arrays.
+	// The space of old clusters that nothing else uses is written over.
+	void StreamObject(PreparedObject* prepared,
+					  std::vector<StreamedCluster>* old_clusters);
+
+	// Checks that the arrays in a header are the lengths its counts and
+	// encoding call for.
+	static bool HasValidLengths(const ClusterHeader& header);
+
+	// Gets a cluster of a streamed object, loading it from the geometry
+	// cache's file if it isn't in memory.
+	std::shared_ptr<PreparedObject> LoadCluster(PreparedObject& object,
+												int cluster_index);
+
+	/**
+	* @brief Gets the mesh that holds the triangle of a hit, which is a
+	* cluster for streamed objects and the object itself otherwise.
+	*
+	* @param hit The hit, which must have hit something.
+	* @param holder Keeps a streamed cluster loaded while it is used.
+	* @param f Set to the offset of the triangle within the mesh.
+	*
+	* @return The mesh.
+	*/
+	PreparedObject& GetHitMesh(Hit* hit, std::shared_ptr<PreparedObject>* holder,
+							   int* f);
+
+	// Intersects every triangle of a mesh, which is a whole object or a
+	// cluster of one.  Hits are recorded against the object with the given
+	// index, with triangle_offset added to their triangle_index.
+	static void IntersectMesh(PreparedObject& mesh, int triangle_offset,
+							  int object_index, float* origin,
+							  float* direction, Hit* output);
+
+	// The same for the rays of a packet that are active.
+	static void IntersectMeshPacket(PreparedObject& mesh, int triangle_offset,
+									int object_index, float* origin,
+									float* directions, int count,
+									bool* active, Hit* outputs);
+
+	static bool IsMeshOccluded(PreparedObject& mesh, float* origin,
+							   float* direction, float max_t);
+
+	// Each of these switches one part of an object that is in the exact
+	// encoding over to the compact one, if that is precise enough.  Vertices
+	// are only quantized if the error is a small fraction of the shortest
+	// edge, and UVs are only halved if they stay within a fraction of a texel
+	// of a large texture.  Indices only need to fit in 16 bits.
+	static void EncodeVertices(PreparedObject* prepared);
+	static void EncodeIndices(PreparedObject* prepared);
+	static void EncodeUVs(PreparedObject* prepared);
+
+	// Gets the index of a vertex of a triangle, where f is the offset of the
+	// triangle, as in a hit's triangle_index.
+	static int GetVertexIndex(PreparedObject& object, int f, int corner);
+
+	/**
+	* @brief Gets the corners of a triangle in the layout GetRayHit takes.
+	* Exact objects point straight into their own arrays, while compact ones
+	* are decoded into the scratch space.
+	*
+	* @param object The object the triangle is in.
+	* @param f The offset of the triangle, as in a hit's triangle_index.
+	* @param scratch A float array with minimum size 12.
+	* @param vertices Set to the vertices to pass to GetRayHit.
+	* @param triangle Set to the triangle to pass to GetRayHit.
+	*/
+	static void LoadTriangle(PreparedObject& object, int f, float* scratch,
+							 float** vertices, int** triangle);
+
+	// Gets the UVs of the three corners of a triangle, 2 floats each, for
+	// an object with UVs.
+	static void LoadTriangleUVs(PreparedObject& object, int f, float* output);
+};
@@ -0,0 +1,81 @@
+#include "ReconstructionFilter.h"
+
+ReconstructionFilter::ReconstructionFilter()
+{
+
+}
+
+ReconstructionFilter::ReconstructionFilter(FilterType _type)
+{
+	type = _type;
+}
+
+FilterType ReconstructionFilter::GetType()
+{
+	return type;
+}
+
+float ReconstructionFilter::GetRadius()
+{
+	switch (type)
+	{
+	case FilterType::Tent:
+		return 1.0f;
+	case FilterType::Gaussian:
+		return 1.5f;
+	default:
+		return 0.5f;
+	}
+}
+
+void ReconstructionFilter::SampleOffset(float* sample, float* output_location)
+{
+	switch (type)
+	{
+	case FilterType::Box:
+	{
+		output_location[0] = sample[0] - 0.5f;
+		output_location[1] = sample[1] - 0.5f;
+		break;
+	}
+	case FilterType::Tent:
+	{
+		output_location[0] = SampleTent(sample[0]);
+		output_location[1] = SampleTent(sample[1]);
+		break;
+	}
+	case FilterType::Gaussian:
+	{
+		// Box-Muller transform.  The radius is clamped to the cut off so that
+		// no sample lands further away than GetRadius says.
+		const float sigma = 0.5f;
+		float radius = sigma * sqrt(-2 * log(1 - sample[0]));
+		radius = fmin(radius, GetRadius());
+		float angle = 2 * M_PI * sample[1];
+
+		output_location[0] = radius * cos(angle);
+		output_location[1] = radius * sin(angle);
+		break;
+	}
+	}
+}
+
+FilterType ReconstructionFilter::ParseFilterType(std::string name)
+{
+	if (name == "box")
+		return FilterType::Box;
+	if (name == "tent")
+		return FilterType::Tent;
+	if (name == "gaussian")
+		return FilterType::Gaussian;
+
+	throw std::invalid_argument("Unknown filter: " + name);
+}
+
+float ReconstructionFilter::SampleTent(float u)
+{
+	// Inverse of the cumulative distribution of a tent of radius 1.
+	if (u < 0.5f)
+		return sqrt(2 * u) - 1;
+	return 1 - sqrt(2 - 2 * u);
+}
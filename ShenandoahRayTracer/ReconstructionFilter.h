@@ -0,0 +1,54 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdexcept>
+#include <string>
+
+// The reconstruction filters that can be used to combine samples into pixels.
+enum class FilterType
+{
+	// Every sample within the pixel counts equally.  Radius 0.5.
+	Box,
+	// Weight falls off linearly from the centre of the pixel.  Radius 1.
+	Tent,
+	// Gaussian with a standard deviation of 0.5 pixels, cut off at radius 1.5.
+	Gaussian
+};
+
+/** Reconstruction filter applied through importance sampling.
+
+Rather than weighting each sample by the filter and splatting it onto every
+pixel it overlaps, the sample positions themselves are distributed according
+to the filter and every sample gets the same weight.  For filters that are
+never negative this gives the same result, but each pixel only ever depends
+on its own samples, so tiles can be rendered independently without any
+synchronization between threads.
+
+*/
+class ReconstructionFilter
+{
+public:
+	ReconstructionFilter();
+	ReconstructionFilter(FilterType _type);
+
+	FilterType GetType();
+	float GetRadius();
+
+	/**
+	* @brief Warps a uniform sample position within the pixel into an offset
+	* from the centre of the pixel, distributed according to the filter.
+	*
+	* @param sample A position in [0, 1) in both dimensions, from a Sampler.
+	* @param output_location The offset from the centre of the pixel, in pixels.
+	* Can be outside of the pixel for filters wider than a pixel.
+	*/
+	void SampleOffset(float* sample, float* output_location);
+
+	static FilterType ParseFilterType(std::string name);
+
+private:
+	FilterType type = FilterType::Box;
+
+	static float SampleTent(float u);
+};
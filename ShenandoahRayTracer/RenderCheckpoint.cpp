@@ -0,0 +1,205 @@
+#include "RenderCheckpoint.h"
+#include "Device.h"
+
+void RenderCheckpoint::Write(std::string location)
+{
+	Header header = {};
+	memcpy(header.magic, "SRCK", 4);
+	header.version = VERSION;
+	header.width = frame.GetWidth();
+	header.height = frame.GetHeight();
+	header.has_aovs = frame.HasAOVs();
+	header.has_costs = !costs.empty();
+	header.samples_per_pixel = samples_per_pixel;
+	header.pass_samples = pass_samples;
+	header.render_mode = (int)render_mode;
+	header.sampler_type = (int)sampler_type;
+	header.sampler_seed = sampler_seed;
+	header.filter_type = (int)filter_type;
+	header.adaptive_threshold = adaptive_threshold;
+	header.adaptive_min_samples = adaptive_min_samples;
+	header.passes = passes;
+	header.next_sample = next_sample;
+	header.integrator = (int)integrator;
+	header.max_depth = max_depth;
+	header.russian_roulette_depth = russian_roulette_depth;
+	memcpy(header.background, background, sizeof(background));
+	header.num_lights = lights.size();
+	header.mesh_encoding = (int)mesh_encoding;
+	header.samples_taken = samples_taken;
+	header.elapsed_milliseconds = elapsed_milliseconds;
+	header.scene_hash = scene_hash;
+
+	size_t light_bytes = lights.size() * sizeof(PointLight);
+	std::vector<char> data(sizeof(Header) + sizeof(Camera) + light_bytes);
+	memcpy(data.data(), &header, sizeof(Header));
+	memcpy(data.data() + sizeof(Header), &camera, sizeof(Camera));
+	if (!lights.empty())
+		memcpy(data.data() + sizeof(Header) + sizeof(Camera), lights.data(), light_bytes);
+	frame.WriteRegion(0, 0, frame.GetWidth(), frame.GetHeight(), &data);
+	if (!costs.empty())
+	{
+		const char* cost_data = (const char*)costs.data();
+		data.insert(data.end(), cost_data, cost_data + costs.size() * sizeof(int));
+	}
+
+	unsigned long long checksum = GetChecksum(data.data(), data.size());
+
+	std::string temporary_location = location + ".tmp";
+	{
+		std::ofstream file(temporary_location, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), data.size());
+		file.write((const char*)&checksum, sizeof(checksum));
+		if (!file)
+			throw std::invalid_argument("Couldn't write the checkpoint " +
+										temporary_location + ".");
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary_location, location, error);
+	if (error)
+		throw std::invalid_argument("Couldn't replace the checkpoint " + location +
+									": " + error.message());
+}
+
+RenderCheckpoint RenderCheckpoint::Read(std::string location)
+{
+	std::ifstream file(location, std::ios::binary | std::ios::ate);
+	if (!file)
+		throw std::invalid_argument("Couldn't open the checkpoint " + location + ".");
+
+	std::vector<char> data((size_t)file.tellg());
+	file.seekg(0);
+	file.read(data.data(), data.size());
+	if (!file)
+		throw std::invalid_argument("Couldn't read the checkpoint " + location + ".");
+
+	Header header;
+	if (data.size() < sizeof(Header) + sizeof(Camera) + sizeof(unsigned long long))
+		throw std::invalid_argument(location + " is too short to be a checkpoint.");
+	memcpy(&header, data.data(), sizeof(Header));
+
+	if (memcmp(header.magic, "SRCK", 4) != 0)
+		throw std::invalid_argument(location + " isn't a checkpoint.");
+	if (header.version != VERSION)
+		throw std::invalid_argument("The checkpoint " + location +
+									" was saved by a different version.");
+
+	size_t body_size = data.size() - sizeof(unsigned long long);
+	unsigned long long checksum;
+	memcpy(&checksum, data.data() + body_size, sizeof(checksum));
+	if (checksum != GetChecksum(data.data(), body_size))
+		throw std::invalid_argument("The checkpoint " + location + " is damaged.");
+
+	RenderCheckpoint checkpoint;
+	memcpy(&checkpoint.camera, data.data() + sizeof(Header), sizeof(Camera));
+	checkpoint.samples_per_pixel = header.samples_per_pixel;
+	checkpoint.pass_samples = header.pass_samples;
+	checkpoint.render_mode = (RenderMode)header.render_mode;
+	checkpoint.sampler_type = (SamplerType)header.sampler_type;
+	checkpoint.sampler_seed = header.sampler_seed;
+	checkpoint.filter_type = (FilterType)header.filter_type;
+	checkpoint.adaptive_threshold = header.adaptive_threshold;
+	checkpoint.adaptive_min_samples = header.adaptive_min_samples;
+	checkpoint.passes = header.passes;
+	checkpoint.next_sample = header.next_sample;
+	checkpoint.integrator = (IntegratorType)header.integrator;
+	checkpoint.max_depth = header.max_depth;
+	checkpoint.russian_roulette_depth = header.russian_roulette_depth;
+	memcpy(checkpoint.background, header.background, sizeof(header.background));
+	checkpoint.mesh_encoding = (MeshEncoding)header.mesh_encoding;
+	checkpoint.samples_taken = header.samples_taken;
+	checkpoint.elapsed_milliseconds = header.elapsed_milliseconds;
+	checkpoint.scene_hash = header.scene_hash;
+
+	if (header.width <= 0 || header.height <= 0)
+		throw std::invalid_argument("The checkpoint " + location + " has no frame.");
+
+	size_t position = sizeof(Header) + sizeof(Camera);
+	if (header.num_lights < 0 ||
+		(body_size - position) / sizeof(PointLight) < (size_t)header.num_lights)
+		throw std::invalid_argument("The checkpoint " + location + " is damaged.");
+	checkpoint.lights.resize(header.num_lights);
+	if (header.num_lights > 0)
+	{
+		memcpy(checkpoint.lights.data(), data.data() + position,
+			   header.num_lights * sizeof(PointLight));
+	}
+	position += header.num_lights * sizeof(PointLight);
+
+	checkpoint.frame = FrameBuffer(header.width, header.height);
+	if (header.has_aovs)
+		checkpoint.frame.EnableAOVs();
+
+	position += checkpoint.frame.ReadRegion(0, 0, header.width, header.height,
+											data.data() + position,
+											body_size - position);
+
+	if (header.has_costs)
+	{
+		size_t cost_bytes = (size_t)header.width * header.height * sizeof(int);
+		if (body_size - position < cost_bytes)
+			throw std::invalid_argument("The checkpoint " + location + " is damaged.");
+
+		checkpoint.costs.resize((size_t)header.width * header.height);
+		memcpy(checkpoint.costs.data(), data.data() + position, cost_bytes);
+	}
+
+	return checkpoint;
+}
+
+void RenderCheckpoint::CheckCompatible(RenderCheckpoint* other)
+{
+	std::string difference;
+	if (frame.GetWidth() != other->frame.GetWidth() ||
+		frame.GetHeight() != other->frame.GetHeight())
+		difference = "resolution";
+	else if (!camera.Equals(other->camera))
+		difference = "camera";
+	else if (samples_per_pixel != other->samples_per_pixel)
+		difference = "samples per pixel";
+	else if (pass_samples != other->pass_samples)
+		difference = "samples per pass";
+	else if (render_mode != other->render_mode)
+		difference = "render mode";
+	else if (integrator != other->integrator)
+		difference = "integrator";
+	else if (max_depth != other->max_depth)
+		difference = "maximum depth";
+	else if (russian_roulette_depth != other->russian_roulette_depth)
+		difference = "Russian roulette depth";
+	else if (memcmp(background, other->background, sizeof(background)) != 0)
+		difference = "background";
+	else if (lights.size() != other->lights.size() ||
+			 (!lights.empty() && memcmp(lights.data(), other->lights.data(),
+										lights.size() * sizeof(PointLight)) != 0))
+		difference = "set of lights";
+	else if (mesh_encoding != other->mesh_encoding)
+		difference = "mesh encoding";
+	else if (scene_hash != other->scene_hash)
+		difference = "scene (objects, transforms, or materials)";
+	else if (sampler_type != other->sampler_type || sampler_seed != other->sampler_seed)
+		difference = "sampler";
+	else if (filter_type != other->filter_type)
+		difference = "filter";
+	else if (adaptive_threshold != other->adaptive_threshold ||
+			 adaptive_min_samples != other->adaptive_min_samples)
+		difference = "adaptive sampling";
+	else if (frame.HasAOVs() != other->frame.HasAOVs())
+		difference = "AOV or denoising setting";
+
+	if (!difference.empty())
+		throw std::invalid_argument("The checkpoint was saved with a different " +
+									difference + ", so the render can't be resumed.");
+}
+
+unsigned long long RenderCheckpoint::GetChecksum(const char* data, size_t size)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
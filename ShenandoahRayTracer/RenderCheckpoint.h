@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Camera.h"
+#include "FrameBuffer.h"
+#include "Integrator.h"
+#include "Light.h"
+#include "ReconstructionFilter.h"
+#include "Sampler.h"
+
+// Declared in Device.h, which includes this file.
+enum class RenderMode;
+
+/** The saved state of a progressive render, from which it can be resumed.
+
+A progressive render only keeps its accumulated samples between passes: the
+samplers are stateless, and every sample's random numbers come from its
+pixel and sample index, so the next pass only needs to know which sample to
+start from.  A checkpoint is that frame buffer, the pass it got to, and the
+settings the render was started with, which have to match for it to be
+resumed.  Resuming carries on exactly where the checkpoint was taken, and
+gives the same image, bit for bit, as a render that was never stopped.
+
+The file is a small header followed by the camera, the lights, and the frame
+buffer's pixels as they are in memory (see FrameBuffer::WriteRegion), and a
+checksum of everything before it, so a file that was cut short or damaged is rejected rather than
+resumed.  It is written to a temporary file next to the checkpoint first,
+and then renamed over it, so a process killed while saving leaves the last
+checkpoint whole.  Values are in the byte order of the machine.
+
+*/
+struct RenderCheckpoint
+{
+	// The settings of the render, which must be the same to resume it.
+	Camera camera;
+	int samples_per_pixel = 0;
+	int pass_samples = 0;
+	RenderMode render_mode = (RenderMode)0;
+	SamplerType sampler_type = SamplerType::Sobol;
+	unsigned int sampler_seed = 0;
+	FilterType filter_type = FilterType::Box;
+	float adaptive_threshold = 0;
+	int adaptive_min_samples = 0;
+
+	// The integrator and its settings, from Integrator::GetCheckpointSettings.
+	// Those of the path tracer are left as they are by other integrators.
+	IntegratorType integrator = IntegratorType::UV;
+	int max_depth = 0;
+	int russian_roulette_depth = 0;
+	float background[3] = { 0, 0, 0 };
+	std::vector<PointLight> lights;
+
+	MeshEncoding mesh_encoding = MeshEncoding::Exact;
+	// A hash of the prepared scene, from PreparedScene::GetHash, which covers
+	// the geometry of every object, where it was placed, and its material.
+	unsigned long long scene_hash = 0;
+
+	// How far the render got.
+	int passes = 0;
+	int next_sample = 0;
+	long long samples_taken = 0;
+	// The time spent rendering, so a time budget carries over.
+	long long elapsed_milliseconds = 0;
+
+	FrameBuffer frame;
+	// The traversal cost of each pixel, only kept in the heatmap render mode.
+	std::vector<int> costs;
+
+	/**
+	* @brief Saves the checkpoint, replacing any file at the location.  Throws
+	* an std::invalid_argument if it can't be written.
+	*
+	* @param location Where the checkpoint is saved.
+	*/
+	void Write(std::string location);
+
+	/**
+	* @brief Loads a checkpoint.  Throws an std::invalid_argument if the file
+	* can't be read, isn't a checkpoint of this version, or is damaged.
+	*
+	* @param location Where the checkpoint was saved.
+	*/
+	static RenderCheckpoint Read(std::string location);
+
+	/**
+	* @brief Checks that a render could be resumed from this checkpoint.
+	* Throws an std::invalid_argument naming the first setting that differs.
+	*
+	* @param other A checkpoint holding the settings of the new render.  Only
+	* the settings, and whether the frame has AOVs, are compared.
+	*/
+	void CheckCompatible(RenderCheckpoint* other);
+
+	// Changed whenever the layout of the file changes.
+	static const int VERSION = 2;
+
+private:
+	// Laid out so there is no padding, since it is written as it is.
+	struct Header
+	{
+		char magic[4];
+		int version;
+		int width, height;
+		int has_aovs;
+		int has_costs;
+		int samples_per_pixel;
+		int pass_samples;
+		int render_mode;
+		int sampler_type;
+		unsigned int sampler_seed;
+		int filter_type;
+		float adaptive_threshold;
+		int adaptive_min_samples;
+		int passes;
+		int next_sample;
+		int integrator;
+		int max_depth;
+		int russian_roulette_depth;
+		float background[3];
+		int num_lights;
+		int mesh_encoding;
+		long long samples_taken;
+		long long elapsed_milliseconds;
+		unsigned long long scene_hash;
+	};
+
+	static_assert(std::is_trivially_copyable<Camera>::value,
+				  "Cameras are saved as their bytes.");
+	static_assert(std::is_trivially_copyable<PointLight>::value,
+				  "Lights are saved as their bytes.");
+
+	// FNV-1a, which is enough to catch files that were damaged or cut short.
+	static unsigned long long GetChecksum(const char* data, size_t size);
+};
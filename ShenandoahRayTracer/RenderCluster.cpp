@@ -0,0 +1,378 @@
+#include "RenderCluster.h"
+
+using namespace ClusterProtocol;
+
+RenderCoordinator::RenderCoordinator(CPUDevice* _device,
+									 std::vector<std::string> addresses)
+{
+	if (addresses.empty())
+		throw std::invalid_argument("A distributed render needs at least one worker.");
+
+	device = _device;
+	workers.resize(addresses.size());
+	for (int w = 0; w < addresses.size(); w++)
+		workers[w].address = addresses[w];
+}
+
+std::vector<std::string> RenderCoordinator::ParseAddresses(std::string list)
+{
+	std::vector<std::string> addresses;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+
+		if (comma > start)
+			addresses.push_back(list.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return addresses;
+}
+
+void RenderCoordinator::SetWorkerTimeout(int seconds)
+{
+	if (seconds < 0)
+		throw std::invalid_argument("The worker timeout can't be negative.");
+
+	worker_timeout = seconds;
+}
+
+void RenderCoordinator::RenderFrame(Camera c, int max_threads, int* output_location)
+{
+	int resolution_x = c.GetResolutionX();
+	int resolution_y = c.GetResolutionY();
+
+	FrameJob job;
+	job.camera = c;
+	job.frame = FrameBuffer(resolution_x, resolution_y);
+	if (device->NeedsAOVs())
+		job.frame.EnableAOVs();
+	if (device->GetRenderMode() == RenderMode::TraversalHeatmap)
+		job.costs.assign(resolution_x * resolution_y, 0);
+
+	for (int y = 0; y < resolution_y; y += REGION_SIZE)
+	{
+		for (int x = 0; x < resolution_x; x += REGION_SIZE)
+		{
+			Region region;
+			region.x = x;
+			region.y = y;
+			region.width = fmin(REGION_SIZE, resolution_x - x);
+			region.height = fmin(REGION_SIZE, resolution_y - y);
+			job.pending.push_back(region);
+		}
+	}
+	job.remaining = job.pending.size();
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < workers.size(); w++)
+		threads.emplace_back(&RenderCoordinator::WorkerThread, this, &workers[w], &job);
+	for (int i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	if (job.remaining > 0)
+		throw std::invalid_argument("Every worker was lost with " +
+									std::to_string(job.remaining) +
+									" regions of the frame left to render.");
+
+	device->ResolveRemoteFrame(std::move(job.frame), job.costs.data(), job.samples,
+							   max_threads, output_location);
+}
+
+int RenderCoordinator::GetConnectedWorkers()
+{
+	int connected = 0;
+	for (int w = 0; w < workers.size(); w++)
+	{
+		if (workers[w].socket.IsOpen())
+			connected++;
+	}
+	return connected;
+}
+
+int RenderCoordinator::GetRetriedRegions()
+{
+	return retried_regions;
+}
+
+void RenderCoordinator::WorkerThread(Worker* worker, FrameJob* job)
+{
+	if (!worker->socket.IsOpen() && !ConnectWorker(worker))
+		return;
+
+	Socket* socket = &worker->socket;
+
+	MessageHeader frame_header = CreateHeader(MessageType::Frame);
+	FrameSettings settings;
+	settings.samples_per_pixel = device->GetSamplesPerPixel();
+	settings.render_mode = device->GetRenderMode();
+	settings.record_aovs = job->frame.HasAOVs();
+	frame_header.payload_bytes = sizeof(Camera) + sizeof(FrameSettings);
+
+	bool connected = socket->Send(&frame_header, sizeof(frame_header)) &&
+		socket->Send(&job->camera, sizeof(Camera)) &&
+		socket->Send(&settings, sizeof(settings));
+
+	// The regions sent to this worker that haven't come back yet, in the
+	// order they were sent, which is the order the results arrive in.
+	std::deque<Region> in_flight;
+	std::vector<char> payload;
+
+	while (connected)
+	{
+		std::vector<Region> to_send;
+		{
+			std::unique_lock<std::mutex> lock(job->mutex);
+
+			// With nothing to do, the worker waits in case another worker is
+			// lost and its regions come back on the queue.
+			if (in_flight.empty())
+			{
+				job->changed.wait(lock, [job]()
+				{
+					return !job->pending.empty() || job->remaining == 0;
+				});
+				if (job->remaining == 0)
+					break;
+			}
+
+			while (in_flight.size() < REGIONS_IN_FLIGHT && !job->pending.empty())
+			{
+				to_send.push_back(job->pending.front());
+				in_flight.push_back(job->pending.front());
+				job->pending.pop_front();
+			}
+		}
+
+		for (int r = 0; r < to_send.size() && connected; r++)
+		{
+			MessageHeader header = CreateHeader(MessageType::Region);
+			header.x = to_send[r].x;
+			header.y = to_send[r].y;
+			header.width = to_send[r].width;
+			header.height = to_send[r].height;
+			connected = socket->Send(&header, sizeof(header));
+		}
+		if (!connected)
+			break;
+
+		// Anything but the result of the oldest region means the worker is
+		// out of step with us, and is treated as lost.
+		Region region = in_flight.front();
+		MessageHeader header;
+		size_t region_bytes = job->frame.GetRegionBytes(region.width, region.height);
+		size_t cost_bytes = job->costs.empty() ? 0 :
+			sizeof(int) * region.width * region.height;
+		connected = socket->Receive(&header, sizeof(header)) &&
+			header.type == MessageType::Result && header.x == region.x &&
+			header.y == region.y && header.width == region.width &&
+			header.height == region.height &&
+			header.payload_bytes == region_bytes + cost_bytes &&
+			ReceivePayload(socket, header, &payload, region_bytes + cost_bytes);
+		if (!connected)
+			break;
+
+		in_flight.pop_front();
+		worker->regions_rendered++;
+
+		std::lock_guard<std::mutex> lock(job->mutex);
+
+		job->frame.ReadRegion(region.x, region.y, region.width, region.height,
+							  payload.data(), region_bytes);
+		if (!job->costs.empty())
+		{
+			const int* costs = (const int*)(payload.data() + region_bytes);
+			for (int j = 0; j < region.height; j++)
+			{
+				std::copy(costs + j * region.width, costs + (j + 1) * region.width,
+						  job->costs.begin() + (region.y + j) * job->frame.GetWidth() +
+						  region.x);
+			}
+		}
+		job->samples += header.samples;
+
+		job->remaining--;
+		if (job->remaining == 0)
+			job->changed.notify_all();
+	}
+
+	if (connected)
+		return;
+
+	// The regions the worker had are rendered again from scratch by the
+	// others, and whatever it sent for them is never used, so the frame still
+	// comes out the same.
+	std::cerr << "Lost the connection to worker " << worker->address;
+	if (!in_flight.empty())
+		std::cerr << ", rendering its " << in_flight.size() << " regions elsewhere";
+	std::cerr << "." << std::endl;
+
+	socket->Close();
+
+	std::lock_guard<std::mutex> lock(job->mutex);
+	for (int r = in_flight.size() - 1; r >= 0; r--)
+		job->pending.push_front(in_flight[r]);
+	retried_regions += in_flight.size();
+	job->changed.notify_all();
+}
+
+bool RenderCoordinator::ConnectWorker(Worker* worker)
+{
+	try
+	{
+		worker->socket = Socket::Connect(worker->address);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return false;
+	}
+
+	worker->socket.SetReceiveTimeout(worker_timeout);
+
+	MessageHeader hello = CreateHeader(MessageType::Hello);
+	MessageHeader reply;
+	if (!worker->socket.Send(&hello, sizeof(hello)) ||
+		!worker->socket.Receive(&reply, sizeof(reply)) ||
+		reply.type != MessageType::Hello || reply.version != VERSION)
+	{
+		std::cerr << "Worker " << worker->address
+				  << " didn't answer as a worker of this version." << std::endl;
+		worker->socket.Close();
+		return false;
+	}
+
+	return true;
+}
+
+
+TileWorker::TileWorker(CPUDevice* _device, int _max_threads)
+{
+	device = _device;
+	max_threads = _max_threads;
+}
+
+void TileWorker::Serve(std::string address)
+{
+	Socket listener = Socket::Listen(address);
+
+	while (true)
+	{
+		Socket connection;
+		try
+		{
+			connection = listener.Accept();
+			ServeConnection(&connection);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+	}
+}
+
+void TileWorker::ServeConnection(Socket* socket)
+{
+	MessageHeader hello;
+	if (!socket->Receive(&hello, sizeof(hello)))
+		return;
+	if (hello.type != MessageType::Hello || hello.version != VERSION)
+		throw std::invalid_argument("A coordinator of a different version connected.");
+
+	MessageHeader reply = CreateHeader(MessageType::Hello);
+	if (!socket->Send(&reply, sizeof(reply)))
+		return;
+
+	Camera camera;
+	FrameBuffer frame;
+	std::vector<int> costs;
+	bool has_frame = false;
+
+	MessageHeader header;
+	std::vector<char> payload;
+	std::vector<char> result;
+
+	while (socket->Receive(&header, sizeof(header)))
+	{
+		if (header.type == MessageType::Frame)
+		{
+			if (!ReceivePayload(socket, header, &payload, sizeof(Camera) + sizeof(FrameSettings)) ||
+				payload.size() != sizeof(Camera) + sizeof(FrameSettings))
+				throw std::invalid_argument("Received an invalid frame from the coordinator.");
+
+			FrameSettings settings;
+			memcpy(&camera, payload.data(), sizeof(Camera));
+			memcpy(&settings, payload.data() + sizeof(Camera), sizeof(FrameSettings));
+
+			device->SetSamplesPerPixel(settings.samples_per_pixel);
+			device->SetRenderMode(settings.render_mode);
+
+			frame = FrameBuffer(camera.GetResolutionX(), camera.GetResolutionY());
+			if (settings.record_aovs)
+				frame.EnableAOVs();
+			costs.assign(camera.GetResolutionX() * camera.GetResolutionY(), 0);
+			has_frame = true;
+		}
+		else if (header.type == MessageType::Region && has_frame)
+		{
+			// A region is always cleared first, in case the coordinator asks
+			// for it again.
+			frame.Clear(header.x, header.y, header.width, header.height);
+			for (int j = header.y; j < header.y + header.height; j++)
+			{
+				std::fill(costs.begin() + j * frame.GetWidth() + header.x,
+						  costs.begin() + j * frame.GetWidth() + header.x + header.width, 0);
+			}
+
+			long long samples = device->RenderRegion(camera, header.x, header.y,
+													 header.width, header.height,
+													 max_threads, &frame, costs.data());
+
+			result.clear();
+			frame.WriteRegion(header.x, header.y, header.width, header.height, &result);
+			if (device->GetRenderMode() == RenderMode::TraversalHeatmap)
+			{
+				for (int j = header.y; j < header.y + header.height; j++)
+				{
+					const char* row = (const char*)&costs[j * frame.GetWidth() + header.x];
+					result.insert(result.end(), row, row + sizeof(int) * header.width);
+				}
+			}
+
+			MessageHeader response = CreateHeader(MessageType::Result);
+			response.x = header.x;
+			response.y = header.y;
+			response.width = header.width;
+			response.height = header.height;
+			response.samples = samples;
+			response.payload_bytes = result.size();
+
+			if (!socket->Send(&response, sizeof(response)) ||
+				!socket->Send(result.data(), result.size()))
+				return;
+		}
+		else
+			throw std::invalid_argument("Received an unexpected message from the coordinator.");
+	}
+}
+
+
+MessageHeader ClusterProtocol::CreateHeader(MessageType type)
+{
+	MessageHeader header = {};
+	header.type = type;
+	header.version = VERSION;
+	return header;
+}
+
+bool ClusterProtocol::ReceivePayload(Socket* socket, const MessageHeader& header,
+									 std::vector<char>* output, size_t max_bytes)
+{
+	if (header.payload_bytes < 0 || (size_t)header.payload_bytes > max_bytes)
+		return false;
+
+	output->resize(header.payload_bytes);
+	return socket->Receive(output->data(), output->size());
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Camera.h"
+#include "Device.h"
+#include "FrameBuffer.h"
+#include "Socket.h"
+
+/** Renders one frame across several processes, usually on different
+machines, that each have a copy of the scene.
+
+Each worker is an instance of the renderer started with the same scene and
+options, and a TileWorker listening at an address.  The coordinator splits
+the frame into square regions of REGION_SIZE pixels, and hands them out to
+the workers over TCP (or Unix domain sockets), a few at a time so that a
+worker always has the next one queued while its result is on the way back.
+Workers render each region on all of their threads with
+CPUDevice::RenderRegion, and send back the accumulated samples rather than
+finished pixels, which are copied straight into the coordinator's frame
+buffer.  The frame is only resolved (or denoised) once every region is in,
+so the image is identical to one rendered by a single CPUDevice.
+
+When a worker's connection is lost, or it doesn't answer within the
+timeout, the regions it was working on go back on the queue for the other
+workers, and it is tried again on the next frame.  The frame only fails if
+every worker is lost.
+
+Only the camera, the samples per pixel, the render mode, and whether AOVs
+are recorded are sent with each frame.  Everything else (the objects, the
+integrator, the sampler and filter, adaptive sampling) comes from the
+worker's own scene file and options, so they must match the coordinator's.
+Time budgets apply to each region separately.  Messages are sent in the
+byte order of the machine, so every process must run on the same
+architecture.
+
+*/
+class RenderCoordinator
+{
+public:
+	// The width and height of the regions frames are divided into.  Each is
+	// rendered as several of the device's tiles, so that a worker can spread
+	// one region across its threads.
+	static const int REGION_SIZE = 64;
+
+	// The most regions sent to a worker before the first result comes back.
+	static const int REGIONS_IN_FLIGHT = 2;
+
+	/**
+	* @brief Creates a coordinator.  Workers are connected to when the first
+	* frame is rendered.
+	*
+	* @param _device The device the frames are resolved with, whose settings
+	* are sent to the workers.  It doesn't need any objects uploaded.
+	* @param addresses The address of each worker, as "host:port" or
+	* "unix:path".
+	*/
+	RenderCoordinator(CPUDevice* _device, std::vector<std::string> addresses);
+
+	// Splits a comma separated list of worker addresses.
+	static std::vector<std::string> ParseAddresses(std::string list);
+
+	// How long a worker can take to return a region before it is treated as
+	// lost.  0 (the default) waits forever, which is only safe if a worker
+	// that stops will also close its connections.
+	void SetWorkerTimeout(int seconds);
+
+	/**
+	* @brief Renders a frame on the workers, and writes it into the output
+	* location the same way CPUDevice::RenderFrame would.  Its AOVs can be
+	* read from the device afterwards.  Throws an std::invalid_argument if
+	* every worker is lost before the frame is finished.
+	*
+	* @param c The camera to render from.
+	* @param max_threads The most threads used to denoise the frame.
+	* @param output_location An int array with minimum size width * height * 3.
+	*/
+	void RenderFrame(Camera c, int max_threads, int* output_location);
+
+	// The number of workers that finished the last frame still connected.
+	int GetConnectedWorkers();
+
+	// The number of regions that had to be sent to another worker since the
+	// coordinator was created, because the one rendering them was lost.
+	int GetRetriedRegions();
+
+private:
+	struct Region
+	{
+		int x, y;
+		int width, height;
+	};
+
+	struct Worker
+	{
+		std::string address;
+		Socket socket;
+		int regions_rendered = 0;
+	};
+
+	// The state of the frame being rendered, shared by the threads talking
+	// to each worker.
+	struct FrameJob
+	{
+		Camera camera;
+		FrameBuffer frame;
+		std::vector<int> costs;
+		long long samples = 0;
+
+		std::mutex mutex;
+		std::condition_variable changed;
+		// Regions that haven't been sent to a worker, or were taken back from
+		// one that was lost.
+		std::deque<Region> pending;
+		int remaining = 0;
+	};
+
+	CPUDevice* device;
+	std::vector<Worker> workers;
+	int worker_timeout = 0;
+	int retried_regions = 0;
+
+	// Talks to one worker until every region of the frame is done or the
+	// worker is lost.
+	void WorkerThread(Worker* worker, FrameJob* job);
+
+	// Connects to a worker that isn't connected, returning false if it can't.
+	bool ConnectWorker(Worker* worker);
+};
+
+/** Serves the regions a RenderCoordinator asks for, rendering them with a
+device that has the scene uploaded.
+
+Coordinators are served one at a time, each for as long as it stays
+connected, so a worker can be shared by coordinators that take turns (such
+as one per frame of an animation).
+
+*/
+class TileWorker
+{
+public:
+	/**
+	* @brief Creates a worker.
+	*
+	* @param _device The device to render with, which must already have the
+	* scene uploaded.
+	* @param _max_threads The most threads each region is rendered on.
+	*/
+	TileWorker(CPUDevice* _device, int _max_threads);
+
+	/**
+	* @brief Listens at an address and serves every coordinator that connects
+	* to it.  Only returns by throwing an std::invalid_argument if the address
+	* can't be listened at.  Errors with a coordinator are written to
+	* std::cerr, and end its connection but not the worker.
+	*
+	* @param address The address, as "host:port", ":port", or "unix:path".
+	*/
+	void Serve(std::string address);
+
+	// Handles the messages of one coordinator until it disconnects.
+	void ServeConnection(Socket* socket);
+
+private:
+	CPUDevice* device;
+	int max_threads;
+};
+
+// The messages between coordinators and workers.  Every message starts with
+// a MessageHeader, followed by payload_bytes of data.
+namespace ClusterProtocol
+{
+	// Changed whenever the messages change, so that mismatched builds refuse
+	// to talk instead of misreading each other.
+	const int VERSION = 1;
+
+	enum class MessageType
+	{
+		// Sent by each side when the coordinator connects, with the version.
+		Hello,
+		// Starts a frame.  The payload is a Camera followed by FrameSettings.
+		Frame,
+		// Asks for the rectangle in the header to be rendered.
+		Region,
+		// The rendered rectangle in the header, with the number of samples
+		// taken.  The payload is the rectangle from FrameBuffer::WriteRegion,
+		// followed by the rows of its traversal costs.
+		Result
+	};
+
+	struct MessageHeader
+	{
+		MessageType type;
+		int version;
+		int x, y;
+		int width, height;
+		long long samples;
+		long long payload_bytes;
+	};
+
+	struct FrameSettings
+	{
+		int samples_per_pixel;
+		RenderMode render_mode;
+		int record_aovs;
+	};
+
+	// The camera is sent as it is laid out in memory, so that the workers
+	// generate exactly the same rays as the coordinator would have, rather
+	// than rebuilding it from vectors that are normalized again.
+	static_assert(std::is_trivially_copyable<Camera>::value,
+				  "Cameras are sent between processes as their bytes.");
+
+	MessageHeader CreateHeader(MessageType type);
+
+	// Receives a message's payload, returning false if the connection was
+	// lost or the payload is larger than max_bytes.
+	bool ReceivePayload(Socket* socket, const MessageHeader& header,
+						std::vector<char>* output, size_t max_bytes);
+}
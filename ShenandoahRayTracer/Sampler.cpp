@@ -0,0 +1,219 @@
+#include "Sampler.h"
+
+Sampler::Sampler()
+{
+
+}
+
+Sampler::Sampler(SamplerType _type, unsigned int _seed)
+{
+	type = _type;
+	seed = _seed;
+}
+
+SamplerType Sampler::GetType()
+{
+	return type;
+}
+
+unsigned int Sampler::GetSeed()
+{
+	return seed;
+}
+
+void Sampler::GetPixelSamples(int i, int j, int first_sample, int num_samples,
+							  int samples_per_pixel, float* output_location)
+{
+	for (int s = 0; s < num_samples; s++)
+		GetSample(i, j, first_sample + s, samples_per_pixel, &output_location[s * 2]);
+}
+
+SamplerType Sampler::ParseSamplerType(std::string name)
+{
+	if (name == "center")
+		return SamplerType::Center;
+	if (name == "stratified")
+		return SamplerType::Stratified;
+	if (name == "halton")
+		return SamplerType::Halton;
+	if (name == "sobol")
+		return SamplerType::Sobol;
+	if (name == "bluenoise")
+		return SamplerType::BlueNoise;
+
+	throw std::invalid_argument("Unknown sampler: " + name);
+}
+
+unsigned int Sampler::Hash(unsigned int a, unsigned int b, unsigned int c)
+{
+	// Based on the "lowbias32" integer hash, applied to each input in turn so
+	// that changing any one of them changes every bit of the output.
+	unsigned int h = a * 0x9E3779B9u;
+	h ^= b + 0x7F4A7C15u + (h << 6) + (h >> 2);
+	h ^= c + 0x6A09E667u + (h << 6) + (h >> 2);
+
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+
+	return h;
+}
+
+float Sampler::ToUnitFloat(unsigned int bits)
+{
+	// 24 bits is all a float can represent below 1, so using more could round
+	// up to exactly 1.
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+float Sampler::RadicalInverse(unsigned int index, unsigned int base)
+{
+	float inverse_base = 1.0f / base;
+	float factor = inverse_base;
+	float result = 0;
+
+	while (index > 0)
+	{
+		result += (index % base) * factor;
+		index /= base;
+		factor *= inverse_base;
+	}
+
+	return result;
+}
+
+unsigned int Sampler::SobolSecondDimension(unsigned int index)
+{
+	// The generator matrix for the second dimension of the Sobol sequence is
+	// the Pascal matrix mod 2, so each direction number is built from the
+	// previous one.  The result is the 32 bit fixed point value of the sample.
+	unsigned int result = 0;
+	unsigned int direction = 1u << 31;
+
+	for (; index > 0; index >>= 1)
+	{
+		if (index & 1)
+			result ^= direction;
+		direction ^= direction >> 1;
+	}
+
+	return result;
+}
+
+unsigned int Sampler::Permute(unsigned int index, unsigned int n, unsigned int key)
+{
+	// The hash works on a power of two range, and values that land outside
+	// of n are hashed again until they're inside it, which always ends since
+	// the hash is a bijection on the range.
+	unsigned int mask = n - 1;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+
+	do
+	{
+		index ^= key;
+		index *= 0xe170893d;
+		index ^= key >> 16;
+		index ^= (index & mask) >> 4;
+		index ^= key >> 8;
+		index *= 0x0929eb3f;
+		index ^= key >> 23;
+		index ^= (index & mask) >> 1;
+		index *= 1 | key >> 27;
+		index *= 0x6935fa69;
+		index ^= (index & mask) >> 11;
+		index *= 0x74dcb303;
+		index ^= (index & mask) >> 2;
+		index *= 0x9e501cc3;
+		index ^= (index & mask) >> 2;
+		index *= 0xc860a3df;
+		index &= mask;
+		index ^= index >> 5;
+	} while (index >= n);
+
+	return (index + key) % n;
+}
+
+void Sampler::GetSample(int i, int j, int sample, int samples_per_pixel,
+						float* output_location)
+{
+	unsigned int pixel_hash = Hash(i, j, seed);
+
+	switch (type)
+	{
+	case SamplerType::Center:
+	{
+		output_location[0] = 0.5f;
+		output_location[1] = 0.5f;
+		break;
+	}
+	case SamplerType::Stratified:
+	{
+		// The grid has exactly one cell per sample of a set, so that a whole
+		// set covers the pixel evenly.  Its columns are the largest divisor
+		// of the set size up to its square root, which keeps the cells as
+		// square as the size allows.
+		int cells = samples_per_pixel > 0 ? samples_per_pixel : 1;
+		int columns = (int)sqrt((double)cells);
+		while (cells % columns != 0)
+			columns--;
+		int rows = cells / columns;
+
+		// Each set visits the cells in its own shuffled order, so a set that
+		// is cut short, like the last pass of a progressive render, is still
+		// spread evenly over the pixel rather than missing one side of it.
+		int set = sample / cells;
+		int cell = Permute(sample % cells, cells, Hash(pixel_hash, set, 2));
+
+		unsigned int jitter = Hash(pixel_hash, sample, set);
+		output_location[0] = ((cell % columns) + ToUnitFloat(jitter)) / columns;
+		output_location[1] = ((cell / columns) + ToUnitFloat(Hash(jitter, 1, 0))) / rows;
+		break;
+	}
+	case SamplerType::Halton:
+	{
+		// A Cranley-Patterson rotation per pixel keeps the low discrepancy of
+		// the sequence within the pixel while decorrelating neighbours.
+		float x = RadicalInverse(sample, 2) + ToUnitFloat(pixel_hash);
+		float y = RadicalInverse(sample, 3) + ToUnitFloat(Hash(pixel_hash, 1, 0));
+		output_location[0] = x - floor(x);
+		output_location[1] = y - floor(y);
+		break;
+	}
+	case SamplerType::Sobol:
+	{
+		// Random digit scrambling (XOR with a per-pixel value) preserves the
+		// stratification of every power of two prefix of the sequence.
+		unsigned int x = 0;
+		for (unsigned int index = sample, bit = 1u << 31; index > 0; index >>= 1, bit >>= 1)
+		{
+			if (index & 1)
+				x |= bit;
+		}
+
+		output_location[0] = ToUnitFloat(x ^ pixel_hash);
+		output_location[1] = ToUnitFloat(SobolSecondDimension(sample) ^
+										 Hash(pixel_hash, 1, 0));
+		break;
+	}
+	case SamplerType::BlueNoise:
+	{
+		// Interleaved gradient noise gives each pixel an offset that differs
+		// strongly from its neighbours, so the error of the R2 sequence is
+		// pushed into high frequencies where it is least visible.
+		float noise = 52.9829189f * fmod(0.06711056f * i + 0.00583715f * j, 1.0f);
+		noise = noise - floor(noise);
+
+		float x = noise + 0.7548776662f * (sample + 1);
+		float y = noise + 0.5698402910f * (sample + 1);
+		output_location[0] = x - floor(x);
+		output_location[1] = y - floor(y);
+		break;
+	}
+	}
+}
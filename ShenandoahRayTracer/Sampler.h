@@ -0,0 +1,101 @@
+#pragma once
+
+#include <math.h>
+#include <stdexcept>
+#include <string>
+
+// The sample patterns that can be used to place rays within a pixel.
+enum class SamplerType
+{
+	// Every sample goes through the centre of the pixel.  Only useful for
+	// matching the old single-sample output.
+	Center,
+	// Jittered samples, one per cell of a grid over the pixel.
+	Stratified,
+	// The Halton sequence in bases 2 and 3.
+	Halton,
+	// The first two dimensions of the Sobol sequence, a (0,2)-sequence, so
+	// every power of two prefix is stratified.
+	Sobol,
+	// The R2 sequence offset per pixel by interleaved gradient noise, which
+	// spreads the remaining error as high-frequency (blue) noise.
+	BlueNoise
+};
+
+/** Generates the positions of samples within pixels.
+
+Samples are identified by their index within the pixel, so a sampler always
+returns the same position for the same pixel and index.  This allows samples
+to be generated in batches (all of the samples of a pixel traced together)
+and continued later (progressive rendering) without storing any state.
+
+Each pixel uses a different scramble or offset of the pattern so that
+neighbouring pixels don't share the same error, which would show up as
+structured artifacts.
+
+*/
+class Sampler
+{
+public:
+	Sampler();
+	Sampler(SamplerType _type, unsigned int _seed);
+
+	SamplerType GetType();
+	unsigned int GetSeed();
+
+	/**
+	* @brief Generates the positions of a range of samples within a pixel.
+	*
+	* @param i The x coordinate of the pixel.
+	* @param j The y coordinate of the pixel.
+	* @param first_sample The index of the first sample to be generated.
+	* @param num_samples The number of samples to be generated.
+	* @param samples_per_pixel The number of samples in a whole set, such as
+	* a pass.  Only used by samplers that need to know it up front, such as
+	* the stratified sampler, which splits each set of this many samples
+	* between the cells of a grid.
+	* @param output_location A float array with minimum size 2 * num_samples.
+	* Each position is in [0, 1) in both dimensions.
+	*/
+	void GetPixelSamples(int i, int j, int first_sample, int num_samples,
+						 int samples_per_pixel, float* output_location);
+
+	/**
+	* @brief Parses a sampler name, such as "sobol".
+	*
+	* @param name The name of the sampler.
+	*
+	* @return The sampler type.
+	*/
+	static SamplerType ParseSamplerType(std::string name);
+
+	// Integer hash used for jitter and per-pixel scrambling.  Returns a well
+	// mixed value for any combination of inputs.
+	static unsigned int Hash(unsigned int a, unsigned int b, unsigned int c);
+
+	// Converts the top 24 bits of an integer to a float in [0, 1).
+	static float ToUnitFloat(unsigned int bits);
+
+	static float RadicalInverse(unsigned int index, unsigned int base);
+	static unsigned int SobolSecondDimension(unsigned int index);
+
+	/**
+	* @brief Shuffles the numbers below n, using Kensler's hashed permutation
+	* from "Correlated Multi-Jittered Sampling", so that any part of a set
+	* of cells visited in this order is spread evenly over them.
+	*
+	* @param index The position in the shuffled order.
+	* @param n The number of values.
+	* @param key Picks the permutation.
+	*
+	* @return The value at that position, below n.
+	*/
+	static unsigned int Permute(unsigned int index, unsigned int n, unsigned int key);
+
+private:
+	SamplerType type = SamplerType::Sobol;
+	unsigned int seed = 0;
+
+	void GetSample(int i, int j, int sample, int samples_per_pixel,
+				   float* output_location);
+};
@@ -0,0 +1,595 @@
+#include "SceneDescription.h"
+
+SceneDescription::SceneDescription()
+{
+
+}
+
+SceneDescription::SceneDescription(std::string file_location)
+{
+	std::ifstream file(file_location);
+
+	if (!file)
+		throw std::invalid_argument("Scene description file not found: " +
+									file_location);
+
+	// Object paths are relative to the scene file so that a scene and its
+	// meshes can be moved around together.
+	size_t separator = file_location.find_last_of("/\\");
+	if (separator != std::string::npos)
+		base_directory = file_location.substr(0, separator + 1);
+
+	std::string line;
+	int line_number = 0;
+	while (std::getline(file, line))
+	{
+		line_number++;
+		ParseLine(line, line_number);
+	}
+}
+
+bool SceneDescription::IsSequence()
+{
+	return last_frame >= first_frame;
+}
+
+Camera SceneDescription::CreateCamera()
+{
+	return Camera(camera_origin, camera_up, camera_right, resolution_x,
+				  resolution_y, vertical_fov, focal_length);
+}
+
+void SceneDescription::LoadObjects(std::vector<ObjectHandler*>* output)
+{
+	std::map<std::string, std::shared_ptr<const MipmappedTexture>> textures;
+	// The objects first loaded from each file, which later objects from the
+	// same file share their geometry with.
+	std::map<std::string, std::vector<ObjectHandler*>> files;
+	// The first object with each welded mesh, by the hash of its geometry.
+	std::unordered_multimap<size_t, ObjectHandler*> welded_meshes;
+
+	if (!geometry_cache_location.empty() && !geometry_cache)
+	{
+		geometry_cache = std::make_shared<GeometryCache>(geometry_cache_location,
+														 (size_t)geometry_cache_size << 20);
+	}
+
+	for (int i = 0; i < objects.size(); i++)
+	{
+		Material material = objects[i].material;
+
+		std::string texture_location = objects[i].texture_location;
+		if (!texture_location.empty())
+		{
+			if (!texture_cache)
+				texture_cache = std::make_shared<TextureCache>((size_t)texture_cache_size << 20);
+
+			if (textures.count(texture_location) == 0)
+			{
+				textures[texture_location] =
+					std::make_shared<const MipmappedTexture>(texture_location,
+															 texture_cache);
+			}
+
+			TexturedMaterial textured;
+			textured.texture = textures[texture_location];
+			material = textured;
+		}
+
+		// Files can hold several objects, which are all placed by the
+		// description's transform, on top of their own placement in the file.
+		std::string file_location = objects[i].file_location;
+		std::vector<ObjectHandler*> loaded;
+		if (files.count(file_location) == 0)
+		{
+			MeshImporter::Load(file_location, &loaded);
+			files[file_location] = loaded;
+
+			// Objects within a file that already share their geometry (such
+			// as glTF instances) are only cleaned up once.  The originals
+			// keep the geometry as it was loaded, to match them against.
+			std::vector<ObjectHandler> originals;
+			std::vector<ObjectHandler*> cleaned;
+			for (int j = 0; j < loaded.size(); j++)
+			{
+				int k = 0;
+				while (k < originals.size() && !loaded[j]->SharesGeometry(originals[k]))
+					k++;
+
+				if (k < originals.size())
+				{
+					loaded[j]->ShareGeometry(*cleaned[k]);
+					continue;
+				}
+
+				originals.push_back(loaded[j]->Instance());
+				CleanUpMesh(loaded[j], &welded_meshes);
+				cleaned.push_back(loaded[j]);
+			}
+		}
+		else
+		{
+			std::vector<ObjectHandler*>& first = files[file_location];
+			for (int j = 0; j < first.size(); j++)
+				loaded.push_back(new ObjectHandler(first[j]->Instance()));
+		}
+
+		for (int j = 0; j < loaded.size(); j++)
+		{
+			ObjectHandler* object = loaded[j];
+
+			if (loaded.size() == 1 || object->name.empty())
+				object->name = objects[i].name;
+			else
+				object->name = objects[i].name + "/" + object->name;
+
+			Transform transform = Transform(objects[i].origin, objects[i].angles,
+											objects[i].scale);
+			transform.SetLocalMatrix(object->transform.GetLocalMatrix());
+			object->transform = transform;
+			object->material = material;
+
+			output->push_back(object);
+			object_descriptions.push_back(i);
+		}
+	}
+}
+
+void SceneDescription::CleanUpMesh(ObjectHandler* object,
+								   std::unordered_multimap<size_t, ObjectHandler*>* welded_meshes)
+{
+	if (weld_meshes)
+	{
+		WeldStatistics welded = object->Weld();
+		weld_statistics.vertices_removed += welded.vertices_removed;
+		weld_statistics.uvs_removed += welded.uvs_removed;
+		weld_statistics.triangles_removed += welded.triangles_removed;
+	}
+
+	// Reordering always gives the same result for the same mesh, so it can
+	// happen before duplicates are looked for.
+	if (reorder_meshes)
+		object->Reorder();
+
+	if (weld_meshes)
+	{
+		// A mesh that is the same as an earlier one shares its geometry, as
+		// if it came from the same file.
+		size_t hash = object->GetGeometryHash();
+		auto range = welded_meshes->equal_range(hash);
+		for (auto match = range.first; match != range.second; match++)
+		{
+			if (object->HasSameGeometry(*match->second))
+			{
+				object->ShareGeometry(*match->second);
+				duplicate_meshes++;
+				return;
+			}
+		}
+
+		welded_meshes->emplace(hash, object);
+	}
+}
+
+RenderMode SceneDescription::ParseRenderMode(std::string name)
+{
+	if (name == "shaded" || name == "uv")
+		return RenderMode::Shaded;
+	if (name == "heatmap")
+		return RenderMode::TraversalHeatmap;
+
+	throw std::invalid_argument("Unknown render mode: " + name);
+}
+
+ExecutionMode SceneDescription::ParseExecutionMode(std::string name)
+{
+	if (name == "depthfirst")
+		return ExecutionMode::DepthFirst;
+	if (name == "wavefront")
+		return ExecutionMode::Wavefront;
+
+	throw std::invalid_argument("Unknown execution mode: " + name);
+}
+
+MeshEncoding SceneDescription::ParseMeshEncoding(std::string name)
+{
+	if (name == "exact")
+		return MeshEncoding::Exact;
+	if (name == "compact")
+		return MeshEncoding::Compact;
+
+	throw std::invalid_argument("Unknown mesh encoding: " + name);
+}
+
+std::string SceneDescription::GetAOVLocation(std::string output_location,
+											AOVType type)
+{
+	// Only an extension after the last directory separator is replaced.
+	size_t dot = output_location.find_last_of('.');
+	size_t separator = output_location.find_last_of("/\\");
+	if (dot != std::string::npos &&
+		(separator == std::string::npos || dot > separator))
+		output_location = output_location.substr(0, dot);
+
+	return output_location + "_" + FrameBuffer::GetAOVName(type) + ".pfm";
+}
+
+void SceneDescription::ParseLine(std::string line, int line_number)
+{
+	// Everything after a '#' that starts a word is a comment.  A '#' within a
+	// word is kept, since sequence output locations use it for frame numbers.
+	for (int i = 0; i < line.size(); i++)
+	{
+		if (line[i] == '#' && (i == 0 || isspace(line[i - 1])))
+		{
+			line = line.substr(0, i);
+			break;
+		}
+	}
+
+	std::istringstream stream(line);
+	std::string setting;
+
+	if (!(stream >> setting))
+		return;
+
+	std::string line_prefix = "Line " + std::to_string(line_number) + ": ";
+
+	if (setting == "resolution")
+	{
+		if (!(stream >> resolution_x >> resolution_y) || resolution_x <= 0 ||
+			resolution_y <= 0)
+			throw std::invalid_argument(line_prefix + "Invalid resolution.");
+	}
+	else if (setting == "threads")
+	{
+		if (!(stream >> threads) || threads <= 0)
+			throw std::invalid_argument(line_prefix + "Invalid thread count.");
+	}
+	else if (setting == "samples")
+	{
+		if (!(stream >> samples_per_pixel) || samples_per_pixel <= 0)
+			throw std::invalid_argument(line_prefix + "Invalid sample count.");
+	}
+	else if (setting == "sampler")
+	{
+		std::string name;
+		stream >> name;
+		sampler = Sampler::ParseSamplerType(name);
+	}
+	else if (setting == "filter")
+	{
+		std::string name;
+		stream >> name;
+		filter = ReconstructionFilter::ParseFilterType(name);
+	}
+	else if (setting == "adaptive")
+	{
+		if (!(stream >> adaptive_threshold) || adaptive_threshold < 0)
+			throw std::invalid_argument(line_prefix + "Invalid adaptive threshold.");
+
+		// The minimum number of samples is optional.
+		int min_samples;
+		if (stream >> min_samples)
+		{
+			if (min_samples <= 0)
+				throw std::invalid_argument(line_prefix +
+											"Invalid adaptive minimum samples.");
+			adaptive_min_samples = min_samples;
+		}
+	}
+	else if (setting == "time_budget")
+	{
+		if (!(stream >> time_budget) || time_budget < 0)
+			throw std::invalid_argument(line_prefix + "Invalid time budget.");
+	}
+	else if (setting == "progressive")
+	{
+		if (!(stream >> progressive_pass_samples) || progressive_pass_samples < 0)
+			throw std::invalid_argument(line_prefix + "Invalid progressive pass samples.");
+	}
+	else if (setting == "checkpoint")
+	{
+		std::string path;
+		if (!(stream >> path))
+			throw std::invalid_argument(line_prefix + "Missing checkpoint location.");
+		checkpoint_location = ResolvePath(base_directory, path);
+
+		if (!(stream >> checkpoint_interval))
+			checkpoint_interval = 60;
+		else if (checkpoint_interval < 0)
+			throw std::invalid_argument(line_prefix + "Invalid checkpoint interval.");
+	}
+	else if (setting == "denoise")
+	{
+		if (!(stream >> denoise_iterations) || denoise_iterations < 0 ||
+			denoise_iterations > 10)
+			throw std::invalid_argument(line_prefix + "Invalid denoiser iterations.");
+	}
+	else if (setting == "output")
+	{
+		if (!(stream >> output_location))
+			throw std::invalid_argument(line_prefix + "Missing output location.");
+
+		// The format is optional, and defaults to plain text.
+		std::string format;
+		if (stream >> format)
+			output_format = format;
+	}
+	else if (setting == "aovs")
+	{
+		aovs.clear();
+		std::string name;
+		while (stream >> name)
+			aovs.push_back(FrameBuffer::ParseAOVType(name));
+	}
+	else if (setting == "mode")
+	{
+		std::string name;
+		stream >> name;
+		mode = ParseRenderMode(name);
+	}
+	else if (setting == "integrator")
+	{
+		stream >> integrator;
+		if (integrator != "uv" && integrator != "path")
+			throw std::invalid_argument(line_prefix + "Unknown integrator: " +
+										integrator);
+	}
+	else if (setting == "execution")
+	{
+		std::string name;
+		stream >> name;
+		execution = ParseExecutionMode(name);
+	}
+	else if (setting == "mesh_encoding")
+	{
+		std::string name;
+		stream >> name;
+		mesh_encoding = ParseMeshEncoding(name);
+	}
+	else if (setting == "weld_meshes")
+	{
+		int value;
+		if (!(stream >> value) || (value != 0 && value != 1))
+			throw std::invalid_argument(line_prefix + "Invalid mesh welding setting.");
+		weld_meshes = value == 1;
+	}
+	else if (setting == "reorder_meshes")
+	{
+		int value;
+		if (!(stream >> value) || (value != 0 && value != 1))
+			throw std::invalid_argument(line_prefix + "Invalid mesh reordering setting.");
+		reorder_meshes = value == 1;
+	}
+	else if (setting == "max_depth")
+	{
+		if (!(stream >> max_depth) || max_depth <= 0)
+			throw std::invalid_argument(line_prefix + "Invalid maximum depth.");
+	}
+	else if (setting == "texture_cache")
+	{
+		if (!(stream >> texture_cache_size) || texture_cache_size <= 0)
+			throw std::invalid_argument(line_prefix + "Invalid texture cache size.");
+	}
+	else if (setting == "geometry_cache")
+	{
+		std::string path;
+		if (!(stream >> path >> geometry_cache_size) || geometry_cache_size <= 0)
+			throw std::invalid_argument(line_prefix + "Invalid geometry cache.");
+		geometry_cache_location = ResolvePath(base_directory, path);
+	}
+	else if (setting == "light")
+	{
+		Vector3 position = ReadVector3(&stream, "light position", line_number);
+		Vector3 intensity = ReadVector3(&stream, "light intensity", line_number);
+
+		PointLight light;
+		position.Copy(light.position);
+		intensity.Copy(light.intensity);
+		lights.push_back(light);
+	}
+	else if (setting == "background")
+		background = ReadVector3(&stream, "background", line_number);
+	else if (setting == "camera")
+	{
+		std::string property;
+		stream >> property;
+
+		if (property == "origin")
+			camera_origin = ReadVector3(&stream, "camera origin", line_number);
+		else if (property == "up")
+			camera_up = ReadVector3(&stream, "camera up", line_number);
+		else if (property == "right")
+			camera_right = ReadVector3(&stream, "camera right", line_number);
+		else if (property == "fov")
+		{
+			if (!(stream >> vertical_fov))
+				throw std::invalid_argument(line_prefix + "Invalid camera fov.");
+		}
+		else if (property == "key")
+			ParseCameraKeyframe(&stream, line_number);
+		else if (property == "focal")
+		{
+			if (!(stream >> focal_length))
+				throw std::invalid_argument(line_prefix + "Invalid camera focal.");
+		}
+		else
+			throw std::invalid_argument(line_prefix + "Unknown camera property: " +
+										property);
+	}
+	else if (setting == "object")
+	{
+		SceneObjectDescription object;
+		std::string path;
+
+		if (!(stream >> object.name >> path))
+			throw std::invalid_argument(line_prefix +
+										"Objects need a name and a file.");
+
+		object.file_location = ResolvePath(base_directory, path);
+
+		objects.push_back(object);
+	}
+	else if (setting == "frames")
+	{
+		if (!(stream >> first_frame >> last_frame) || last_frame < first_frame)
+			throw std::invalid_argument(line_prefix + "Invalid frame range.");
+	}
+	else if (setting == "key")
+	{
+		if (objects.empty())
+			throw std::invalid_argument(line_prefix +
+										"key must come after an object.");
+
+		ParseKeyframe(&stream, line_number);
+	}
+	else if (setting == "material")
+	{
+		if (objects.empty())
+			throw std::invalid_argument(line_prefix +
+										"material must come after an object.");
+
+		ParseMaterial(&stream, line_number);
+	}
+	else if (setting == "position" || setting == "rotation" || setting == "scale")
+	{
+		if (objects.empty())
+			throw std::invalid_argument(line_prefix + setting +
+										" must come after an object.");
+
+		Vector3 value = ReadVector3(&stream, setting, line_number);
+
+		if (setting == "position")
+			objects.back().origin = value;
+		else if (setting == "rotation")
+			objects.back().angles = value;
+		else
+			objects.back().scale = value;
+	}
+	else
+		throw std::invalid_argument(line_prefix + "Unknown setting: " + setting);
+}
+
+void SceneDescription::ParseKeyframe(std::istringstream* stream, int line_number)
+{
+	SceneObjectDescription& object = objects.back();
+
+	TransformKeyframe keyframe;
+	keyframe.origin = object.origin;
+	keyframe.angles = object.angles;
+	keyframe.scale = object.scale;
+
+	if (!(*stream >> keyframe.frame))
+		throw std::invalid_argument("Line " + std::to_string(line_number) +
+									": key needs a frame number.");
+
+	std::string property;
+	while (*stream >> property)
+	{
+		if (property == "position")
+			keyframe.origin = ReadVector3(stream, "key position", line_number);
+		else if (property == "rotation")
+			keyframe.angles = ReadVector3(stream, "key rotation", line_number);
+		else if (property == "scale")
+			keyframe.scale = ReadVector3(stream, "key scale", line_number);
+		else
+			throw std::invalid_argument("Line " + std::to_string(line_number) +
+										": Unknown key property: " + property);
+	}
+
+	object.keyframes.push_back(keyframe);
+}
+
+void SceneDescription::ParseCameraKeyframe(std::istringstream* stream,
+										   int line_number)
+{
+	CameraKeyframe keyframe;
+	keyframe.origin = camera_origin;
+	keyframe.up = camera_up;
+	keyframe.right = camera_right;
+
+	if (!(*stream >> keyframe.frame))
+		throw std::invalid_argument("Line " + std::to_string(line_number) +
+									": camera key needs a frame number.");
+
+	std::string property;
+	while (*stream >> property)
+	{
+		if (property == "origin")
+			keyframe.origin = ReadVector3(stream, "camera key origin", line_number);
+		else if (property == "up")
+			keyframe.up = ReadVector3(stream, "camera key up", line_number);
+		else if (property == "right")
+			keyframe.right = ReadVector3(stream, "camera key right", line_number);
+		else
+			throw std::invalid_argument("Line " + std::to_string(line_number) +
+										": Unknown camera key property: " +
+										property);
+	}
+
+	camera_keyframes.push_back(keyframe);
+}
+
+void SceneDescription::ParseMaterial(std::istringstream* stream, int line_number)
+{
+	SceneObjectDescription& object = objects.back();
+	std::string line_prefix = "Line " + std::to_string(line_number) + ": ";
+
+	std::string type;
+	*stream >> type;
+	object.texture_location = "";
+
+	if (type == "diffuse")
+	{
+		DiffuseMaterial material;
+		ReadVector3(stream, "diffuse albedo", line_number).Copy(material.albedo);
+		object.material = material;
+	}
+	else if (type == "glossy")
+	{
+		GlossyMaterial material;
+		ReadVector3(stream, "glossy color", line_number).Copy(material.color);
+		if (!(*stream >> material.exponent) || material.exponent < 0)
+			throw std::invalid_argument(line_prefix + "Invalid glossy exponent.");
+		object.material = material;
+	}
+	else if (type == "emissive")
+	{
+		EmissiveMaterial material;
+		ReadVector3(stream, "emissive radiance", line_number).Copy(material.radiance);
+		object.material = material;
+	}
+	else if (type == "texture")
+	{
+		std::string path;
+		if (!(*stream >> path))
+			throw std::invalid_argument(line_prefix + "texture needs a file.");
+
+		// The texture itself is loaded with the objects.
+		object.texture_location = ResolvePath(base_directory, path);
+	}
+	else
+		throw std::invalid_argument(line_prefix + "Unknown material: " + type);
+}
+
+std::string SceneDescription::ResolvePath(std::string directory,
+										  std::string path)
+{
+	// Absolute paths are used as-is, both in Unix and Windows form.
+	if (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'))
+		return path;
+
+	return directory + path;
+}
+
+Vector3 SceneDescription::ReadVector3(std::istringstream* stream,
+									  std::string setting, int line_number)
+{
+	float x, y, z;
+	if (!(*stream >> x >> y >> z))
+		throw std::invalid_argument("Line " + std::to_string(line_number) +
+									": " + setting + " needs three values.");
+
+	return Vector3(x, y, z);
+}
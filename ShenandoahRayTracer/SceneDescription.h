@@ -0,0 +1,259 @@
+#pragma once
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+#include "Device.h"
+#include "Light.h"
+#include "MeshImporter.h"
+#include "ObjectHandler.h"
+#include "SequenceRenderer.h"
+
+// The settings for a single object within a scene description.
+struct SceneObjectDescription
+{
+	std::string name;
+	std::string file_location;
+	Vector3 origin = Vector3(0, 0, 0);
+	Vector3 angles = Vector3(0, 0, 0);
+	Vector3 scale = Vector3(1, 1, 1);
+
+	Material material;
+	// Set for textured materials, which get their texture when the objects
+	// are loaded.
+	std::string texture_location;
+
+	std::vector<TransformKeyframe> keyframes;
+};
+
+/** Everything needed to render a frame without recompiling.
+
+A scene description is a plain text file with one setting per line.  Blank
+lines and anything after a '#' at the start of a word are ignored.  Object transforms apply to the
+most recently declared object, and relative object paths are resolved against
+the directory of the scene file.
+
+	resolution 500 500
+	threads 8
+	samples 1
+	sampler sobol
+	filter box
+	adaptive 0.01 8
+	time_budget 0
+	progressive 0
+	checkpoint render.ckpt 60
+	denoise 0
+	output render.ppm ppm
+	mode shaded
+	integrator path
+	execution wavefront
+	mesh_encoding exact
+	weld_meshes 0
+	reorder_meshes 0
+	geometry_cache geometry.bin 256
+	max_depth 5
+	light 0 -2 3 20 20 20
+	background 0.1 0.1 0.1
+	camera origin 0 0 0
+	camera up 0 0 1
+	camera right 1 0 0
+	camera fov 90
+	camera focal 1
+	object monkey MonkeyOnly.obj
+	position 0 -5 0
+	rotation 0 0 0
+	scale 1 1 1
+	material glossy 0.9 0.6 0.2 40
+
+Animations are described with a frame range and keyframes.  Object keyframes
+apply to the most recently declared object, and any part of the transform
+that a keyframe leaves out is taken from the object's static transform.
+Camera keyframes work the same way with the camera vectors.  The output
+location of an animation needs a run of '#' for the frame number.
+
+	frames 0 47
+	output turntable_####.ppm ppm
+	key 0 rotation 0 0 0
+	key 47 rotation 0 0 352.5
+	camera key 0 origin 0 0 0
+	camera key 47 origin 0 2 0
+
+*/
+class SceneDescription
+{
+public:
+	std::vector<SceneObjectDescription> objects;
+
+	Vector3 camera_origin = Vector3(0, 0, 0);
+	Vector3 camera_up = Vector3(0, 0, 1);
+	Vector3 camera_right = Vector3(1, 0, 0);
+	float vertical_fov = 90;
+	float focal_length = 1;
+
+	int resolution_x = 500;
+	int resolution_y = 500;
+	int threads = 1;
+	int samples_per_pixel = 1;
+	SamplerType sampler = SamplerType::Sobol;
+	FilterType filter = FilterType::Box;
+	float adaptive_threshold = 0; // 0 disables adaptive sampling.
+	int adaptive_min_samples = 8;
+	int time_budget = 0; // In milliseconds, 0 for no limit.
+	int progressive_pass_samples = 0; // 0 renders the frame in one go.
+	// Where progressive renders save checkpoints to be resumed from, or empty
+	// for none, and the least time between them in seconds.
+	std::string checkpoint_location = "";
+	int checkpoint_interval = 60;
+	int denoise_iterations = 0; // 0 disables the denoiser.
+	RenderMode mode = RenderMode::Shaded;
+	ExecutionMode execution = ExecutionMode::DepthFirst;
+	MeshEncoding mesh_encoding = MeshEncoding::Exact;
+
+	// Whether LoadObjects welds every mesh it loads, and shares meshes from
+	// different files that turn out to be the same.
+	bool weld_meshes = false;
+	// What welding removed, and how many meshes were shared because of it.
+	WeldStatistics weld_statistics;
+	int duplicate_meshes = 0;
+	// Whether LoadObjects sorts the triangles of every mesh it loads so that
+	// neighbouring triangles are next to each other in memory.
+	bool reorder_meshes = false;
+
+	// Either "uv" or "path".  The path tracer settings are only used by "path".
+	std::string integrator = "uv";
+	int max_depth = 5;
+	std::vector<PointLight> lights;
+	Vector3 background = Vector3(0, 0, 0);
+
+	// The most memory the tiles of every texture can take, in megabytes.
+	int texture_cache_size = 256;
+	// Shared by every texture, and created by LoadObjects if any object is
+	// textured.
+	std::shared_ptr<TextureCache> texture_cache;
+
+	// Where streamed geometry is written, or empty to keep every object's
+	// geometry in memory.
+	std::string geometry_cache_location = "";
+	// The most memory the loaded clusters of streamed objects can take, in
+	// megabytes.
+	int geometry_cache_size = 256;
+	// Created by LoadObjects if geometry_cache_location is set.
+	std::shared_ptr<GeometryCache> geometry_cache;
+
+	std::string output_location = "output.txt";
+	std::string output_format = "txt";
+	// Written next to the output, one PFM file per AOV.
+	std::vector<AOVType> aovs;
+
+	// A sequence is rendered instead of a single frame when last_frame is at
+	// least first_frame.
+	int first_frame = 0;
+	int last_frame = -1;
+	std::vector<CameraKeyframe> camera_keyframes;
+
+	// The index of the description each object loaded by LoadObjects came
+	// from, since one file can hold several objects.
+	std::vector<int> object_descriptions;
+
+	bool IsSequence();
+
+	/**
+	* @brief Creates a scene description with the default settings and no
+	* objects.
+	*/
+	SceneDescription();
+
+	/**
+	* @brief Loads a scene description from a file.  Throws an
+	* std::invalid_argument naming the offending line if the file can't be
+	* read or contains an unknown setting.
+	*
+	* @param file_location The location of the scene description file.
+	*/
+	SceneDescription(std::string file_location);
+
+	/**
+	* @brief Creates the camera described by the scene.
+	*
+	* @return The camera, with the scene's resolution.
+	*/
+	Camera CreateCamera();
+
+	/**
+	* @brief Loads every object in the scene and applies its transform and
+	* material.  Object files can be .obj, .ply, .gltf, or .glb, and files
+	* with several objects add all of them, recording which description each
+	* came from in object_descriptions.  Textures used by several objects are
+	* only opened once, and
+	* all of them share one texture cache.  Objects loaded from the same file
+	* share their geometry, as do meshes from different files that are the
+	* same once welded, if welding is on.  The geometry cache is created here
+	* too, if the scene streams its geometry.  The caller takes ownership of the
+	* new ObjectHandlers.
+	*
+	* @param output The vector the loaded objects are appended to.
+	*/
+	void LoadObjects(std::vector<ObjectHandler*>* output);
+
+	/**
+	* @brief Parses a render mode name, either "shaded" or "heatmap".  "uv"
+	* is accepted as another name for "shaded", as it was before integrators.
+	*
+	* @param name The name of the render mode.
+	*
+	* @return The render mode.
+	*/
+	static RenderMode ParseRenderMode(std::string name);
+
+	/**
+	* @brief Parses an execution mode name, either "depthfirst" or
+	* "wavefront".
+	*
+	* @param name The name of the execution mode.
+	*
+	* @return The execution mode.
+	*/
+	static ExecutionMode ParseExecutionMode(std::string name);
+
+	/**
+	* @brief Parses a mesh encoding name, either "exact" or "compact".
+	*
+	* @param name The name of the mesh encoding.
+	*
+	* @return The mesh encoding.
+	*/
+	static MeshEncoding ParseMeshEncoding(std::string name);
+
+	/**
+	* @brief Finds where an AOV is written, which is the output location with
+	* the AOV's name added and a .pfm extension, such as render_depth.pfm.
+	*
+	* @param output_location The location of the main output.
+	* @param type The AOV.
+	*
+	* @return The location of the AOV.
+	*/
+	static std::string GetAOVLocation(std::string output_location, AOVType type);
+
+private:
+	std::string base_directory = "";
+
+	// Welds, reorders, and looks for an earlier copy of a newly loaded mesh,
+	// as the settings ask for.
+	void CleanUpMesh(ObjectHandler* object,
+					 std::unordered_multimap<size_t, ObjectHandler*>* welded_meshes);
+
+	void ParseLine(std::string line, int line_number);
+	void ParseKeyframe(std::istringstream* stream, int line_number);
+	void ParseCameraKeyframe(std::istringstream* stream, int line_number);
+	void ParseMaterial(std::istringstream* stream, int line_number);
+	static std::string ResolvePath(std::string directory, std::string path);
+	static Vector3 ReadVector3(std::istringstream* stream, std::string setting,
+							   int line_number);
+};
@@ -0,0 +1,274 @@
+#include "SequenceRenderer.h"
+
+SequenceRenderer::SequenceRenderer(CPUDevice* _device,
+								   std::vector<ObjectHandler*>* _objects,
+								   Camera _camera)
+{
+	device = _device;
+	objects = _objects;
+	camera = _camera;
+}
+
+void SequenceRenderer::AddTransformKeyframe(ObjectHandler* object,
+											TransformKeyframe keyframe)
+{
+	int index = -1;
+	for (int i = 0; i < animated_objects.size(); i++)
+	{
+		if (animated_objects[i] == object)
+			index = i;
+	}
+
+	if (index == -1)
+	{
+		animated_objects.push_back(object);
+		transform_keyframes.emplace_back();
+		index = animated_objects.size() - 1;
+	}
+
+	// Keyframes are kept sorted by frame so that interpolation only has to
+	// find the first keyframe after the current frame.
+	std::vector<TransformKeyframe>& keyframes = transform_keyframes[index];
+	int position = 0;
+	while (position < keyframes.size() && keyframes[position].frame <= keyframe.frame)
+		position++;
+
+	keyframes.insert(keyframes.begin() + position, keyframe);
+}
+
+void SequenceRenderer::AddCameraKeyframe(CameraKeyframe keyframe)
+{
+	int position = 0;
+	while (position < camera_keyframes.size() &&
+		   camera_keyframes[position].frame <= keyframe.frame)
+		position++;
+
+	camera_keyframes.insert(camera_keyframes.begin() + position, keyframe);
+}
+
+void SequenceRenderer::SetTraceRecorder(TraceRecorder* recorder)
+{
+	trace = recorder;
+}
+
+void SequenceRenderer::Render(int first_frame, int last_frame, int max_threads,
+							  std::string output_location,
+							  std::string output_format)
+{
+	if (last_frame < first_frame)
+		throw std::invalid_argument("The last frame comes before the first.");
+
+	// Checked up front so that a bad location fails before anything renders,
+	// rather than on the write thread.
+	GetFrameLocation(output_location, first_frame);
+
+	if (trace != nullptr)
+	{
+		trace->SetThreadName(UPDATE_THREAD_ID, "Update");
+		trace->SetThreadName(WRITE_THREAD_ID, "Write");
+	}
+
+	// The first frame can't be overlapped with anything, so it is prepared
+	// up front.  The second scene only exists so that it can be refit while
+	// the first is rendering.
+	ApplyKeyframes(first_frame);
+	PreparedScene rendering_scene = PreparedScene(objects, device->GetMeshEncoding(),
+												  device->GetGeometryCache());
+	PreparedScene updating_scene = rendering_scene;
+	device->SwapPreparedScene(&rendering_scene);
+
+	int buffer_size = camera.GetResolutionX() * camera.GetResolutionY() * 3;
+	int* buffers[2] = { new int[buffer_size], new int[buffer_size] };
+
+	std::thread write_thread;
+
+	for (int frame = first_frame; frame <= last_frame; frame++)
+	{
+		int* buffer = buffers[frame % 2];
+
+		// The update for the next frame only touches the objects and the spare
+		// scene, neither of which the device reads while rendering.
+		std::thread update_thread;
+		if (frame < last_frame)
+			update_thread = std::thread(&SequenceRenderer::UpdateStage, this,
+										frame + 1, &updating_scene);
+
+		device->RenderFrame(GetFrameCamera(frame), max_threads, buffer);
+
+		if (update_thread.joinable())
+		{
+			update_thread.join();
+			device->SwapPreparedScene(&updating_scene);
+		}
+
+		// The previous frame has to be written before its buffer is reused for
+		// the next frame, which also keeps at most one write in flight.
+		if (write_thread.joinable())
+			write_thread.join();
+
+		write_thread = std::thread(&SequenceRenderer::WriteStage, this, frame,
+								   buffer, output_location, output_format);
+	}
+
+	if (write_thread.joinable())
+		write_thread.join();
+
+	delete[] buffers[0];
+	delete[] buffers[1];
+}
+
+TransformKeyframe SequenceRenderer::InterpolateTransform(
+	std::vector<TransformKeyframe>* keyframes, float frame)
+{
+	TransformKeyframe output = keyframes->front();
+
+	if (frame <= keyframes->front().frame)
+		return keyframes->front();
+	if (frame >= keyframes->back().frame)
+		return keyframes->back();
+
+	for (int i = 1; i < keyframes->size(); i++)
+	{
+		TransformKeyframe& previous = keyframes->at(i - 1);
+		TransformKeyframe& next = keyframes->at(i);
+
+		if (frame > next.frame)
+			continue;
+
+		float f = (frame - previous.frame) / (float)(next.frame - previous.frame);
+		output.frame = frame;
+		output.origin = previous.origin + (next.origin - previous.origin) * f;
+		output.angles = previous.angles + (next.angles - previous.angles) * f;
+		output.scale = previous.scale + (next.scale - previous.scale) * f;
+		break;
+	}
+
+	return output;
+}
+
+CameraKeyframe SequenceRenderer::InterpolateCamera(
+	std::vector<CameraKeyframe>* keyframes, float frame)
+{
+	CameraKeyframe output = keyframes->front();
+
+	if (frame <= keyframes->front().frame)
+		return keyframes->front();
+	if (frame >= keyframes->back().frame)
+		return keyframes->back();
+
+	for (int i = 1; i < keyframes->size(); i++)
+	{
+		CameraKeyframe& previous = keyframes->at(i - 1);
+		CameraKeyframe& next = keyframes->at(i);
+
+		if (frame > next.frame)
+			continue;
+
+		// The up and right vectors are normalized by the camera, so a linear
+		// blend is enough here.
+		float f = (frame - previous.frame) / (float)(next.frame - previous.frame);
+		output.frame = frame;
+		output.origin = previous.origin + (next.origin - previous.origin) * f;
+		output.up = previous.up + (next.up - previous.up) * f;
+		output.right = previous.right + (next.right - previous.right) * f;
+		break;
+	}
+
+	return output;
+}
+
+std::string SequenceRenderer::GetFrameLocation(std::string output_location,
+											   int frame)
+{
+	size_t end = output_location.find_last_of('#');
+	if (end == std::string::npos)
+		throw std::invalid_argument("Sequence output locations need a '#' "
+									"where the frame number goes.");
+
+	size_t start = end;
+	while (start > 0 && output_location[start - 1] == '#')
+		start--;
+
+	std::string number = std::to_string(frame);
+	while (number.size() < end - start + 1)
+		number = "0" + number;
+
+	return output_location.substr(0, start) + number +
+		   output_location.substr(end + 1);
+}
+
+void SequenceRenderer::ApplyKeyframes(int frame)
+{
+	for (int i = 0; i < animated_objects.size(); i++)
+	{
+		TransformKeyframe keyframe = InterpolateTransform(&transform_keyframes[i],
+														  frame);
+		// The local matrix is kept, so objects placed by a file's node
+		// hierarchy are animated as a whole.
+		Transform transform = Transform(keyframe.origin, keyframe.angles,
+										keyframe.scale);
+		transform.SetLocalMatrix(animated_objects[i]->transform.GetLocalMatrix());
+		animated_objects[i]->transform = transform;
+	}
+}
+
+Camera SequenceRenderer::GetFrameCamera(int frame)
+{
+	Camera frame_camera = camera;
+
+	if (camera_keyframes.empty())
+		return frame_camera;
+
+	CameraKeyframe keyframe = InterpolateCamera(&camera_keyframes, frame);
+	frame_camera.SetOrigin(keyframe.origin);
+	frame_camera.SetUp(keyframe.up);
+	frame_camera.SetRight(keyframe.right);
+
+	return frame_camera;
+}
+
+void SequenceRenderer::UpdateStage(int frame, PreparedScene* scene)
+{
+	long long update_start = GetTraceTimestamp();
+
+	ApplyKeyframes(frame);
+	scene->Refit();
+
+	AddTraceSpan("Update " + std::to_string(frame), update_start,
+				 UPDATE_THREAD_ID);
+}
+
+void SequenceRenderer::WriteStage(int frame, int* pixels,
+								  std::string output_location,
+								  std::string output_format)
+{
+	long long write_start = GetTraceTimestamp();
+
+	// Exceptions can't cross back to the render thread, so a failed write is
+	// reported and the rest of the sequence carries on.
+	try
+	{
+		ImageWriter::Write(GetFrameLocation(output_location, frame), output_format,
+						   pixels, camera.GetResolutionX(), camera.GetResolutionY());
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Frame " << frame << ": " << e.what() << std::endl;
+	}
+
+	AddTraceSpan("Write " + std::to_string(frame), write_start, WRITE_THREAD_ID);
+}
+
+long long SequenceRenderer::GetTraceTimestamp()
+{
+	if (trace == nullptr)
+		return 0;
+	return trace->GetTimestamp();
+}
+
+void SequenceRenderer::AddTraceSpan(std::string name, long long start,
+									int thread_id)
+{
+	if (trace != nullptr)
+		trace->AddSpan(name, "sequence", start, thread_id);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Camera.h"
+#include "Device.h"
+#include "ImageWriter.h"
+#include "ObjectHandler.h"
+#include "PreparedScene.h"
+#include "Trace.h"
+
+// The transform of an object at a specific frame.  Frames between two
+// keyframes are linearly interpolated, and frames outside of the keyframes
+// hold the nearest one.
+struct TransformKeyframe
+{
+	int frame;
+	Vector3 origin;
+	Vector3 angles;
+	Vector3 scale;
+};
+
+// The camera vectors at a specific frame.  Interpolated the same way as
+// TransformKeyframe.
+struct CameraKeyframe
+{
+	int frame;
+	Vector3 origin;
+	Vector3 up;
+	Vector3 right;
+};
+
+/** Renders animation sequences, such as turntables.
+
+Rendering a sequence frame by frame serializes three stages: updating the
+scene, rendering it, and writing the image.  The SequenceRenderer pipelines
+them, so that while frame N is rendering the scene for frame N+1 is updated
+and refit on one thread and the image for frame N-1 is written on another.
+
+Memory is bounded to two prepared scenes (the one being rendered and the one
+being refit) and two output buffers (the one being rendered and the one being
+written), no matter how long the sequence is.
+
+*/
+class SequenceRenderer
+{
+public:
+	// Thread ids used for the pipeline stages when tracing.  These are well
+	// above the ids used by device workers so they never collide.
+	static const int UPDATE_THREAD_ID = 1000;
+	static const int WRITE_THREAD_ID = 1001;
+
+	/**
+	* @brief Creates a sequence renderer.
+	*
+	* @param _device The device used to render each frame.
+	* @param _objects The objects in the scene.  Objects with keyframes have
+	* their transforms changed during rendering.
+	* @param _camera The camera used for every frame, other than the vectors
+	* set by camera keyframes.
+	*/
+	SequenceRenderer(CPUDevice* _device, std::vector<ObjectHandler*>* _objects,
+					 Camera _camera);
+
+	void AddTransformKeyframe(ObjectHandler* object, TransformKeyframe keyframe);
+	void AddCameraKeyframe(CameraKeyframe keyframe);
+
+	void SetTraceRecorder(TraceRecorder* recorder);
+
+	/**
+	* @brief Renders every frame from first_frame to last_frame, inclusive.
+	*
+	* @param first_frame The first frame to be rendered.
+	* @param last_frame The last frame to be rendered.
+	* @param max_threads The maximum number of render threads.
+	* @param output_location Where each frame is written.  The last run of '#'
+	* characters is replaced by the zero padded frame number, for example
+	* "frame_####.ppm".
+	* @param output_format The format passed to ImageWriter.
+	*/
+	void Render(int first_frame, int last_frame, int max_threads,
+				std::string output_location, std::string output_format);
+
+	/**
+	* @brief Finds the transform of an object at the given frame.
+	*
+	* @param keyframes The keyframes of the object, sorted by frame.
+	* @param frame The frame.
+	*
+	* @return The interpolated transform.
+	*/
+	static TransformKeyframe InterpolateTransform(
+		std::vector<TransformKeyframe>* keyframes, float frame);
+
+	static CameraKeyframe InterpolateCamera(
+		std::vector<CameraKeyframe>* keyframes, float frame);
+
+	/**
+	* @brief Replaces the last run of '#' in the location with the frame.
+	*
+	* @return The location of the frame's output.
+	*/
+	static std::string GetFrameLocation(std::string output_location, int frame);
+
+private:
+	CPUDevice* device;
+	std::vector<ObjectHandler*>* objects;
+	Camera camera;
+	TraceRecorder* trace = nullptr;
+
+	// Keyframes for each object, matched by index.
+	std::vector<ObjectHandler*> animated_objects;
+	std::vector<std::vector<TransformKeyframe>> transform_keyframes;
+	std::vector<CameraKeyframe> camera_keyframes;
+
+	// Sets the transforms of every animated object for the frame.
+	void ApplyKeyframes(int frame);
+
+	// Builds the camera for the frame.
+	Camera GetFrameCamera(int frame);
+
+	// Applies the keyframes for the frame and refits the scene to match.  Run
+	// on the update thread.
+	void UpdateStage(int frame, PreparedScene* scene);
+
+	// Writes a finished frame.  Run on the write thread.
+	void WriteStage(int frame, int* pixels, std::string output_location,
+					std::string output_format);
+
+	long long GetTraceTimestamp();
+	void AddTraceSpan(std::string name, long long start, int thread_id);
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+/** A fixed-size cache of values loaded on demand, shared by every thread.
+
+Values are identified by a 64 bit key and each has a size in bytes.  Once the
+values in the cache take more than the budget, the least recently used ones
+are dropped, so the memory they take stays bounded however many are loaded.
+
+The cache is split into shards, each with its own lock and its own share of
+the budget, and keys are spread across them by a hash.  Threads looking up
+different values then rarely wait on each other.  Values are handed out as
+shared pointers, so one that is evicted while a thread is still using it
+stays alive until the thread is done.  The TextureCache and GeometryCache
+are both built on it.
+
+*/
+template <typename Value>
+class ShardedLruCache
+{
+public:
+	// The number of independently locked parts of the cache.
+	static const int NUM_SHARDS = 16;
+
+	/**
+	* @brief Creates an empty cache.
+	*
+	* @param name What the cache holds, for the error if the size is 0.
+	* @param _max_bytes The most memory the cached values can take, which
+	* must be positive.
+	*/
+	ShardedLruCache(std::string name, size_t _max_bytes)
+	{
+		if (_max_bytes == 0)
+			throw std::invalid_argument("The " + name + " cache size must be positive.");
+
+		max_bytes = _max_bytes;
+		shard_budget = (max_bytes + NUM_SHARDS - 1) / NUM_SHARDS;
+
+		hits = 0;
+		misses = 0;
+		evictions = 0;
+	}
+
+	/**
+	* @brief Looks up a value, marking it as recently used.
+	*
+	* @param key The key of the value.
+	*
+	* @return The value, or nullptr if it isn't in the cache.
+	*/
+	std::shared_ptr<Value> Find(unsigned long long key)
+	{
+		Shard& shard = GetShard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto found = shard.lookup.find(key);
+		if (found == shard.lookup.end())
+		{
+			misses++;
+			return nullptr;
+		}
+
+		hits++;
+		shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+		return found->second->value;
+	}
+
+	/**
+	* @brief Adds a value that was just loaded, evicting the least recently
+	* used values of its shard if the shard is over budget.  The lock isn't
+	* held while values are loaded, so two threads can load the same value
+	* at once; the second one to insert it gets the first one's copy back.
+	*
+	* @param key The key of the value.
+	* @param value The loaded value.
+	* @param bytes The memory the value takes.
+	*
+	* @return The value now in the cache under the key.
+	*/
+	std::shared_ptr<Value> Insert(unsigned long long key, std::shared_ptr<Value> value,
+								  size_t bytes)
+	{
+		Shard& shard = GetShard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto found = shard.lookup.find(key);
+		if (found != shard.lookup.end())
+			return found->second->value;
+
+		shard.entries.push_front(Entry{ key, value, bytes });
+		shard.lookup[key] = shard.entries.begin();
+		shard.bytes += bytes;
+
+		// The new value is always kept, even if it is larger than the shard's
+		// budget on its own, since the caller is about to use it.
+		while (shard.bytes > shard_budget && shard.entries.size() > 1)
+		{
+			Entry& oldest = shard.entries.back();
+			shard.bytes -= oldest.bytes;
+			shard.lookup.erase(oldest.key);
+			shard.entries.pop_back();
+			evictions++;
+		}
+
+		return value;
+	}
+
+	// Drops every value.  Values still held by a thread stay alive until it
+	// is done with them.
+	void Clear()
+	{
+		for (int i = 0; i < NUM_SHARDS; i++)
+		{
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			shards[i].entries.clear();
+			shards[i].lookup.clear();
+			shards[i].bytes = 0;
+		}
+	}
+
+	size_t GetMaxBytes() { return max_bytes; }
+
+	size_t GetBytesUsed()
+	{
+		size_t total = 0;
+		for (int i = 0; i < NUM_SHARDS; i++)
+		{
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			total += shards[i].bytes;
+		}
+		return total;
+	}
+
+	// Statistics since the cache was created, for tuning its size.
+	long long GetHits() { return hits; }
+	long long GetMisses() { return misses; }
+	long long GetEvictions() { return evictions; }
+
+private:
+	struct Entry
+	{
+		unsigned long long key;
+		std::shared_ptr<Value> value;
+		size_t bytes;
+	};
+
+	// The entries of a shard are kept in order of use, most recent first, so
+	// the back of the list is always the next to be evicted.
+	struct Shard
+	{
+		std::mutex mutex;
+		std::list<Entry> entries;
+		std::unordered_map<unsigned long long, typename std::list<Entry>::iterator> lookup;
+		size_t bytes = 0;
+	};
+
+	Shard shards[NUM_SHARDS];
+	size_t max_bytes;
+	size_t shard_budget;
+
+	std::atomic<long long> hits;
+	std::atomic<long long> misses;
+	std::atomic<long long> evictions;
+
+	Shard& GetShard(unsigned long long key)
+	{
+		// Keys often differ only in their low bits, such as neighbouring
+		// tiles or clusters handed out in order, so they are mixed (the
+		// splitmix64 finalizer) to spread them across the shards.
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ull;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBull;
+		key ^= key >> 31;
+
+		return shards[key % NUM_SHARDS];
+	}
+};
@@ -0,0 +1,236 @@
+#include "SharedMemory.h"
+
+SharedMemory::SharedMemory()
+{
+
+}
+
+SharedMemory::~SharedMemory()
+{
+	Close();
+}
+
+SharedMemory::SharedMemory(SharedMemory&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		data = other.data;
+		size = other.size;
+		other.data = nullptr;
+		other.size = 0;
+#ifdef _WIN32
+		mapping = other.mapping;
+		other.mapping = nullptr;
+#endif
+	}
+	return *this;
+}
+
+SharedMemory SharedMemory::Create(std::string location, const std::vector<char>& data,
+								  size_t header_bytes)
+{
+	if (data.empty())
+		throw std::invalid_argument("Can't share an empty block of memory at " +
+									location + ".");
+	if (header_bytes > data.size())
+		throw std::invalid_argument("The header of the memory shared at " + location +
+									" is larger than the memory.");
+
+	std::string name = GetSegmentName(location);
+	if (name.empty())
+	{
+		// Written next to the file first, so that a process opening it never
+		// sees it half written.
+		std::string temporary_location = location + ".tmp";
+		{
+			std::ofstream file(temporary_location, std::ios::binary | std::ios::trunc);
+			file.write(data.data(), data.size());
+			if (!file)
+				throw std::invalid_argument("Couldn't write " + temporary_location + ".");
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary_location, location, error);
+		if (error)
+			throw std::invalid_argument("Couldn't replace " + location + ": " +
+										error.message());
+		return Open(location);
+	}
+
+#ifdef _WIN32
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+										(DWORD)((unsigned long long)data.size() >> 32),
+										(DWORD)data.size(), name.c_str());
+	if (mapping == nullptr)
+		throw std::invalid_argument("Couldn't create the shared memory " + location + ".");
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		CloseHandle(mapping);
+		throw std::invalid_argument("The shared memory " + location +
+									" is still open in another process.");
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, data.size());
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		throw std::invalid_argument("Couldn't map the shared memory " + location + ".");
+	}
+	CopyHeaderLast((char*)view, data, header_bytes);
+	UnmapViewOfFile(view);
+
+	SharedMemory memory;
+	memory.mapping = mapping;
+	memory.data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, data.size());
+	memory.size = data.size();
+	if (memory.data == nullptr)
+		throw std::invalid_argument("Couldn't map the shared memory " + location + ".");
+	return memory;
+#else
+	// Processes that have the old segment mapped keep it until they unmap
+	// it, while the name goes to the new one.
+	shm_unlink(name.c_str());
+	int handle = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (handle < 0)
+		throw std::invalid_argument("Couldn't create the shared memory " + location + ".");
+
+	void* view = MAP_FAILED;
+	if (ftruncate(handle, data.size()) == 0)
+		view = mmap(nullptr, data.size(), PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+	close(handle);
+	if (view == MAP_FAILED)
+	{
+		shm_unlink(name.c_str());
+		throw std::invalid_argument("Couldn't map the shared memory " + location + ".");
+	}
+	CopyHeaderLast((char*)view, data, header_bytes);
+	munmap(view, data.size());
+
+	return Open(location);
+#endif
+}
+
+SharedMemory SharedMemory::Open(std::string location)
+{
+	std::string name = GetSegmentName(location);
+	SharedMemory memory;
+
+#ifdef _WIN32
+	if (name.empty())
+	{
+		HANDLE file = CreateFileA(location.c_str(), GENERIC_READ,
+								  FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+								  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::invalid_argument("Couldn't open " + location + ".");
+
+		LARGE_INTEGER file_size;
+		if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+			memory.mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (memory.mapping == nullptr)
+			throw std::invalid_argument("Couldn't map " + location + ".");
+		memory.size = file_size.QuadPart;
+	}
+	else
+	{
+		memory.mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+		if (memory.mapping == nullptr)
+			throw std::invalid_argument("Couldn't open the shared memory " + location + ".");
+	}
+
+	memory.data = (const char*)MapViewOfFile(memory.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (memory.data == nullptr)
+		throw std::invalid_argument("Couldn't map " + location + ".");
+
+	// Segments don't record their size, so they are taken to be as large as
+	// the pages they were given.
+	if (!name.empty())
+	{
+		MEMORY_BASIC_INFORMATION information;
+		VirtualQuery(memory.data, &information, sizeof(information));
+		memory.size = information.RegionSize;
+	}
+#else
+	int handle = name.empty() ? open(location.c_str(), O_RDONLY) :
+		shm_open(name.c_str(), O_RDONLY, 0);
+	if (handle < 0)
+		throw std::invalid_argument("Couldn't open " + location + ".");
+
+	struct stat status;
+	if (fstat(handle, &status) != 0 || status.st_size == 0)
+	{
+		close(handle);
+		throw std::invalid_argument("Couldn't map " + location + ", since it is empty.");
+	}
+
+	void* view = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, handle, 0);
+	close(handle);
+	if (view == MAP_FAILED)
+		throw std::invalid_argument("Couldn't map " + location + ".");
+
+	memory.data = (const char*)view;
+	memory.size = status.st_size;
+#endif
+
+	return memory;
+}
+
+const char* SharedMemory::GetData()
+{
+	return data;
+}
+
+size_t SharedMemory::GetSize()
+{
+	return size;
+}
+
+void SharedMemory::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	mapping = nullptr;
+#else
+	if (data != nullptr)
+		munmap((void*)data, size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void SharedMemory::CopyHeaderLast(char* view, const std::vector<char>& data,
+								  size_t header_bytes)
+{
+	memcpy(view + header_bytes, data.data() + header_bytes, data.size() - header_bytes);
+
+	// Keeps the header from becoming visible to other processes before the
+	// rest of the data.
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(view, data.data(), header_bytes);
+}
+
+std::string SharedMemory::GetSegmentName(std::string location)
+{
+	if (location.rfind("shm:", 0) != 0)
+		return "";
+
+	std::string name = location.substr(4);
+	if (name.empty())
+		throw std::invalid_argument("The shared memory " + location + " has no name.");
+#ifndef _WIN32
+	// POSIX names start with a slash, and can't have any others.
+	if (name[0] != '/')
+		name = "/" + name;
+#endif
+	return name;
+}
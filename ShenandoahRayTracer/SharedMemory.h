@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** A block of data that several processes on the same machine map into
+memory read-only, so they all share one copy of it.
+
+Locations are written as "shm:name" for a named shared memory segment, or as
+the path of a file otherwise.  A file is mapped straight from the page
+cache, so it is shared just as well, and also lasts across restarts.  POSIX
+segments last until the machine restarts or they are removed (on Linux they
+are files in /dev/shm), but on Windows a segment only lasts while some
+process has it open, so it goes away once the process that created it and
+every process that opened it have exited.
+
+Creating data at a location that already has some replaces it for anything
+that opens it afterwards, while processes that already have the old data
+open keep it until they close it, so it is safe to replace while in use.
+The exception is a Windows segment, which can't be replaced until every
+process has closed it.
+
+Mappings are closed when destroyed, and can be moved but not copied.  Every
+failure throws an std::invalid_argument.
+
+*/
+class SharedMemory
+{
+public:
+	SharedMemory();
+	~SharedMemory();
+
+	SharedMemory(SharedMemory&& other) noexcept;
+	SharedMemory& operator=(SharedMemory&& other) noexcept;
+
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	/**
+	* @brief Writes data to a location, replacing anything that was there,
+	* and opens it.  A segment can be opened while it is still being
+	* written, so the data's header is written last, once everything after
+	* it is in place.  A process that opens the segment early then sees a
+	* header of zeroes, which it should refuse, rather than a whole header
+	* in front of data that is only partly written.
+	*
+	* @param location The location, as "shm:name" or a file path.
+	* @param data The data.
+	* @param header_bytes The size of the header at the start of the data.
+	*/
+	static SharedMemory Create(std::string location, const std::vector<char>& data,
+							   size_t header_bytes);
+
+	// Maps the data at a location read-only.
+	static SharedMemory Open(std::string location);
+
+	const char* GetData();
+	size_t GetSize();
+
+	void Close();
+
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	// The mapping, which keeps a named segment alive while it is open.
+	HANDLE mapping = nullptr;
+#endif
+
+	// Copies data into a new segment, with its first header_bytes bytes last.
+	static void CopyHeaderLast(char* view, const std::vector<char>& data,
+							   size_t header_bytes);
+
+	// Gets the name of a segment from a "shm:name" location, or an empty
+	// string if the location is a file.
+	static std::string GetSegmentName(std::string location);
+};
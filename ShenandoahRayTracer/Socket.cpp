@@ -0,0 +1,298 @@
+#include "Socket.h"
+
+#ifdef _WIN32
+#pragma comment(lib, "Ws2_32.lib")
+#define CLOSE_SOCKET closesocket
+#else
+#define CLOSE_SOCKET close
+#endif
+
+// Linux raises SIGPIPE when sending to a socket whose other end has closed,
+// which would kill the process instead of letting Send return false.
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+Socket::Socket()
+{
+
+}
+
+Socket::Socket(Handle _handle)
+{
+	handle = _handle;
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+Socket::Socket(Socket&& other) noexcept
+{
+	handle = other.handle;
+	unix_path = std::move(other.unix_path);
+	other.handle = INVALID_HANDLE;
+	other.unix_path.clear();
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		handle = other.handle;
+		unix_path = std::move(other.unix_path);
+		other.handle = INVALID_HANDLE;
+		other.unix_path.clear();
+	}
+	return *this;
+}
+
+Socket Socket::Connect(std::string address)
+{
+	Initialize();
+
+	if (address.rfind("unix:", 0) == 0)
+	{
+		sockaddr_un unix_address = CreateUnixAddress(address.substr(5));
+
+		Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+		if (!socket.IsOpen() ||
+			connect(socket.handle, (sockaddr*)&unix_address, sizeof(unix_address)) != 0)
+			throw std::invalid_argument("Couldn't connect to " + address + ".");
+		return socket;
+	}
+
+	std::string host, port;
+	ParseAddress(address, &host, &port);
+	if (host.empty())
+		host = "localhost";
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* results;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0)
+		throw std::invalid_argument("Couldn't resolve " + address + ".");
+
+	// Every address the host resolves to is tried in turn, since a name like
+	// localhost can give both an IPv6 and an IPv4 address.
+	Socket socket;
+	for (addrinfo* result = results; result != nullptr; result = result->ai_next)
+	{
+		Socket attempt(::socket(result->ai_family, result->ai_socktype,
+								result->ai_protocol));
+		if (attempt.IsOpen() &&
+			connect(attempt.handle, result->ai_addr, (int)result->ai_addrlen) == 0)
+		{
+			socket = std::move(attempt);
+			break;
+		}
+	}
+	freeaddrinfo(results);
+
+	if (!socket.IsOpen())
+		throw std::invalid_argument("Couldn't connect to " + address + ".");
+
+	// Requests are small and each one is waited on, so they are sent straight
+	// away rather than held back to be combined.
+	int no_delay = 1;
+	setsockopt(socket.handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay,
+			   sizeof(no_delay));
+
+	return socket;
+}
+
+Socket Socket::Listen(std::string address)
+{
+	Initialize();
+
+	if (address.rfind("unix:", 0) == 0)
+	{
+		std::string path = address.substr(5);
+		sockaddr_un unix_address = CreateUnixAddress(path);
+		remove(path.c_str());
+
+		Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+		if (!socket.IsOpen() ||
+			bind(socket.handle, (sockaddr*)&unix_address, sizeof(unix_address)) != 0 ||
+			listen(socket.handle, SOMAXCONN) != 0)
+			throw std::invalid_argument("Couldn't listen at " + address + ".");
+		socket.unix_path = path;
+		return socket;
+	}
+
+	std::string host, port;
+	ParseAddress(address, &host, &port);
+
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	addrinfo* results;
+	if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints,
+					&results) != 0)
+		throw std::invalid_argument("Couldn't resolve " + address + ".");
+
+	Socket socket;
+	for (addrinfo* result = results; result != nullptr; result = result->ai_next)
+	{
+		Socket attempt(::socket(result->ai_family, result->ai_socktype,
+								result->ai_protocol));
+		if (!attempt.IsOpen())
+			continue;
+
+		// Lets a worker be restarted straight away on the same port, rather
+		// than waiting for the old connections to time out.
+		int reuse = 1;
+		setsockopt(attempt.handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse,
+				   sizeof(reuse));
+
+		if (bind(attempt.handle, result->ai_addr, (int)result->ai_addrlen) == 0 &&
+			listen(attempt.handle, SOMAXCONN) == 0)
+		{
+			socket = std::move(attempt);
+			break;
+		}
+	}
+	freeaddrinfo(results);
+
+	if (!socket.IsOpen())
+		throw std::invalid_argument("Couldn't listen at " + address + ".");
+
+	return socket;
+}
+
+Socket Socket::Accept()
+{
+	Handle connection = accept(handle, nullptr, nullptr);
+	if (connection == INVALID_HANDLE)
+		throw std::invalid_argument("Couldn't accept a connection.");
+
+	Socket socket(connection);
+	if (unix_path.empty())
+	{
+		int no_delay = 1;
+		setsockopt(socket.handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay,
+				   sizeof(no_delay));
+	}
+	return socket;
+}
+
+bool Socket::IsOpen()
+{
+	return handle != INVALID_HANDLE;
+}
+
+void Socket::Close()
+{
+	if (handle == INVALID_HANDLE)
+		return;
+
+	CLOSE_SOCKET(handle);
+	handle = INVALID_HANDLE;
+
+	if (!unix_path.empty())
+	{
+		remove(unix_path.c_str());
+		unix_path.clear();
+	}
+}
+
+bool Socket::Send(const void* data, size_t bytes)
+{
+	const char* position = (const char*)data;
+	while (bytes > 0)
+	{
+		// Sent in pieces of at most 1 GB, since the length is an int on
+		// Windows.
+		int chunk = (int)(bytes < (1 << 30) ? bytes : (1 << 30));
+		int sent = send(handle, position, chunk, SEND_FLAGS);
+		if (sent <= 0)
+			return false;
+
+		position += sent;
+		bytes -= sent;
+	}
+	return true;
+}
+
+bool Socket::Receive(void* output_location, size_t bytes)
+{
+	char* position = (char*)output_location;
+	while (bytes > 0)
+	{
+		int chunk = (int)(bytes < (1 << 30) ? bytes : (1 << 30));
+		int received = recv(handle, position, chunk, 0);
+		if (received <= 0)
+			return false;
+
+		position += received;
+		bytes -= received;
+	}
+	return true;
+}
+
+void Socket::SetReceiveTimeout(int seconds)
+{
+#ifdef _WIN32
+	DWORD timeout = seconds * 1000;
+#else
+	timeval timeout = {};
+	timeout.tv_sec = seconds;
+#endif
+	setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout,
+			   sizeof(timeout));
+}
+
+void Socket::Initialize()
+{
+#ifdef _WIN32
+	static std::once_flag started;
+	std::call_once(started, []()
+	{
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+			throw std::invalid_argument("Couldn't start Winsock.");
+	});
+#endif
+}
+
+void Socket::ParseAddress(std::string address, std::string* host,
+						  std::string* port)
+{
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos)
+	{
+		*host = "";
+		*port = address;
+	}
+	else
+	{
+		*host = address.substr(0, colon);
+		*port = address.substr(colon + 1);
+	}
+
+	if (host->size() >= 2 && host->front() == '[' && host->back() == ']')
+		*host = host->substr(1, host->size() - 2);
+
+	if (port->empty())
+		throw std::invalid_argument("The address " + address + " has no port.");
+}
+
+sockaddr_un Socket::CreateUnixAddress(std::string path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+
+	if (path.empty() || path.size() >= sizeof(address.sun_path))
+		throw std::invalid_argument("Invalid Unix socket path: " + path + ".");
+
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return address;
+}
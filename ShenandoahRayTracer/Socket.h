@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+// Keeps windows.h from defining min and max as macros, which would break
+// std::min and std::max in every file that includes this one.
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/** A stream socket, either TCP or a Unix domain socket, that sends and
+receives whole buffers at a time.
+
+Addresses are written as "host:port" for TCP, or "unix:path" for a Unix
+domain socket, which is the easiest way to test with several processes on
+one machine.  When listening, the host can be left out (":port" or just the
+port) to listen on every interface.  Hosts can be names or IPv4/IPv6
+addresses, and IPv6 addresses go in brackets, like "[::1]:7000".
+
+Sockets close themselves when destroyed, and can be moved but not copied.
+Failures to set a socket up throw an std::invalid_argument, but Send and
+Receive only return false, since losing the connection to another process is
+something the caller is expected to recover from.
+
+*/
+class Socket
+{
+public:
+	Socket();
+	~Socket();
+
+	Socket(Socket&& other) noexcept;
+	Socket& operator=(Socket&& other) noexcept;
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	/**
+	* @brief Connects to a socket that is listening at an address.  Throws an
+	* std::invalid_argument if the address is invalid or nothing accepts the
+	* connection.
+	*
+	* @param address The address, as "host:port" or "unix:path".
+	*/
+	static Socket Connect(std::string address);
+
+	/**
+	* @brief Creates a socket that listens for connections at an address.
+	* Throws an std::invalid_argument if the address is invalid or can't be
+	* bound.  A Unix domain socket replaces any file already at its path.
+	*
+	* @param address The address, as "host:port", ":port", or "unix:path".
+	*/
+	static Socket Listen(std::string address);
+
+	// Waits for the next connection to a listening socket.  Throws an
+	// std::invalid_argument if it fails.
+	Socket Accept();
+
+	bool IsOpen();
+	void Close();
+
+	// Sends all of the data, returning false if the connection was lost.
+	bool Send(const void* data, size_t bytes);
+
+	// Waits for exactly this much data, returning false if the connection was
+	// lost or closed, or the timeout passed, before all of it arrived.
+	bool Receive(void* output_location, size_t bytes);
+
+	// The longest Receive waits for data to arrive before giving up.  0 (the
+	// default) waits forever.
+	void SetReceiveTimeout(int seconds);
+
+private:
+#ifdef _WIN32
+	typedef SOCKET Handle;
+	static const Handle INVALID_HANDLE = INVALID_SOCKET;
+#else
+	typedef int Handle;
+	static const Handle INVALID_HANDLE = -1;
+#endif
+
+	Handle handle = INVALID_HANDLE;
+	// The path of a listening Unix domain socket, which is removed when it
+	// closes.
+	std::string unix_path;
+
+	explicit Socket(Handle _handle);
+
+	// Winsock has to be started once before any socket is made.
+	static void Initialize();
+
+	// Splits a TCP address into its host and port.
+	static void ParseAddress(std::string address, std::string* host,
+							 std::string* port);
+	static sockaddr_un CreateUnixAddress(std::string path);
+};
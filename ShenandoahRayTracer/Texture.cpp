@@ -0,0 +1,154 @@
+#include "Texture.h"
+
+Texture::Texture()
+{
+
+}
+
+Texture::Texture(int _width, int _height, std::vector<float> _texels)
+{
+	if (_width <= 0 || _height <= 0 || _texels.size() != _width * _height * 3)
+		throw std::invalid_argument("Texels don't match the texture size.");
+
+	width = _width;
+	height = _height;
+	texels = _texels;
+}
+
+Texture::Texture(std::string file_location)
+{
+	std::ifstream file(file_location, std::ifstream::binary);
+
+	if (!file)
+		throw std::invalid_argument("Texture file not found: " + file_location);
+
+	PPMHeader header = ReadPPMHeader(&file, file_location);
+	width = header.width;
+	height = header.height;
+	int max_value = header.max_value;
+
+	texels.resize(width * height * 3);
+
+	if (!header.binary)
+	{
+		for (int i = 0; i < width * height * 3; i++)
+		{
+			int value;
+			if (!(file >> value))
+				throw std::invalid_argument("PPM file is too short: " + file_location);
+			texels[i] = (float)value / max_value;
+		}
+		return;
+	}
+
+	// Binary files use two bytes per value (most significant first) when the
+	// maximum is above 255.
+	int bytes_per_value = max_value > 255 ? 2 : 1;
+	std::vector<unsigned char> bytes(width * height * 3 * bytes_per_value);
+	if (!file.read((char*)bytes.data(), bytes.size()))
+		throw std::invalid_argument("PPM file is too short: " + file_location);
+
+	for (int i = 0; i < width * height * 3; i++)
+	{
+		int value = bytes[i * bytes_per_value];
+		if (bytes_per_value == 2)
+			value = value << 8 | bytes[i * 2 + 1];
+		texels[i] = (float)value / max_value;
+	}
+}
+
+int Texture::GetWidth() const
+{
+	return width;
+}
+
+int Texture::GetHeight() const
+{
+	return height;
+}
+
+void Texture::Sample(float u, float v, float* output_location) const
+{
+	if (texels.empty())
+	{
+		output_location[0] = 0;
+		output_location[1] = 0;
+		output_location[2] = 0;
+		return;
+	}
+
+	// Texel centres are at half-integer positions, and rows count down from
+	// the top of the image.
+	float x = (u - floor(u)) * width - 0.5f;
+	float y = (1 - (v - floor(v))) * height - 0.5f;
+
+	int x0 = (int)floor(x);
+	int y0 = (int)floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	int xs[2] = { (x0 % width + width) % width, ((x0 + 1) % width + width) % width };
+	int ys[2] = { (y0 % height + height) % height, ((y0 + 1) % height + height) % height };
+	float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+
+	for (int c = 0; c < 3; c++)
+	{
+		output_location[c] =
+			texels[(ys[0] * width + xs[0]) * 3 + c] * weights[0] +
+			texels[(ys[0] * width + xs[1]) * 3 + c] * weights[1] +
+			texels[(ys[1] * width + xs[0]) * 3 + c] * weights[2] +
+			texels[(ys[1] * width + xs[1]) * 3 + c] * weights[3];
+	}
+}
+
+void Texture::GetTexel(int x, int y, float* output_location) const
+{
+	for (int c = 0; c < 3; c++)
+		output_location[c] = texels[(y * width + x) * 3 + c];
+}
+
+PPMHeader Texture::ReadPPMHeader(std::ifstream* file, std::string file_location)
+{
+	std::string magic;
+	*file >> magic;
+	if (magic != "P6" && magic != "P3")
+		throw std::invalid_argument("Textures must be P3 or P6 PPM files: " +
+									file_location);
+
+	PPMHeader header;
+	header.binary = magic == "P6";
+	header.width = ReadHeaderValue(file);
+	header.height = ReadHeaderValue(file);
+	header.max_value = ReadHeaderValue(file);
+
+	if (header.width <= 0 || header.height <= 0 || header.max_value <= 0 ||
+		header.max_value > 65535)
+		throw std::invalid_argument("Invalid PPM header: " + file_location);
+
+	// Binary files have a single whitespace character after the header.
+	if (header.binary)
+		file->get();
+	header.data_offset = file->tellg();
+
+	return header;
+}
+
+int Texture::ReadHeaderValue(std::ifstream* file)
+{
+	// Comments can appear anywhere in the header, and run to the end of the
+	// line.
+	while (true)
+	{
+		*file >> std::ws;
+		if (file->peek() != '#')
+			break;
+
+		std::string comment;
+		std::getline(*file, comment);
+	}
+
+	int value;
+	if (!(*file >> value))
+		return -1;
+	return value;
+}
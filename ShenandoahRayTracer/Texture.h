@@ -0,0 +1,82 @@
+#pragma once
+
+#include <fstream>
+#include <math.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The header of a PPM file, which is followed by the texel values.
+struct PPMHeader
+{
+	bool binary = true; // P6 rather than P3.
+	int width = 0;
+	int height = 0;
+	int max_value = 255;
+	// Where the texel values start within the file.
+	std::streamoff data_offset = 0;
+};
+
+/** An RGB image that can be looked up by texture coordinates.
+
+Texels are stored as floats in the range 0-1, with the first row of the
+image at the top (v = 1), as in the UV layout of .obj files.  Lookups wrap
+around in both directions and are bilinearly filtered.
+
+*/
+class Texture
+{
+public:
+	Texture();
+
+	/**
+	* @brief Creates a texture from raw texel values.
+	*
+	* @param _width The width of the texture in texels.
+	* @param _height The height of the texture in texels.
+	* @param _texels The texels, 3 floats each, row by row from the top.
+	*/
+	Texture(int _width, int _height, std::vector<float> _texels);
+
+	/**
+	* @brief Loads a texture from a binary (P6) or plain text (P3) PPM file.
+	* Throws an std::invalid_argument if the file can't be read.
+	*
+	* @param file_location The location of the PPM file.
+	*/
+	Texture(std::string file_location);
+
+	int GetWidth() const;
+	int GetHeight() const;
+
+	/**
+	* @brief Looks up the colour at a texture coordinate.
+	*
+	* @param u The horizontal texture coordinate.
+	* @param v The vertical texture coordinate.
+	* @param output_location A float array with minimum size 3.
+	*/
+	void Sample(float u, float v, float* output_location) const;
+
+	// Copies the texel in column x and row y (counting down from the top).
+	void GetTexel(int x, int y, float* output_location) const;
+
+	/**
+	* @brief Reads the header of a P3 or P6 PPM file, leaving the file at the
+	* start of the texel values.  Throws an std::invalid_argument if the
+	* header is invalid.
+	*
+	* @param file The open file, at its start.
+	* @param file_location The location of the file, for error messages.
+	*
+	* @return The header.
+	*/
+	static PPMHeader ReadPPMHeader(std::ifstream* file, std::string file_location);
+
+private:
+	int width = 0;
+	int height = 0;
+	std::vector<float> texels;
+
+	static int ReadHeaderValue(std::ifstream* file);
+};
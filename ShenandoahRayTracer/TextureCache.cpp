@@ -0,0 +1,47 @@
+#include "TextureCache.h"
+
+TextureCache::TextureCache(size_t max_bytes) : tiles("texture", max_bytes)
+{
+
+}
+
+std::shared_ptr<const TextureTile> TextureCache::Find(unsigned long long key)
+{
+	return tiles.Find(key);
+}
+
+std::shared_ptr<const TextureTile> TextureCache::Insert(unsigned long long key,
+														std::shared_ptr<const TextureTile> tile)
+{
+	return tiles.Insert(key, tile, sizeof(TextureTile) + tile->texels.size() * sizeof(float));
+}
+
+void TextureCache::Clear()
+{
+	tiles.Clear();
+}
+
+size_t TextureCache::GetMaxBytes()
+{
+	return tiles.GetMaxBytes();
+}
+
+size_t TextureCache::GetBytesUsed()
+{
+	return tiles.GetBytesUsed();
+}
+
+long long TextureCache::GetHits()
+{
+	return tiles.GetHits();
+}
+
+long long TextureCache::GetMisses()
+{
+	return tiles.GetMisses();
+}
+
+long long TextureCache::GetEvictions()
+{
+	return tiles.GetEvictions();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "ShardedLruCache.h"
+
+// A square block of texels from one mip level of a texture.  Tiles at the
+// right and bottom edges of a level can be smaller than the tile size.
+struct TextureTile
+{
+	int width = 0;
+	int height = 0;
+	std::vector<float> texels; // 3 floats each, row by row from the top.
+};
+
+/** A fixed-size cache of texture tiles, shared by every texture and thread.
+
+Tiles are identified by a 64 bit key made by the texture from its id, the mip
+level, and the tile's position.  Once the tiles in the cache take more than
+the budget, the least recently used ones are dropped, so the memory used by
+textures stays bounded no matter how many or how large they are.
+
+It is a ShardedLruCache of tiles, so threads looking up different tiles
+rarely wait on each other, and a tile that is evicted while a thread is
+still reading it stays alive until the thread is done.
+
+*/
+class TextureCache
+{
+public:
+	/**
+	* @brief Creates an empty cache.
+	*
+	* @param max_bytes The most memory the cached tiles can take, which must
+	* be positive.
+	*/
+	TextureCache(size_t max_bytes);
+
+	/**
+	* @brief Looks up a tile, marking it as recently used.
+	*
+	* @param key The key of the tile.
+	*
+	* @return The tile, or nullptr if it isn't in the cache.
+	*/
+	std::shared_ptr<const TextureTile> Find(unsigned long long key);
+
+	/**
+	* @brief Adds a tile that was just loaded, evicting the least recently
+	* used tiles of its shard if the shard is over budget.  The lock isn't
+	* held while tiles are loaded, so two threads can load the same tile at
+	* once; the second one to insert it gets the first one's copy back.
+	*
+	* @param key The key of the tile.
+	* @param tile The loaded tile.
+	*
+	* @return The tile now in the cache under the key.
+	*/
+	std::shared_ptr<const TextureTile> Insert(unsigned long long key,
+											  std::shared_ptr<const TextureTile> tile);
+
+	// Drops every tile.  Tiles still held by a thread stay alive until it is
+	// done with them.
+	void Clear();
+
+	size_t GetMaxBytes();
+	size_t GetBytesUsed();
+
+	// Statistics since the cache was created, for tuning its size.
+	long long GetHits();
+	long long GetMisses();
+	long long GetEvictions();
+
+private:
+	ShardedLruCache<const TextureTile> tiles;
+};
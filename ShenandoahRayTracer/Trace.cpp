@@ -0,0 +1,123 @@
+#include "Trace.h"
+
+TraceRecorder::TraceRecorder()
+{
+	creation_time = std::chrono::steady_clock::now();
+}
+
+bool TraceRecorder::IsEnabled()
+{
+	return enabled;
+}
+
+void TraceRecorder::SetEnabled(bool _enabled)
+{
+	enabled = _enabled;
+}
+
+long long TraceRecorder::GetTimestamp()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - creation_time).count();
+}
+
+void TraceRecorder::AddSpan(std::string name, std::string category,
+							long long start, int thread_id)
+{
+	if (!enabled)
+		return;
+
+	// The end time is taken before locking so that waiting on the mutex isn't
+	// counted as part of the span.
+	long long end = GetTimestamp();
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+	events.push_back({ name, category, start, end - start, thread_id });
+}
+
+void TraceRecorder::SetThreadName(int thread_id, std::string name)
+{
+	if (!enabled)
+		return;
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+	for (int i = 0; i < thread_names.size(); i++)
+	{
+		if (thread_names[i].first == thread_id)
+		{
+			thread_names[i].second = name;
+			return;
+		}
+	}
+
+	thread_names.emplace_back(thread_id, name);
+}
+
+int TraceRecorder::GetNumEvents()
+{
+	std::lock_guard<std::mutex> lock(events_mutex);
+	return events.size();
+}
+
+void TraceRecorder::Clear()
+{
+	std::lock_guard<std::mutex> lock(events_mutex);
+	events.clear();
+	thread_names.clear();
+}
+
+void TraceRecorder::WriteChromeTrace(std::string file_location)
+{
+	std::ofstream file;
+	file.open(file_location, std::ofstream::trunc);
+
+	if (!file)
+		throw std::invalid_argument("Could not open file for trace output.");
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+
+	// The format is documented in the "Trace Event Format" document used by
+	// chrome://tracing.  "X" events are complete spans with a duration, and
+	// "M" events are metadata used to name the threads.
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+
+	bool first = true;
+	for (int i = 0; i < thread_names.size(); i++)
+	{
+		if (!first)
+			file << "," << std::endl;
+		first = false;
+
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+			 << thread_names[i].first << ",\"args\":{\"name\":\""
+			 << EscapeString(thread_names[i].second) << "\"}}";
+	}
+
+	for (int i = 0; i < events.size(); i++)
+	{
+		if (!first)
+			file << "," << std::endl;
+		first = false;
+
+		file << "{\"name\":\"" << EscapeString(events[i].name)
+			 << "\",\"cat\":\"" << EscapeString(events[i].category)
+			 << "\",\"ph\":\"X\",\"ts\":" << events[i].start
+			 << ",\"dur\":" << events[i].duration
+			 << ",\"pid\":1,\"tid\":" << events[i].thread_id << "}";
+	}
+
+	file << std::endl << "]}" << std::endl;
+}
+
+std::string TraceRecorder::EscapeString(std::string s)
+{
+	std::string output = "";
+	for (int i = 0; i < s.size(); i++)
+	{
+		if (s[i] == '"' || s[i] == '\\')
+			output += '\\';
+		output += s[i];
+	}
+
+	return output;
+}
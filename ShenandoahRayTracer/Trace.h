@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A single timestamped span, stored in the units used by the Chrome
+// trace-event format (microseconds).
+struct TraceEvent
+{
+	std::string name;
+	std::string category;
+	long long start;    // Microseconds since the recorder was created.
+	long long duration; // Microseconds.
+	int thread_id;      // 0 is the main thread, workers start at 1.
+};
+
+// Records timestamped spans for the different phases of a render (upload,
+// ray generation, each section on each worker, shading, output) and writes
+// them out as a Chrome trace-event JSON file.  The file can be opened in
+// chrome://tracing or ui.perfetto.dev to see the actual timeline of a frame.
+//
+// Recording is disabled by default, in which case adding spans does nothing,
+// so devices can always call into the recorder without checking.
+class TraceRecorder
+{
+public:
+	TraceRecorder();
+
+	bool IsEnabled();
+	void SetEnabled(bool enabled);
+
+	/**
+	* @brief Returns the current time relative to the creation of the recorder.
+	*
+	* @return The time in microseconds.
+	*/
+	long long GetTimestamp();
+
+	/**
+	* @brief Adds a span that started at the given timestamp and ends now.
+	* Safe to call from multiple threads at once.
+	*
+	* @param name The name shown on the span in the timeline.
+	* @param category The category of the span, used for filtering.
+	* @param start The timestamp returned by GetTimestamp when the span began.
+	* @param thread_id The thread the span ran on.  0 is the main thread.
+	*/
+	void AddSpan(std::string name, std::string category, long long start,
+				 int thread_id);
+
+	/**
+	* @brief Gives a thread a readable name in the timeline.
+	*
+	* @param thread_id The thread to be named.
+	* @param name The name of the thread.
+	*/
+	void SetThreadName(int thread_id, std::string name);
+
+	int GetNumEvents();
+	void Clear();
+
+	/**
+	* @brief Writes all recorded spans to a Chrome trace-event JSON file.
+	*
+	* @param file_location The location of the file to be written.
+	*/
+	void WriteChromeTrace(std::string file_location);
+
+private:
+	bool enabled = false;
+	std::chrono::steady_clock::time_point creation_time;
+
+	// Events are appended by every worker, so they are guarded by a mutex.
+	// Spans are coarse (one per phase or section), so contention is minimal.
+	std::mutex events_mutex;
+	std::vector<TraceEvent> events;
+	std::vector<std::pair<int, std::string>> thread_names;
+
+	static std::string EscapeString(std::string s);
+};
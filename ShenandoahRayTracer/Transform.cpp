@@ -67,6 +67,13 @@ Matrix Transform::GetCompositeMatrix()
 	return composite_matrix;
 }
 
+Matrix Transform::GetLocalMatrix()
+{
+	if (!has_local_matrix)
+		return Matrix::GetTranslationMatrix(0, 0, 0);
+	return local_matrix;
+}
+
 
 void Transform::SetOrigin(Vector3 vec)
 {
@@ -90,7 +97,7 @@ void Transform::SetAngles(Vector3 vec)
 {
 	angles = vec.Copy();
 	
-	rotate_matrix = Matrix::GetRotationMatrix(origin);
+	rotate_matrix = Matrix::GetRotationMatrix(angles);
 
 	CreateComposite();
 }
@@ -99,7 +106,7 @@ void Transform::OffsetAngles(Vector3 vec)
 {
 	angles = angles + vec;
 
-	rotate_matrix = Matrix::GetRotationMatrix(origin);
+	rotate_matrix = Matrix::GetRotationMatrix(angles);
 
 	CreateComposite();
 }
@@ -123,9 +130,24 @@ void Transform::OffsetScale(Vector3 vec)
 }
 
 
+void Transform::SetLocalMatrix(Matrix mat)
+{
+	if (mat.GetRows() != 4 || mat.GetColumns() != 4)
+		throw std::invalid_argument("Local matrices must be 4x4.");
+
+	local_matrix = mat;
+	has_local_matrix = !mat.Equals(Matrix::GetTranslationMatrix(0, 0, 0));
+
+	CreateComposite();
+}
+
+
 void Transform::CreateComposite()
 {
 	// We use the order rotate, scale, translate so that we don't have to move
 	// objects away from the origin.
 	composite_matrix = (rotate_matrix * scale_matrix) * translate_matrix;
+
+	if (has_local_matrix)
+		composite_matrix = local_matrix * composite_matrix;
 }
\ No newline at end of file
@@ -5,7 +5,9 @@
 
 // Transform is used to provide a simple way for objects to represent their
 // world position, rotation, and scale, and to get the composite transformation
-// matrix out of it.
+// matrix out of it.  A local matrix can be set as well, which is applied before
+// the rest, for placements that came from a file's node hierarchy and can't be
+// written as a position, rotation, and scale.
 class Transform
 {
 public:
@@ -20,6 +22,7 @@ public:
 	Matrix GetRotationMatrix();
 	Matrix GetScaleMatrix();
 	Matrix GetCompositeMatrix();
+	Matrix GetLocalMatrix();
 
 	// Offset methods add the vector to the current one.
 	void SetOrigin(Vector3 vec);
@@ -29,10 +32,17 @@ public:
 	void SetScale(Vector3 vec);
 	void OffsetScale(Vector3 vec);
 
+	// The matrix must be 4x4, in the same row vector layout as the others.
+	void SetLocalMatrix(Matrix mat);
+
 private:
 	Vector3 origin, angles, scale;
 	Matrix translate_matrix, rotate_matrix, scale_matrix;
 	Matrix composite_matrix;
+	Matrix local_matrix;
+	// Whether the local matrix is anything but the identity, so that plain
+	// transforms skip the extra multiplication.
+	bool has_local_matrix = false;
 
 	void CreateComposite();
 };
\ No newline at end of file
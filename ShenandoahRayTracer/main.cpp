@@ -1,53 +1,557 @@
 #include <fstream>
 #include <iostream>
 #include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <thread>
 #include <vector>
 #include "ObjectHandler.h"
+#include "PathTracer.h"
 #include "Device.h"
 #include "Camera.h"
+#include "ImageWriter.h"
+#include "RenderCluster.h"
+#include "SceneDescription.h"
+#include "SequenceRenderer.h"
+#include "Trace.h"
 
-int main()
+// Set when the process is asked to stop, such as when a preemptible machine
+// is reclaimed, so that a checkpointed render can save its progress first.
+volatile std::sig_atomic_t stop_signal = 0;
+
+void HandleStopSignal(int signal)
+{
+	stop_signal = 1;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage: ShenandoahRayTracer <scene file> [options]" << std::endl
+			  << "Options override the values in the scene file:" << std::endl
+			  << "  --resolution <x> <y>  Output resolution" << std::endl
+			  << "  --threads <n>         Number of render threads" << std::endl
+			  << "  --samples <n>         Samples per pixel" << std::endl
+			  << "  --sampler <name>      center, stratified, halton, sobol or"
+			  << " bluenoise" << std::endl
+			  << "  --filter <name>       box, tent or gaussian" << std::endl
+			  << "  --adaptive <error>    Stop sampling pixels below this relative"
+			  << " error" << std::endl
+			  << "  --time-budget <ms>    Maximum time spent sampling a frame"
+			  << std::endl
+			  << "  --progressive <n>     Render in passes of n samples, writing"
+			  << " the output after each" << std::endl
+			  << "  --checkpoint <file>   Save checkpoints of the render to resume"
+			  << " from" << std::endl
+			  << "  --checkpoint-interval <s>  Least time between checkpoints"
+			  << std::endl
+			  << "  --resume              Carry on from the checkpoint, if there is"
+			  << " one" << std::endl
+			  << "  --output <file>       Output file location" << std::endl
+			  << "  --format <txt|ppm>    Output file format" << std::endl
+			  << "  --mode <shaded|heatmap>  Render mode" << std::endl
+			  << "  --integrator <uv|path>  How shaded samples are coloured"
+			  << std::endl
+			  << "  --max-depth <n>       Maximum path tracer bounces" << std::endl
+			  << "  --execution <depthfirst|wavefront>  How samples are shaded"
+			  << std::endl
+			  << "  --mesh-encoding <exact|compact>  How geometry is stored"
+			  << std::endl
+			  << "  --geometry-cache <file>  Stream geometry through this file"
+			  << std::endl
+			  << "  --weld-meshes         Weld vertices and share duplicate meshes"
+			  << " when loading" << std::endl
+			  << "  --reorder-meshes      Sort triangles for memory locality when"
+			  << " loading" << std::endl
+			  << "  --publish-scene <location>  Share the prepared scene at shm:name"
+			  << " or a file" << std::endl
+			  << "  --attach-scene <location>  Render a shared scene instead of"
+			  << " loading the objects" << std::endl
+			  << "  --denoise <n>         Denoise with n iterations, 0 to disable"
+			  << std::endl
+			  << "  --aov <name>          Also write an AOV: depth, normal, albedo,"
+			  << " uv, objectid, triangleid or coverage" << std::endl
+			  << "  --heatmap             Same as --mode heatmap" << std::endl
+			  << "  --trace <file>        Write a Chrome trace of the render"
+			  << std::endl
+			  << "  --worker <address>    Serve tiles to coordinators at host:port"
+			  << " or unix:path" << std::endl
+			  << "  --workers <a,b,...>   Render the frame on these workers" << std::endl
+			  << "  --worker-timeout <s>  Retry a worker's tiles elsewhere after"
+			  << " this long" << std::endl;
+}
+
+void WriteOutput(SceneDescription* scene, int* output, TraceRecorder* trace)
+{
+	long long output_start = trace->GetTimestamp();
+	try
+	{
+		ImageWriter::Write(scene->output_location, scene->output_format, output,
+						   scene->resolution_x, scene->resolution_y);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+	trace->AddSpan("Output", "output", output_start, 0);
+}
+
+void WriteAOVs(SceneDescription* scene, Device* device, TraceRecorder* trace)
 {
-	int width = 500;
-	int height = 500;
+	long long output_start = trace->GetTimestamp();
+	std::vector<float> values;
 
-	Camera c = Camera(Vector3(0, 0, 0), Vector3(0, 0, 1), Vector3(1, 0, 0), width, height, 90, 1);
-	std::cout << c.GetForward().ToString() << std::endl;
+	for (int i = 0; i < scene->aovs.size(); i++)
+	{
+		AOVType type = scene->aovs[i];
+		values.resize(scene->resolution_x * scene->resolution_y *
+					  FrameBuffer::GetAOVChannels(type));
 
-	ObjectHandler oh = ObjectHandler("C:\\Users\\Connor Herfurth\\Documents\\MonkeyOnly.obj");
-	oh.transform.OffsetOrigin(Vector3(0, -5, 0));
+		try
+		{
+			device->GetAOV(type, 0, values.data());
+			ImageWriter::WritePFM(SceneDescription::GetAOVLocation(scene->output_location, type),
+								  values.data(), scene->resolution_x,
+								  scene->resolution_y, FrameBuffer::GetAOVChannels(type));
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+	}
+	trace->AddSpan("AOV Output", "output", output_start, 0);
+}
 
-	float* vertices = new float[oh.GetNumVertices() * 4];
-	oh.CopyAdjustedVertices(vertices);
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || std::string(argv[1]) == "--help")
+	{
+		PrintUsage();
+		return 1;
+	}
 
-	float* uvs = new float[oh.GetNumUVs() * 2];
-	oh.CopyUVs(uvs);
+	TraceRecorder trace;
+	std::string trace_location = "";
+	SceneDescription scene;
 
-	CPUDevice device = CPUDevice();
+	// A process either serves tiles to coordinators, or renders its frame on
+	// workers, or neither.  These only make sense for one run, so they
+	// aren't part of the scene file.
+	std::string worker_address = "";
+	std::vector<std::string> worker_addresses;
+	int worker_timeout = 0;
+	bool resume = false;
 
+	// Processes on the same machine can share one copy of the prepared
+	// scene, which one of them publishes and the rest attach to.
+	std::string publish_location = "";
+	std::string attach_location = "";
 
+	try
+	{
+		scene = SceneDescription(argv[1]);
+
+		// Everything after the scene file overrides a setting from it, so that
+		// benchmark scripts can sweep a setting without editing the scene.
+		for (int a = 2; a < argc; a++)
+		{
+			std::string arg = argv[a];
+			bool has_value = a + 1 < argc;
+
+			if (arg == "--resolution" && a + 2 < argc)
+			{
+				scene.resolution_x = std::stoi(argv[++a]);
+				scene.resolution_y = std::stoi(argv[++a]);
+			}
+			else if (arg == "--threads" && has_value)
+				scene.threads = std::stoi(argv[++a]);
+			else if (arg == "--samples" && has_value)
+				scene.samples_per_pixel = std::stoi(argv[++a]);
+			else if (arg == "--sampler" && has_value)
+				scene.sampler = Sampler::ParseSamplerType(argv[++a]);
+			else if (arg == "--filter" && has_value)
+				scene.filter = ReconstructionFilter::ParseFilterType(argv[++a]);
+			else if (arg == "--adaptive" && has_value)
+				scene.adaptive_threshold = std::stof(argv[++a]);
+			else if (arg == "--time-budget" && has_value)
+				scene.time_budget = std::stoi(argv[++a]);
+			else if (arg == "--progressive" && has_value)
+				scene.progressive_pass_samples = std::stoi(argv[++a]);
+			else if (arg == "--checkpoint" && has_value)
+				scene.checkpoint_location = argv[++a];
+			else if (arg == "--checkpoint-interval" && has_value)
+				scene.checkpoint_interval = std::stoi(argv[++a]);
+			else if (arg == "--resume")
+				resume = true;
+			else if (arg == "--output" && has_value)
+				scene.output_location = argv[++a];
+			else if (arg == "--format" && has_value)
+				scene.output_format = argv[++a];
+			else if (arg == "--mode" && has_value)
+				scene.mode = SceneDescription::ParseRenderMode(argv[++a]);
+			else if (arg == "--integrator" && has_value)
+				scene.integrator = argv[++a];
+			else if (arg == "--execution" && has_value)
+				scene.execution = SceneDescription::ParseExecutionMode(argv[++a]);
+			else if (arg == "--mesh-encoding" && has_value)
+				scene.mesh_encoding = SceneDescription::ParseMeshEncoding(argv[++a]);
+			else if (arg == "--geometry-cache" && has_value)
+				scene.geometry_cache_location = argv[++a];
+			else if (arg == "--weld-meshes")
+				scene.weld_meshes = true;
+			else if (arg == "--reorder-meshes")
+				scene.reorder_meshes = true;
+			else if (arg == "--publish-scene" && has_value)
+				publish_location = argv[++a];
+			else if (arg == "--attach-scene" && has_value)
+				attach_location = argv[++a];
+			else if (arg == "--max-depth" && has_value)
+				scene.max_depth = std::stoi(argv[++a]);
+			else if (arg == "--denoise" && has_value)
+				scene.denoise_iterations = std::stoi(argv[++a]);
+			else if (arg == "--aov" && has_value)
+				scene.aovs.push_back(FrameBuffer::ParseAOVType(argv[++a]));
+			else if (arg == "--heatmap")
+				scene.mode = RenderMode::TraversalHeatmap;
+			else if (arg == "--worker" && has_value)
+				worker_address = argv[++a];
+			else if (arg == "--workers" && has_value)
+				worker_addresses = RenderCoordinator::ParseAddresses(argv[++a]);
+			else if (arg == "--worker-timeout" && has_value)
+				worker_timeout = std::stoi(argv[++a]);
+			else if (arg == "--trace" && has_value)
+			{
+				trace_location = argv[++a];
+				trace.SetEnabled(true);
+				trace.SetThreadName(0, "Main");
+			}
+			else
+				throw std::invalid_argument("Unknown option: " + arg);
+		}
+
+		if (!worker_address.empty() && !worker_addresses.empty())
+			throw std::invalid_argument("A process can't be both a worker and a coordinator.");
+		if (!worker_addresses.empty() &&
+			(scene.IsSequence() || scene.progressive_pass_samples > 0 ||
+			 !scene.checkpoint_location.empty()))
+			throw std::invalid_argument("Only single frames can be rendered on workers.");
+		if (!scene.checkpoint_location.empty() && scene.IsSequence())
+			throw std::invalid_argument("Sequences can't be checkpointed.");
+		if (resume && scene.checkpoint_location.empty())
+			throw std::invalid_argument("--resume needs a checkpoint location.");
+		if (!publish_location.empty() && !attach_location.empty())
+			throw std::invalid_argument("A process can't both publish a scene and attach to one.");
+		if ((!publish_location.empty() || !attach_location.empty()) &&
+			(scene.IsSequence() || !worker_addresses.empty()))
+			throw std::invalid_argument("Only a single frame rendered in this process "
+										"can publish or attach to a scene.");
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return 1;
+	}
+
+	int width = scene.resolution_x;
+	int height = scene.resolution_y;
+
+	// Only progressive renders can be checkpointed, so a checkpointed render
+	// that wasn't asked to be progressive is rendered in passes of a sample
+	// batch each, but still only written out once it's done.
+	bool write_passes = scene.progressive_pass_samples > 0;
+	if (!scene.checkpoint_location.empty() && scene.progressive_pass_samples == 0)
+		scene.progressive_pass_samples = CPUDevice::SAMPLE_BATCH;
+
+	Camera c = scene.CreateCamera();
+
+	long long load_start = trace.GetTimestamp();
 	std::vector<ObjectHandler*> objects;
-	objects.emplace_back(&oh);
+	try
+	{
+		// A coordinator never traces any rays, so only the workers need the
+		// objects, and a process attaching to a scene gets them from there.
+		if (worker_addresses.empty() && attach_location.empty())
+			scene.LoadObjects(&objects);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	trace.AddSpan("Load", "load", load_start, 0);
+
+	if (scene.weld_meshes)
+	{
+		std::cout << "Mesh welding: " << scene.weld_statistics.vertices_removed
+				  << " vertices, " << scene.weld_statistics.uvs_removed << " UVs, "
+				  << scene.weld_statistics.triangles_removed
+				  << " triangles removed, " << scene.duplicate_meshes
+				  << " duplicate meshes shared" << std::endl;
+	}
 
-	device.UploadData(&objects);
+	// Declared before the device, since the device uses it until it is
+	// destroyed.
+	PathTracer path_tracer;
 
-	int* output = new int[width * height * 3];
+	CPUDevice device = CPUDevice();
+	device.SetTraceRecorder(&trace);
+	device.SetRenderMode(scene.mode);
+	device.SetExecutionMode(scene.execution);
+	device.SetMeshEncoding(scene.mesh_encoding);
+	device.SetGeometryCache(scene.geometry_cache);
+	device.SetSamplerType(scene.sampler);
+	device.SetFilterType(scene.filter);
+
+	// Command line values haven't been checked like the scene file's have.
+	try
+	{
+		device.SetSamplesPerPixel(scene.samples_per_pixel);
+		device.SetAdaptiveSampling(scene.adaptive_threshold,
+								   scene.adaptive_min_samples);
+		device.SetTimeBudget(scene.time_budget);
+		device.SetDenoising(scene.denoise_iterations);
+		device.SetAOVsEnabled(!scene.aovs.empty());
+		if (scene.progressive_pass_samples > 0)
+			device.SetProgressivePassSamples(scene.progressive_pass_samples);
+		device.SetCheckpointing(scene.checkpoint_location, scene.checkpoint_interval);
 
-	auto start = std::chrono::high_resolution_clock::now();
-	device.RenderFrame(c, 1, output);
-	auto stop = std::chrono::high_resolution_clock::now();
+		if (scene.integrator == "path")
+		{
+			path_tracer.SetMaxDepth(scene.max_depth);
+			path_tracer.SetPixelSpread(c.GetPixelSpreadAngle());
+			path_tracer.SetBackground(scene.background.x, scene.background.y,
+									  scene.background.z);
+			path_tracer.SetLights(scene.lights);
+
+			device.SetIntegrator(&path_tracer);
+		}
+		else if (scene.integrator != "uv")
+			throw std::invalid_argument("Unknown integrator: " + scene.integrator);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	if (worker_addresses.empty())
+	{
+		try
+		{
+			if (!attach_location.empty())
+			{
+				if (!scene.texture_cache)
+				{
+					scene.texture_cache =
+						std::make_shared<TextureCache>((size_t)scene.texture_cache_size << 20);
+				}
+				device.AttachScene(attach_location, scene.texture_cache);
+				std::cout << "Attached to the scene at " << attach_location << std::endl;
+			}
+			else
+				device.UploadData(&objects);
 
-	std::cout << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << std::endl;
+			if (!publish_location.empty())
+			{
+				device.PublishScene(publish_location);
+				std::cout << "Published the scene to " << publish_location << std::endl;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
 
-	std::ofstream file;
-	file.open("test.txt", std::ofstream::trunc);
+		std::cout << "Scene geometry (KB): " << (device.GetGeometryBytes() >> 10)
+				  << std::endl;
+	}
 
-	for (int i = 0; i < width * height * 3; i += 3)
+	if (!worker_address.empty())
 	{
-		file << "(" << output[i] << "," << output[i + 1] << "," << output[i + 2] << ")" << std::endl;
+		// Serves coordinators until the process is stopped.
+		std::cout << "Serving tiles at " << worker_address << std::endl;
+		try
+		{
+			TileWorker worker = TileWorker(&device, scene.threads);
+			worker.Serve(worker_address);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
 	}
+	else if (scene.IsSequence())
+	{
+		SequenceRenderer sequence = SequenceRenderer(&device, &objects, c);
+		sequence.SetTraceRecorder(&trace);
+
+		for (int i = 0; i < objects.size(); i++)
+		{
+			SceneObjectDescription& description =
+				scene.objects[scene.object_descriptions[i]];
+			for (int k = 0; k < description.keyframes.size(); k++)
+				sequence.AddTransformKeyframe(objects[i], description.keyframes[k]);
+		}
+
+		for (int k = 0; k < scene.camera_keyframes.size(); k++)
+			sequence.AddCameraKeyframe(scene.camera_keyframes[k]);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		try
+		{
+			sequence.Render(scene.first_frame, scene.last_frame, scene.threads,
+							scene.output_location, scene.output_format);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		std::cout << "Sequence time (us): "
+				  << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()
+				  << std::endl;
+	}
+	else
+	{
+		int* output = new int[width * height * 3];
+
+		auto start = std::chrono::high_resolution_clock::now();
+		if (scene.progressive_pass_samples > 0)
+		{
+			// The output is rewritten after every pass, so it can be watched
+			// as it refines.  IsDeviceFinished is checked before the result is
+			// fetched so that the last pass is always written.
+			try
+			{
+				if (resume && std::filesystem::exists(scene.checkpoint_location))
+				{
+					device.ResumeProgressiveRender(c, scene.threads,
+												   scene.checkpoint_location);
+					std::cout << "Resumed from " << scene.checkpoint_location << std::endl;
+				}
+				else
+					device.StartProgressiveRender(c, scene.threads);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				delete[] output;
+				return 1;
+			}
+
+			// Stopping saves a last checkpoint, and the process exits once the
+			// device has finished with it.
+			if (!scene.checkpoint_location.empty())
+			{
+				std::signal(SIGINT, HandleStopSignal);
+				std::signal(SIGTERM, HandleStopSignal);
+			}
+
+			int passes_written = 0;
+			while (true)
+			{
+				if (stop_signal)
+				{
+					device.StopProgressiveRender();
+					std::cout << "Stopped, saved the checkpoint to "
+							  << scene.checkpoint_location << std::endl;
+					delete[] output;
+					return 1;
+				}
+
+				bool finished = device.IsDeviceFinished();
+				int passes = device.GetProgressiveResult(output);
+
+				if (passes > passes_written && (write_passes || finished))
+				{
+					WriteOutput(&scene, output, &trace);
+					passes_written = passes;
+
+					auto now = std::chrono::high_resolution_clock::now();
+					std::cout << "Pass " << passes << " (us): "
+							  << std::chrono::duration_cast<std::chrono::microseconds>(now - start).count()
+							  << std::endl;
+				}
+
+				if (finished)
+					break;
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+
+			device.StopProgressiveRender();
+		}
+		else if (!worker_addresses.empty())
+		{
+			try
+			{
+				RenderCoordinator coordinator = RenderCoordinator(&device, worker_addresses);
+				coordinator.SetWorkerTimeout(worker_timeout);
+				coordinator.RenderFrame(c, scene.threads, output);
+
+				std::cout << "Workers: " << coordinator.GetConnectedWorkers() << " of "
+						  << worker_addresses.size() << " connected, "
+						  << coordinator.GetRetriedRegions() << " regions retried"
+						  << std::endl;
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << std::endl;
+				delete[] output;
+				return 1;
+			}
+		}
+		else
+			device.RenderFrame(c, scene.threads, output);
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		std::cout << "Render time (us): "
+				  << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count()
+				  << std::endl;
+		std::cout << "Average samples per pixel: "
+				  << (double)device.GetSamplesTaken() / (width * height)
+				  << std::endl;
+
+		ArenaStatistics arena_statistics = device.GetArenaStatistics();
+		std::cout << "Frame arenas: " << arena_statistics.allocations
+				  << " allocations, " << (arena_statistics.peak_bytes >> 10)
+				  << " KB peak, " << (arena_statistics.reserved_bytes >> 10)
+				  << " KB reserved, " << arena_statistics.blocks_allocated
+				  << " blocks allocated" << std::endl;
+
+		if (scene.texture_cache)
+		{
+			std::cout << "Texture cache: " << scene.texture_cache->GetHits()
+					  << " hits, " << scene.texture_cache->GetMisses()
+					  << " misses, " << scene.texture_cache->GetEvictions()
+					  << " evictions" << std::endl;
+		}
+
+		if (scene.geometry_cache)
+		{
+			std::cout << "Geometry cache: " << scene.geometry_cache->GetHits()
+					  << " hits, " << scene.geometry_cache->GetMisses()
+					  << " misses, " << scene.geometry_cache->GetEvictions()
+					  << " evictions, " << (scene.geometry_cache->GetFileBytes() >> 10)
+					  << " KB on disk" << std::endl;
+		}
+
+		if (scene.progressive_pass_samples == 0)
+			WriteOutput(&scene, output, &trace);
+		if (!scene.aovs.empty())
+			WriteAOVs(&scene, &device, &trace);
+
+		delete[] output;
+	}
+
+	for (int i = 0; i < objects.size(); i++)
+		delete objects[i];
 
-	delete[] output;
+	if (trace.IsEnabled())
+		trace.WriteChromeTrace(trace_location);
 
 	return 0;
-}
\ No newline at end of file
+}
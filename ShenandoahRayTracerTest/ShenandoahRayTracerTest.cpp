@@ -1,7 +1,18 @@
 #include "pch.h"
 #include "CppUnitTest.h"
+#include <filesystem>
 #include <iostream>
 #include "../ShenandoahRayTracer/Vector.cpp"
+#include "../ShenandoahRayTracer/HalfFloat.cpp"
+#include "../ShenandoahRayTracer/Matrix.cpp"
+#include "../ShenandoahRayTracer/Transform.cpp"
+#include "../ShenandoahRayTracer/ObjectHandler.cpp"
+#include "../ShenandoahRayTracer/Sampler.cpp"
+#include "../ShenandoahRayTracer/FrameBuffer.cpp"
+#include "../ShenandoahRayTracer/Json.cpp"
+#include "../ShenandoahRayTracer/MeshImporter.cpp"
+#include "../ShenandoahRayTracer/Camera.cpp"
+#include "../ShenandoahRayTracer/RenderCheckpoint.cpp"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -291,4 +302,879 @@ namespace ShenandoahRayTracerTest
 			Assert::AreEqual(true, Vector3::Equals(expected, output, TEST_EPSILON));
 		}
 	};
+
+	TEST_CLASS(HalfFloatTest)
+	{
+	public:
+
+		TEST_METHOD(HalfFloatRoundTrip)
+		{
+			// Every half that isn't a NaN comes back exactly.
+			for (int h = 0; h < 0x10000; h++)
+			{
+				if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0)
+					continue;
+
+				unsigned short half = (unsigned short)h;
+				Assert::AreEqual(h, (int)HalfFloat::FromFloat(HalfFloat::ToFloat(half)));
+			}
+		}
+
+		TEST_METHOD(HalfFloatExactValues)
+		{
+			Assert::AreEqual(0x3c00, (int)HalfFloat::FromFloat(1.0f));
+			Assert::AreEqual(0xc000, (int)HalfFloat::FromFloat(-2.0f));
+			Assert::AreEqual(0x3800, (int)HalfFloat::FromFloat(0.5f));
+			Assert::AreEqual(0x8000, (int)HalfFloat::FromFloat(-0.0f));
+			Assert::AreEqual(1.0f, HalfFloat::ToFloat(0x3c00));
+			Assert::AreEqual(-2.0f, HalfFloat::ToFloat(0xc000));
+		}
+
+		TEST_METHOD(HalfFloatTiesToEven)
+		{
+			// Halfway between 1 and the next half up, which is odd, so it
+			// rounds down to 1.
+			Assert::AreEqual(0x3c00, (int)HalfFloat::FromFloat(1.0f + ldexpf(1, -11)));
+			// Halfway between an odd half and the even one above it.
+			Assert::AreEqual(0x3c02, (int)HalfFloat::FromFloat(1.0f + 3 * ldexpf(1, -11)));
+			// Just past halfway rounds up.
+			Assert::AreEqual(0x3c01, (int)HalfFloat::FromFloat(1.0f + ldexpf(1, -11) +
+																ldexpf(1, -20)));
+		}
+
+		TEST_METHOD(HalfFloatSubnormals)
+		{
+			float smallest = ldexpf(1, -24);
+			Assert::AreEqual(0x0001, (int)HalfFloat::FromFloat(smallest));
+			Assert::AreEqual(smallest, HalfFloat::ToFloat(0x0001));
+			Assert::AreEqual(0x8001, (int)HalfFloat::FromFloat(-smallest));
+
+			// Half of the smallest subnormal is a tie with 0, which is even.
+			Assert::AreEqual(0x0000, (int)HalfFloat::FromFloat(smallest / 2));
+			Assert::AreEqual(0x0001, (int)HalfFloat::FromFloat(smallest * 0.75f));
+
+			// The largest subnormal, and the smallest normal above it.
+			Assert::AreEqual(0x03ff, (int)HalfFloat::FromFloat(ldexpf(1023, -24)));
+			Assert::AreEqual(0x0400, (int)HalfFloat::FromFloat(ldexpf(1, -14)));
+		}
+
+		TEST_METHOD(HalfFloatOverflow)
+		{
+			Assert::AreEqual(0x7bff, (int)HalfFloat::FromFloat(65504.0f));
+			Assert::AreEqual(0x7bff, (int)HalfFloat::FromFloat(65519.0f));
+			// Halfway to the next power of two rounds up to infinity.
+			Assert::AreEqual(0x7c00, (int)HalfFloat::FromFloat(65520.0f));
+			Assert::AreEqual(0xfc00, (int)HalfFloat::FromFloat(-65520.0f));
+			Assert::AreEqual(0x7c00, (int)HalfFloat::FromFloat(1e10f));
+		}
+
+		TEST_METHOD(HalfFloatInfinityAndNaN)
+		{
+			Assert::AreEqual(0x7c00, (int)HalfFloat::FromFloat(INFINITY));
+			Assert::AreEqual(0xfc00, (int)HalfFloat::FromFloat(-INFINITY));
+			Assert::AreEqual(INFINITY, HalfFloat::ToFloat(0x7c00));
+			Assert::AreEqual(-INFINITY, HalfFloat::ToFloat(0xfc00));
+
+			unsigned short nan = HalfFloat::FromFloat(NAN);
+			Assert::AreEqual(0x7c00, nan & 0x7c00);
+			Assert::AreNotEqual(0, nan & 0x3ff);
+			Assert::IsTrue(std::isnan(HalfFloat::ToFloat(nan)));
+		}
+	};
+
+	TEST_CLASS(ObjectHandlerTest)
+	{
+	public:
+
+		// A unit square made of two triangles, with a copy of one corner,
+		// a triangle with no area along the bottom edge, and a UV that only
+		// that triangle uses.
+		static ObjectHandler MakeUnweldedSquare()
+		{
+			float vertices[] = { 0, 0, 0, 1,   1, 0, 0, 1,   1, 1, 0, 1,
+								 0, 1, 0, 1,   1, 0, 0, 1,   2, 0, 0, 1 };
+			float uvs[] = { 0, 0,   1, 0,   1, 1,   0, 1,   0.5, 0.5,   1, 0 };
+			int triangles[] = { 0, 1, 2,   4, 2, 3,   0, 1, 5 };
+			int triangle_uvs[] = { 0, 1, 2,   5, 2, 3,   0, 1, 4 };
+
+			return ObjectHandler(vertices, 6, uvs, 6, triangles, 3, triangle_uvs,
+								 Transform(), "Square");
+		}
+
+		// Gets the corners of every triangle as their vertex and UV, with the
+		// triangles sorted, so that objects that render the same compare equal
+		// however their geometry is numbered.
+		static std::vector<std::vector<float>> GetCorners(ObjectHandler& obj)
+		{
+			std::vector<float> vertices(obj.GetNumVertices() * 4);
+			std::vector<float> uvs(obj.GetNumUVs() * 2);
+			std::vector<int> triangles(obj.GetNumTriangles() * 3);
+			std::vector<int> triangle_uvs(obj.GetNumTriangles() * 3);
+			obj.CopyRawVertices(vertices.data());
+			obj.CopyUVs(uvs.data());
+			obj.CopyTriangles(triangles.data());
+			obj.CopyTriangleUVs(triangle_uvs.data());
+
+			std::vector<std::vector<float>> corners;
+			for (int t = 0; t < obj.GetNumTriangles(); t++)
+			{
+				std::vector<float> triangle;
+				for (int k = 0; k < 3; k++)
+				{
+					int vertex = triangles[t * 3 + k];
+					int uv = triangle_uvs[t * 3 + k];
+					triangle.insert(triangle.end(), &vertices[vertex * 4], &vertices[vertex * 4 + 3]);
+					triangle.insert(triangle.end(), &uvs[uv * 2], &uvs[uv * 2 + 2]);
+				}
+				corners.push_back(triangle);
+			}
+			std::sort(corners.begin(), corners.end());
+			return corners;
+		}
+
+		TEST_METHOD(ObjectHandlerWeldCounts)
+		{
+			ObjectHandler obj = MakeUnweldedSquare();
+			WeldStatistics statistics = obj.Weld();
+
+			// The copied corner is merged, and the vertex and UV that only
+			// the triangle with no area used are dropped with it.
+			Assert::AreEqual(4, obj.GetNumVertices());
+			Assert::AreEqual(4, obj.GetNumUVs());
+			Assert::AreEqual(2, obj.GetNumTriangles());
+			Assert::AreEqual(2, statistics.vertices_removed);
+			Assert::AreEqual(2, statistics.uvs_removed);
+			Assert::AreEqual(1, statistics.triangles_removed);
+		}
+
+		TEST_METHOD(ObjectHandlerWeldKeepsCorners)
+		{
+			ObjectHandler obj = MakeUnweldedSquare();
+			obj.Weld();
+
+			// The same square without the triangle that has no area.
+			float vertices[] = { 0, 0, 0, 1,   1, 0, 0, 1,   1, 1, 0, 1,   0, 1, 0, 1 };
+			float uvs[] = { 0, 0,   1, 0,   1, 1,   0, 1 };
+			int triangles[] = { 0, 1, 2,   1, 2, 3 };
+			ObjectHandler expected(vertices, 4, uvs, 4, triangles, 2, triangles,
+								   Transform(), "Square");
+
+			Assert::IsTrue(GetCorners(expected) == GetCorners(obj));
+		}
+
+		TEST_METHOD(ObjectHandlerWeldNearlyCollinear)
+		{
+			// The third corner is 1e-7 off the line through the first two,
+			// so the cross product isn't zero, but the triangle is still far
+			// too thin to ever be hit.  The second triangle is thin as well,
+			// but a real one, and is kept.
+			float vertices[] = { 0, 0, 0, 1,   1, 0.0000001f, 0, 1,   3, 0, 0, 1,
+								 0, 1, 0, 1,   3, 1.001f, 0, 1 };
+			int triangles[] = { 0, 1, 2,   0, 3, 4 };
+			ObjectHandler obj(vertices, 5, nullptr, 0, triangles, 2, triangles,
+							  Transform(), "Slivers");
+
+			float edge1[3] = { 1, 0.0000001f, 0 };
+			float edge2[3] = { 3, 0, 0 };
+			float cross[3];
+			Vector3::Cross(edge1, edge2, cross);
+			Assert::AreNotEqual(0.0f, cross[2]);
+
+			WeldStatistics statistics = obj.Weld();
+			Assert::AreEqual(1, statistics.triangles_removed);
+			Assert::AreEqual(2, statistics.vertices_removed);
+			Assert::AreEqual(1, obj.GetNumTriangles());
+		}
+
+		TEST_METHOD(ObjectHandlerWeldTwice)
+		{
+			ObjectHandler obj = MakeUnweldedSquare();
+			obj.Weld();
+			WeldStatistics statistics = obj.Weld();
+
+			Assert::AreEqual(0, statistics.vertices_removed);
+			Assert::AreEqual(0, statistics.uvs_removed);
+			Assert::AreEqual(0, statistics.triangles_removed);
+		}
+
+		TEST_METHOD(ObjectHandlerEqualGeometry)
+		{
+			ObjectHandler a = MakeUnweldedSquare();
+			ObjectHandler b = MakeUnweldedSquare();
+			b.transform.SetOrigin(Vector3(1, 2, 3));
+			b.name = "Other Square";
+
+			// The two don't share their geometry, but it is the same, and
+			// only the geometry is compared.
+			Assert::IsFalse(a.SharesGeometry(b));
+			Assert::IsTrue(a.HasSameGeometry(b));
+			Assert::IsTrue(a.GetGeometryHash() == b.GetGeometryHash());
+
+			a.Weld();
+			b.Weld();
+			Assert::IsTrue(a.HasSameGeometry(b));
+			Assert::IsTrue(a.GetGeometryHash() == b.GetGeometryHash());
+		}
+
+		TEST_METHOD(ObjectHandlerDifferentGeometry)
+		{
+			ObjectHandler a = MakeUnweldedSquare();
+			ObjectHandler b = MakeUnweldedSquare();
+			b.Weld();
+
+			Assert::IsFalse(a.HasSameGeometry(b));
+			Assert::IsFalse(a.GetGeometryHash() == b.GetGeometryHash());
+		}
+
+		TEST_METHOD(ObjectHandlerReorderKeepsCorners)
+		{
+			// A 4 by 4 grid of squares, with the triangles in an order that
+			// jumps around it.
+			const int size = 4;
+			std::vector<float> vertices;
+			std::vector<float> uvs;
+			for (int y = 0; y <= size; y++)
+			{
+				for (int x = 0; x <= size; x++)
+				{
+					vertices.insert(vertices.end(), { (float)x, (float)y, 0, 1 });
+					uvs.insert(uvs.end(), { (float)x / size, (float)y / size });
+				}
+			}
+
+			std::vector<int> triangles;
+			for (int i = 0; i < size * size; i++)
+			{
+				int square = (i * 7) % (size * size);
+				int corner = square / size * (size + 1) + square % size;
+				triangles.insert(triangles.end(), { corner, corner + 1, corner + size + 2,
+													corner, corner + size + 2, corner + size + 1 });
+			}
+
+			int num_triangles = triangles.size() / 3;
+			ObjectHandler obj(vertices.data(), vertices.size() / 4, uvs.data(), uvs.size() / 2,
+							  triangles.data(), num_triangles, triangles.data(),
+							  Transform(), "Grid");
+			std::vector<std::vector<float>> corners = GetCorners(obj);
+			obj.Reorder();
+
+			Assert::AreEqual((int)vertices.size() / 4, obj.GetNumVertices());
+			Assert::AreEqual((int)uvs.size() / 2, obj.GetNumUVs());
+			Assert::AreEqual(num_triangles, obj.GetNumTriangles());
+			Assert::IsTrue(corners == GetCorners(obj));
+
+			// Vertices are numbered in the order the triangles first use them.
+			std::vector<int> reordered(num_triangles * 3);
+			obj.CopyTriangles(reordered.data());
+			int next = 0;
+			for (int index : reordered)
+			{
+				Assert::IsTrue(index <= next);
+				if (index == next)
+					next++;
+			}
+		}
+	};
+
+	TEST_CLASS(SamplerTest)
+	{
+	public:
+
+		// Takes samples first_sample onwards of every pixel of a 40 by 25
+		// image, in sets of samples_per_pixel, and gets the fraction that
+		// land in each quadrant of their pixel.
+		static void GetQuadrantFractions(SamplerType type, int first_sample,
+										 int num_samples, int samples_per_pixel,
+										 float* output_location)
+		{
+			Sampler sampler(type, 0);
+			int counts[4] = { 0, 0, 0, 0 };
+			std::vector<float> samples(num_samples * 2);
+
+			for (int j = 0; j < 25; j++)
+			{
+				for (int i = 0; i < 40; i++)
+				{
+					sampler.GetPixelSamples(i, j, first_sample, num_samples,
+											samples_per_pixel, samples.data());
+					for (int s = 0; s < num_samples; s++)
+						counts[(samples[s * 2] >= 0.5f) + (samples[s * 2 + 1] >= 0.5f) * 2]++;
+				}
+			}
+
+			for (int q = 0; q < 4; q++)
+				output_location[q] = counts[q] / (1000.0f * num_samples);
+		}
+
+		TEST_METHOD(SamplerRange)
+		{
+			SamplerType types[] = { SamplerType::Center, SamplerType::Stratified,
+									SamplerType::Halton, SamplerType::Sobol,
+									SamplerType::BlueNoise };
+			for (SamplerType type : types)
+			{
+				Sampler sampler(type, 7);
+				float samples[2 * 37];
+				for (int i = 0; i < 20; i++)
+				{
+					sampler.GetPixelSamples(i, i * 3, 5, 37, 10, samples);
+					for (float value : samples)
+						Assert::IsTrue(value >= 0 && value < 1);
+				}
+			}
+		}
+
+		TEST_METHOD(SamplerRepeatable)
+		{
+			// A sample is the same whether it is taken alone or in a batch.
+			Sampler sampler(SamplerType::Stratified, 3);
+			float batch[2 * 8];
+			sampler.GetPixelSamples(4, 9, 0, 8, 8, batch);
+			for (int s = 0; s < 8; s++)
+			{
+				float single[2];
+				sampler.GetPixelSamples(4, 9, s, 1, 8, single);
+				Assert::AreEqual(batch[s * 2], single[0]);
+				Assert::AreEqual(batch[s * 2 + 1], single[1]);
+			}
+		}
+
+		TEST_METHOD(SamplerStratifiedOneSamplePerCell)
+		{
+			// Sets of 6 samples use a grid of 2 columns by 3 rows, and every
+			// set puts one sample in each cell.
+			Sampler sampler(SamplerType::Stratified, 0);
+			for (int set = 0; set < 4; set++)
+			{
+				float samples[2 * 6];
+				sampler.GetPixelSamples(3, 5, set * 6, 6, 6, samples);
+
+				bool used[6] = { false, false, false, false, false, false };
+				for (int s = 0; s < 6; s++)
+				{
+					int cell = (int)(samples[s * 2] * 2) + (int)(samples[s * 2 + 1] * 3) * 2;
+					Assert::IsFalse(used[cell]);
+					used[cell] = true;
+				}
+			}
+		}
+
+		TEST_METHOD(SamplerStratifiedEvenCoverage)
+		{
+			// Counts that aren't square, or have no divisors at all, still
+			// cover every part of the pixel equally.
+			int counts[] = { 2, 3, 5, 6, 7, 12 };
+			for (int spp : counts)
+			{
+				float fractions[4];
+				GetQuadrantFractions(SamplerType::Stratified, 0, spp, spp, fractions);
+				for (int q = 0; q < 4; q++)
+					Assert::IsTrue(fabs(fractions[q] - 0.25f) < 0.03f);
+			}
+		}
+
+		TEST_METHOD(SamplerStratifiedShortSet)
+		{
+			// A last pass that is cut short after 3 of its 16 samples, which
+			// starts at a sample that isn't a multiple of the set size.
+			float fractions[4];
+			GetQuadrantFractions(SamplerType::Stratified, 32, 3, 16, fractions);
+			for (int q = 0; q < 4; q++)
+				Assert::IsTrue(fabs(fractions[q] - 0.25f) < 0.03f);
+
+			GetQuadrantFractions(SamplerType::Stratified, 5, 11, 16, fractions);
+			for (int q = 0; q < 4; q++)
+				Assert::IsTrue(fabs(fractions[q] - 0.25f) < 0.03f);
+		}
+
+		TEST_METHOD(SamplerPermute)
+		{
+			for (unsigned int n = 1; n < 70; n++)
+			{
+				std::vector<bool> seen(n, false);
+				for (unsigned int i = 0; i < n; i++)
+				{
+					unsigned int value = Sampler::Permute(i, n, n * 0x9E3779B9u);
+					Assert::IsTrue(value < n);
+					Assert::IsFalse(seen[value]);
+					seen[value] = true;
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(FrameBufferTest)
+	{
+	public:
+
+		// A colour for sample s of a pixel, which varies enough to have a
+		// variance worth checking.
+		static void GetTestColor(int pixel, int s, float* output_location)
+		{
+			output_location[0] = (float)((s * 37 + pixel * 11) % 17);
+			output_location[1] = (float)((s * 53 + pixel * 5) % 23) * 0.5f;
+			output_location[2] = (float)(s % 3) + pixel;
+		}
+
+		TEST_METHOD(FrameBufferVariance)
+		{
+			// The sample variance of the luminance, worked out in two passes.
+			FrameBuffer frame(1, 1);
+			std::vector<double> luminances;
+			for (int s = 0; s < 10; s++)
+			{
+				float color[3];
+				GetTestColor(0, s, color);
+				frame.AddSample(0, color);
+				luminances.push_back(FrameBuffer::GetLuminance(color));
+			}
+
+			double mean = 0;
+			for (double l : luminances)
+				mean += l / luminances.size();
+			double variance = 0;
+			for (double l : luminances)
+				variance += (l - mean) * (l - mean) / (luminances.size() - 1);
+
+			Assert::AreEqual(10, frame.GetSampleCount(0));
+			Assert::AreEqual((float)variance, frame.GetVariance(0), 0.0001f);
+
+			FrameBuffer single(1, 1);
+			float color[3] = { 1, 2, 3 };
+			single.AddSample(0, color);
+			Assert::AreEqual(INFINITY, single.GetVariance(0));
+		}
+
+		TEST_METHOD(FrameBufferAddMatchesSamples)
+		{
+			// Pixels get their samples split between two buffers in
+			// different ways, including not at all, and adding them must
+			// give what adding every sample to one buffer gives.
+			const int pixels = 4;
+			int first_counts[pixels] = { 0, 3, 7, 5 };
+			int second_counts[pixels] = { 4, 0, 9, 1 };
+
+			FrameBuffer first(pixels, 1);
+			FrameBuffer second(pixels, 1);
+			FrameBuffer all(pixels, 1);
+			for (int p = 0; p < pixels; p++)
+			{
+				for (int s = 0; s < first_counts[p] + second_counts[p]; s++)
+				{
+					float color[3];
+					GetTestColor(p, s, color);
+					(s < first_counts[p] ? first : second).AddSample(p, color);
+					all.AddSample(p, color);
+				}
+			}
+
+			first.Add(&second);
+			for (int p = 0; p < pixels; p++)
+			{
+				Assert::AreEqual(all.GetSampleCount(p), first.GetSampleCount(p));
+
+				float expected[3], actual[3];
+				all.GetColor(p, expected);
+				first.GetColor(p, actual);
+				for (int c = 0; c < 3; c++)
+					Assert::AreEqual(expected[c], actual[c], 0.0001f);
+
+				Assert::AreEqual(all.GetVariance(p), first.GetVariance(p),
+								 0.0001f * fmax(1.0f, all.GetVariance(p)));
+			}
+		}
+
+		TEST_METHOD(FrameBufferAddDifferentSizes)
+		{
+			FrameBuffer a(2, 2);
+			FrameBuffer b(2, 3);
+			bool thrown = false;
+			try
+			{
+				a.Add(&b);
+			}
+			catch (const std::invalid_argument&)
+			{
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+		}
+	};
+
+	TEST_CLASS(JsonValueTest)
+	{
+	public:
+
+		static bool ParseFails(const std::string& text)
+		{
+			try
+			{
+				JsonValue::Parse(text);
+			}
+			catch (const std::invalid_argument&)
+			{
+				return true;
+			}
+			return false;
+		}
+
+		TEST_METHOD(JsonParseObject)
+		{
+			JsonValue root = JsonValue::Parse(
+				" { \"name\": \"box\", \"count\": -12, \"scale\": 2.5e-1,\n"
+				"   \"flags\": [true, false, null], \"empty\": {} } ");
+
+			Assert::IsTrue(root.type == JsonValue::Type::Object);
+			Assert::AreEqual(5, root.GetSize());
+			Assert::AreEqual(std::string("box"), root.GetString("name", ""));
+			Assert::AreEqual(-12, root.GetInt("count", 0));
+			Assert::AreEqual(0.25, root.GetNumber("scale", 0));
+			Assert::AreEqual(7.0, root.GetNumber("missing", 7));
+			Assert::IsFalse(root.Has("missing"));
+
+			const JsonValue& flags = root.Get("flags");
+			Assert::AreEqual(3, flags.GetSize());
+			Assert::IsTrue(flags.At(0).boolean);
+			Assert::IsFalse(flags.At(1).boolean);
+			Assert::IsTrue(flags.At(2).type == JsonValue::Type::Null);
+			Assert::AreEqual(0, root.Get("empty").GetSize());
+		}
+
+		TEST_METHOD(JsonParseEscapes)
+		{
+			// U+00E9 is two bytes of UTF-8, and U+1F600 is written as a
+			// surrogate pair and comes out as four.
+			JsonValue root = JsonValue::Parse(
+				"[\"a\\\"b\\\\c\\/d\\n\\t\", \"\\u0041\\u00e9\", \"\\ud83d\\ude00\"]");
+
+			Assert::AreEqual(std::string("a\"b\\c/d\n\t"), root.At(0).string);
+			Assert::AreEqual(std::string("A\xC3\xA9"), root.At(1).string);
+			Assert::AreEqual(std::string("\xF0\x9F\x98\x80"), root.At(2).string);
+		}
+
+		TEST_METHOD(JsonParseInvalid)
+		{
+			Assert::IsTrue(ParseFails(""));
+			Assert::IsTrue(ParseFails("{"));
+			Assert::IsTrue(ParseFails("[1, 2"));
+			Assert::IsTrue(ParseFails("{\"a\" 1}"));
+			Assert::IsTrue(ParseFails("\"unterminated"));
+			Assert::IsTrue(ParseFails("tru"));
+			Assert::IsTrue(ParseFails("1 2"));
+			Assert::IsTrue(ParseFails(std::string(1000, '[') + std::string(1000, ']')));
+			Assert::IsFalse(ParseFails("[[[]]]"));
+		}
+
+		TEST_METHOD(JsonWrongTypeThrows)
+		{
+			JsonValue root = JsonValue::Parse("{\"a\": [1], \"b\": \"text\"}");
+
+			bool thrown = false;
+			try
+			{
+				root.GetInt("b", 0);
+			}
+			catch (const std::invalid_argument&)
+			{
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+
+			thrown = false;
+			try
+			{
+				root.Get("a").At(1);
+			}
+			catch (const std::invalid_argument&)
+			{
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+		}
+	};
+
+	TEST_CLASS(MeshImporterTest)
+	{
+	public:
+
+		TEST_METHOD(DecodeBase64)
+		{
+			std::vector<char> decoded = MeshImporter::DecodeBase64("TWFu");
+			Assert::AreEqual(std::string("Man"), std::string(decoded.begin(), decoded.end()));
+
+			// Padding, in both lengths.
+			decoded = MeshImporter::DecodeBase64("TWE=");
+			Assert::AreEqual(std::string("Ma"), std::string(decoded.begin(), decoded.end()));
+			decoded = MeshImporter::DecodeBase64("TQ==");
+			Assert::AreEqual(std::string("M"), std::string(decoded.begin(), decoded.end()));
+
+			// Every byte value, in the standard and the URL safe alphabets,
+			// with a line break in the middle that is skipped.
+			decoded = MeshImporter::DecodeBase64("AP+A/w==");
+			Assert::AreEqual(4, (int)decoded.size());
+			Assert::AreEqual((int)(unsigned char)0x00, (int)(unsigned char)decoded[0]);
+			Assert::AreEqual((int)(unsigned char)0xFF, (int)(unsigned char)decoded[1]);
+			Assert::AreEqual((int)(unsigned char)0x80, (int)(unsigned char)decoded[2]);
+			Assert::AreEqual((int)(unsigned char)0xFF, (int)(unsigned char)decoded[3]);
+			Assert::IsTrue(MeshImporter::DecodeBase64("AP-A\n_w") == decoded);
+
+			Assert::AreEqual(0, (int)MeshImporter::DecodeBase64("").size());
+		}
+
+		// Appends a value to a binary PLY body in the given byte order.
+		template <typename T>
+		static void AppendValue(std::string* body, T value, bool big_endian)
+		{
+			char bytes[sizeof(T)];
+			memcpy(bytes, &value, sizeof(T));
+
+			// The tests run on little endian machines.
+			if (big_endian)
+				std::reverse(bytes, bytes + sizeof(T));
+			body->append(bytes, sizeof(T));
+		}
+
+		// Writes a square as one quad, with UVs and a property that isn't
+		// used, and loads it back.
+		static void CheckBinaryPLY(bool big_endian)
+		{
+			std::string contents = std::string("ply\n") +
+				"format " + (big_endian ? "binary_big_endian" : "binary_little_endian") + " 1.0\n"
+				"comment written by the tests\n"
+				"element vertex 4\n"
+				"property float x\n"
+				"property float y\n"
+				"property float z\n"
+				"property ushort flags\n"
+				"property double s\n"
+				"property double t\n"
+				"element face 1\n"
+				"property list uchar int vertex_indices\n"
+				"end_header\n";
+
+			float positions[] = { 0, 0, 0,   2, 0, 0,   2, 3, 0,   0, 3, 1 };
+			double uvs[] = { 0, 0,   1, 0,   1, 1,   0, 1 };
+			for (int i = 0; i < 4; i++)
+			{
+				for (int k = 0; k < 3; k++)
+					AppendValue(&contents, positions[i * 3 + k], big_endian);
+				AppendValue(&contents, (unsigned short)(0x1234 + i), big_endian);
+				AppendValue(&contents, uvs[i * 2], big_endian);
+				AppendValue(&contents, uvs[i * 2 + 1], big_endian);
+			}
+			AppendValue(&contents, (unsigned char)4, big_endian);
+			for (int i = 0; i < 4; i++)
+				AppendValue(&contents, i, big_endian);
+
+			std::filesystem::path location = std::filesystem::temp_directory_path() /
+				(big_endian ? "ShenandoahRayTracerTest_big.ply" : "ShenandoahRayTracerTest_little.ply");
+			{
+				std::ofstream file(location, std::ios::binary);
+				file.write(contents.data(), contents.size());
+			}
+
+			ObjectHandler* obj = MeshImporter::LoadPLY(location.string());
+			std::filesystem::remove(location);
+
+			Assert::AreEqual(4, obj->GetNumVertices());
+			Assert::AreEqual(2, obj->GetNumTriangles());
+			Assert::AreEqual(4, obj->GetNumUVs());
+
+			float vertices[16];
+			obj->CopyRawVertices(vertices);
+			for (int i = 0; i < 4; i++)
+			{
+				for (int k = 0; k < 3; k++)
+					Assert::AreEqual(positions[i * 3 + k], vertices[i * 4 + k]);
+				Assert::AreEqual(1.0f, vertices[i * 4 + 3]);
+			}
+
+			float loaded_uvs[8];
+			obj->CopyUVs(loaded_uvs);
+			for (int i = 0; i < 8; i++)
+				Assert::AreEqual((float)uvs[i], loaded_uvs[i]);
+
+			// The quad is split into a fan around its first corner.
+			int triangles[6];
+			int expected[] = { 0, 1, 2,   0, 2, 3 };
+			obj->CopyTriangles(triangles);
+			for (int i = 0; i < 6; i++)
+				Assert::AreEqual(expected[i], triangles[i]);
+
+			delete obj;
+		}
+
+		TEST_METHOD(LoadBinaryPLYLittleEndian)
+		{
+			CheckBinaryPLY(false);
+		}
+
+		TEST_METHOD(LoadBinaryPLYBigEndian)
+		{
+			CheckBinaryPLY(true);
+		}
+	};
+
+	TEST_CLASS(RenderCheckpointTest)
+	{
+	public:
+
+		// A checkpoint partway through a render, with every setting changed
+		// from its default.
+		static RenderCheckpoint MakeCheckpoint()
+		{
+			RenderCheckpoint checkpoint;
+			checkpoint.camera = Camera(Vector3(1, 2, 3), Vector3(0, 0, 1), Vector3(1, 0, 0),
+									   3, 2, 45, 1.5f);
+			checkpoint.samples_per_pixel = 64;
+			checkpoint.pass_samples = 4;
+			checkpoint.render_mode = RenderMode::TraversalHeatmap;
+			checkpoint.sampler_type = SamplerType::Stratified;
+			checkpoint.sampler_seed = 1234;
+			checkpoint.filter_type = FilterType::Gaussian;
+			checkpoint.adaptive_threshold = 0.01f;
+			checkpoint.adaptive_min_samples = 8;
+			checkpoint.integrator = IntegratorType::PathTracer;
+			checkpoint.max_depth = 6;
+			checkpoint.russian_roulette_depth = 3;
+			checkpoint.background[0] = 0.1f;
+			checkpoint.background[1] = 0.2f;
+			checkpoint.background[2] = 0.3f;
+			checkpoint.mesh_encoding = MeshEncoding::Compact;
+			checkpoint.scene_hash = 0x0123456789ABCDEFull;
+			checkpoint.passes = 5;
+			checkpoint.next_sample = 20;
+			checkpoint.samples_taken = 120;
+			checkpoint.elapsed_milliseconds = 98765;
+
+			PointLight light;
+			light.position[0] = 4;
+			light.intensity[2] = 7;
+			checkpoint.lights.push_back(light);
+			light.position[1] = -2;
+			checkpoint.lights.push_back(light);
+
+			checkpoint.frame = FrameBuffer(3, 2);
+			for (int p = 0; p < 6; p++)
+			{
+				for (int s = 0; s < p + 1; s++)
+				{
+					float color[3];
+					FrameBufferTest::GetTestColor(p, s, color);
+					checkpoint.frame.AddSample(p, color);
+				}
+				checkpoint.costs.push_back(p * 100);
+			}
+
+			return checkpoint;
+		}
+
+		static std::string GetTestLocation()
+		{
+			return (std::filesystem::temp_directory_path() /
+					"ShenandoahRayTracerTest.checkpoint").string();
+		}
+
+		static bool ReadFails(std::string location)
+		{
+			try
+			{
+				RenderCheckpoint::Read(location);
+			}
+			catch (const std::invalid_argument&)
+			{
+				return true;
+			}
+			return false;
+		}
+
+		TEST_METHOD(CheckpointRoundTrip)
+		{
+			RenderCheckpoint checkpoint = MakeCheckpoint();
+			std::string location = GetTestLocation();
+			checkpoint.Write(location);
+			RenderCheckpoint loaded = RenderCheckpoint::Read(location);
+			std::filesystem::remove(location);
+
+			// Throws if any of the settings came back different.
+			checkpoint.CheckCompatible(&loaded);
+
+			Assert::IsTrue(loaded.camera.Equals(checkpoint.camera));
+			Assert::AreEqual(2, (int)loaded.lights.size());
+			Assert::AreEqual(-2.0f, loaded.lights[1].position[1]);
+			Assert::AreEqual(7.0f, loaded.lights[1].intensity[2]);
+			Assert::AreEqual(5, loaded.passes);
+			Assert::AreEqual(20, loaded.next_sample);
+			Assert::AreEqual(120LL, loaded.samples_taken);
+			Assert::AreEqual(98765LL, loaded.elapsed_milliseconds);
+			Assert::IsTrue(loaded.costs == checkpoint.costs);
+
+			Assert::AreEqual(3, loaded.frame.GetWidth());
+			Assert::AreEqual(2, loaded.frame.GetHeight());
+			for (int p = 0; p < 6; p++)
+			{
+				Assert::AreEqual(checkpoint.frame.GetSampleCount(p), loaded.frame.GetSampleCount(p));
+
+				float expected[3], actual[3];
+				checkpoint.frame.GetColor(p, expected);
+				loaded.frame.GetColor(p, actual);
+				for (int c = 0; c < 3; c++)
+					Assert::AreEqual(expected[c], actual[c]);
+				Assert::AreEqual(checkpoint.frame.GetVariance(p), loaded.frame.GetVariance(p));
+			}
+		}
+
+		TEST_METHOD(CheckpointIncompatible)
+		{
+			RenderCheckpoint checkpoint = MakeCheckpoint();
+			RenderCheckpoint other = MakeCheckpoint();
+			other.lights[1].intensity[0] = 2;
+
+			bool thrown = false;
+			try
+			{
+				checkpoint.CheckCompatible(&other);
+			}
+			catch (const std::invalid_argument&)
+			{
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+		}
+
+		TEST_METHOD(CheckpointRejectsDamage)
+		{
+			std::string location = GetTestLocation();
+			MakeCheckpoint().Write(location);
+
+			std::vector<char> data;
+			{
+				std::ifstream file(location, std::ios::binary);
+				data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+
+			// Cut short inside the pixels, inside the header, and by just the
+			// last byte of the checksum.
+			size_t lengths[] = { data.size() / 2, 10, data.size() - 1 };
+			for (size_t length : lengths)
+			{
+				{
+					std::ofstream file(location, std::ios::binary | std::ios::trunc);
+					file.write(data.data(), length);
+				}
+				Assert::IsTrue(ReadFails(location));
+			}
+
+			// Whole, but with one bit of the traversal costs flipped.
+			data[data.size() - 20] ^= 1;
+			{
+				std::ofstream file(location, std::ios::binary | std::ios::trunc);
+				file.write(data.data(), data.size());
+			}
+			Assert::IsTrue(ReadFails(location));
+
+			std::filesystem::remove(location);
+			Assert::IsTrue(ReadFails(location));
+		}
+	};
 }